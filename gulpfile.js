@@ -5,6 +5,7 @@ const through = require("through2");
 const path = require("path");
 const fs = require("fs");
 const readline = require("readline");
+const zlib = require("zlib");
 
 const destination = "new_http.c";
 
@@ -17,6 +18,64 @@ function dumpFileSize() {
   });
 }
 
+/** This function replaces the region of a field in new_http.c with output */
+function writeRegion(file, field_name, output, cb) {
+  const target_path = path.join(path.dirname(file.path), destination);
+  //console.log(`Updated ${target_path}`);
+
+  const rl = readline.createInterface({
+    input: fs.createReadStream(target_path),
+    crlfDelay: Infinity,
+  });
+
+  const merged_contents = [];
+  const marker_start = `//region_start ${field_name}`;
+  const marker_end = `//region_end ${field_name}`;
+  let region_state = 0;
+
+  rl.on("line", (line) => {
+    if (line.trim() === marker_start) {
+      region_state = 1;
+      merged_contents.push(marker_start);
+      merged_contents.push(output);
+      merged_contents.push(marker_end);
+    } else {
+      //Skip all existing content lines till region ends
+      if (region_state === 1) {
+        if (line.trim() === marker_end) {
+          region_state = 2;
+        }
+      } else {
+        merged_contents.push(line);
+      }
+    }
+  });
+
+  rl.on("close", () => {
+    if (region_state === 0) {
+      //Starting marker was not found, append
+
+      merged_contents.push("");
+      merged_contents.push(marker_start);
+      merged_contents.push(output);
+      merged_contents.push(marker_end);
+    }
+
+    if (region_state === 1) {
+      cb(`Ending marker "${marker_end}" was not found.`, file);
+    } else {
+      fs.writeFile(
+        target_path,
+        merged_contents.join("\r\n"),
+        "utf8",
+        (err) => {
+          cb(err, file);
+        }
+      );
+    }
+  });
+}
+
 /** This function injects C for a const field in new_http.c */
 function generateCode(field_name, is_script) {
   return through.obj(function (file, enc, cb) {
@@ -33,61 +92,33 @@ function generateCode(field_name, is_script) {
       const suffix = is_script ? "</script>" : "</style>";
       output = `const char ${field_name}[] = "${prefix}${output}${suffix}";`;
 
-      const target_path = path.join(path.dirname(file.path), destination);
-      //console.log(`Updated ${target_path}`);
-
-      const rl = readline.createInterface({
-        input: fs.createReadStream(target_path),
-        crlfDelay: Infinity,
-      });
-
-      const merged_contents = [];
-      const marker_start = `//region_start ${field_name}`;
-      const marker_end = `//region_end ${field_name}`;
-      let region_state = 0;
-
-      rl.on("line", (line) => {
-        if (line.trim() === marker_start) {
-          region_state = 1;
-          merged_contents.push(marker_start);
-          merged_contents.push(output);
-          merged_contents.push(marker_end);
-        } else {
-          //Skip all existing content lines till region ends
-          if (region_state === 1) {
-            if (line.trim() === marker_end) {
-              region_state = 2;
-            }
-          } else {
-            merged_contents.push(line);
-          }
-        }
-      });
-
-      rl.on("close", () => {
-        if (region_state === 0) {
-          //Starting marker was not found, append
-
-          merged_contents.push("");
-          merged_contents.push(marker_start);
-          merged_contents.push(output);
-          merged_contents.push(marker_end);
-        }
+      writeRegion(file, field_name, output, cb);
+      return;
+    }
 
-        if (region_state === 1) {
-          cb(`Ending marker "${marker_end}" was not found.`, file);
-        } else {
-          fs.writeFile(
-            target_path,
-            merged_contents.join("\r\n"),
-            "utf8",
-            (err) => {
-              cb(err, file);
-            }
-          );
-        }
-      });
+    cb(null, file);
+  });
+}
 
+/** This function injects the gzipped contents as a const byte array in new_http.c */
+function generateGzipCode(field_name) {
+  return through.obj(function (file, enc, cb) {
+    if (file.isBuffer()) {
+      const gz = zlib.gzipSync(file.contents, { level: 9 });
+      console.log(`Processing ${file.basename}, gzipped length ${gz.length}`);
+
+      const lines = [];
+      for (let i = 0; i < gz.length; i += 16) {
+        const bytes = Array.from(gz.subarray(i, i + 16), (b) =>
+          "0x" + b.toString(16).padStart(2, "0")
+        );
+        lines.push(bytes.join(",") + ",");
+      }
+      const output = `const unsigned char ${field_name}[] = {\r\n${lines.join(
+        "\r\n"
+      )}\r\n};`;
+
+      writeRegion(file, field_name, output, cb);
       return;
     }
 
@@ -100,7 +131,8 @@ function minifyJs() {
     .src("./src/httpserver/script.js")
     .pipe(dumpFileSize())
     .pipe(uglify())
-    .pipe(generateCode("pageScript", true));
+    .pipe(generateCode("pageScript", true))
+    .pipe(generateGzipCode("pageScriptGz"));
 }
 
 function minifyHassDiscoveryJs() {
@@ -116,7 +148,8 @@ function minifyCss() {
     .src("./src/httpserver/style.css")
     .pipe(dumpFileSize())
     .pipe(cssnano())
-    .pipe(generateCode("htmlHeadStyle", false));
+    .pipe(generateCode("htmlHeadStyle", false))
+    .pipe(generateGzipCode("htmlHeadStyleGz"));
 }
 
 exports.default = gulp.series(minifyJs, minifyHassDiscoveryJs, minifyCss);
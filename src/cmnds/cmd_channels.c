@@ -371,7 +371,7 @@ static commandResult_t CMD_GetReadings(const void *context, const char *cmd, con
 	snprintf(tmp, sizeof(tmp), "%f %f %f %f %f",v,c,p,e,elh);
 
 	if(cmdFlags & COMMAND_FLAG_SOURCE_TCP) {
-		ADDLOG_INFO(LOG_FEATURE_RAW, tmp);
+		ADDLOG_INFO(LOG_FEATURE_RAW, "%s", tmp);
 	} else {
 		ADDLOG_INFO(LOG_FEATURE_CMD, "Readings are %s",tmp);
 	}
@@ -385,7 +385,7 @@ static commandResult_t CMD_ShortName(const void *context, const char *cmd, const
 	s = CFG_GetShortDeviceName();
 	if (Tokenizer_GetArgsCount() == 0) {
 		if (cmdFlags & COMMAND_FLAG_SOURCE_TCP) {
-			ADDLOG_INFO(LOG_FEATURE_RAW, s);
+			ADDLOG_INFO(LOG_FEATURE_RAW, "%s", s);
 		}
 		else {
 			ADDLOG_INFO(LOG_FEATURE_CMD, "Name is %s", s);
@@ -403,7 +403,7 @@ static commandResult_t CMD_FriendlyName(const void *context, const char *cmd, co
 	s = CFG_GetDeviceName();
 	if (Tokenizer_GetArgsCount() == 0) {
 		if (cmdFlags & COMMAND_FLAG_SOURCE_TCP) {
-			ADDLOG_INFO(LOG_FEATURE_RAW, s);
+			ADDLOG_INFO(LOG_FEATURE_RAW, "%s", s);
 		}
 		else {
 			ADDLOG_INFO(LOG_FEATURE_CMD, "FriendlyName is %s", s);
@@ -275,106 +275,165 @@ typedef struct eventHandler_s {
 	int requiredArgument3;
 	// command to execute when it happens
 	char *command;
+	// the same command, resolved once
+	compiledCommand_t compiled;
 	// for UART event handlers?
 	char *requiredArgumentText;
+	// case insensitive hash of requiredArgumentText
+	unsigned int requiredArgumentTextHash;
 
+	// all handlers, in order of adding (newest first)
 	struct eventHandler_s *next;
+	// handlers with the same eventCode
+	struct eventHandler_s *nextSameCode;
+	// handlers with the same eventCode and requiredArgument hash
+	struct eventHandler_s *nextSameKey;
 } eventHandler_t;
 
+// Handlers are kept in a single list (for listing and freeing) and
+// additionally indexed, so an event only visits handlers that can match:
+// - by event code, for change handlers and string events
+// - by event code and first argument, for pin/channel scoped events
+#define EVENT_KEY_BUCKETS 64
+
 static eventHandler_t *g_eventHandlers = 0;
+static eventHandler_t *g_eventHandlersByCode[CMD_EVENT_MAX_TYPES];
+static eventHandler_t *g_eventHandlersByKey[EVENT_KEY_BUCKETS];
+
+static int EVENT_KeyBucket(byte eventCode, int argument) {
+	unsigned int h;
+
+	h = (unsigned int)argument * 2654435761u;
+	h ^= eventCode * 31;
+	return (h ^ (h >> 16)) & (EVENT_KEY_BUCKETS - 1);
+}
+static unsigned int EVENT_HashText(const char *s) {
+	unsigned int h = 5381;
+
+	while (*s) {
+		// same folding as wal_stricmp
+		h = h * 33 + (byte)tolower(toupper((byte)*s));
+		s++;
+	}
+	return h;
+}
+static void EVENT_LinkHandler(eventHandler_t *ev) {
+	int bucket;
+
+	ev->next = g_eventHandlers;
+	g_eventHandlers = ev;
 
+	ev->nextSameCode = g_eventHandlersByCode[ev->eventCode];
+	g_eventHandlersByCode[ev->eventCode] = ev;
+
+	bucket = EVENT_KeyBucket(ev->eventCode, ev->requiredArgument);
+	ev->nextSameKey = g_eventHandlersByKey[bucket];
+	g_eventHandlersByKey[bucket] = ev;
+}
 
 void EventHandlers_ProcessVariableChange_Integer(byte eventCode, int oldValue, int newValue) {
 	struct eventHandler_s *ev;
 
-	ev = g_eventHandlers;
+	if (eventCode >= CMD_EVENT_MAX_TYPES)
+		return;
+
+	ev = g_eventHandlersByCode[eventCode];
 
 	while(ev) {
-		if(eventCode==ev->eventCode) {
-			if(EVENT_EvaluateChangeCondition(ev->eventType, ev->requiredArgument, oldValue, newValue)) {
-				ADDLOG_INFO(LOG_FEATURE_EVENT, "EventHandlers_ProcessVariableChange_Integer: executing command %s",ev->command);
-				CMD_ExecuteCommand(ev->command, COMMAND_FLAG_SOURCE_SCRIPT);
-			}
+		if(EVENT_EvaluateChangeCondition(ev->eventType, ev->requiredArgument, oldValue, newValue)) {
+			ADDLOG_INFO(LOG_FEATURE_EVENT, "EventHandlers_ProcessVariableChange_Integer: executing command %s",ev->command);
+			CMD_ExecuteCompiledCommand(&ev->compiled, COMMAND_FLAG_SOURCE_SCRIPT);
 		}
-		ev = ev->next;
+		ev = ev->nextSameCode;
 	}
 }
 
 void EventHandlers_AddEventHandler_Integer(byte eventCode, int type, int requiredArgument, int requiredArgument2, int requiredArgument3, const char *commandToRun)
 {
-	eventHandler_t *ev = malloc(sizeof(eventHandler_t));
-	memset(ev,0,sizeof(eventHandler_t));
+	eventHandler_t *ev;
 
-	ev->next = g_eventHandlers;
-	g_eventHandlers = ev;
+	if (eventCode >= CMD_EVENT_MAX_TYPES)
+		return;
+
+	ev = malloc(sizeof(eventHandler_t));
+	memset(ev,0,sizeof(eventHandler_t));
 
 	ev->requiredArgumentText = NULL;
 	ev->eventType = type;
 	ev->command = strdup(commandToRun);
+	CMD_CompileCommand(&ev->compiled, ev->command);
 	ev->eventCode = eventCode;
 	ev->requiredArgument = requiredArgument;
 	ev->requiredArgument2 = requiredArgument2;
 	ev->requiredArgument3 = requiredArgument3;
+
+	EVENT_LinkHandler(ev);
 }
 
 void EventHandlers_AddEventHandler_String(byte eventCode, int type, const char *requiredArgument, const char *commandToRun)
 {
-	eventHandler_t *ev = malloc(sizeof(eventHandler_t));
-	memset(ev,0,sizeof(eventHandler_t));
+	eventHandler_t *ev;
 
-	ev->next = g_eventHandlers;
-	g_eventHandlers = ev;
+	if (eventCode >= CMD_EVENT_MAX_TYPES)
+		return;
+
+	ev = malloc(sizeof(eventHandler_t));
+	memset(ev,0,sizeof(eventHandler_t));
 
 	ev->requiredArgumentText = strdup(requiredArgument);
+	ev->requiredArgumentTextHash = EVENT_HashText(requiredArgument);
 	ev->eventType = type;
 	ev->command = strdup(commandToRun);
+	CMD_CompileCommand(&ev->compiled, ev->command);
 	ev->eventCode = eventCode;
 	ev->requiredArgument = 0;
 	ev->requiredArgument2 = 0;
+
+	EVENT_LinkHandler(ev);
 }
 void EventHandlers_FireEvent3(byte eventCode, int argument, int argument2, int argument3) {
 	struct eventHandler_s *ev;
 
-	ev = g_eventHandlers;
+	ev = g_eventHandlersByKey[EVENT_KeyBucket(eventCode, argument)];
 
 	while (ev) {
 		if (eventCode == ev->eventCode) {
 			if (argument == ev->requiredArgument && argument2 == ev->requiredArgument2 && argument3 == ev->requiredArgument3) {
 				ADDLOG_INFO(LOG_FEATURE_EVENT, "EventHandlers_FireEvent3: executing command %s", ev->command);
-				CMD_ExecuteCommand(ev->command, COMMAND_FLAG_SOURCE_SCRIPT);
+				CMD_ExecuteCompiledCommand(&ev->compiled, COMMAND_FLAG_SOURCE_SCRIPT);
 			}
 		}
-		ev = ev->next;
+		ev = ev->nextSameKey;
 	}
 }
 void EventHandlers_FireEvent2(byte eventCode, int argument, int argument2) {
 	struct eventHandler_s *ev;
 
-	ev = g_eventHandlers;
+	ev = g_eventHandlersByKey[EVENT_KeyBucket(eventCode, argument)];
 
 	while(ev) {
 		if(eventCode==ev->eventCode) {
 			if(argument == ev->requiredArgument && argument2 == ev->requiredArgument2) {
 				ADDLOG_INFO(LOG_FEATURE_EVENT, "EventHandlers_FireEvent2: executing command %s",ev->command);
-				CMD_ExecuteCommand(ev->command, COMMAND_FLAG_SOURCE_SCRIPT);
+				CMD_ExecuteCompiledCommand(&ev->compiled, COMMAND_FLAG_SOURCE_SCRIPT);
 			}
 		}
-		ev = ev->next;
+		ev = ev->nextSameKey;
 	}
 }
 void EventHandlers_FireEvent(byte eventCode, int argument) {
 	struct eventHandler_s *ev;
 
-	ev = g_eventHandlers;
+	ev = g_eventHandlersByKey[EVENT_KeyBucket(eventCode, argument)];
 
 	while(ev) {
 		if(eventCode==ev->eventCode) {
 			if(argument == ev->requiredArgument) {
 				ADDLOG_INFO(LOG_FEATURE_EVENT, "EventHandlers_FireEvent: executing command %s",ev->command);
-				CMD_ExecuteCommand(ev->command, COMMAND_FLAG_SOURCE_SCRIPT);
+				CMD_ExecuteCompiledCommand(&ev->compiled, COMMAND_FLAG_SOURCE_SCRIPT);
 			}
 		}
-		ev = ev->next;
+		ev = ev->nextSameKey;
 	}
 
 #if defined(PLATFORM_BEKEN) || defined(WINDOWS)
@@ -383,19 +442,22 @@ void EventHandlers_FireEvent(byte eventCode, int argument) {
 }
 void EventHandlers_FireEvent_String(byte eventCode, const char *argument) {
 	struct eventHandler_s *ev;
+	unsigned int hash;
 
-	ev = g_eventHandlers;
+	if (eventCode >= CMD_EVENT_MAX_TYPES)
+		return;
+
+	ev = g_eventHandlersByCode[eventCode];
+	hash = EVENT_HashText(argument);
 
 	while(ev) {
-		if(eventCode==ev->eventCode) {
-			if(ev->requiredArgumentText != 0) {
-				if(!stricmp(argument,ev->requiredArgumentText)) {
-					ADDLOG_INFO(LOG_FEATURE_EVENT, "EventHandlers_FireEvent_String: executing command %s",ev->command);
-					CMD_ExecuteCommand(ev->command, COMMAND_FLAG_SOURCE_SCRIPT);
-				}
+		if(ev->requiredArgumentText != 0 && ev->requiredArgumentTextHash == hash) {
+			if(!stricmp(argument,ev->requiredArgumentText)) {
+				ADDLOG_INFO(LOG_FEATURE_EVENT, "EventHandlers_FireEvent_String: executing command %s",ev->command);
+				CMD_ExecuteCompiledCommand(&ev->compiled, COMMAND_FLAG_SOURCE_SCRIPT);
 			}
 		}
-		ev = ev->next;
+		ev = ev->nextSameCode;
 	}
 
 }
@@ -474,7 +536,9 @@ commandResult_t CMD_ClearAllHandlers(const void *context, const char *cmd, const
 	while(ev != 0) {
 		next = ev->next;
 
+		CMD_FreeCompiledCommand(&ev->compiled);
 		free(ev->command);
+		free(ev->requiredArgumentText);
 		free(ev);
 
 		ev = next;
@@ -483,6 +547,8 @@ commandResult_t CMD_ClearAllHandlers(const void *context, const char *cmd, const
 
 	addLogAdv(LOG_INFO, LOG_FEATURE_CMD, "Fried %i handlers", c);
 	g_eventHandlers = 0;
+	memset(g_eventHandlersByCode, 0, sizeof(g_eventHandlersByCode));
+	memset(g_eventHandlersByKey, 0, sizeof(g_eventHandlersByKey));
 
 	return CMD_RES_OK;
 }
@@ -542,6 +608,11 @@ static commandResult_t CMD_ListEventHandlers(const void *context, const char *cm
 
 	return CMD_RES_OK;
 }
+bool EventHandlers_HasHandlers(byte eventCode) {
+	if (eventCode >= CMD_EVENT_MAX_TYPES)
+		return false;
+	return g_eventHandlersByCode[eventCode] != 0;
+}
 int EventHandlers_GetActiveCount() {
 	struct eventHandler_s *ev;
 	int c;
@@ -6,6 +6,9 @@
 #include "../new_cfg.h"
 #include "../driver/drv_public.h"
 #include "../driver/drv_ntp.h"
+#if WINDOWS
+#include "../sim/sim_import.h"
+#endif
 #include <ctype.h> // isspace
 
 /*
@@ -368,7 +371,8 @@ static int g_totalConstants = sizeof(g_constants) / sizeof(g_constants[0]);
 // Etc etc
 // Returns true if constant matches
 // Returns false if no constants found
-const char *CMD_ExpandConstant(const char *s, const char *stop, float *out) {
+// returns index of constant in g_constants or -1, sets *after past the matched text
+static int CMD_FindConstant(const char *s, const char *stop, const char **after) {
 	const constant_t *var;
 	int i;
 	var = g_constants;
@@ -376,11 +380,22 @@ const char *CMD_ExpandConstant(const char *s, const char *stop, float *out) {
 		bool bAllowWildCard = strstr(var->constantName, "*");
 		const char *ret = strCompareBound(s, var->constantName, stop, bAllowWildCard);
 		if (ret) {
-			*out = var->getValue(s);
-			ADDLOG_IF_MATHEXP_DBG(LOG_FEATURE_EVENT, "CMD_ExpandConstant: %s", var->name);
-			return ret;
+			*after = ret;
+			return i;
 		}
 	}
+	return -1;
+}
+const char *CMD_ExpandConstant(const char *s, const char *stop, float *out) {
+	const char *ret;
+	int i;
+
+	i = CMD_FindConstant(s, stop, &ret);
+	if (i >= 0) {
+		*out = g_constants[i].getValue(s);
+		ADDLOG_IF_MATHEXP_DBG(LOG_FEATURE_EVENT, "CMD_ExpandConstant: %s", g_constants[i].constantName);
+		return ret;
+	}
 	return false;
 }
 #if WINDOWS
@@ -569,7 +584,54 @@ char *CMD_ExpandingStrdup(const char *in) {
 	CMD_ExpandConstantsWithinString(in, ret, realLen);
 	return ret;
 }
-float CMD_EvaluateExpression(const char *s, const char *stop) {
+static float CMD_ApplyOperator(byte opCode, float a, float b) {
+	float c;
+
+	switch(opCode)
+	{
+	case OP_EQUAL:
+		c = a == b;
+		break;
+	case OP_EQUAL_OR_GREATER:
+		c = a >= b;
+		break;
+	case OP_EQUAL_OR_LESS:
+		c = a <= b;
+		break;
+	case OP_NOT_EQUAL:
+		c = a != b;
+		break;
+	case OP_GREATER:
+		c = a > b;
+		break;
+	case OP_LESS:
+		c = a < b;
+		break;
+	case OP_AND:
+		c = ((int)a) && ((int)b);
+		break;
+	case OP_OR:
+		c = ((int)a) || ((int)b);
+		break;
+	case OP_ADD:
+		c = a + b;
+		break;
+	case OP_SUB:
+		c = a - b;
+		break;
+	case OP_MUL:
+		c = a * b;
+		break;
+	case OP_DIV:
+		c = a / b;
+		break;
+	default:
+		c = 0;
+		break;
+	}
+	return c;
+}
+float CMD_EvaluateExpression_Interpreted(const char *s, const char *stop) {
 	byte opCode;
 	const char *op;
 	float a, b, c;
@@ -613,8 +675,8 @@ float CMD_EvaluateExpression(const char *s, const char *stop) {
 		// second token block begins at 'p2' and ends at NULL
 		p2 = op + g_operators[opCode].len;
 
-		a = CMD_EvaluateExpression(s, op);
-		b = CMD_EvaluateExpression(p2, stop);
+		a = CMD_EvaluateExpression_Interpreted(s, op);
+		b = CMD_EvaluateExpression_Interpreted(p2, stop);
 
 		// Why, again, %f crashes?
 		//ADDLOG_INFO(LOG_FEATURE_EVENT, "CMD_EvaluateExpression: a = %f, b = %f", a, b);
@@ -622,52 +684,11 @@ float CMD_EvaluateExpression(const char *s, const char *stop) {
 		//sprintf(g_expDebugBuffer,"CMD_EvaluateExpression: a = %f, b = %f", a, b);
 		//ADDLOG_INFO(LOG_FEATURE_EVENT, g_expDebugBuffer);
 
-		switch(opCode)
-		{
-		case OP_EQUAL:
-			c = a == b;
-			break;
-		case OP_EQUAL_OR_GREATER:
-			c = a >= b;
-			break;
-		case OP_EQUAL_OR_LESS:
-			c = a <= b;
-			break;
-		case OP_NOT_EQUAL:
-			c = a != b;
-			break;
-		case OP_GREATER:
-			c = a > b;
-			break;
-		case OP_LESS:
-			c = a < b;
-			break;
-		case OP_AND:
-			c = ((int)a) && ((int)b);
-			break;
-		case OP_OR:
-			c = ((int)a) || ((int)b);
-			break;
-		case OP_ADD:
-			c = a + b;
-			break;
-		case OP_SUB:
-			c = a - b;
-			break;
-		case OP_MUL:
-			c = a * b;
-			break;
-		case OP_DIV:
-			c = a / b;
-			break;
-		default:
-			c = 0;
-			break;
-		}
+		c = CMD_ApplyOperator(opCode, a, b);
 		return c;
 	}
 	if(s[0] == '!') {
-		return !CMD_EvaluateExpression(s+1,stop);
+		return !CMD_EvaluateExpression_Interpreted(s+1,stop);
 	}
 	if(CMD_ExpandConstant(s,stop,&c)) {
 		return c;
@@ -682,6 +703,231 @@ float CMD_EvaluateExpression(const char *s, const char *stop) {
 	return atof(g_expDebugBuffer);
 }
 
+
+// Expressions are compiled once to postfix code for a small stack machine.
+// The compiler walks the text exactly like CMD_EvaluateExpression_Interpreted,
+// so both give the same results, but operators are found, constants resolved
+// to g_constants[] entries and numbers parsed only once.
+#define EXPR_OP_PUSH		0x20
+#define EXPR_OP_CHANNEL		0x21
+#define EXPR_OP_CONSTANT	0x22
+#define EXPR_OP_NOT			0x23
+
+#define EXPR_MAX_CODE		48
+#define EXPR_MAX_STACK		16
+// must be power of two
+#define EXPR_CACHE_SIZE		32
+
+typedef struct exprInstruction_s {
+	// opCode_t for binary operators, EXPR_OP_* otherwise
+	byte op;
+	union {
+		float value;
+		int index;
+	};
+} exprInstruction_t;
+
+typedef struct exprCompiler_s {
+	exprInstruction_t code[EXPR_MAX_CODE];
+	int count;
+	int depth;
+	int maxDepth;
+	bool bError;
+} exprCompiler_t;
+
+typedef struct compiledExpression_s {
+	// trimmed source text, also the cache key
+	char *text;
+	int len;
+	int numInstructions;
+	exprInstruction_t *code;
+} compiledExpression_t;
+
+static compiledExpression_t g_exprCache[EXPR_CACHE_SIZE];
+
+static void EXPR_Emit(exprCompiler_t *c, byte op, int stackChange) {
+	if (c->count >= EXPR_MAX_CODE) {
+		c->bError = true;
+		return;
+	}
+	c->code[c->count].op = op;
+	c->code[c->count].index = 0;
+	c->count++;
+	c->depth += stackChange;
+	if (c->depth > c->maxDepth) {
+		c->maxDepth = c->depth;
+	}
+}
+static void EXPR_EmitValue(exprCompiler_t *c, float value) {
+	EXPR_Emit(c, EXPR_OP_PUSH, 1);
+	if (!c->bError) {
+		c->code[c->count - 1].value = value;
+	}
+}
+static void EXPR_Compile(exprCompiler_t *c, const char *s, const char *stop) {
+	byte opCode;
+	const char *op;
+	const char *after;
+	char tmp[32];
+	int idx;
+
+	if (c->bError)
+		return;
+	if (s == 0 || *s == 0) {
+		EXPR_EmitValue(c, 0);
+		return;
+	}
+	while (stop > s && isspace(((int)stop[-1]))) {
+		stop--;
+	}
+	while (isspace(((int)*s))) {
+		s++;
+		if (s >= stop) {
+			EXPR_EmitValue(c, 0);
+			return;
+		}
+	}
+	op = CMD_FindOperator(s, stop, &opCode);
+	if (op) {
+		EXPR_Compile(c, s, op);
+		EXPR_Compile(c, op + g_operators[opCode].len, stop);
+		EXPR_Emit(c, opCode, -1);
+		return;
+	}
+	if (s[0] == '!') {
+		EXPR_Compile(c, s + 1, stop);
+		EXPR_Emit(c, EXPR_OP_NOT, 0);
+		return;
+	}
+	idx = CMD_FindConstant(s, stop, &after);
+	if (idx >= 0) {
+		if (g_constants[idx].getValue == getChannelValue) {
+			// $CH* wildcards, channel index is known now
+			EXPR_Emit(c, EXPR_OP_CHANNEL, 1);
+			if (!c->bError) {
+				c->code[c->count - 1].index = atoi(s + 3);
+			}
+		}
+		else {
+			EXPR_Emit(c, EXPR_OP_CONSTANT, 1);
+			if (!c->bError) {
+				c->code[c->count - 1].index = idx;
+			}
+		}
+		return;
+	}
+	idx = stop - s;
+	if (idx >= sizeof(tmp)) {
+		idx = sizeof(tmp) - 1;
+	}
+	memcpy(tmp, s, idx);
+	tmp[idx] = 0;
+	EXPR_EmitValue(c, atof(tmp));
+}
+static float EXPR_Run(const exprInstruction_t *code, int count) {
+	float stack[EXPR_MAX_STACK];
+	int sp = 0;
+	int i;
+
+	for (i = 0; i < count; i++, code++) {
+		switch (code->op) {
+		case EXPR_OP_PUSH:
+			stack[sp++] = code->value;
+			break;
+		case EXPR_OP_CHANNEL:
+			stack[sp++] = CHANNEL_Get(code->index);
+			break;
+		case EXPR_OP_CONSTANT:
+			stack[sp++] = g_constants[code->index].getValue(g_constants[code->index].constantName);
+			break;
+		case EXPR_OP_NOT:
+			stack[sp - 1] = !stack[sp - 1];
+			break;
+		default:
+			sp--;
+			stack[sp - 1] = CMD_ApplyOperator(code->op, stack[sp - 1], stack[sp]);
+			break;
+		}
+	}
+	return stack[0];
+}
+// plain numbers are most common arguments, they are not worth a cache slot
+static bool EXPR_IsPlainNumber(const char *s, const char *stop) {
+	if (*s == '-')
+		s++;
+	if (s >= stop)
+		return false;
+	while (s < stop) {
+		if (!isdigit((int)*s) && *s != '.')
+			return false;
+		s++;
+	}
+	return true;
+}
+float CMD_EvaluateExpression(const char *s, const char *stop) {
+	compiledExpression_t *e;
+	exprCompiler_t c;
+	unsigned int hash;
+	const char *p;
+	char tmp[32];
+	int len;
+
+	if (s == 0)
+		return 0;
+	if (*s == 0)
+		return 0;
+	if (stop == 0) {
+		stop = s + strlen(s);
+	}
+	while (stop > s && isspace(((int)stop[-1]))) {
+		stop--;
+	}
+	while (isspace(((int)*s))) {
+		s++;
+		if (s >= stop) {
+			return 0;
+		}
+	}
+	len = stop - s;
+	if (len < sizeof(tmp) && EXPR_IsPlainNumber(s, stop)) {
+		memcpy(tmp, s, len);
+		tmp[len] = 0;
+		return atof(tmp);
+	}
+	hash = 0;
+	for (p = s; p < stop; p++) {
+		hash = hash * 31 + (byte)*p;
+	}
+	e = &g_exprCache[hash & (EXPR_CACHE_SIZE - 1)];
+	if (e->text && e->len == len && !memcmp(e->text, s, len)) {
+		return EXPR_Run(e->code, e->numInstructions);
+	}
+	memset(&c, 0, sizeof(c));
+	EXPR_Compile(&c, s, stop);
+	if (c.bError || c.maxDepth > EXPR_MAX_STACK) {
+		// too complex for the compiled form
+		return CMD_EvaluateExpression_Interpreted(s, stop);
+	}
+	// replace whatever was in this slot
+	free(e->text);
+	free(e->code);
+	e->text = malloc(len + 1);
+	e->code = malloc(sizeof(exprInstruction_t) * c.count);
+	if (e->text == 0 || e->code == 0) {
+		free(e->text);
+		free(e->code);
+		e->text = 0;
+		e->code = 0;
+		return EXPR_Run(c.code, c.count);
+	}
+	memcpy(e->text, s, len);
+	e->text[len] = 0;
+	e->len = len;
+	memcpy(e->code, c.code, sizeof(exprInstruction_t) * c.count);
+	e->numInstructions = c.count;
+	return EXPR_Run(e->code, e->numInstructions);
+}
+
 // if MQTTOnline then "qq" else "qq"
 commandResult_t CMD_If(const void *context, const char *cmd, const char *args, int cmdFlags){
 	const char *cmdA;
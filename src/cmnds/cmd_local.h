@@ -11,17 +11,77 @@ typedef struct command_s {
 } command_t;
 
 command_t *CMD_Find(const char *name);
+
+// Pre-split argument vector of a command line, filled by the tokenizer
+// the first time a compiled command tokenizes its (constant) arguments.
+typedef struct tokenizerCache_s tokenizerCache_t;
+
+// Command line resolved once and executed many times (aliases, event handlers,
+// script lines). The line text is owned by the caller and must not change.
+// Resolution is redone automatically when the command table changes.
+typedef struct compiledCommand_s {
+	const char *line;
+	// resolved command, 0 if unknown
+	command_t *cmd;
+	// length of the command word at the start of the line
+	int nameLen;
+	const char *args;
+	int generation;
+	tokenizerCache_t *split;
+} compiledCommand_t;
+
+void CMD_CompileCommand(compiledCommand_t *cc, const char *line);
+commandResult_t CMD_ExecuteCompiledCommand(compiledCommand_t *cc, int cmdFlags);
+void CMD_FreeCompiledCommand(compiledCommand_t *cc);
+// tokenizer side of the cache, see cmd_tokenizer.c
+void Tokenizer_SetCache(const char *s, tokenizerCache_t **cache);
+void Tokenizer_GetCache(const char **s, tokenizerCache_t ***cache);
+void Tokenizer_FreeCache(tokenizerCache_t *cache);
 // for autocompletion?
 void CMD_ListAllCommands(void *userData, void (*callback)(command_t *cmd, void *userData));
 int get_cmd(const char *s, char *dest, int maxlen, int stripnum);
 
 
 float CMD_EvaluateExpression(const char *s, const char *stop);
+// original recursive evaluator, kept for comparison and as a fallback
+float CMD_EvaluateExpression_Interpreted(const char *s, const char *stop);
 commandResult_t CMD_If(const void *context, const char *cmd, const char *args, int cmdFlags);
 void CMD_ExpandConstantsWithinString(const char *in, char *out, int outLen);
 const char *CMD_ExpandConstant(const char *s, const char *stop, float *out);
 void CMD_Script_ProcessWaitersForEvent(byte eventCode, int argument);
 
+// Hierarchical timer wheel with millisecond resolution, see cmd_repeatingEvents.c.
+// Insert and cancel are O(1), advancing costs only the expiring timers
+// (plus one cascade per 64 ms when timers are pending).
+#define TIMERWHEEL_LEVEL_BITS 6
+#define TIMERWHEEL_SLOTS (1 << TIMERWHEEL_LEVEL_BITS)
+#define TIMERWHEEL_LEVELS 4
+
+typedef struct timerWheelEntry_s {
+	// absolute expiry time, in wheel milliseconds
+	unsigned int expires;
+	void (*callback)(struct timerWheelEntry_s *t);
+	void *userData;
+	byte level;
+	struct timerWheelEntry_s *next;
+	// 0 if not scheduled
+	struct timerWheelEntry_s **pprev;
+} timerWheelEntry_t;
+
+typedef struct timerWheel_s {
+	// all timers expiring at or before now have fired
+	unsigned int now;
+	// end of the currently running TimerWheel_Advance
+	unsigned int target;
+	int count[TIMERWHEEL_LEVELS];
+	timerWheelEntry_t *slots[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS];
+} timerWheel_t;
+
+void TimerWheel_Add(timerWheel_t *w, timerWheelEntry_t *t, unsigned int expires);
+void TimerWheel_Cancel(timerWheel_t *w, timerWheelEntry_t *t);
+void TimerWheel_Advance(timerWheel_t *w, int deltaMS);
+#define TimerWheel_IsPending(t) ((t)->pprev != 0)
+
 #endif // __CMD_LOCAL_H__
 
 
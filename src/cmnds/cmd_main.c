@@ -41,6 +41,8 @@ static int generateHashValue(const char* fname) {
 }
 
 command_t* g_commands[HASH_SIZE] = { NULL };
+// bumped whenever command table changes, so compiled commands know when to resolve again
+static int g_commandsGeneration = 1;
 bool g_powersave;
 
 static commandResult_t CMD_PowerSave(const void* context, const char* cmd, const char* args, int cmdFlags) {
@@ -184,7 +186,10 @@ static void stackOverflow(int a) {
 	for (i = 0; i < sizeof(lala); i++) {
 		lala[i] = a;
 	}
-	stackOverflow(a + 1);
+	// always true, it only keeps the compiler from flagging the recursion
+	if (a >= 0) {
+		stackOverflow(a + 1);
+	}
 }
 static commandResult_t CMD_StackOverflow(const void* context, const char* cmd, const char* args, int cmdFlags) {
 	ADDLOG_INFO(LOG_FEATURE_CMD, "CMD_StackOverflow: Will overflow soon");
@@ -270,7 +275,7 @@ static commandResult_t CMD_Echo(const void* context, const char* cmd, const char
 #else
 	// we want $CH40 etc expanded
 	Tokenizer_TokenizeString(args, TOKENIZER_ALTERNATE_EXPAND_AT_START | TOKENIZER_FORCE_SINGLE_ARGUMENT_MODE);
-	ADDLOG_INFO(LOG_FEATURE_CMD, Tokenizer_GetArgFrom(0));
+	ADDLOG_INFO(LOG_FEATURE_CMD, "%s", Tokenizer_GetArgFrom(0));
 #endif
 
 	return CMD_RES_OK;
@@ -417,23 +422,23 @@ void CMD_RunUartCmndIfRequired() {
 #endif
 }
 
+typedef struct alias_s {
+	char *command;
+	compiledCommand_t compiled;
+} alias_t;
+
 // run an aliased command
 static commandResult_t runcmd(const void* context, const char* cmd, const char* args, int cmdFlags) {
-	char* c = (char*)context;
-	//   char *p = c;
+	alias_t* a = (alias_t*)context;
 
-	//   while (*p && !isWhiteSpace(*p)) {
-	//       p++;
-	   //}
-	//   if (*p) p++;
 	if (*args) {
-		return CMD_ExecuteCommandArgs(c, args, cmdFlags);
+		return CMD_ExecuteCommandArgs(a->command, args, cmdFlags);
 	}
-	return CMD_ExecuteCommand(c, cmdFlags);
+	return CMD_ExecuteCompiledCommand(&a->compiled, cmdFlags);
 }
 
 commandResult_t CMD_CreateAliasHelper(const char *alias, const char *ocmd) {
-	char* cmdMem;
+	alias_t* a;
 	char* aliasMem;
 	command_t* existing;
 
@@ -443,7 +448,9 @@ commandResult_t CMD_CreateAliasHelper(const char *alias, const char *ocmd) {
 		return CMD_RES_BAD_ARGUMENT;
 	}
 
-	cmdMem = strdup(ocmd);
+	a = (alias_t*)malloc(sizeof(alias_t));
+	memset(a, 0, sizeof(alias_t));
+	a->command = strdup(ocmd);
 	aliasMem = strdup(alias);
 
 	ADDLOG_INFO(LOG_FEATURE_CMD, "New alias has been set: %s runs %s", alias, ocmd);
@@ -452,7 +459,9 @@ commandResult_t CMD_CreateAliasHelper(const char *alias, const char *ocmd) {
 	//cmddetail:"descr":"Internal usage only. See docs for 'alias' command.",
 	//cmddetail:"fn":"runcmd","file":"cmnds/cmd_test.c","requires":"",
 	//cmddetail:"examples":""}
-	CMD_RegisterCommand(aliasMem, runcmd, cmdMem);
+	CMD_RegisterCommand(aliasMem, runcmd, a);
+	// compile after registering, alias may refer to itself
+	CMD_CompileCommand(&a->compiled, a->command);
 	return CMD_RES_OK;
 }
 // run an aliased command
@@ -655,7 +664,7 @@ void CMD_FreeAllCommands() {
 		}
 		g_commands[i] = 0;
 	}
-
+	g_commandsGeneration++;
 }
 void CMD_RegisterCommand(const char* name, commandHandler_t handler, void* context) {
 	int hash;
@@ -676,6 +685,7 @@ void CMD_RegisterCommand(const char* name, commandHandler_t handler, void* conte
 	newCmd->next = g_commands[hash];
 	newCmd->context = context;
 	g_commands[hash] = newCmd;
+	g_commandsGeneration++;
 }
 
 command_t* CMD_Find(const char* name) {
@@ -717,27 +727,29 @@ int get_cmd(const char* s, char* dest, int maxlen, int stripnum) {
 }
 
 
+// look for complete commmand, then for the command with numeric suffix stripped (POWER1 -> POWER)
+static command_t* CMD_Resolve(const char* cmd) {
+	command_t* newCmd;
+	char nonums[32];
+
+	newCmd = CMD_Find(cmd);
+	if (newCmd) {
+		return newCmd;
+	}
+	// get the complete string up to numbers.
+	get_cmd(cmd, nonums, 32, 1);
+	return CMD_Find(nonums);
+}
+
 // execute a command from cmd and args - used below and in MQTT
 commandResult_t CMD_ExecuteCommandArgs(const char* cmd, const char* args, int cmdFlags) {
 	command_t* newCmd;
-	//int len;
 
-	// look for complete commmand
-	newCmd = CMD_Find(cmd);
+	newCmd = CMD_Resolve(cmd);
 	if (!newCmd) {
-		// not found, so...
-		char nonums[32];
-		// get the complete string up to numbers.
-		//len =
-		get_cmd(cmd, nonums, 32, 1);
-		newCmd = CMD_Find(nonums);
-		if (!newCmd) {
-			// if still not found, then error
-			ADDLOG_ERROR(LOG_FEATURE_CMD, "cmd %s NOT found (args %s)", cmd, args);
-			return CMD_RES_UNKNOWN_COMMAND;
-		}
-	}
-	else {
+		// if still not found, then error
+		ADDLOG_ERROR(LOG_FEATURE_CMD, "cmd %s NOT found (args %s)", cmd, args);
+		return CMD_RES_UNKNOWN_COMMAND;
 	}
 
 	if (newCmd->handler) {
@@ -787,4 +799,66 @@ commandResult_t CMD_ExecuteCommand(const char* s, int cmdFlags) {
 	return CMD_ExecuteCommandArgs(copy, args, cmdFlags);
 }
 
+void CMD_CompileCommand(compiledCommand_t* cc, const char* line) {
+	char name[128];
+	const char* p;
 
+	p = line;
+	while (*p && isWhiteSpace(*p)) {
+		p++;
+	}
+	cc->line = p;
+	// same command word rules as in CMD_ExecuteCommand
+	cc->nameLen = get_cmd(p, name, sizeof(name), 0);
+	p += cc->nameLen;
+	while (*p && isWhiteSpace(*p)) {
+		p++;
+	}
+	cc->args = p;
+	cc->cmd = CMD_Resolve(name);
+	cc->generation = g_commandsGeneration;
+	// split arguments belong to the old resolution
+	if (cc->split) {
+		Tokenizer_FreeCache(cc->split);
+		cc->split = 0;
+	}
+}
+void CMD_FreeCompiledCommand(compiledCommand_t* cc) {
+	if (cc->split) {
+		Tokenizer_FreeCache(cc->split);
+	}
+	memset(cc, 0, sizeof(*cc));
+}
+// like CMD_ExecuteCommand, but without copying, hashing and splitting the same text each time
+commandResult_t CMD_ExecuteCompiledCommand(compiledCommand_t* cc, int cmdFlags) {
+	char name[128];
+	commandResult_t res;
+	const char* prevCacheFor;
+	tokenizerCache_t** prevCache;
+
+	if (cc->line == 0 || *cc->line == 0) {
+		return CMD_RES_EMPTY_STRING;
+	}
+	if (cc->generation != g_commandsGeneration) {
+		CMD_CompileCommand(cc, cc->line);
+	}
+	if ((cmdFlags & COMMAND_FLAG_SOURCE_TCP) == 0) {
+		ADDLOG_DEBUG(LOG_FEATURE_CMD, "cmd [%s]", cc->line);
+	}
+	memcpy(name, cc->line, cc->nameLen);
+	name[cc->nameLen] = 0;
+	if (cc->cmd == 0) {
+		ADDLOG_ERROR(LOG_FEATURE_CMD, "cmd %s NOT found (args %s)", name, cc->args);
+		return CMD_RES_UNKNOWN_COMMAND;
+	}
+	if (cc->cmd->handler == 0) {
+		return CMD_RES_UNKNOWN_COMMAND;
+	}
+	// handler may run other compiled commands (eg. channel change events),
+	// so the cache of the outer one is restored afterwards
+	Tokenizer_GetCache(&prevCacheFor, &prevCache);
+	Tokenizer_SetCache(cc->args, &cc->split);
+	res = cc->cmd->handler(cc->cmd->context, name, cc->args, cmdFlags);
+	Tokenizer_SetCache(prevCacheFor, prevCache);
+	return res;
+}
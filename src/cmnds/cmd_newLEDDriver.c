@@ -108,8 +108,7 @@ void LED_ResetGlobalVariablesToDefaults() {
 bool LED_IsLedDriverChipRunning()
 {
 #ifndef OBK_DISABLE_ALL_DRIVERS
-	return DRV_IsRunning("SM2135") || DRV_IsRunning("BP5758D") 
-		|| DRV_IsRunning("TESTLED") || DRV_IsRunning("SM2235") || DRV_IsRunning("BP1658CJ");
+	return DRV_HasRunningDriverWithFlag(DRV_FLAG_LED_CHIP);
 #else
 	return false;
 #endif
@@ -241,16 +240,21 @@ void LED_I2CDriver_WriteRGBCW(float* finalRGBCW) {
 			// keep W unchanged
 		}
 	}
-	if (DRV_IsRunning("SM2135")) {
+	static int sm2135ID = DRV_ID_NOT_FOUND_YET;
+	static int bp5758dID = DRV_ID_NOT_FOUND_YET;
+	static int bp1658cjID = DRV_ID_NOT_FOUND_YET;
+	static int sm2235ID = DRV_ID_NOT_FOUND_YET;
+
+	if (DRV_IsRunningCached(&sm2135ID, "SM2135")) {
 		SM2135_Write(finalRGBCW);
 	}
-	if (DRV_IsRunning("BP5758D")) {
+	if (DRV_IsRunningCached(&bp5758dID, "BP5758D")) {
 		BP5758D_Write(finalRGBCW);
 	}
-	if (DRV_IsRunning("BP1658CJ")) {
+	if (DRV_IsRunningCached(&bp1658cjID, "BP1658CJ")) {
 		BP1658CJ_Write(finalRGBCW);
 	}
-	if (DRV_IsRunning("SM2235")) {
+	if (DRV_IsRunningCached(&sm2235ID, "SM2235")) {
 		SM2235_Write(finalRGBCW);
 	}
 #endif
@@ -170,7 +170,7 @@ int Tokenizer_GetArgIntegerRange(int i, int rangeMax, int rangeMin);
 void Tokenizer_TokenizeString(const char* s, int flags);
 // cmd_repeatingEvents.c
 void RepeatingEvents_Init();
-void RepeatingEvents_RunUpdate(float deltaTimeSeconds);
+void RepeatingEvents_RunUpdate(int deltaMS);
 void SIM_GenerateRepeatingEventsDesc(char *o, int outLen);
 // cmd_eventHandlers.c
 void EventHandlers_Init();
@@ -185,6 +185,9 @@ void EventHandlers_FireEvent3(byte eventCode, int argument, int argument2, int a
 // This is more advanced event handler. It will only fire handlers when a variable state changes from one to another.
 // For example, you can watch for Voltage from BL0942 to change below 230, and it will fire event only when it becomes below 230.
 void EventHandlers_ProcessVariableChange_Integer(byte eventCode, int oldValue, int newValue);
+// Tells if any handler is registered for the event, so that callers can
+// skip building the argument (like a hex string of a received packet).
+bool EventHandlers_HasHandlers(byte eventCode);
 int EventHandlers_GetActiveCount();
 // cmd_tasmota.c
 int taslike_commands_init();
@@ -15,23 +15,168 @@ typedef struct repeatingEvent_s {
 	// command string to execute
 	char *command;
 	//char *condition;
-	// how often event repeats
-	float intervalSeconds;
-	// current value until next repeat (decremented every second)
-	float currentInterval;
+	// how often event repeats, in milliseconds
+	int intervalMS;
 	// number of times to repeat.
 	// If set to -1, then it's infinite repeater
 	// If set to EVENT_CANCELED_TIMES, then event structure is ready to be reused
 	int times;
 	// user can set an ID and then cancel repeating event by ID
 	int userID;
+	// scheduled while the event is active
+	timerWheelEntry_t timer;
 	struct repeatingEvent_s *next;
 } repeatingEvent_t;
 
 #define EVENT_CANCELED_TIMES -999
 
 static repeatingEvent_t *g_repeatingEvents = 0;
+static timerWheel_t g_repeatingWheel;
 
+#define TIMERWHEEL_LEVEL_MASK (TIMERWHEEL_SLOTS - 1)
+// timers further away than this are parked in the last level and re-cascaded
+#define TIMERWHEEL_MAX_DELTA ((1u << (TIMERWHEEL_LEVELS * TIMERWHEEL_LEVEL_BITS)) - 1)
+
+static void TimerWheel_Insert(timerWheel_t *w, timerWheelEntry_t *t) {
+	timerWheelEntry_t **slot;
+	unsigned int delta;
+	unsigned int expires;
+	int level;
+
+	expires = t->expires;
+	delta = expires - w->now;
+	if (delta > TIMERWHEEL_MAX_DELTA) {
+		delta = TIMERWHEEL_MAX_DELTA;
+		expires = w->now + delta;
+	}
+	level = 0;
+	while (level < TIMERWHEEL_LEVELS - 1 && delta >= (1u << ((level + 1) * TIMERWHEEL_LEVEL_BITS))) {
+		level++;
+	}
+	slot = &w->slots[level][(expires >> (level * TIMERWHEEL_LEVEL_BITS)) & TIMERWHEEL_LEVEL_MASK];
+
+	t->level = level;
+	t->next = *slot;
+	if (t->next) {
+		t->next->pprev = &t->next;
+	}
+	t->pprev = slot;
+	*slot = t;
+	w->count[level]++;
+}
+void TimerWheel_Cancel(timerWheel_t *w, timerWheelEntry_t *t) {
+	if (t->pprev == 0) {
+		return;
+	}
+	*t->pprev = t->next;
+	if (t->next) {
+		t->next->pprev = t->pprev;
+	}
+	t->next = 0;
+	t->pprev = 0;
+	w->count[t->level]--;
+}
+void TimerWheel_Add(timerWheel_t *w, timerWheelEntry_t *t, unsigned int expires) {
+	TimerWheel_Cancel(w, t);
+	// the current millisecond is already being processed (or done)
+	if ((int)(expires - w->now) <= 0) {
+		expires = w->now + 1;
+	}
+	t->expires = expires;
+	TimerWheel_Insert(w, t);
+}
+// move timers of a higher level slot down, now that they are close enough
+static void TimerWheel_Cascade(timerWheel_t *w, int level, int index) {
+	timerWheelEntry_t *list;
+	timerWheelEntry_t *t;
+
+	list = w->slots[level][index];
+	if (list == 0) {
+		return;
+	}
+	w->slots[level][index] = 0;
+	list->pprev = &list;
+	while (list) {
+		t = list;
+		TimerWheel_Cancel(w, t);
+		TimerWheel_Insert(w, t);
+	}
+}
+void TimerWheel_Advance(timerWheel_t *w, int deltaMS) {
+	timerWheelEntry_t *list;
+	timerWheelEntry_t *t;
+	unsigned int boundary;
+	int level;
+	int index;
+
+	if (deltaMS <= 0) {
+		return;
+	}
+	w->target = w->now + deltaMS;
+	while (w->now != w->target) {
+		// skip milliseconds that can't have any work
+		for (level = 0; level < TIMERWHEEL_LEVELS && w->count[level] == 0; level++) {
+		}
+		if (level == TIMERWHEEL_LEVELS) {
+			w->now = w->target;
+			break;
+		}
+		if (level > 0) {
+			boundary = (w->now | ((1u << (level * TIMERWHEEL_LEVEL_BITS)) - 1)) + 1;
+			if ((int)(boundary - w->target) > 0) {
+				w->now = w->target;
+				break;
+			}
+			w->now = boundary - 1;
+		}
+		w->now++;
+		index = w->now & TIMERWHEEL_LEVEL_MASK;
+		for (level = 1; level < TIMERWHEEL_LEVELS; level++) {
+			if (w->now & ((1u << (level * TIMERWHEEL_LEVEL_BITS)) - 1)) {
+				break;
+			}
+			TimerWheel_Cascade(w, level, (w->now >> (level * TIMERWHEEL_LEVEL_BITS)) & TIMERWHEEL_LEVEL_MASK);
+		}
+		list = w->slots[0][index];
+		if (list == 0) {
+			continue;
+		}
+		// detach, so callbacks can freely add and cancel timers
+		w->slots[0][index] = 0;
+		list->pprev = &list;
+		while (list) {
+			t = list;
+			TimerWheel_Cancel(w, t);
+			t->callback(t);
+		}
+	}
+}
+
+static void RepeatingEvents_OnTimer(timerWheelEntry_t *t) {
+	repeatingEvent_t *ev;
+	unsigned int next;
+
+	ev = (repeatingEvent_t*)t->userData;
+	// -1 means 'forever'
+	if(ev->times != -1) {
+		ev->times -= 1;
+		if (ev->times <= 0) {
+			// if finished all calls, mark as empty so we can reuse later
+			ev->times = EVENT_CANCELED_TIMES;
+		}
+	}
+	if (ev->times != EVENT_CANCELED_TIMES) {
+		// next run is counted from the planned time, not from now, so it doesn't drift.
+		// Intervals shorter than a tick still run only once per tick.
+		next = t->expires + ev->intervalMS;
+		if ((int)(next - g_repeatingWheel.target) <= 0) {
+			next = g_repeatingWheel.target + 1;
+		}
+		TimerWheel_Add(&g_repeatingWheel, t, next);
+	}
+	// may free this event (clearRepeatingEvents), so do it last
+	CMD_ExecuteCommand(ev->command, COMMAND_FLAG_SOURCE_SCRIPT);
+}
 void RepeatingEvents_CancelRepeatingEvents(int userID)
 {
 	repeatingEvent_t *ev;
@@ -41,11 +186,20 @@ void RepeatingEvents_CancelRepeatingEvents(int userID)
 		if(ev->userID == userID) {
 			// mark as finished
 			ev->times = EVENT_CANCELED_TIMES;
+			TimerWheel_Cancel(&g_repeatingWheel, &ev->timer);
 			addLogAdv(LOG_INFO, LOG_FEATURE_CMD,"Event with id %i and cmd %s has been canceled",ev->userID,ev->command);
 		}
 	}
 
 }
+static int RepeatingEvents_SecondsToMS(float secondsInterval) {
+	int ms;
+
+	ms = (int)(secondsInterval * 1000.0f + 0.5f);
+	if (ms < 1)
+		ms = 1;
+	return ms;
+}
 void RepeatingEvents_AddRepeatingEvent(const char *command, float secondsInterval, int times, int userID)
 {
 	repeatingEvent_t *ev;
@@ -56,10 +210,11 @@ void RepeatingEvents_AddRepeatingEvent(const char *command, float secondsInterva
 		// is this event canceled/empty?
 		if(ev->times == EVENT_CANCELED_TIMES) {
 			if(!strcmp(ev->command,command)) {
-				ev->intervalSeconds = secondsInterval;
-				// fire after delay
-				ev->currentInterval = secondsInterval;
+				ev->intervalMS = RepeatingEvents_SecondsToMS(secondsInterval);
 				ev->times = times;
+				ev->userID = userID;
+				// fire after delay
+				TimerWheel_Add(&g_repeatingWheel, &ev->timer, g_repeatingWheel.now + ev->intervalMS);
 				return;
 			}
 		}
@@ -76,18 +231,18 @@ void RepeatingEvents_AddRepeatingEvent(const char *command, float secondsInterva
 		free(ev);
 		return;
 	}
+	memset(ev, 0, sizeof(repeatingEvent_t));
 
 	ev->next = g_repeatingEvents;
 	g_repeatingEvents = ev;
 	ev->command = cmd_copy;
-	ev->intervalSeconds = secondsInterval;
+	ev->intervalMS = RepeatingEvents_SecondsToMS(secondsInterval);
 	ev->times = times;
 	ev->userID = userID;
-	// fire next frame
-	// TODO: is this what we want? or do we want to fire after full interval?
-	//ev->currentInterval = 1;
+	ev->timer.callback = RepeatingEvents_OnTimer;
+	ev->timer.userData = ev;
 	// fire after full interval
-	ev->currentInterval = secondsInterval;
+	TimerWheel_Add(&g_repeatingWheel, &ev->timer, g_repeatingWheel.now + ev->intervalMS);
 }
 void SIM_GenerateRepeatingEventsDesc(char *o, int outLen) {
 	repeatingEvent_t *cur;
@@ -98,10 +253,11 @@ void SIM_GenerateRepeatingEventsDesc(char *o, int outLen) {
 		// -1 means 'forever'
 		if (cur->times > 0 || cur->times == -1) {
 			//ci++;
-			snprintf(buffer, outLen,"ID %i, repeats %i",(int) cur->userID, (int)cur->times);
+			snprintf(buffer, sizeof(buffer),"ID %i, repeats %i",(int) cur->userID, (int)cur->times);
 			strcat_safe(o, buffer, outLen);
-			snprintf(buffer, outLen, ", interval %i", (int)cur->intervalSeconds);
-			snprintf(buffer, outLen, " (cur left %i), cmd: ", (int)cur->currentInterval);
+			snprintf(buffer, sizeof(buffer), ", interval %i", cur->intervalMS / 1000);
+			strcat_safe(o, buffer, outLen);
+			snprintf(buffer, sizeof(buffer), " (cur left %i), cmd: ", (int)(cur->timer.expires - g_repeatingWheel.now) / 1000);
 			strcat_safe(o, buffer, outLen);
 			strcat_safe(o, cur->command, outLen);
 		}
@@ -123,41 +279,8 @@ int RepeatingEvents_GetActiveCount() {
 	}
 	return c_active;
 }
-void RepeatingEvents_RunUpdate(float deltaTimeSeconds) {
-	repeatingEvent_t *cur;
-	int c_checked = 0;
-	int c_ran = 0;
-
-	cur = g_repeatingEvents;
-	while(cur) {
-		c_checked++;
-		// debug only check
-		if(cur == cur->next) {
-			addLogAdv(LOG_ERROR, LOG_FEATURE_CMD,"RepeatingEvents_OnEverySecond: single linked list was broken?");
-			cur->next = 0;
-			return;
-		}
-		// -1 means 'forever'
-		if(cur->times > 0 || cur->times == -1) {
-			cur->currentInterval-= deltaTimeSeconds;
-			if(cur->currentInterval<=0){
-				c_ran++;
-				// -1 means 'forever'
-				if(cur->times != -1) {
-					cur->times -= 1;
-					if (cur->times <= 0) {
-						// if finished all calls, mark as empty so we can reuse later
-						cur->times = EVENT_CANCELED_TIMES;
-					}
-				}
-				cur->currentInterval = cur->intervalSeconds;
-				CMD_ExecuteCommand(cur->command, COMMAND_FLAG_SOURCE_SCRIPT);
-			}
-		}
-		cur = cur->next;
-	}
-
-	//addLogAdv(LOG_INFO, LOG_FEATURE_CMD,"RepeatingEvents_OnEverySecond checked %i events, ran %i\n",c_checked,c_ran);
+void RepeatingEvents_RunUpdate(int deltaMS) {
+	TimerWheel_Advance(&g_repeatingWheel, deltaMS);
 }
 // addRepeatingEventID 1234 5 -1 DGR_SendPower "testgr" 1 1 
 // cancelRepeatingEvent 1234
@@ -205,6 +328,7 @@ commandResult_t RepeatingEvents_Cmd_ClearRepeatingEvents(const void *context, co
 	while (cur) {
 		rem = cur;
 		cur = cur->next;
+		TimerWheel_Cancel(&g_repeatingWheel, &rem->timer);
 		free(rem->command);
 		free(rem);
 		c++;
@@ -240,8 +364,8 @@ static commandResult_t RepeatingEvents_Cmd_ListRepeatingEvents(const void *conte
 	c = 0;
 
 	while (ev) {
-		ADDLOG_INFO(LOG_FEATURE_EVENT, "Repeater %i has ID %i, interval %i, reps %i, and command %s",
-			c,  ev->userID, ev->intervalSeconds, ev->times, ev->command);
+		ADDLOG_INFO(LOG_FEATURE_EVENT, "Repeater %i has ID %i, interval %i ms, reps %i, and command %s",
+			c,  ev->userID, ev->intervalMS, ev->times, ev->command);
 		ev = ev->next;
 		c++;
 	}
@@ -225,18 +225,41 @@ addEventHandler OnHold 20 backlog AddChannel 10 2 0 255; DGR_SendBrightness room
 
 */
 
+// executable line of a loaded script
+typedef struct scriptLine_s {
+	// points into scriptFile_t data, terminated in place
+	const char *text;
+	compiledCommand_t compiled;
+} scriptLine_t;
+
+typedef struct scriptLabel_s {
+	const char *name;
+	// index of first line after label
+	int line;
+} scriptLabel_t;
+
 typedef struct scriptFile_s {
 	char *fname;
 	char *data;
+	// script image built at load time - executable lines without
+	// comments and labels, and a hash table of labels
+	scriptLine_t *lines;
+	int numLines;
+	scriptLabel_t *labels;
+	// power of two, 0 if there are no labels
+	int labelsSize;
 
 	struct scriptFile_s *next;
 } scriptFile_t;
 
 typedef struct scriptInstance_s {
+	// 0 if thread is not running
 	scriptFile_t *curFile;
 	int uniqueID;
-	const char *curLine;
-	int currentDelayMS;
+	// index of next line to execute
+	int curLine;
+	// pending while the thread sleeps after delay_s/delay_ms
+	timerWheelEntry_t delay;
 
 	int waitingForEvent;
 	int waitingForArgument;
@@ -245,12 +268,37 @@ typedef struct scriptInstance_s {
 } scriptInstance_t;
 
 #define MAX_SCRIPT_LINE 512
+// default number of script lines a thread may run per SVM_RunThreads call
+#define DEFAULT_SCRIPT_BUDGET 10
 
-char *g_scrBuffer = 0;
 int svm_deltaMS;
+int svm_budget = DEFAULT_SCRIPT_BUDGET;
 scriptFile_t *g_scriptFiles = 0;
 scriptInstance_t *g_scriptThreads = 0;
 scriptInstance_t *g_activeThread = 0;
+// script delays, advanced by SVM_RunThreads
+static timerWheel_t g_scriptWheel;
+
+static void SVM_BuildImage(scriptFile_t *f);
+
+static void SVM_OnDelayFinished(timerWheelEntry_t *t) {
+	// nothing to do, thread is no longer pending and will run
+}
+static void SVM_AddDelay(scriptInstance_t *t, int ms) {
+	unsigned int from;
+
+	if (ms <= 0) {
+		return;
+	}
+	// delays executed in a single run add up
+	if (TimerWheel_IsPending(&t->delay)) {
+		from = t->delay.expires;
+	}
+	else {
+		from = g_scriptWheel.now;
+	}
+	TimerWheel_Add(&g_scriptWheel, &t->delay, from + ms);
+}
 
 scriptInstance_t *SVM_RegisterThread() {
 	scriptInstance_t *r;
@@ -258,7 +306,7 @@ scriptInstance_t *SVM_RegisterThread() {
 	r = g_scriptThreads;
 
 	while(r) {
-		if(r->curLine == 0) {
+		if(r->curFile == 0) {
 			break;
 		}
 		r = r->next;
@@ -272,7 +320,8 @@ scriptInstance_t *SVM_RegisterThread() {
 	r->uniqueID = 0;
 	r->curLine = 0;
 	r->curFile = 0;
-	r->currentDelayMS = 0;
+	TimerWheel_Cancel(&g_scriptWheel, &r->delay);
+	r->delay.callback = SVM_OnDelayFinished;
 	return r;
 }
 
@@ -304,6 +353,7 @@ scriptFile_t *SVM_RegisterFile(const char *fname) {
 	g_scriptFiles = r;
 	if(r->data == 0)
 		return 0;
+	SVM_BuildImage(r);
 	return r;
 }
 const char *SVM_SkipWS(const char *p) {
@@ -327,92 +377,147 @@ const char *SVM_SkipLine(const char *p) {
 	}
 	return p;
 }
+// unsigned, so long labels wrap around instead of overflowing;
+// callers mask it with (labelsSize - 1), labelsSize is a power of two
+static unsigned int SVM_HashLabel(const char *s) {
+	unsigned int hash = 0;
 
-const char *SVM_FindLabel(const char *text, const char *label, const char *fname) {
-	int labLen;
+	while(*s) {
+		hash = hash * 31 + (unsigned char)*s;
+		s++;
+	}
+	return hash;
+}
+static void SVM_AddLabel(scriptFile_t *f, const char *name, int line) {
+	int i;
+
+	i = SVM_HashLabel(name) & (f->labelsSize - 1);
+	while(f->labels[i].name) {
+		// first label with given name wins, like with text search
+		if(!strcmp(f->labels[i].name, name)) {
+			return;
+		}
+		i = (i + 1) & (f->labelsSize - 1);
+	}
+	f->labels[i].name = name;
+	f->labels[i].line = line;
+}
+// Single pass over the text that splits it into lines in place,
+// so script text is not kept twice in memory. First run only counts.
+static void SVM_BuildImage(scriptFile_t *f) {
+	char *p, *start, *end, *next;
+	int len, pass, numLines, numLabels;
+
+	for(pass = 0; pass < 2; pass++) {
+		numLines = 0;
+		numLabels = 0;
+		p = (char*)SVM_SkipWS(f->data);
+		while(*p) {
+			start = p;
+			next = (char*)SVM_SkipLine(start);
+			p = (char*)SVM_SkipWS(next);
+			if(start[0] == '/' && start[1] == '/') {
+				continue;
+			}
+			end = next;
+			while(end > start && (end[-1]==' '||end[-1]=='\r'||end[-1]=='\n'||end[-1]=='\t')) {
+				end--;
+			}
+			len = end - start;
+			if(len <= 0) {
+				continue;
+			}
+			if(start[len-1] == ':') {
+				if(pass == 1) {
+					start[len-1] = 0;
+					SVM_AddLabel(f, start, numLines);
+				}
+				numLabels++;
+				continue;
+			}
+			if(pass == 1) {
+				if(len >= MAX_SCRIPT_LINE) {
+					len = MAX_SCRIPT_LINE-1;
+				}
+				start[len] = 0;
+				f->lines[numLines].text = start;
+				CMD_CompileCommand(&f->lines[numLines].compiled, start);
+			}
+			numLines++;
+		}
+		if(pass == 0) {
+			if(numLines > 0) {
+				f->lines = malloc(sizeof(scriptLine_t) * numLines);
+				memset(f->lines, 0, sizeof(scriptLine_t) * numLines);
+			}
+			f->numLines = numLines;
+			if(numLabels > 0) {
+				f->labelsSize = 4;
+				while(f->labelsSize < numLabels * 2) {
+					f->labelsSize *= 2;
+				}
+				f->labels = malloc(sizeof(scriptLabel_t) * f->labelsSize);
+				memset(f->labels, 0, sizeof(scriptLabel_t) * f->labelsSize);
+			}
+		}
+	}
+	ADDLOG_EXTRADEBUG(LOG_FEATURE_CMD, "Script %s has %i lines and %i labels",f->fname,numLines,numLabels);
+}
+
+// returns index of line to continue at
+int SVM_FindLabel(scriptFile_t *f, const char *label) {
+	int i;
 
 	if(label == 0)
-		return text;
+		return 0;
 	if (!strcmp(label, "*"))
-		return text;
+		return 0;
 	if (*label == 0)
-		return text;
-
-	labLen = strlen(label);
+		return 0;
 
-	while(*text) {
-		text = SVM_SkipWS(text); 
-		if(strncmp(text,label,labLen) == 0 && text[labLen] == ':') {
-			return text;
-		}
-		if(text[0] == '/' && text[1] == '/') {
-			text = SVM_SkipLine(text); 
-			text = SVM_SkipWS(text); 
-		} else {
-			text = SVM_SkipLine(text); 
-			text = SVM_SkipWS(text); 
+	if(f->labelsSize) {
+		i = SVM_HashLabel(label) & (f->labelsSize - 1);
+		while(f->labels[i].name) {
+			if(!strcmp(f->labels[i].name, label)) {
+				return f->labels[i].line;
+			}
+			i = (i + 1) & (f->labelsSize - 1);
 		}
 	}
-	ADDLOG_INFO(LOG_FEATURE_CMD, "Label %s not found in %s - will go to the start of file",label,fname);
-	return text;
+	ADDLOG_INFO(LOG_FEATURE_CMD, "Label %s not found in %s - script will end",label,f->fname);
+	return f->numLines;
 }
 void SVM_RunThread(scriptInstance_t *t) {
-	int maxLoops = 10;
-	int loop = 0;
-	const char *start, *end;
-	int len, p;
+	int executed = 0;
+	scriptLine_t *l;
 
 	while(1) {
-		loop++;
 		// check if "waitFor" was executed last frame
 		if (t->waitingForEvent) {
 			return;
 		}
-		if(t->curLine == 0) {
+		if(t->curFile == 0) {
 			t->curLine = 0;
-			t->curFile = 0;
 			return;
 		}
-		if (loop > maxLoops) {
-			return;
-		}
-		t->curLine = SVM_SkipWS(t->curLine); 
-		if(t->curLine[0] == 0) {
+		if(t->curLine >= t->curFile->numLines) {
 			t->curLine = 0;
 			t->curFile = 0;
 			return;
 		}
-		if(t->curLine[0] == '/' && t->curLine[1] == '/') {
-			t->curLine = SVM_SkipLine(t->curLine); 
-			t->curLine = SVM_SkipWS(t->curLine); 
-		} else {
-			start = t->curLine;
-			end = SVM_SkipLine(start);
-			t->curLine = SVM_SkipWS(end); 
-
-			while(end > start && (end[-1]==' '||end[-1]=='\r'||end[-1]=='\n'||end[-1]=='\t')) {
-				end--;
-			}
-			len = (end - start);
-			//ADDLOG_EXTRADEBUG(LOG_FEATURE_CMD, "Script len: %i",len);
-
-			// skip empty lines and skip labels
-			if(len > 0 && start[len-1] != ':') {
-				if(len >= MAX_SCRIPT_LINE) {
-					len = MAX_SCRIPT_LINE-1;
-				}
-				memcpy(g_scrBuffer,start,len);
-				g_scrBuffer[len] = 0;
-
-				p = start-t->curFile->data;
-				///ADDLOG_EXTRADEBUG(LOG_FEATURE_CMD, "[Loop %i] Script line: %s, char index %i",loop,g_scrBuffer,p);
-				CMD_ExecuteCommand(g_scrBuffer,0);
-
-				// did we get a sleep?
-				if(t->currentDelayMS > 0) {
-					return;
-				}	
-			}
+		if (executed >= svm_budget) {
+			return;
+		}
+		l = &t->curFile->lines[t->curLine];
+		// advance first, so goto can override it
+		t->curLine++;
+		executed++;
+		///ADDLOG_EXTRADEBUG(LOG_FEATURE_CMD, "Script line: %s",l->text);
+		CMD_ExecuteCompiledCommand(&l->compiled, 0);
+
+		// did we get a sleep?
+		if(TimerWheel_IsPending(&t->delay)) {
+			return;
 		}
 	}
 }
@@ -423,10 +528,8 @@ void SVM_RunThreads(int deltaMS) {
 	c_sleep = 0;
 	c_run = 0;
 	svm_deltaMS = deltaMS;
-
-	if(g_scrBuffer == 0) {
-		g_scrBuffer = malloc(MAX_SCRIPT_LINE);
-	}
+	// wakes up threads whose delay has passed
+	TimerWheel_Advance(&g_scriptWheel, deltaMS);
 
 	g_activeThread = g_scriptThreads;
 	while(g_activeThread) {
@@ -435,12 +538,7 @@ void SVM_RunThreads(int deltaMS) {
 			c_sleep++;
 		}
 		else {
-			if (g_activeThread->currentDelayMS > 0) {
-				g_activeThread->currentDelayMS -= deltaMS;
-				// the following block is needed to handle with long freezes on simulator
-				if (g_activeThread->currentDelayMS < 0) {
-					g_activeThread->currentDelayMS = 0;
-				}
+			if (TimerWheel_IsPending(&g_activeThread->delay)) {
 				c_sleep++;
 			}
 			else {
@@ -486,12 +584,13 @@ void SVM_GoTo(scriptInstance_t *th, const char *fname, const char *label) {
 		return;
 	}
 	th->curFile = f;
-	th->curLine = SVM_FindLabel(f->data,label,f->fname);
+	th->curLine = SVM_FindLabel(f,label);
 
 	return;
 }
 void SVM_FreeAllFiles() {
 	scriptFile_t *f; 
+	int i;
 
 	f = g_scriptFiles;
 	while(f) {
@@ -499,6 +598,11 @@ void SVM_FreeAllFiles() {
 
 		n = f->next;
 
+		for(i = 0; i < f->numLines; i++) {
+			CMD_FreeCompiledCommand(&f->lines[i].compiled);
+		}
+		free(f->lines);
+		free(f->labels);
 		free(f->data);
 		free(f->fname);
 		free(f);
@@ -515,7 +619,7 @@ void SVM_StopAllScripts() {
 		t->curLine = 0;
 		t->curFile = 0;
 		t->uniqueID = 0;
-		t->currentDelayMS = 0;
+		TimerWheel_Cancel(&g_scriptWheel, &t->delay);
 
 		t = t->next;
 	}
@@ -532,7 +636,7 @@ void SVM_StopScripts(int id, int bExcludeSelf) {
 				t->curLine = 0;
 				t->curFile = 0;
 				t->uniqueID = 0;
-				t->currentDelayMS = 0;
+				TimerWheel_Cancel(&g_scriptWheel, &t->delay);
 			} 
 		}
 		t = t->next;
@@ -544,7 +648,7 @@ void SVM_GoToLocal(scriptInstance_t *th, const char *label) {
 
 		return;
 	}
-	th->curLine = SVM_FindLabel(th->curFile->data,label,th->curFile->fname);
+	th->curLine = SVM_FindLabel(th->curFile,label);
 
 	return;
 }
@@ -571,7 +675,7 @@ void SVM_StartScript(const char *fname, const char *label, int uniqueID) {
 	}
 	th->uniqueID = uniqueID;
 	th->curFile = f;
-	th->curLine = SVM_FindLabel(f->data,label,f->fname);
+	th->curLine = SVM_FindLabel(f,label);
 
 	if(label==0) {
 		ADDLOG_INFO(LOG_FEATURE_CMD, "CMD_StartScript: started %s at the beginning",fname);
@@ -657,7 +761,7 @@ static commandResult_t CMD_Delay_s(const void *context, const char *cmd, const c
 	del = Tokenizer_GetArgFloat(0);
 	delMS = del * 1000;
 	ADDLOG_EXTRADEBUG(LOG_FEATURE_CMD, "CMD_Delay_s: thread will delay %i extra ms\n",delMS);
-	g_activeThread->currentDelayMS += delMS;
+	SVM_AddDelay(g_activeThread, delMS);
 
 
 	return CMD_RES_OK;
@@ -680,7 +784,7 @@ static commandResult_t CMD_Delay_ms(const void *context, const char *cmd, const
 	del = Tokenizer_GetArgInteger(0);
 
 	ADDLOG_EXTRADEBUG(LOG_FEATURE_CMD, "CMD_Delay_ms: thread will delay %i\n",del);
-	g_activeThread->currentDelayMS += del;
+	SVM_AddDelay(g_activeThread, del);
 
 
 	return CMD_RES_OK;
@@ -743,7 +847,7 @@ static commandResult_t CMD_ListScripts(const void *context, const char *cmd, con
 	t = g_scriptThreads;
 	while(t) {
 		if(t->curFile) {
-			ADDLOG_INFO(LOG_FEATURE_CMD, "[%i] Thread UID %i - at file %s",cnt,t->uniqueID,t->curFile->fname);
+			ADDLOG_INFO(LOG_FEATURE_CMD, "[%i] Thread UID %i - at file %s line %i",cnt,t->uniqueID,t->curFile->fname,t->curLine);
 		} else {
 			ADDLOG_INFO(LOG_FEATURE_CMD, "[%i] Empty thread.",cnt);
 		}
@@ -802,6 +906,23 @@ commandResult_t CMD_waitFor(const void *context, const char *cmd, const char *ar
 
 	return CMD_RES_OK;
 }
+static commandResult_t CMD_SetScriptBudget(const void *context, const char *cmd, const char *args, int cmdFlags) {
+
+	Tokenizer_TokenizeString(args, 0);
+	// following check must be done after 'Tokenizer_TokenizeString',
+	// so we know arguments count in Tokenizer. 'cmd' argument is
+	// only for warning display
+	if (Tokenizer_CheckArgsCountAndPrintWarning(cmd, 1)) {
+		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
+	}
+	svm_budget = Tokenizer_GetArgInteger(0);
+	if (svm_budget < 1) {
+		svm_budget = 1;
+	}
+	ADDLOG_INFO(LOG_FEATURE_CMD, "Script threads will run up to %i lines per tick", svm_budget);
+
+	return CMD_RES_OK;
+}
 void CMD_InitScripting(){
 	//cmddetail:{"name":"startScript","args":"[FileName][Label][UniqueID]",
 	//cmddetail:"descr":"Starts a script thread from given file, at given label - can be * for whole file, with given unique ID",
@@ -853,6 +974,11 @@ void CMD_InitScripting(){
 	//cmddetail:"fn":"CMD_waitFor","file":"cmnds/cmd_script.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("waitFor", CMD_waitFor, NULL);
+	//cmddetail:{"name":"scriptBudget","args":"[LinesPerTick]",
+	//cmddetail:"descr":"Sets how many script lines (commands) a single script thread can run per tick before other tasks get their turn. Default is 10. Delays and waitFor end the tick earlier.",
+	//cmddetail:"fn":"CMD_SetScriptBudget","file":"cmnds/cmd_script.c","requires":"",
+	//cmddetail:"examples":"scriptBudget 50"}
+	CMD_RegisterCommand("scriptBudget", CMD_SetScriptBudget, NULL);
 
 }
 
@@ -17,6 +17,20 @@ static const char *g_argsFrom[MAX_ARGS];
 static int g_numArgs = 0;
 static int tok_flags = 0;
 
+// pre-split result of a constant argument string, see CMD_ExecuteCompiledCommand
+struct tokenizerCache_s {
+	int flags;
+	int numArgs;
+	int bufferLen;
+	// offsets of g_args in buffer and of g_argsFrom in source string
+	unsigned short args[MAX_ARGS];
+	unsigned short argsFrom[MAX_ARGS];
+	char buffer[1];
+};
+// set only while a compiled command runs its handler
+static const char *g_cacheFor = 0;
+static tokenizerCache_t **g_cache = 0;
+
 #define g_bAllowQuotes (tok_flags&TOKENIZER_ALLOW_QUOTES)
 #define g_bAllowExpand (!(tok_flags&TOKENIZER_DONT_EXPAND))
 
@@ -172,8 +186,55 @@ float Tokenizer_GetArgFloat(int i) {
 #endif
 	return atof(s);
 }
+void Tokenizer_SetCache(const char *s, tokenizerCache_t **cache) {
+	g_cacheFor = s;
+	g_cache = cache;
+}
+void Tokenizer_GetCache(const char **s, tokenizerCache_t ***cache) {
+	*s = g_cacheFor;
+	*cache = g_cache;
+}
+void Tokenizer_FreeCache(tokenizerCache_t *cache) {
+	free(cache);
+}
+static bool Tokenizer_LoadFromCache(const char *s, tokenizerCache_t *c) {
+	int i;
+
+	if (c == 0 || c->flags != tok_flags)
+		return false;
+	memcpy(g_buffer, c->buffer, c->bufferLen);
+	for (i = 0; i < c->numArgs; i++) {
+		g_args[i] = g_buffer + c->args[i];
+		g_argsFrom[i] = s + c->argsFrom[i];
+	}
+	g_numArgs = c->numArgs;
+	return true;
+}
+static void Tokenizer_SaveToCache(const char *s, int bufferLen, tokenizerCache_t **slot) {
+	tokenizerCache_t *c;
+	int i;
+
+	c = *slot;
+	if (c == 0 || c->bufferLen < bufferLen) {
+		free(c);
+		c = malloc(sizeof(tokenizerCache_t) + bufferLen);
+		*slot = c;
+		if (c == 0)
+			return;
+	}
+	c->flags = tok_flags;
+	c->numArgs = g_numArgs;
+	c->bufferLen = bufferLen;
+	memcpy(c->buffer, g_buffer, bufferLen);
+	for (i = 0; i < g_numArgs; i++) {
+		c->args[i] = g_args[i] - g_buffer;
+		c->argsFrom[i] = g_argsFrom[i] - s;
+	}
+}
+static void Tokenizer_SplitBuffer(const char *s);
+
 void Tokenizer_TokenizeString(const char *s, int flags) {
-	char *p;
+	tokenizerCache_t **slot = 0;
 
 	tok_flags = flags;
 	g_numArgs = 0;
@@ -181,6 +242,11 @@ void Tokenizer_TokenizeString(const char *s, int flags) {
 	if(s == 0) {
 		return;
 	}
+	// arguments of a compiled command never change, so unless they have to
+	// be expanded first, they are split only once
+	if (s == g_cacheFor && (flags & TOKENIZER_ALTERNATE_EXPAND_AT_START) == 0) {
+		slot = g_cache;
+	}
 
 	while(isWhiteSpace(*s)) {
 		s++;
@@ -190,6 +256,10 @@ void Tokenizer_TokenizeString(const char *s, int flags) {
 		return;
 	}
 
+	if (slot && Tokenizer_LoadFromCache(s, *slot)) {
+		return;
+	}
+
 	// not really needed, but nice for testing
 	memset(g_args, 0, sizeof(g_args));
 	memset(g_argsFrom, 0, sizeof(g_argsFrom));
@@ -205,6 +275,18 @@ void Tokenizer_TokenizeString(const char *s, int flags) {
 		g_numArgs = 1;
 		return;
 	}
+	if (slot) {
+		int bufferLen = strlen(g_buffer) + 1;
+
+		Tokenizer_SplitBuffer(s);
+		Tokenizer_SaveToCache(s, bufferLen, slot);
+		return;
+	}
+	Tokenizer_SplitBuffer(s);
+}
+static void Tokenizer_SplitBuffer(const char *s) {
+	char *p;
+
 	p = g_buffer;
 	// we need to rewrite this function and check it well with unit tests
 	if (*p == '"') {
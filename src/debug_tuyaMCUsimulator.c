@@ -1,6 +1,8 @@
 #ifdef WINDOWS
 
 #include "new_common.h"
+#include "driver/drv_public.h"
+#include "driver/drv_uart.h"
 
 const char *dataToSimulate[] =
 {
@@ -166,6 +168,88 @@ void NewTuyaMCUSimulator_RunQuickTick(int deltaMS) {
 
 }
 
+// Appends a frame with a valid length and checksum to the receive buffer,
+// as if it came from the MCU
+void TuyaMCUSimulator_AppendFrame(byte version, byte cmd, const byte *payload, int len) {
+	byte header[6];
+	byte checkSum;
+	int i;
+
+	header[0] = 0x55;
+	header[1] = 0xAA;
+	header[2] = version;
+	header[3] = cmd;
+	header[4] = len >> 8;
+	header[5] = len & 0xFF;
+	checkSum = 0;
+	for (i = 0; i < sizeof(header); i++) {
+		checkSum += header[i];
+		UART_AppendByteToCircularBuffer(header[i]);
+	}
+	for (i = 0; i < len; i++) {
+		checkSum += payload[i];
+		UART_AppendByteToCircularBuffer(payload[i]);
+	}
+	UART_AppendByteToCircularBuffer(checkSum);
+}
+
+static int TuyaMCUSimulator_Random(unsigned int *seed) {
+	*seed = *seed * 1103515245 + 12345;
+	return (*seed >> 16) & 0x7FFF;
+}
+
+// Appends line noise to the receive buffer: random bytes, a bogus header
+// with a random length, or a state report (cmd 0x07) with the given payload
+// that has one byte damaged or is cut short.
+void TuyaMCUSimulator_AppendNoise(unsigned int *seed, const byte *payload, int len) {
+	byte frame[64];
+	int frameLen;
+	int i, n;
+
+	frame[0] = 0x55;
+	frame[1] = 0xAA;
+	frame[2] = 0x03;
+	frame[3] = 0x07;
+	frame[4] = len >> 8;
+	frame[5] = len & 0xFF;
+	memcpy(frame + 6, payload, len);
+	frameLen = 6 + len;
+	frame[frameLen] = 0;
+	for (i = 0; i < frameLen; i++) {
+		frame[frameLen] += frame[i];
+	}
+	frameLen++;
+
+	switch (TuyaMCUSimulator_Random(seed) % 4) {
+	case 0:
+		n = 1 + TuyaMCUSimulator_Random(seed) % 16;
+		for (i = 0; i < n; i++) {
+			UART_AppendByteToCircularBuffer(TuyaMCUSimulator_Random(seed) & 0xFF);
+		}
+		break;
+	case 1:
+		frame[4] = (TuyaMCUSimulator_Random(seed) % 3) ? 0 : (TuyaMCUSimulator_Random(seed) & 0xFF);
+		frame[5] = TuyaMCUSimulator_Random(seed) & 0xFF;
+		for (i = 0; i < 6; i++) {
+			UART_AppendByteToCircularBuffer(frame[i]);
+		}
+		break;
+	case 2:
+		i = 2 + TuyaMCUSimulator_Random(seed) % (frameLen - 2);
+		frame[i] ^= 1 + TuyaMCUSimulator_Random(seed) % 255;
+		for (i = 0; i < frameLen; i++) {
+			UART_AppendByteToCircularBuffer(frame[i]);
+		}
+		break;
+	default:
+		n = 2 + TuyaMCUSimulator_Random(seed) % (frameLen - 2);
+		for (i = 0; i < n; i++) {
+			UART_AppendByteToCircularBuffer(frame[i]);
+		}
+		break;
+	}
+}
+
 
 #endif
 
@@ -88,7 +88,7 @@ commandResult_t BL0937_PowerMax(const void *context, const char *cmd, const char
         {
             char dbg[128];
             snprintf(dbg, sizeof(dbg),"PowerMax: set max to %f\n", BL0937_PMAX);
-            addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,dbg);
+            addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER, "%s", dbg);
         }
     }
     return CMD_RES_OK;
@@ -270,7 +270,7 @@ void BL0937_RunFrame(void) {
         {
             char dbg[128];
             snprintf(dbg, sizeof(dbg),"Power reading: %f exceeded MAX limit: %f, Last: %f\n", final_p, BL0937_PMAX, last_p);
-            addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER, dbg);
+            addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER, "%s", dbg);
         }
         final_p = last_p;
     } else {
@@ -281,7 +281,7 @@ void BL0937_RunFrame(void) {
 	{
 		char dbg[128];
 		snprintf(dbg, sizeof(dbg),"Voltage %f, current %f, power %f\n", final_v, final_c, final_p);
-		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,dbg);
+		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER, "%s", dbg);
 	}
 #endif
 	BL_ProcessUpdate(final_v, final_c, final_p, 0.0f);
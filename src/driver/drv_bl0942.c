@@ -67,8 +67,8 @@ static void ScaleAndUpdate(int raw_voltage, int raw_current, int raw_power,
 static int UART_TryToGetNextPacket(void) {
 	int cs;
 	int i;
-	int c_garbage_consumed = 0;
-	byte a;
+	int c_garbage_consumed;
+	byte packet[BL0942_UART_PACKET_LEN];
 	byte checksum;
 
 	cs = UART_GetDataSize();
@@ -77,30 +77,21 @@ static int UART_TryToGetNextPacket(void) {
 		return 0;
 	}
 	// skip garbage data (should not happen)
-	while(cs > 0) {
-		a = UART_GetNextByte(0);
-		if(a != BL0942_UART_PACKET_HEAD) {
-			UART_ConsumeBytes(1);
-			c_garbage_consumed++;
-			cs--;
-		} else {
-			break;
-		}
-	}
+	c_garbage_consumed = UART_FindByte(0, BL0942_UART_PACKET_HEAD);
 	if(c_garbage_consumed > 0){
+		UART_ConsumeBytes(c_garbage_consumed);
+		cs -= c_garbage_consumed;
 		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,"Consumed %i unwanted non-header byte in BL0942 buffer\n", c_garbage_consumed);
 	}
 	if(cs < BL0942_UART_PACKET_LEN) {
 		return 0;
 	}
-	a = UART_GetNextByte(0);
-	if(a != 0x55) {
-		return 0;
-	}
+	// the packet is consumed whether its checksum is good or not
+	UART_ReadSpan(packet, BL0942_UART_PACKET_LEN);
     checksum = BL0942_UART_CMD_READ(BL0942_UART_ADDR);
 
     for(i = 0; i < BL0942_UART_PACKET_LEN-1; i++) {
-		checksum += UART_GetNextByte(i);
+		checksum += packet[i];
 	}
 	checksum ^= 0xFF;
 
@@ -110,30 +101,26 @@ static int UART_TryToGetNextPacket(void) {
 		char buffer2[32];
 		buffer_for_log[0] = 0;
 		for(i = 0; i < BL0942_UART_PACKET_LEN; i++) {
-			snprintf(buffer2, sizeof(buffer2), "%02X ",UART_GetNextByte(i));
+			snprintf(buffer2, sizeof(buffer2), "%02X ",packet[i]);
 			strcat_safe(buffer_for_log,buffer2,sizeof(buffer_for_log));
 		}
 		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,"BL0942 received: %s\n", buffer_for_log);
 	}
 #endif
 
-	if(checksum != UART_GetNextByte(BL0942_UART_PACKET_LEN-1)) {
+	if(checksum != packet[BL0942_UART_PACKET_LEN-1]) {
         ADDLOG_WARN(LOG_FEATURE_ENERGYMETER,
                     "Skipping packet with bad checksum %02X wanted %02X\n",
-                    UART_GetNextByte(BL0942_UART_PACKET_LEN - 1), checksum);
-        UART_ConsumeBytes(BL0942_UART_PACKET_LEN);
+                    packet[BL0942_UART_PACKET_LEN - 1], checksum);
 		return 1;
 	}
 
     int voltage, current, power, frequency;
-    current = (UART_GetNextByte(3) << 16) | (UART_GetNextByte(2) << 8) |
-              UART_GetNextByte(1);
-    voltage = (UART_GetNextByte(6) << 16) | (UART_GetNextByte(5) << 8) |
-              UART_GetNextByte(4);
-    power = (UART_GetNextByte(12) << 24) | (UART_GetNextByte(11) << 16) |
-            (UART_GetNextByte(10) << 8);
+    current = (packet[3] << 16) | (packet[2] << 8) | packet[1];
+    voltage = (packet[6] << 16) | (packet[5] << 8) | packet[4];
+    power = (packet[12] << 24) | (packet[11] << 16) | (packet[10] << 8);
     power = (power >> 8);
-    frequency = (UART_GetNextByte(17) << 8) | UART_GetNextByte(16);
+    frequency = (packet[17] << 8) | packet[16];
 
     ScaleAndUpdate(voltage, current, power, frequency);
 
@@ -142,11 +129,10 @@ static int UART_TryToGetNextPacket(void) {
 		char res[128];
 		// V=245.107925,I=109.921143,P=0.035618
 		snprintf(res, sizeof(res),"V=%f,I=%f,P=%f\n",lastReadings[OBK_VOLTAGE],lastReadings[OBK_CURRENT],lastReadings[OBK_POWER]);
-		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,res );
+		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER, "%s", res);
 	}
 #endif
 
-    UART_ConsumeBytes(BL0942_UART_PACKET_LEN);
 	return BL0942_UART_PACKET_LEN;
 }
 
@@ -64,6 +64,8 @@ float dailyStats[DAILY_STATS_LENGTH];
 int actual_mday = -1;
 float lastSavedEnergyCounterValue = 0.0f;
 float changeSavedThresholdEnergy = 10.0f;
+// consumption is also saved after this many seconds, even if it changed less
+int changeSavedIntervalSeconds = 6 * 3600;
 long ConsumptionSaveCounter = 0;
 portTickType lastConsumptionSaveStamp;
 time_t ConsumptionResetTime = 0;
@@ -82,19 +84,24 @@ float g_apparentPower = 0;
 float g_powerFactor = 0;
 float g_reactivePower = 0;
 
+static int g_bl0937ID = DRV_ID_NOT_FOUND_YET;
+static int g_bl0942ID = DRV_ID_NOT_FOUND_YET;
+static int g_bl0942spiID = DRV_ID_NOT_FOUND_YET;
+static int g_cse7766ID = DRV_ID_NOT_FOUND_YET;
+
 void BL09XX_AppendInformationToHTTPIndexPage(http_request_t *request)
 {
     int i;
     const char *mode;
     struct tm *ltm;
 
-    if(DRV_IsRunning("BL0937")) {
+    if(DRV_IsRunningCached(&g_bl0937ID, "BL0937")) {
         mode = "BL0937";
-    } else if(DRV_IsRunning("BL0942")) {
+    } else if(DRV_IsRunningCached(&g_bl0942ID, "BL0942")) {
         mode = "BL0942";
-    } else if (DRV_IsRunning("BL0942SPI")) {
+    } else if (DRV_IsRunningCached(&g_bl0942spiID, "BL0942SPI")) {
         mode = "BL0942SPI";
-    } else if(DRV_IsRunning("CSE7766")) {
+    } else if(DRV_IsRunningCached(&g_cse7766ID, "CSE7766")) {
         mode = "CSE7766";
     } else {
         mode = "PWR";
@@ -433,7 +440,15 @@ commandResult_t BL09XX_SetupConsumptionThreshold(const void *context, const char
     if (threshold>200.0f)
         threshold = 200.0f;
     changeSavedThresholdEnergy = threshold;
-    addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER, "ConsumptionThreshold: %1.1f", changeSavedThresholdEnergy);
+    if (Tokenizer_GetArgsCount() >= 2)
+    {
+        changeSavedIntervalSeconds = Tokenizer_GetArgInteger(1);
+        if (changeSavedIntervalSeconds < 60)
+            changeSavedIntervalSeconds = 60;
+        if (changeSavedIntervalSeconds > 24 * 3600)
+            changeSavedIntervalSeconds = 24 * 3600;
+    }
+    addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER, "ConsumptionThreshold: %1.1f, interval %is", changeSavedThresholdEnergy, changeSavedIntervalSeconds);
 
     return CMD_RES_OK;
 }
@@ -765,7 +780,7 @@ void BL_ProcessUpdate(float voltage, float current, float power,
         stat_updatesSkipped++;
     }
     if (((energyCounter - lastSavedEnergyCounterValue) >= changeSavedThresholdEnergy) ||
-        ((xTaskGetTickCount() - lastConsumptionSaveStamp) >= (6 * 3600 * 1000 / portTICK_PERIOD_MS)))
+        ((xTaskGetTickCount() - lastConsumptionSaveStamp) >= (changeSavedIntervalSeconds * 1000 / portTICK_PERIOD_MS)))
     {
 #if WINDOWS
 #elif PLATFORM_BL602
@@ -843,8 +858,8 @@ void BL_Shared_Init(void)
 	//cmddetail:"fn":"BL09XX_SetupEnergyStatistic","file":"driver/drv_bl_shared.c","requires":"",
 	//cmddetail:"examples":""}
     CMD_RegisterCommand("SetupEnergyStats", BL09XX_SetupEnergyStatistic, NULL);
-	//cmddetail:{"name":"ConsumptionThreshold","args":"[FloatValue]",
-	//cmddetail:"descr":"Setup value for automatic save of consumption data [1..100]",
+	//cmddetail:{"name":"ConsumptionThreshold","args":"[FloatValue][IntervalSeconds]",
+	//cmddetail:"descr":"Setup value for automatic save of consumption data [1..200] Wh. Optional second argument is the interval [60..86400] after which consumption is saved even if it changed less, default is 6 hours. Saves only append a small record to the flash vars journal.",
 	//cmddetail:"fn":"BL09XX_SetupConsumptionThreshold","file":"driver/drv_bl_shared.c","requires":"",
 	//cmddetail:"examples":""}
     CMD_RegisterCommand("ConsumptionThreshold", BL09XX_SetupConsumptionThreshold, NULL);
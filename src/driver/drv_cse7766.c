@@ -12,14 +12,15 @@
 #define DEFAULT_POWER_CAL 1.88214409
 
 #define CSE7766_BAUD_RATE 4800
+#define CSE7766_UART_RECEIVE_BUFFER_SIZE 512
+#define CSE7766_PACKET_LEN 24
 
 int CSE7766_TryToGetNextCSE7766Packet() {
 	int cs;
 	int i;
-	int c_garbage_consumed = 0;
-	byte a;
+	int c_garbage_consumed;
 	byte checksum;
-	int CSE7766_PACKET_LEN = 24;
+	byte packet[CSE7766_PACKET_LEN];
 	byte header;
 
 	cs = UART_GetDataSize();
@@ -28,32 +29,23 @@ int CSE7766_TryToGetNextCSE7766Packet() {
 	if(cs < CSE7766_PACKET_LEN) {
 		return 0;
 	}
-	header = UART_GetNextByte(0);
-	// skip garbage data (should not happen)
-	while(cs > 0) {
-		a = UART_GetNextByte(1);
-		if(a != 0x5A) {
-			UART_ConsumeBytes(1);
-			c_garbage_consumed++;
-			cs--;
-		} else {
-			break;
-		}
-	}
+	// skip garbage data (should not happen), the 0x5A id follows the header byte
+	c_garbage_consumed = UART_FindByte(1, 0x5A) - 1;
 	if(c_garbage_consumed > 0){
+		UART_ConsumeBytes(c_garbage_consumed);
+		cs -= c_garbage_consumed;
 		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,"Consumed %i unwanted non-header byte in CSE7766 buffer\n", c_garbage_consumed);
 	}
 	if(cs < CSE7766_PACKET_LEN) {
 		return 0;
 	}
-	a = UART_GetNextByte(1);
-	if(a != 0x5A) {
-		return 0;
-	}
+	// the packet is consumed whether its checksum is good or not
+	UART_ReadSpan(packet, CSE7766_PACKET_LEN);
+	header = packet[0];
 	checksum = 0;
 
 	for(i = 2; i < CSE7766_PACKET_LEN-1; i++) {
-		checksum += UART_GetNextByte(i);
+		checksum += packet[i];
 	}
 
 #if 1
@@ -62,15 +54,14 @@ int CSE7766_TryToGetNextCSE7766Packet() {
 		char buffer2[32];
 		buffer_for_log[0] = 0;
 		for(i = 0; i < CSE7766_PACKET_LEN; i++) {
-			snprintf(buffer2, sizeof(buffer2), "%02X ",UART_GetNextByte(i));
+			snprintf(buffer2, sizeof(buffer2), "%02X ",packet[i]);
 			strcat_safe(buffer_for_log,buffer2,sizeof(buffer_for_log));
 		}
 		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,"CSE7766 received: %s\n", buffer_for_log);
 	}
 #endif
-	if(checksum != UART_GetNextByte(CSE7766_PACKET_LEN-1)) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,"Skipping packet with bad checksum %02X wanted %02X\n",checksum,UART_GetNextByte(CSE7766_PACKET_LEN-1));
-		UART_ConsumeBytes(CSE7766_PACKET_LEN);
+	if(checksum != packet[CSE7766_PACKET_LEN-1]) {
+		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,"Skipping packet with bad checksum %02X wanted %02X\n",checksum,packet[CSE7766_PACKET_LEN-1]);
 		return 1;
 	}
 	//addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,"CSE checksum ok");
@@ -131,20 +122,20 @@ int CSE7766_TryToGetNextCSE7766Packet() {
 		
 		
 
-		adjustement = UART_GetNextByte(20);
-		int vol_par = UART_GetNextByte(2) << 16 | UART_GetNextByte(3) << 8 | UART_GetNextByte(4);
-		int cur_par = UART_GetNextByte(8) << 16 | UART_GetNextByte(9) << 8 | UART_GetNextByte(10);
-		int pow_par = UART_GetNextByte(14) << 16 | UART_GetNextByte(15) << 8 | UART_GetNextByte(16);
-        float raw_unscaled_voltage = UART_GetNextByte(5) << 16 |
-                                     UART_GetNextByte(6) << 8 |
-                                     UART_GetNextByte(7);
-        float raw_unscaled_current = UART_GetNextByte(11) << 16 |
-                                     UART_GetNextByte(12) << 8 |
-                                     UART_GetNextByte(13);
-        float raw_unscaled_power = UART_GetNextByte(17) << 16 |
-                                   UART_GetNextByte(18) << 8 |
-                                   UART_GetNextByte(19);
-        cf_pulses = UART_GetNextByte(21) << 8 | UART_GetNextByte(22);
+		adjustement = packet[20];
+		int vol_par = packet[2] << 16 | packet[3] << 8 | packet[4];
+		int cur_par = packet[8] << 16 | packet[9] << 8 | packet[10];
+		int pow_par = packet[14] << 16 | packet[15] << 8 | packet[16];
+        float raw_unscaled_voltage = packet[5] << 16 |
+                                     packet[6] << 8 |
+                                     packet[7];
+        float raw_unscaled_current = packet[11] << 16 |
+                                     packet[12] << 8 |
+                                     packet[13];
+        float raw_unscaled_power = packet[17] << 16 |
+                                   packet[18] << 8 |
+                                   packet[19];
+        cf_pulses = packet[21] << 8 | packet[22];
 
 		// i am not sure about these flags
 		if (adjustement & 0x40) {  // Voltage valid
@@ -189,12 +180,10 @@ int CSE7766_TryToGetNextCSE7766Packet() {
 		char res[128];
 		// V=245.107925,I=109.921143,P=0.035618
 		snprintf(res, sizeof(res), "V=%f,I=%f,P=%f\n",lastReadings[OBK_VOLTAGE],lastReadings[OBK_CURRENT],lastReadings[OBK_POWER]);
-		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER,res );
+		addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER, "%s", res);
 	}
 #endif
 
-	UART_ConsumeBytes(CSE7766_PACKET_LEN);
-
 	return CSE7766_PACKET_LEN;
 }
 
@@ -205,7 +194,7 @@ void CSE7766_Init(void) {
                 DEFAULT_POWER_CAL);
 
 	UART_InitUART(CSE7766_BAUD_RATE);
-	UART_InitReceiveRingBuffer(512);
+	UART_InitReceiveRingBuffer(CSE7766_UART_RECEIVE_BUFFER_SIZE);
 }
 
 void CSE7766_RunFrame(void) {
@@ -12,6 +12,7 @@
 #include "drv_test_drivers.h"
 #include "drv_tuyaMCU.h"
 #include "drv_uart.h"
+#include "../hal/hal_generic.h"
 
 const char* sensor_mqttNames[OBK_NUM_MEASUREMENTS] = {
 	"voltage",
@@ -58,7 +59,13 @@ typedef struct driver_s {
 	void (*runQuickTick)();
 	void (*stopFunc)();
 	void (*onChannelChanged)(int ch, int val);
+	// DRV_FLAG_* capabilities
+	int flags;
 	bool bLoaded;
+	// per hook time statistics, zeroed at startup
+	unsigned int hookCalls[DRV_HOOK_COUNT];
+	unsigned int hookTimeUs[DRV_HOOK_COUNT];
+	unsigned int hookMaxUs[DRV_HOOK_COUNT];
 } driver_t;
 
 
@@ -69,230 +76,323 @@ static driver_t g_drivers[] = {
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"TuyaMCU is a protocol used for communication between WiFI module and external MCU. This protocol is using usually RX1/TX1 port of BK chips. See [TuyaMCU dimmer example](https://www.elektroda.com/rtvforum/topic3929151.html), see [TH06 LCD humidity/temperature sensor example](https://www.elektroda.com/rtvforum/topic3942730.html), see [fan controller example](https://www.elektroda.com/rtvforum/topic3908093.html), see [simple switch example](https://www.elektroda.com/rtvforum/topic3906443.html)",
 	//drvdetail:"requires":""}
-	{ "TuyaMCU",	TuyaMCU_Init,		TuyaMCU_RunFrame,			NULL, NULL, NULL, NULL, false },
+	{ "TuyaMCU",	TuyaMCU_Init,		TuyaMCU_RunFrame,			NULL, TuyaMCU_RunQuickTick, NULL, NULL, DRV_FLAG_NEEDS_UART, false },
 	//drvdetail:{"name":"tmSensor",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"tmSensor must be used only when TuyaMCU is already started. tmSensor is a TuyaMcu Sensor, it's used for Low Power TuyaMCU communication on devices like TuyaMCU door sensor, or TuyaMCU humidity sensor. After device reboots, tmSensor uses TuyaMCU to request data update from the sensor and reports it on MQTT. Then MCU turns off WiFi module again and goes back to sleep. See an [example door sensor here](https://www.elektroda.com/rtvforum/topic3914412.html).",
 	//drvdetail:"requires":""}
-	{ "tmSensor",	TuyaMCU_Sensor_Init, TuyaMCU_Sensor_RunFrame,	NULL, NULL, NULL, NULL, false },
+	{ "tmSensor",	TuyaMCU_Sensor_Init, TuyaMCU_Sensor_RunFrame,	NULL, NULL, NULL, NULL, 0, false },
 #endif
 #ifdef ENABLE_NTP
 	//drvdetail:{"name":"NTP",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"NTP driver is required to get current time and date from web. Without it, there is no correct datetime.",
 	//drvdetail:"requires":""}
-	{ "NTP",		NTP_Init,			NTP_OnEverySecond,			NTP_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, false },
+	{ "NTP",		NTP_Init,			NTP_OnEverySecond,			NTP_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, 0, false },
 #endif
 #ifdef ENABLE_HTTPBUTTONS
 	//drvdetail:{"name":"HTTPButtons",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"This driver allows you to create custom, scriptable buttons on main WWW page. You can create those buttons in autoexec.bat and assign commands to them",
 	//drvdetail:"requires":""}
-	{ "HTTPButtons",	DRV_InitHTTPButtons, NULL, NULL, NULL, NULL, NULL, false },
+	{ "HTTPButtons",	DRV_InitHTTPButtons, NULL, NULL, NULL, NULL, NULL, 0, false },
 #endif
 #ifdef ENABLE_TEST_DRIVERS
 	//drvdetail:{"name":"TESTPOWER",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"This is a fake POWER measuring socket driver, only for testing",
 	//drvdetail:"requires":""}
-	{ "TESTPOWER",	Test_Power_Init,	 Test_Power_RunFrame,		BL09XX_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, false },
+	{ "TESTPOWER",	Test_Power_Init,	 Test_Power_RunFrame,		BL09XX_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, DRV_FLAG_MEASURES_POWER, false },
 	//drvdetail:{"name":"TESTLED",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"This is a fake I2C LED driver, only for testing",
 	//drvdetail:"requires":""}
-	{ "TESTLED",	Test_LED_Driver_Init, Test_LED_Driver_RunFrame, NULL, NULL, NULL, Test_LED_Driver_OnChannelChanged, false },
+	{ "TESTLED",	Test_LED_Driver_Init, Test_LED_Driver_RunFrame, NULL, NULL, NULL, Test_LED_Driver_OnChannelChanged, DRV_FLAG_LED_CHIP, false },
 #endif
 #if ENABLE_I2C
 	//drvdetail:{"name":"I2C",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"Generic I2C, not used for LED drivers, but may be useful for displays or port expanders. Supports both hardware and software I2C.",
 	//drvdetail:"requires":""}
-	{ "I2C",		DRV_I2C_Init,		DRV_I2C_EverySecond,		NULL, NULL, NULL, NULL, false },
+	{ "I2C",		DRV_I2C_Init,		DRV_I2C_EverySecond,		NULL, NULL, NULL, NULL, 0, false },
 #endif
 #ifdef ENABLE_DRIVER_BL0942
 	//drvdetail:{"name":"BL0942",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"BL0942 is a power-metering chip which uses UART protocol for communication. It's usually connected to TX1/RX1 port of BK. You need to calibrate power metering once, just like in Tasmota. See [LSPA9 teardown example](https://www.elektroda.com/rtvforum/topic3887748.html). ",
 	//drvdetail:"requires":""}
-	{ "BL0942",		BL0942_UART_Init,	BL0942_UART_RunFrame,		BL09XX_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, false },
+	{ "BL0942",		BL0942_UART_Init,	BL0942_UART_RunFrame,		BL09XX_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, DRV_FLAG_MEASURES_POWER | DRV_FLAG_NEEDS_UART, false },
 #endif
 #ifdef ENABLE_DRIVER_BL0942SPI
 	//drvdetail:{"name":"BL0942SPI",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"BL0942 is a power-metering chip which uses SPI protocol for communication. It's usually connected to SPI1 port of BK. You need to calibrate power metering once, just like in Tasmota. See [PZIOT-E01 teardown example](https://www.elektroda.com/rtvforum/topic3945667.html). ",
 	//drvdetail:"requires":""}
-	{ "BL0942SPI",	BL0942_SPI_Init,	BL0942_SPI_RunFrame,		BL09XX_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, false },
+	{ "BL0942SPI",	BL0942_SPI_Init,	BL0942_SPI_RunFrame,		BL09XX_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, DRV_FLAG_MEASURES_POWER, false },
 #endif
 #ifdef ENABLE_DRIVER_BL0937
 	//drvdetail:{"name":"BL0937",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"BL0937 is a power-metering chip which uses custom protocol to report data. It requires setting 3 pins in pin config: CF, CF1 and SEL",
 	//drvdetail:"requires":""}
-	{ "BL0937",		BL0937_Init,		BL0937_RunFrame,			BL09XX_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, false },
+	{ "BL0937",		BL0937_Init,		BL0937_RunFrame,			BL09XX_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, DRV_FLAG_MEASURES_POWER, false },
 #endif
 #ifdef ENABLE_DRIVER_CSE7766
 	//drvdetail:{"name":"CSE7766",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"BL0942 is a power-metering chip which uses UART protocol for communication. It's usually connected to TX1/RX1 port of BK",
 	//drvdetail:"requires":""}
-	{ "CSE7766",	CSE7766_Init,		CSE7766_RunFrame,			BL09XX_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, false },
+	{ "CSE7766",	CSE7766_Init,		CSE7766_RunFrame,			BL09XX_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, DRV_FLAG_MEASURES_POWER | DRV_FLAG_NEEDS_UART, false },
 #endif
 #if PLATFORM_BEKEN
 	//drvdetail:{"name":"SM16703P",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"WIP driver",
 	//drvdetail:"requires":""}
-	{ "SM16703P",	SM16703P_Init,		NULL,						NULL, NULL, NULL, NULL, false },
+	{ "SM16703P",	SM16703P_Init,		NULL,						NULL, NULL, NULL, NULL, 0, false },
 	//drvdetail:{"name":"IR",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"IRLibrary wrapper, so you can receive remote signals and send them. See [forum discussion here](https://www.elektroda.com/rtvforum/topic3920360.html), also see [LED strip and IR YT video](https://www.youtube.com/watch?v=KU0tDwtjfjw)",
 	//drvdetail:"requires":""}
-	{ "IR",			DRV_IR_Init,		 NULL,						NULL, DRV_IR_RunFrame, NULL, NULL, false },
+	{ "IR",			DRV_IR_Init,		 NULL,						NULL, DRV_IR_RunFrame, NULL, NULL, 0, false },
 #endif
 #if defined(PLATFORM_BEKEN) || defined(WINDOWS)	|| defined(PLATFORM_BL602)
 	//drvdetail:{"name":"DDP",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"DDP is a LED control protocol that is using UDP. You can use xLights or any other app to control OBK LEDs that way.",
 	//drvdetail:"requires":""}
-	{ "DDP",		DRV_DDP_Init,		NULL,						DRV_DDP_AppendInformationToHTTPIndexPage, DRV_DDP_RunFrame, DRV_DDP_Shutdown, NULL, false },
+	{ "DDP",		DRV_DDP_Init,		NULL,						DRV_DDP_AppendInformationToHTTPIndexPage, DRV_DDP_RunFrame, DRV_DDP_Shutdown, NULL, 0, false },
 	//drvdetail:{"name":"SSDP",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"SSDP is a discovery protocol, so BK devices can show up in, for example, Windows network section",
 	//drvdetail:"requires":""}
-	{ "SSDP",		DRV_SSDP_Init,		DRV_SSDP_RunEverySecond,	NULL, DRV_SSDP_RunQuickTick, DRV_SSDP_Shutdown, NULL, false },
+	{ "SSDP",		DRV_SSDP_Init,		DRV_SSDP_RunEverySecond,	NULL, DRV_SSDP_RunQuickTick, DRV_SSDP_Shutdown, NULL, 0, false },
 	//drvdetail:{"name":"Wemo",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"Wemo emulation for Alexa. You must also start SSDP so it can run, because it depends on SSDP discovery.",
 	//drvdetail:"requires":""}
-	{ "Wemo",		WEMO_Init,		NULL,		WEMO_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, false },
+	{ "Wemo",		WEMO_Init,		NULL,		WEMO_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, 0, false },
 	//drvdetail:{"name":"DGR",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"Tasmota Device groups driver. See [forum example](https://www.elektroda.com/rtvforum/topic3925472.html) and TODO-video tutorial (will post on YT soon)",
 	//drvdetail:"requires":""}
-	{ "DGR",		DRV_DGR_Init,		DRV_DGR_RunEverySecond,		DRV_DGR_AppendInformationToHTTPIndexPage, DRV_DGR_RunQuickTick, DRV_DGR_Shutdown, DRV_DGR_OnChannelChanged, false },
+	{ "DGR",		DRV_DGR_Init,		DRV_DGR_RunEverySecond,		DRV_DGR_AppendInformationToHTTPIndexPage, DRV_DGR_RunQuickTick, DRV_DGR_Shutdown, DRV_DGR_OnChannelChanged, 0, false },
 #endif
 #if defined(PLATFORM_BEKEN) || defined(WINDOWS)
 	//drvdetail:{"name":"PWMToggler",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"PWMToggler is a custom abstraction layer that can run on top of raw PWM channels. It provides ability to turn off/on the PWM while keeping it's value, which is not possible by direct channel operations. It can be used for some custom devices with extra lights/lasers. See example [here](https://www.elektroda.com/rtvforum/topic3939064.html).",
 	//drvdetail:"requires":""}
-	{ "PWMToggler",	DRV_InitPWMToggler, NULL, DRV_Toggler_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, false },
+	{ "PWMToggler",	DRV_InitPWMToggler, NULL, DRV_Toggler_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, 0, false },
 	//drvdetail:{"name":"DoorSensor",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"DoorSensor is using deep sleep to preserve battery. This is used for devices without TuyaMCU, where BK deep sleep and wakeup on GPIO is used. This drives requires you to set a DoorSensor pin. Change on door sensor pin wakes up the device. If there are no changes for some time, device goes to sleep. See example [here](https://www.elektroda.com/rtvforum/topic3960149.html). If your door sensor does not wake up in certain pos, please use DSEdge command (try all 3 options, default is 2). ",
 	//drvdetail:"requires":""}
-	{ "DoorSensor",		DoorDeepSleep_Init,		DoorDeepSleep_OnEverySecond,	DoorDeepSleep_AppendInformationToHTTPIndexPage, NULL, NULL, DoorDeepSleep_OnChannelChanged, false },
+	{ "DoorSensor",		DoorDeepSleep_Init,		DoorDeepSleep_OnEverySecond,	DoorDeepSleep_AppendInformationToHTTPIndexPage, NULL, NULL, DoorDeepSleep_OnChannelChanged, 0, false },
 	//drvdetail:{"name":"MAX72XX_Clock",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"Simple hardcoded driver for MAX72XX clock. Requirex manual start of MAX72XX driver with MAX72XX setup and NTP start.",
 	//drvdetail:"requires":""}
-	{ "MAX72XX_Clock",		DRV_MAX72XX_Clock_Init,		DRV_MAX72XX_Clock_OnEverySecond,	NULL, DRV_MAX72XX_Clock_RunFrame, NULL, NULL, false },
+	{ "MAX72XX_Clock",		DRV_MAX72XX_Clock_Init,		DRV_MAX72XX_Clock_OnEverySecond,	NULL, DRV_MAX72XX_Clock_RunFrame, NULL, NULL, 0, false },
 	//drvdetail:{"name":"ADCButton",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"This allows you to connect multiple buttons on single ADC pin. Each button must have a different resistor value, this works by probing the voltage on ADC from a resistor divider. You need to select AB_Map first. See forum post for [details](https://www.elektroda.com/rtvforum/viewtopic.php?p=20541973#20541973).",
 	//drvdetail:"requires":""}
-	{ "ADCButton",		DRV_ADCButton_Init,		NULL,	NULL, DRV_ADCButton_RunFrame, NULL, NULL, false },
+	{ "ADCButton",		DRV_ADCButton_Init,		NULL,	NULL, DRV_ADCButton_RunFrame, NULL, NULL, 0, false },
 #endif
 #ifdef ENABLE_DRIVER_LED
 	//drvdetail:{"name":"SM2135",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"SM2135 custom-'I2C' LED driver for RGBCW lights. This will start automatically if you set both SM2135 pin roles. This may need you to remap the RGBCW indexes with SM2135_Map command",
 	//drvdetail:"requires":""}
-	{ "SM2135",		SM2135_Init,		NULL,			NULL, NULL, NULL, NULL, false },
+	{ "SM2135",		SM2135_Init,		NULL,			NULL, NULL, NULL, NULL, DRV_FLAG_LED_CHIP, false },
 	//drvdetail:{"name":"BP5758D",
 	//drvdetail:"title":"TODO",	
 	//drvdetail:"descr":"BP5758D custom-'I2C' LED driver for RGBCW lights. This will start automatically if you set both BP5758D pin roles. This may need you to remap the RGBCW indexes with BP5758D_Map command. This driver is used in some of BL602/Sonoff bulbs, see [video flashing tutorial here](https://www.youtube.com/watch?v=L6d42IMGhHw)",
 	//drvdetail:"requires":""}
-	{ "BP5758D",	BP5758D_Init,		NULL,			NULL, NULL, NULL, NULL, false },
+	{ "BP5758D",	BP5758D_Init,		NULL,			NULL, NULL, NULL, NULL, DRV_FLAG_LED_CHIP, false },
 	//drvdetail:{"name":"BP1658CJ",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"BP1658CJ custom-'I2C' LED driver for RGBCW lights. This will start automatically if you set both BP1658CJ pin roles. This may need you to remap the RGBCW indexes with BP1658CJ_Map command",
 	//drvdetail:"requires":""}
-	{ "BP1658CJ",	BP1658CJ_Init,		NULL,			NULL, NULL, NULL, NULL, false },
+	{ "BP1658CJ",	BP1658CJ_Init,		NULL,			NULL, NULL, NULL, NULL, DRV_FLAG_LED_CHIP, false },
 	//drvdetail:{"name":"SM2235",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"SM2335 andd SM2235 custom-'I2C' LED driver for RGBCW lights. This will start automatically if you set both SM2235 pin roles. This may need you to remap the RGBCW indexes with SM2235_Map command",
 	//drvdetail:"requires":""}
-	{ "SM2235",		SM2235_Init,		NULL,			NULL, NULL, NULL, NULL, false },
+	{ "SM2235",		SM2235_Init,		NULL,			NULL, NULL, NULL, NULL, DRV_FLAG_LED_CHIP, false },
 #endif
 #if defined(PLATFORM_BEKEN) || defined(WINDOWS)
 	//drvdetail:{"name":"CHT8305",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"CHT8305 is a Temperature and Humidity sensor with I2C interface.",
 	//drvdetail:"requires":""}
-	{ "CHT8305",	CHT8305_Init,		CHT8305_OnEverySecond,		CHT8305_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, false },
+	{ "CHT8305",	CHT8305_Init,		CHT8305_OnEverySecond,		CHT8305_AppendInformationToHTTPIndexPage, NULL, NULL, NULL, DRV_FLAG_SENSOR, false },
 	//drvdetail:{"name":"KP18068",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"KP18068 I2C LED driver",
 	//drvdetail:"requires":""}
-	{ "KP18068",		KP18068_Init,		NULL,			NULL, NULL, NULL, NULL, false },
+	{ "KP18068",		KP18068_Init,		NULL,			NULL, NULL, NULL, NULL, 0, false },
 	//drvdetail:{"name":"MAX72XX",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"MAX72XX LED matrix display driver with font and simple script interface.",
 	//drvdetail:"requires":""}
-	{ "MAX72XX",	DRV_MAX72XX_Init,		NULL,		NULL, NULL, NULL, NULL, false },
+	{ "MAX72XX",	DRV_MAX72XX_Init,		NULL,		NULL, NULL, NULL, NULL, DRV_FLAG_DISPLAY, false },
 	//drvdetail:{"name":"TM1637",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"Driver for 7-segment LED display with DIO/CLK interface",
 	//drvdetail:"requires":""}
-	{ "TM1637",	TM1637_Init,		NULL,		NULL,  TMGN_RunQuickTick,NULL, NULL, false },
+	{ "TM1637",	TM1637_Init,		NULL,		NULL,  TMGN_RunQuickTick,NULL, NULL, DRV_FLAG_DISPLAY, false },
 	//drvdetail:{"name":"GN6932",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"Driver for 7-segment LED display with DIO/CLK/STB interface. See [this topic](https://www.elektroda.com/rtvforum/topic3971252.html) for details.",
 	//drvdetail:"requires":""}
-	{ "GN6932",	GN6932_Init,		NULL,		NULL, TMGN_RunQuickTick, NULL, NULL, false },
+	{ "GN6932",	GN6932_Init,		NULL,		NULL, TMGN_RunQuickTick, NULL, NULL, DRV_FLAG_DISPLAY, false },
 	//drvdetail:{"name":"TM1638",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"Driver for 7-segment LED display with DIO/CLK/STB interface. TM1638 is very similiar to GN6932 and TM1637. See [this topic](https://www.elektroda.com/rtvforum/viewtopic.php?p=20553628#20553628) for details.",
 	//drvdetail:"requires":""}
-	{ "TM1638",	TM1638_Init,		NULL,		NULL, TMGN_RunQuickTick,NULL,  NULL, false },
+	{ "TM1638",	TM1638_Init,		NULL,		NULL, TMGN_RunQuickTick,NULL,  NULL, DRV_FLAG_DISPLAY, false },
 	//drvdetail:{"name":"SHT3X",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"Humidity/temperature sensor. See [SHT Sensor tutorial topic here](https://www.elektroda.com/rtvforum/topic3958369.html), also see [this sensor teardown](https://www.elektroda.com/rtvforum/topic3945688.html)",
 	//drvdetail:"requires":""}
-	{ "SHT3X",	    SHT3X_Init,		SHT3X_OnEverySecond,		SHT3X_AppendInformationToHTTPIndexPage, NULL, SHT3X_StopDriver, NULL, false },
+	{ "SHT3X",	    SHT3X_Init,		SHT3X_OnEverySecond,		SHT3X_AppendInformationToHTTPIndexPage, NULL, SHT3X_StopDriver, NULL, DRV_FLAG_SENSOR, false },
 	//drvdetail:{"name":"SGP",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"SGP Air Quality sensor with I2C interface.",
 	//drvdetail:"requires":""}
-	{ "SGP",	    SGP_Init,		SGP_OnEverySecond,		SGP_AppendInformationToHTTPIndexPage, NULL, SGP_StopDriver, NULL, false },
+	{ "SGP",	    SGP_Init,		SGP_OnEverySecond,		SGP_AppendInformationToHTTPIndexPage, NULL, SGP_StopDriver, NULL, DRV_FLAG_SENSOR, false },
 
 	//drvdetail:{"name":"ShiftRegister",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"ShiftRegisterShiftRegisterShiftRegisterShiftRegister",
 	//drvdetail:"requires":""}
-	{ "ShiftRegister",	    Shift_Init,		Shift_OnEverySecond,		NULL, NULL, NULL, Shift_OnChannelChanged, false },
+	{ "ShiftRegister",	    Shift_Init,		Shift_OnEverySecond,		NULL, NULL, NULL, Shift_OnChannelChanged, 0, false },
 #endif
 #if defined(PLATFORM_BEKEN) || defined(WINDOWS)
 	//drvdetail:{"name":"Battery",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"Custom mechanism to measure battery level with ADC and an optional relay. See [example here](https://www.elektroda.com/rtvforum/topic3959103.html).",
 	//drvdetail:"requires":""}
-	{ "Battery",	Batt_Init,		Batt_OnEverySecond,		Batt_AppendInformationToHTTPIndexPage, NULL, Batt_StopDriver, NULL, false },
+	{ "Battery",	Batt_Init,		Batt_OnEverySecond,		Batt_AppendInformationToHTTPIndexPage, NULL, Batt_StopDriver, NULL, DRV_FLAG_MEASURES_BATTERY, false },
 #endif
 #ifdef ENABLE_DRIVER_BRIDGE
 	//drvdetail:{"name":"Bridge",
 	//drvdetail:"title":"TODO",
 	//drvdetail:"descr":"TODO",
 	//drvdetail:"requires":""}
-	{ "Bridge",     Bridge_driver_Init, NULL,                       NULL, Bridge_driver_QuickFrame, Bridge_driver_DeInit, Bridge_driver_OnChannelChanged, false }
+	{ "Bridge",     Bridge_driver_Init, NULL,                       NULL, Bridge_driver_QuickFrame, Bridge_driver_DeInit, Bridge_driver_OnChannelChanged, 0, false }
 #endif
 };
 
 
-static const int g_numDrivers = sizeof(g_drivers) / sizeof(g_drivers[0]);
+#define DRV_TABLE_SIZE (sizeof(g_drivers) / sizeof(g_drivers[0]))
 
-bool DRV_IsRunning(const char* name) {
+static const int g_numDrivers = DRV_TABLE_SIZE;
+
+// compact lists of running drivers that implement given hook,
+// rebuilt on every start/stop so that hooks called often do not
+// have to scan whole driver table
+static byte g_hookDrivers[DRV_HOOK_COUNT][DRV_TABLE_SIZE];
+static int g_hookDriversCount[DRV_HOOK_COUNT];
+// OR of flags of all running drivers
+static int g_runningFlags = 0;
+// running drivers with onChannelChanged as one bit per table entry.
+// DRV_OnChannelChanged walks it without the driver mutex, so every word is
+// stored once per rebuild and a racing reader sees each bit either old or new.
+#define DRV_MASK_WORDS ((DRV_TABLE_SIZE + 31) / 32)
+static volatile unsigned int g_channelChangedMask[DRV_MASK_WORDS];
+
+static void DRV_RebuildRunningLists() {
+	int i, h;
+	int counts[DRV_HOOK_COUNT];
+	int flags;
+	unsigned int mask[DRV_MASK_WORDS];
+	driver_t* d;
+
+	for (h = 0; h < DRV_HOOK_COUNT; h++) {
+		counts[h] = 0;
+	}
+	memset(mask, 0, sizeof(mask));
+	flags = 0;
+	for (i = 0; i < g_numDrivers; i++) {
+		d = &g_drivers[i];
+		if (d->bLoaded == false) {
+			continue;
+		}
+		flags |= d->flags;
+		if (d->runQuickTick) {
+			g_hookDrivers[DRV_HOOK_QUICKTICK][counts[DRV_HOOK_QUICKTICK]++] = i;
+		}
+		if (d->onEverySecond) {
+			g_hookDrivers[DRV_HOOK_EVERYSECOND][counts[DRV_HOOK_EVERYSECOND]++] = i;
+		}
+		if (d->onChannelChanged) {
+			g_hookDrivers[DRV_HOOK_CHANNELCHANGED][counts[DRV_HOOK_CHANNELCHANGED]++] = i;
+			mask[i / 32] |= 1u << (i % 32);
+		}
+		if (d->appendInformationToHTTPIndexPage) {
+			g_hookDrivers[DRV_HOOK_HTTPINDEX][counts[DRV_HOOK_HTTPINDEX]++] = i;
+		}
+	}
+	for (h = 0; h < DRV_HOOK_COUNT; h++) {
+		g_hookDriversCount[h] = counts[h];
+	}
+	for (i = 0; i < DRV_MASK_WORDS; i++) {
+		g_channelChangedMask[i] = mask[i];
+	}
+	g_runningFlags = flags;
+}
+static void DRV_AccountHookTime(driver_t* d, int hook, unsigned int start) {
+	unsigned int delta;
+
+	delta = HAL_GetTimeUs() - start;
+	d->hookCalls[hook]++;
+	d->hookTimeUs[hook] += delta;
+	if (delta > d->hookMaxUs[hook]) {
+		d->hookMaxUs[hook] = delta;
+	}
+}
+int DRV_FindDriver(const char* name) {
 	int i;
 
 	for (i = 0; i < g_numDrivers; i++) {
-		if (g_drivers[i].bLoaded) {
-			if (!stricmp(name, g_drivers[i].name)) {
-				return true;
-			}
+		if (!stricmp(name, g_drivers[i].name)) {
+			return i;
 		}
 	}
-	return false;
+	return -1;
+}
+bool DRV_IsRunningID(int id) {
+	if (id < 0 || id >= g_numDrivers) {
+		return false;
+	}
+	return g_drivers[id].bLoaded;
+}
+bool DRV_IsRunning(const char* name) {
+	return DRV_IsRunningID(DRV_FindDriver(name));
+}
+bool DRV_IsRunningCached(int* id, const char* name) {
+	if (*id == DRV_ID_NOT_FOUND_YET) {
+		*id = DRV_FindDriver(name);
+	}
+	return DRV_IsRunningID(*id);
+}
+bool DRV_HasRunningDriverWithFlag(int flag) {
+	return (g_runningFlags & flag) != 0;
+}
+int DRV_GetHookDriversCount(int hook) {
+	if (hook < 0 || hook >= DRV_HOOK_COUNT) {
+		return 0;
+	}
+	return g_hookDriversCount[hook];
+}
+unsigned int DRV_GetHookCalls(int id, int hook) {
+	if (id < 0 || id >= g_numDrivers || hook < 0 || hook >= DRV_HOOK_COUNT) {
+		return 0;
+	}
+	return g_drivers[id].hookCalls[hook];
 }
 
 static SemaphoreHandle_t g_mutex = 0;
@@ -315,48 +415,63 @@ void DRV_Mutex_Free() {
 }
 void DRV_OnEverySecond() {
 	int i;
+	unsigned int start;
+	driver_t* d;
 
 	if (DRV_Mutex_Take(100) == false) {
 		return;
 	}
-	for (i = 0; i < g_numDrivers; i++) {
-		if (g_drivers[i].bLoaded) {
-			if (g_drivers[i].onEverySecond != 0) {
-				g_drivers[i].onEverySecond();
-			}
-		}
+	for (i = 0; i < g_hookDriversCount[DRV_HOOK_EVERYSECOND]; i++) {
+		d = &g_drivers[g_hookDrivers[DRV_HOOK_EVERYSECOND][i]];
+		start = HAL_GetTimeUs();
+		d->onEverySecond();
+		DRV_AccountHookTime(d, DRV_HOOK_EVERYSECOND, start);
 	}
 	DRV_Mutex_Free();
 }
 void DRV_RunQuickTick() {
 	int i;
+	unsigned int start;
+	driver_t* d;
 
+	if (g_hookDriversCount[DRV_HOOK_QUICKTICK] == 0) {
+		return;
+	}
 	if (DRV_Mutex_Take(0) == false) {
 		return;
 	}
-	for (i = 0; i < g_numDrivers; i++) {
-		if (g_drivers[i].bLoaded) {
-			if (g_drivers[i].runQuickTick != 0) {
-				g_drivers[i].runQuickTick();
-			}
-		}
+	for (i = 0; i < g_hookDriversCount[DRV_HOOK_QUICKTICK]; i++) {
+		d = &g_drivers[g_hookDrivers[DRV_HOOK_QUICKTICK][i]];
+		start = HAL_GetTimeUs();
+		d->runQuickTick();
+		DRV_AccountHookTime(d, DRV_HOOK_QUICKTICK, start);
 	}
 	DRV_Mutex_Free();
 }
+// Channels are also set from inside other driver hooks, which already hold
+// the driver mutex, so this walks g_channelChangedMask without taking it.
 void DRV_OnChannelChanged(int channel, int iVal) {
-	int i;
+	int w, b;
+	unsigned int bits;
+	unsigned int start;
+	driver_t* d;
 
-	//if(DRV_Mutex_Take(100)==false) {
-	//	return;
-	//}
-	for (i = 0; i < g_numDrivers; i++) {
-		if (g_drivers[i].bLoaded) {
-			if (g_drivers[i].onChannelChanged != 0) {
-				g_drivers[i].onChannelChanged(channel, iVal);
+	for (w = 0; w < DRV_MASK_WORDS; w++) {
+		bits = g_channelChangedMask[w];
+		for (b = 0; bits; b++, bits >>= 1) {
+			if ((bits & 1) == 0) {
+				continue;
 			}
+			d = &g_drivers[w * 32 + b];
+			// no mutex here, so driver may have been stopped in the meantime
+			if (d->bLoaded == false) {
+				continue;
+			}
+			start = HAL_GetTimeUs();
+			d->onChannelChanged(channel, iVal);
+			DRV_AccountHookTime(d, DRV_HOOK_CHANNELCHANGED, start);
 		}
 	}
-	//DRV_Mutex_Free();
 }
 // right now only used by simulator
 void DRV_ShutdownAllDrivers() {
@@ -380,6 +495,7 @@ void DRV_StopDriver(const char* name) {
 					g_drivers[i].stopFunc();
 				}
 				g_drivers[i].bLoaded = false;
+				DRV_RebuildRunningLists();
 				addLogAdv(LOG_INFO, LOG_FEATURE_MAIN, "Drv %s stopped.", g_drivers[i].name);
 			}
 			else {
@@ -399,22 +515,22 @@ void DRV_StartDriver(const char* name) {
 		return;
 	}
 	bStarted = 0;
-	for (i = 0; i < g_numDrivers; i++) {
-		if (!stricmp(g_drivers[i].name, name)) {
-			if (g_drivers[i].bLoaded) {
-				addLogAdv(LOG_INFO, LOG_FEATURE_MAIN, "Drv %s is already loaded.\n", name);
-				bStarted = 1;
-				break;
-
-			}
-			else {
-				g_drivers[i].initFunc();
-				g_drivers[i].bLoaded = true;
-				addLogAdv(LOG_INFO, LOG_FEATURE_MAIN, "Started %s.\n", name);
-				bStarted = 1;
-				break;
-			}
+	i = DRV_FindDriver(name);
+	if (i != -1) {
+		if (g_drivers[i].bLoaded) {
+			addLogAdv(LOG_INFO, LOG_FEATURE_MAIN, "Drv %s is already loaded.\n", name);
+		}
+		else if (g_drivers[i].flags & g_runningFlags & DRV_FLAG_NEEDS_UART) {
+			// UART drivers set their own baud rate and share one receive buffer
+			addLogAdv(LOG_ERROR, LOG_FEATURE_MAIN, "Drv %s needs the UART, which another driver uses.\n", name);
 		}
+		else {
+			g_drivers[i].initFunc();
+			g_drivers[i].bLoaded = true;
+			DRV_RebuildRunningLists();
+			addLogAdv(LOG_INFO, LOG_FEATURE_MAIN, "Started %s.\n", name);
+		}
+		bStarted = 1;
 	}
 	if (!bStarted) {
 		addLogAdv(LOG_INFO, LOG_FEATURE_MAIN, "Driver %s is not known in this build.\n", name);
@@ -458,6 +574,49 @@ static commandResult_t DRV_Stop(const void* context, const char* cmd, const char
 	DRV_StopDriver(Tokenizer_GetArg(0));
 	return CMD_RES_OK;
 }
+static const char* g_hookNames[DRV_HOOK_COUNT] = {
+	"quickTick",
+	"everySecond",
+	"channelChanged",
+	"httpIndex"
+};
+// DriverStats
+// DriverStats reset
+static commandResult_t DRV_Stats(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	int i, h;
+	driver_t* d;
+
+	if (args && !stricmp(args, "reset")) {
+		for (i = 0; i < g_numDrivers; i++) {
+			d = &g_drivers[i];
+			memset(d->hookCalls, 0, sizeof(d->hookCalls));
+			memset(d->hookTimeUs, 0, sizeof(d->hookTimeUs));
+			memset(d->hookMaxUs, 0, sizeof(d->hookMaxUs));
+		}
+	}
+	for (h = 0; h < DRV_HOOK_COUNT; h++) {
+		ADDLOG_INFO(LOG_FEATURE_MAIN, "%s: %i drivers", g_hookNames[h], g_hookDriversCount[h]);
+	}
+	if (HAL_GetTimeUsResolution() > 1) {
+		// each call is timed in whole clock steps, so short hooks add 0
+		ADDLOG_INFO(LOG_FEATURE_MAIN, "clock resolution is %u us, shorter calls read as 0",
+			HAL_GetTimeUsResolution());
+	}
+	for (i = 0; i < g_numDrivers; i++) {
+		d = &g_drivers[i];
+		if (d->bLoaded == false) {
+			continue;
+		}
+		for (h = 0; h < DRV_HOOK_COUNT; h++) {
+			if (d->hookCalls[h] == 0) {
+				continue;
+			}
+			ADDLOG_INFO(LOG_FEATURE_MAIN, "%s %s: %u calls, total %u us, max %u us",
+				d->name, g_hookNames[h], d->hookCalls[h], d->hookTimeUs[h], d->hookMaxUs[h]);
+		}
+	}
+	return CMD_RES_OK;
+}
 
 void DRV_Generic_Init() {
 	//cmddetail:{"name":"startDriver","args":"[DriverName]",
@@ -470,20 +629,30 @@ void DRV_Generic_Init() {
 	//cmddetail:"fn":"DRV_Stop","file":"driver/drv_main.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("stopDriver", DRV_Stop, NULL);
+	//cmddetail:{"name":"DriverStats","args":"[reset-Optional]",
+	//cmddetail:"descr":"Logs how many running drivers use each driver hook and how much time each running driver spent in its hooks (calls, total and max microseconds). When the clock only counts RTOS ticks, its resolution is logged too. Use 'reset' to clear the counters.",
+	//cmddetail:"fn":"DRV_Stats","file":"driver/drv_main.c","requires":"",
+	//cmddetail:"examples":""}
+	CMD_RegisterCommand("DriverStats", DRV_Stats, NULL);
 }
 void DRV_AppendInformationToHTTPIndexPage(http_request_t* request) {
 	int i, j;
 	int c_active = 0;
+	unsigned int start;
+	driver_t* d;
 
 	if (DRV_Mutex_Take(100) == false) {
 		return;
 	}
+	for (i = 0; i < g_hookDriversCount[DRV_HOOK_HTTPINDEX]; i++) {
+		d = &g_drivers[g_hookDrivers[DRV_HOOK_HTTPINDEX][i]];
+		start = HAL_GetTimeUs();
+		d->appendInformationToHTTPIndexPage(request);
+		DRV_AccountHookTime(d, DRV_HOOK_HTTPINDEX, start);
+	}
 	for (i = 0; i < g_numDrivers; i++) {
 		if (g_drivers[i].bLoaded) {
 			c_active++;
-			if (g_drivers[i].appendInformationToHTTPIndexPage) {
-				g_drivers[i].appendInformationToHTTPIndexPage(request);
-			}
 		}
 	}
 	DRV_Mutex_Free();
@@ -511,14 +680,14 @@ void DRV_AppendInformationToHTTPIndexPage(http_request_t* request) {
 
 bool DRV_IsMeasuringPower() {
 #ifndef OBK_DISABLE_ALL_DRIVERS
-	return DRV_IsRunning("BL0937") || DRV_IsRunning("BL0942") || DRV_IsRunning("CSE7766") || DRV_IsRunning("TESTPOWER");
+	return DRV_HasRunningDriverWithFlag(DRV_FLAG_MEASURES_POWER);
 #else
 	return false;
 #endif
 }
 bool DRV_IsMeasuringBattery() {
 #ifndef OBK_DISABLE_ALL_DRIVERS
-	return DRV_IsRunning("Battery");
+	return DRV_HasRunningDriverWithFlag(DRV_FLAG_MEASURES_BATTERY);
 #else
 	return false;
 #endif
@@ -526,7 +695,7 @@ bool DRV_IsMeasuringBattery() {
 
 bool DRV_IsSensor() {
 #ifndef OBK_DISABLE_ALL_DRIVERS
-	return DRV_IsRunning("SHT3X") || DRV_IsRunning("CHT8305") || DRV_IsRunning("SGP");
+	return DRV_HasRunningDriverWithFlag(DRV_FLAG_SENSOR);
 #else
 	return false;
 #endif
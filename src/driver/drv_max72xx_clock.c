@@ -239,8 +239,10 @@ if $CH10==4 then my_send_style_blue
 
 */
 void DRV_MAX72XX_Clock_Init() {
-
-
+	// the clock only prints through MAX72XX commands
+	if (DRV_HasRunningDriverWithFlag(DRV_FLAG_DISPLAY) == false) {
+		addLogAdv(LOG_ERROR, LOG_FEATURE_MAIN, "MAX72XX_Clock needs a display driver, start MAX72XX first.\n");
+	}
 }
 
 
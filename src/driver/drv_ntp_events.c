@@ -22,68 +22,228 @@ typedef struct ntpEvent_s {
 	byte weekDayFlags;
 	int id;
 	char *command;
+	// next time this event fires, 0 if it can't fire (or time is not known yet)
+	unsigned int nextRun;
+	// position in ntp_heap, -1 if not there
+	int heapIndex;
 	struct ntpEvent_s *next;
 } ntpEvent_t;
 
 ntpEvent_t *ntp_events = 0;
 
+// min-heap of events ordered by nextRun, so a second without events costs one comparison
+static ntpEvent_t **ntp_heap = 0;
+static int ntp_heapCount = 0;
+static int ntp_heapSize = 0;
+
+// what to do with events missed when the clock jumps forward
+enum {
+	NTP_CATCHUP_ALL,
+	NTP_CATCHUP_LATEST,
+	NTP_CATCHUP_SKIP,
+};
+static int ntp_catchUpPolicy = NTP_CATCHUP_ALL;
+// forward steps up to this many seconds are not jumps, all events in them run
+static int ntp_catchUpJumpSeconds = 100;
+// after a jump, 'all' only runs events missed in this many last seconds,
+// so a jump of months does not replay every day of them
+static int ntp_catchUpWindowSeconds = 86400;
+
+static void NTP_HeapSwap(int a, int b) {
+	ntpEvent_t *tmp;
+
+	tmp = ntp_heap[a];
+	ntp_heap[a] = ntp_heap[b];
+	ntp_heap[b] = tmp;
+	ntp_heap[a]->heapIndex = a;
+	ntp_heap[b]->heapIndex = b;
+}
+static void NTP_HeapUp(int i) {
+	int parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (ntp_heap[parent]->nextRun <= ntp_heap[i]->nextRun)
+			break;
+		NTP_HeapSwap(parent, i);
+		i = parent;
+	}
+}
+static void NTP_HeapDown(int i) {
+	int smallest, l, r;
+
+	while (1) {
+		smallest = i;
+		l = i * 2 + 1;
+		r = l + 1;
+		if (l < ntp_heapCount && ntp_heap[l]->nextRun < ntp_heap[smallest]->nextRun)
+			smallest = l;
+		if (r < ntp_heapCount && ntp_heap[r]->nextRun < ntp_heap[smallest]->nextRun)
+			smallest = r;
+		if (smallest == i)
+			break;
+		NTP_HeapSwap(smallest, i);
+		i = smallest;
+	}
+}
+static void NTP_HeapRemove(ntpEvent_t *e) {
+	int i;
 
-void NTP_RunEventsForSecond(unsigned int runTime) {
-	ntpEvent_t *e;
+	i = e->heapIndex;
+	if (i < 0)
+		return;
+	e->heapIndex = -1;
+	ntp_heapCount--;
+	if (i == ntp_heapCount)
+		return;
+	ntp_heap[i] = ntp_heap[ntp_heapCount];
+	ntp_heap[i]->heapIndex = i;
+	NTP_HeapUp(i);
+	NTP_HeapDown(ntp_heap[i]->heapIndex);
+}
+static void NTP_HeapPush(ntpEvent_t *e) {
+	ntpEvent_t **n;
+
+	if (e->nextRun == 0)
+		return;
+	if (ntp_heapCount == ntp_heapSize) {
+		n = (ntpEvent_t**)realloc(ntp_heap, sizeof(ntpEvent_t*) * (ntp_heapSize + 16));
+		if (n == 0) {
+			addLogAdv(LOG_ERROR, LOG_FEATURE_NTP, "NTP_HeapPush: failed to malloc");
+			return;
+		}
+		ntp_heap = n;
+		ntp_heapSize += 16;
+	}
+	e->heapIndex = ntp_heapCount;
+	ntp_heap[ntp_heapCount] = e;
+	ntp_heapCount++;
+	NTP_HeapUp(e->heapIndex);
+}
+static bool NTP_EventMatches(ntpEvent_t *e, unsigned int runTime) {
 	struct tm *ltm;
+	time_t t = runTime;
 
-	// NOTE: on windows, you need _USE_32BIT_TIME_T 
-	ltm = localtime((time_t*)&runTime);
-	
+	ltm = localtime(&t);
 	if (ltm == 0) {
-		return;
+		return false;
+	}
+	if (e->hour != ltm->tm_hour || e->minute != ltm->tm_min || e->second != ltm->tm_sec) {
+		return false;
 	}
+	return BIT_CHECK(e->weekDayFlags, ltm->tm_wday);
+}
+// Finds the first time after 'from' (dir 1) or the last time before 'from' (dir -1)
+// when the event fires, 0 if never. Local days are assumed to be 24h long,
+// the +/- hour candidates cover daylight saving changes.
+static unsigned int NTP_FindRun(ntpEvent_t *e, unsigned int from, int dir) {
+	static const int adjustments[3] = { -3600, 0, 3600 };
+	struct tm *ltm;
+	time_t t = from;
+	unsigned int midnight;
+	unsigned int when;
+	int day, i;
 
-	e = ntp_events;
+	ltm = localtime(&t);
+	if (ltm == 0) {
+		return 0;
+	}
+	midnight = from - (ltm->tm_hour * 3600 + ltm->tm_min * 60 + ltm->tm_sec);
+	// a week and a day is enough to see every weekday after the current one
+	for (day = 0; day <= 8; day++) {
+		for (i = 0; i < 3; i++) {
+			when = midnight + dir * day * 86400 + e->hour * 3600 + e->minute * 60 + e->second;
+			when += adjustments[dir > 0 ? i : 2 - i];
+			if (dir > 0 ? (when <= from) : (when >= from))
+				continue;
+			if (NTP_EventMatches(e, when))
+				return when;
+		}
+	}
+	return 0;
+}
+static void NTP_ScheduleEvent(ntpEvent_t *e, unsigned int after) {
+	NTP_HeapRemove(e);
+	e->nextRun = NTP_FindRun(e, after, 1);
+	NTP_HeapPush(e);
+}
+// clock was set or stepped, find next runs for all events from scratch
+static void NTP_ScheduleAllEvents(unsigned int after) {
+	ntpEvent_t *e;
 
-	while (e) {
-		if (e->command) {
-			// base check
-			if (e->hour == ltm->tm_hour && e->second == ltm->tm_sec && e->minute == ltm->tm_min) {
-				// weekday check
-				if (BIT_CHECK(e->weekDayFlags, ltm->tm_wday)) {
-					CMD_ExecuteCommand(e->command, 0);
-				}
-			}
+	ntp_heapCount = 0;
+	for (e = ntp_events; e; e = e->next) {
+		e->heapIndex = -1;
+		e->nextRun = 0;
+		if (after != 0) {
+			e->nextRun = NTP_FindRun(e, after, 1);
+			NTP_HeapPush(e);
 		}
-		e = e->next;
+	}
+}
+// runs events due before newTime (all of their occurences, in time order)
+static void NTP_RunDueEvents(unsigned int newTime) {
+	ntpEvent_t *e;
+
+	while (ntp_heapCount > 0 && ntp_heap[0]->nextRun < newTime) {
+		e = ntp_heap[0];
+		NTP_ScheduleEvent(e, e->nextRun);
+		// the command might remove events, including this one
+		CMD_ExecuteCommand(e->command, 0);
 	}
 }
 void NTP_RunEvents(unsigned int newTime, bool bTimeValid) {
+	ntpEvent_t *e;
 	unsigned int delta;
-	unsigned int i;
 
 	// new time invalid?
 	if (bTimeValid == false) {
 		ntp_eventsTime = 0;
+		NTP_ScheduleAllEvents(0);
 		return;
 	}
 	// old time invalid, but new one ok?
 	if (ntp_eventsTime == 0) {
 		ntp_eventsTime = newTime;
+		NTP_ScheduleAllEvents(newTime - 1);
 		return;
 	}
 	// time went backwards
 	if (newTime < ntp_eventsTime) {
 		ntp_eventsTime = newTime;
+		NTP_ScheduleAllEvents(newTime - 1);
 		return;
 	}
-	if (ntp_events) {
-		// NTP resynchronization could cause us to skip some seconds in some rare cases?
-		delta = newTime - ntp_eventsTime;
-		// a large shift in time is not expected, so limit to a constant number of seconds
-		if (delta > 100)
-			delta = 100;
-		for (i = 0; i < delta; i++) {
-			NTP_RunEventsForSecond(ntp_eventsTime + i);
+	delta = newTime - ntp_eventsTime;
+	ntp_eventsTime = newTime;
+	if (delta > (unsigned int)ntp_catchUpJumpSeconds && ntp_heapCount > 0 && ntp_heap[0]->nextRun < newTime) {
+		addLogAdv(LOG_INFO, LOG_FEATURE_NTP, "Clock jumped %u seconds, catch up policy %i", delta, ntp_catchUpPolicy);
+		if (ntp_catchUpPolicy == NTP_CATCHUP_SKIP) {
+			NTP_ScheduleAllEvents(newTime - 1);
+			return;
+		}
+		if (ntp_catchUpPolicy == NTP_CATCHUP_LATEST) {
+			// each missed event runs once, ordered by its latest missed time
+			for (e = ntp_events; e; e = e->next) {
+				if (e->heapIndex >= 0 && e->nextRun < newTime) {
+					NTP_HeapRemove(e);
+					e->nextRun = NTP_FindRun(e, newTime, -1);
+					NTP_HeapPush(e);
+				}
+			}
+			while (ntp_heapCount > 0 && ntp_heap[0]->nextRun < newTime) {
+				e = ntp_heap[0];
+				NTP_ScheduleEvent(e, newTime - 1);
+				CMD_ExecuteCommand(e->command, 0);
+			}
+			return;
+		}
+		if (delta > (unsigned int)ntp_catchUpWindowSeconds) {
+			// older runs are dropped, the ones in the window run in order below
+			NTP_ScheduleAllEvents(newTime - ntp_catchUpWindowSeconds - 1);
 		}
 	}
-	ntp_eventsTime = newTime;
+	NTP_RunDueEvents(newTime);
 }
 void NTP_AddClockEvent(int hour, int minute, int second, int weekDayFlags, int id, const char* command) {
 	ntpEvent_t* newEvent = (ntpEvent_t*)malloc(sizeof(ntpEvent_t));
@@ -99,8 +259,15 @@ void NTP_AddClockEvent(int hour, int minute, int second, int weekDayFlags, int i
 	newEvent->id = id;
 	newEvent->command = strdup(command);
 	newEvent->next = ntp_events;
+	newEvent->heapIndex = -1;
+	newEvent->nextRun = 0;
 
 	ntp_events = newEvent;
+
+	if (ntp_eventsTime != 0) {
+		// seconds from ntp_eventsTime on are not processed yet
+		NTP_ScheduleEvent(newEvent, ntp_eventsTime - 1);
+	}
 }
 int NTP_RemoveClockEvent(int id) {
 	int ret = 0;
@@ -115,6 +282,7 @@ int NTP_RemoveClockEvent(int id) {
 			else {
 				prev->next = curr->next;
 			}
+			NTP_HeapRemove(curr);
 			free(curr->command);
 			free(curr);
 			ret++;
@@ -220,6 +388,44 @@ commandResult_t CMD_NTP_RemoveClockEvent(const void* context, const char* cmd, c
 
 	return CMD_RES_OK;
 }
+// clockEventsCatchUp [all/latest/skip] [JumpSeconds] [WindowSeconds]
+// all - run every event missed in the last WindowSeconds, in order
+// latest - run each missed event once, eg. to restore light state after a long outage
+// skip - don't run missed events
+commandResult_t CMD_NTP_ClockEventsCatchUp(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	const char *s;
+
+	Tokenizer_TokenizeString(args, 0);
+	if (Tokenizer_CheckArgsCountAndPrintWarning(cmd, 1)) {
+		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
+	}
+	s = Tokenizer_GetArg(0);
+	if (!stricmp(s, "all")) {
+		ntp_catchUpPolicy = NTP_CATCHUP_ALL;
+	}
+	else if (!stricmp(s, "latest")) {
+		ntp_catchUpPolicy = NTP_CATCHUP_LATEST;
+	}
+	else if (!stricmp(s, "skip")) {
+		ntp_catchUpPolicy = NTP_CATCHUP_SKIP;
+	}
+	else {
+		return CMD_RES_BAD_ARGUMENT;
+	}
+	if (Tokenizer_GetArgsCount() > 1) {
+		ntp_catchUpJumpSeconds = Tokenizer_GetArgInteger(1);
+	}
+	if (Tokenizer_GetArgsCount() > 2) {
+		ntp_catchUpWindowSeconds = Tokenizer_GetArgInteger(2);
+		if (ntp_catchUpWindowSeconds < 0) {
+			return CMD_RES_BAD_ARGUMENT;
+		}
+	}
+	addLogAdv(LOG_INFO, LOG_FEATURE_NTP, "Clock events catch up: %s after jumps over %i seconds, window %i seconds",
+		s, ntp_catchUpJumpSeconds, ntp_catchUpWindowSeconds);
+
+	return CMD_RES_OK;
+}
 int NTP_PrintEventList() {
 	ntpEvent_t* e;
 	int t;
@@ -229,7 +435,8 @@ int NTP_PrintEventList() {
 
 	while (e) {
 		// Print the command
-		addLogAdv(LOG_INFO, LOG_FEATURE_CMD, "Ev %i - %i:%i:%i, days %i, cmd %s\n", (int)e->id, (int)e->hour, (int)e->minute, (int)e->second, (int)e->weekDayFlags, e->command);
+		addLogAdv(LOG_INFO, LOG_FEATURE_CMD, "Ev %i - %i:%i:%i, days %i, next in %i s, cmd %s\n", (int)e->id, (int)e->hour, (int)e->minute, (int)e->second, (int)e->weekDayFlags,
+			e->nextRun ? (int)(e->nextRun - ntp_eventsTime) : -1, e->command);
 
 		t++;
 		e = e->next;
@@ -261,6 +468,7 @@ int NTP_ClearEvents() {
 		free(p);
 	}
 	ntp_events = 0;
+	ntp_heapCount = 0;
 	addLogAdv(LOG_INFO, LOG_FEATURE_CMD, "Removed %i events", t);
 	return t;
 }
@@ -292,6 +500,11 @@ void NTP_Init_Events() {
 	//cmddetail:"fn":"CMD_NTP_ClearEvents","file":"driver/drv_ntp_events.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("clearClockEvents", CMD_NTP_ClearEvents, NULL);
+	//cmddetail:{"name":"clockEventsCatchUp","args":"[all/latest/skip] [JumpSeconds] [WindowSeconds]",
+	//cmddetail:"descr":"Sets what happens to clock events missed when the clock jumps forward by more than JumpSeconds (default 100): 'all' (default) runs every event missed in the last WindowSeconds (default 86400) in order, 'latest' runs each missed event once, 'skip' drops them",
+	//cmddetail:"fn":"CMD_NTP_ClockEventsCatchUp","file":"driver/drv_ntp_events.c","requires":"",
+	//cmddetail:"examples":"clockEventsCatchUp latest 60"}
+	CMD_RegisterCommand("clockEventsCatchUp", CMD_NTP_ClockEventsCatchUp, NULL);
 	//CMD_RegisterCommand("addPeriodValue", CMD_NTP_AddPeriodValue, NULL);
 }
 
@@ -20,6 +20,23 @@ enum {
 	OBK_NUM_EMUNS_MAX
 };
 
+// capability flags of entries in driver table, see DRV_HasRunningDriverWithFlag
+#define DRV_FLAG_MEASURES_POWER		1
+#define DRV_FLAG_MEASURES_BATTERY	2
+#define DRV_FLAG_SENSOR				4
+#define DRV_FLAG_DISPLAY			8
+#define DRV_FLAG_NEEDS_UART			16
+#define DRV_FLAG_LED_CHIP			32
+
+// driver hooks with their own list of running drivers and time statistics
+enum {
+	DRV_HOOK_QUICKTICK,
+	DRV_HOOK_EVERYSECOND,
+	DRV_HOOK_CHANNELCHANGED,
+	DRV_HOOK_HTTPINDEX,
+	DRV_HOOK_COUNT
+};
+
 #define OBK_NUM_COUNTERS            (OBK_NUM_EMUNS_MAX-OBK_NUM_MEASUREMENTS)
 #define OBK_NUM_SENSOR_COUNT         OBK_NUM_EMUNS_MAX
 
@@ -42,6 +59,18 @@ void DRV_StopDriver(const char* name);
 // right now only used by simulator
 void DRV_ShutdownAllDrivers();
 bool DRV_IsRunning(const char* name);
+// index of driver in driver table, -1 if not known in this build.
+// Can be cached by caller and checked later with DRV_IsRunningID
+int DRV_FindDriver(const char* name);
+bool DRV_IsRunningID(int id);
+// initial value of an id kept for DRV_IsRunningCached
+#define DRV_ID_NOT_FOUND_YET		-2
+// DRV_IsRunning that looks the name up only once and keeps the id in *id
+bool DRV_IsRunningCached(int* id, const char* name);
+bool DRV_HasRunningDriverWithFlag(int flag);
+int DRV_GetHookDriversCount(int hook);
+// calls of the hook counted for DriverStats since the last reset
+unsigned int DRV_GetHookCalls(int id, int hook);
 void DRV_OnChannelChanged(int channel, int iVal);
 void SM2135_Write(float* rgbcw);
 void BP5758D_Write(float* rgbcw);
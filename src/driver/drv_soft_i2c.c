@@ -12,7 +12,7 @@
 
 void usleep(int r) //delay function do 10*r nops, because rtos_delay_milliseconds is too much
 {
-#ifdef WIN32
+#if WINDOWS
 	// not possible on Windows port
 #else
 	for (volatile int i = 0; i < r; i++)
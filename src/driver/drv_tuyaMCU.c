@@ -25,6 +25,7 @@ https://developer.tuya.com/en/docs/iot/tuyacloudlowpoweruniversalserialaccesspro
 #include "drv_public.h"
 #include <time.h>
 #include "drv_ntp.h"
+#include "../quicktick.h"
 
 
 #define TUYA_CMD_HEARTBEAT     0x00
@@ -47,6 +48,9 @@ https://developer.tuya.com/en/docs/iot/tuyacloudlowpoweruniversalserialaccesspro
 #define TUYA_NETWORK_STATUS_CONNECTED_TO_CLOUD  0x04
 #define TUYA_NETWORK_STATUS_LOW_POWER_MODE      0x05
 
+// at 115200 a busy MCU can send several frames between two quick ticks
+#define TUYAMCU_UART_RECEIVE_BUFFER_SIZE 1024
+
 void TuyaMCU_RunFrame();
 
 static byte g_tuyaMCUConfirmationsToSend_0x08 = 0;
@@ -151,6 +155,11 @@ typedef struct tuyaMCUMapping_s {
 } tuyaMCUMapping_t;
 
 tuyaMCUMapping_t* g_tuyaMappings = 0;
+// Mappings are looked up for every received dpId and every channel change,
+// so both directions are indexed. dpIds are a single byte.
+static tuyaMCUMapping_t* g_tuyaMappingsByID[256];
+// first mapping in g_tuyaMappings for a channel, like the old linear search
+static tuyaMCUMapping_t* g_tuyaMappingsByChannel[CHANNEL_MAX];
 
 /**
  * Dimmer range
@@ -166,6 +175,10 @@ static int g_dimmerRangeMax = 100;
 // serial baud rate used to communicate with the TuyaMCU
 // common baud rates are 9600 bit/s and 115200 bit/s
 static int g_baudRate = 9600;
+// baud rate and g_uart_init_counter from our last UART_InitUART,
+// the counter changes if something else has reconfigured the UART
+static int g_tuyaUARTBaudRate = 0;
+static int g_tuyaUARTInitCounter = -1;
 
 // global mcu time
 static int g_tuyaNextRequestDelay;
@@ -202,27 +215,36 @@ static byte g_hello[] = { 0x55, 0xAA, 0x00, 0x01, 0x00, 0x00, 0x00 };
 //static byte g_request_state[] = { 0x55, 0xAA, 0x00, 0x02, 0x00, 0x01, 0x04, 0x06 };
 
 tuyaMCUMapping_t* TuyaMCU_FindDefForID(int fnId) {
+	if (fnId < 0 || fnId >= 256)
+		return 0;
+	return g_tuyaMappingsByID[fnId];
+}
+
+tuyaMCUMapping_t* TuyaMCU_FindDefForChannel(int channel) {
 	tuyaMCUMapping_t* cur;
 
+	if (channel >= 0 && channel < CHANNEL_MAX)
+		return g_tuyaMappingsByChannel[channel];
+	// channel 255 and other out of range links are rare, walk the list
 	cur = g_tuyaMappings;
 	while (cur) {
-		if (cur->fnId == fnId)
+		if (cur->channel == channel)
 			return cur;
 		cur = cur->next;
 	}
 	return 0;
 }
 
-tuyaMCUMapping_t* TuyaMCU_FindDefForChannel(int channel) {
+static void TuyaMCU_RebuildChannelIndex() {
 	tuyaMCUMapping_t* cur;
 
+	memset(g_tuyaMappingsByChannel, 0, sizeof(g_tuyaMappingsByChannel));
 	cur = g_tuyaMappings;
 	while (cur) {
-		if (cur->channel == channel)
-			return cur;
+		if (cur->channel < CHANNEL_MAX && g_tuyaMappingsByChannel[cur->channel] == 0)
+			g_tuyaMappingsByChannel[cur->channel] = cur;
 		cur = cur->next;
 	}
-	return 0;
 }
 
 void TuyaMCU_MapIDToChannel(int fnId, int dpType, int channel, int bDPCache) {
@@ -238,96 +260,151 @@ void TuyaMCU_MapIDToChannel(int fnId, int dpType, int channel, int bDPCache) {
 		cur->prevValue = 0;
 		cur->next = g_tuyaMappings;
 		g_tuyaMappings = cur;
+		g_tuyaMappingsByID[cur->fnId] = cur;
 	}
 
 	cur->channel = channel;
+	// links are only made by commands, so it's fine to redo the whole index
+	TuyaMCU_RebuildChannelIndex();
 }
 
 
 // header version command lenght data checksum
 // 55AA     00      00      0000   xx   00
+// lenght is big endian, checksum is the sum of all previous bytes
 
 #define MIN_TUYAMCU_PACKET_SIZE (2+1+1+2+1)
-int UART_TryToGetNextTuyaPacket(byte* out, int maxSize) {
-	int cs;
-	int len, i;
-	int c_garbage_consumed = 0;
-	byte a, b, version, command, lena, lenb;
-	char printfSkipDebug[256];
-	char buffer2[8];
 
-	printfSkipDebug[0] = 0;
+static tuyaMCUParserStats_t g_tuyaParserStats;
 
-	cs = UART_GetDataSize();
+const tuyaMCUParserStats_t* TuyaMCU_GetParserStats() {
+	return &g_tuyaParserStats;
+}
 
-	if (cs < MIN_TUYAMCU_PACKET_SIZE) {
-		return 0;
-	}
-	// skip garbage data (should not happen)
-	while (cs > 0) {
-		a = UART_GetNextByte(0);
-		b = UART_GetNextByte(1);
-		if (a != 0x55 || b != 0xAA) {
-			UART_ConsumeBytes(1);
-			if (c_garbage_consumed + 2 < sizeof(printfSkipDebug)) {
-				snprintf(buffer2, sizeof(buffer2), "%02X ", a);
-				strcat_safe(printfSkipDebug, buffer2, sizeof(printfSkipDebug));
-			}
-			c_garbage_consumed++;
-			cs--;
+// returns the number of bytes before the first possible 55 AA header
+static int TuyaMCU_FindHeader(int cs) {
+	int i;
+
+	for (i = 0; i < cs; i++) {
+		if (UART_GetNextByte(i) != 0x55) {
+			continue;
 		}
-		else {
+		// a trailing 0x55 may be the start of a header that is not complete yet
+		if (i + 1 >= cs || UART_GetNextByte(i + 1) == 0xAA) {
 			break;
 		}
 	}
-	if (c_garbage_consumed > 0) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "Consumed %i unwanted non-header byte in Tuya MCU buffer\n", c_garbage_consumed);
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "Skipped data (part) %s\n", printfSkipDebug);
-	}
-	if (cs < MIN_TUYAMCU_PACKET_SIZE) {
-		return 0;
+	return i;
+}
+
+static void TuyaMCU_LogSkippedBytes(int count) {
+	char printfSkipDebug[64];
+	int i;
+
+	if (LOG_IsEnabled(LOG_INFO, LOG_FEATURE_TUYAMCU) == false) {
+		return;
 	}
-	a = UART_GetNextByte(0);
-	b = UART_GetNextByte(1);
-	if (a != 0x55 || b != 0xAA) {
-		return 0;
+	for (i = 0; i < count && i * 3 + 4 < sizeof(printfSkipDebug); i++) {
+		snprintf(printfSkipDebug + i * 3, 4, "%02X ", UART_GetNextByte(i));
 	}
-	version = UART_GetNextByte(2);
-	command = UART_GetNextByte(3);
-	lena = UART_GetNextByte(4); // hi
-	lenb = UART_GetNextByte(5); // lo
-	len = lenb | lena >> 8;
-	// now check if we have received whole packet
-	len += 2 + 1 + 1 + 2 + 1; // header 2 bytes, version, command, lenght, chekcusm
-	if (cs >= len) {
-		int ret;
-		// can packet fit into the buffer?
-		if (len <= maxSize) {
-			for (i = 0; i < len; i++) {
-				out[i] = UART_GetNextByte(i);
+	printfSkipDebug[i * 3] = 0;
+	ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "Consumed %i unwanted non-header byte in Tuya MCU buffer\n", count);
+	ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "Skipped data (part) %s\n", printfSkipDebug);
+}
+
+// Copies the next complete frame into out and returns its length, or 0 if
+// there is none yet. Data before a header is dropped in one go. A frame
+// that is too large or has a bad checksum only loses its first byte,
+// because a real frame may start inside of it.
+int UART_TryToGetNextTuyaPacket(byte* out, int maxSize) {
+	int cs;
+	int len, i;
+	int skip, span;
+	const byte* data;
+	byte checkSum;
+
+	while (1) {
+		cs = UART_GetDataSize();
+		if (cs < MIN_TUYAMCU_PACKET_SIZE) {
+			return 0;
+		}
+		skip = TuyaMCU_FindHeader(cs);
+		if (skip > 0) {
+			TuyaMCU_LogSkippedBytes(skip);
+			UART_ConsumeBytes(skip);
+			g_tuyaParserStats.skippedBytes += skip;
+			g_tuyaParserStats.resyncs++;
+			cs -= skip;
+			if (cs < MIN_TUYAMCU_PACKET_SIZE) {
+				return 0;
 			}
-			ret = len;
 		}
-		else {
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU packet too large, %i > %i\n", len, maxSize);
-			ret = 0;
+		len = (UART_GetNextByte(4) << 8) | UART_GetNextByte(5);
+		len += MIN_TUYAMCU_PACKET_SIZE;
+		// a frame that does not fit in the ring buffer would never be complete
+		if (len > maxSize || len > UART_GetReceiveRingBufferSize()) {
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU packet too large, %i > %i\n", len,
+				maxSize < UART_GetReceiveRingBufferSize() ? maxSize : UART_GetReceiveRingBufferSize());
+			g_tuyaParserStats.oversizeFrames++;
+			UART_ConsumeBytes(1);
+			continue;
+		}
+		// now check if we have received whole packet
+		if (cs < len) {
+			return 0;
+		}
+		// copy at most two contiguous spans (before and after ring wrap)
+		for (i = 0; i < len; i += span) {
+			span = UART_PeekSpan(i, &data);
+			if (span > len - i) {
+				span = len - i;
+			}
+			memcpy(out + i, data, span);
+		}
+		checkSum = 0;
+		for (i = 0; i < len - 1; i++) {
+			checkSum += out[i];
+		}
+		if (checkSum != out[len - 1]) {
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU packet bad checksum, expected %i and got %i\n", (int)checkSum, (int)out[len - 1]);
+			g_tuyaParserStats.badChecksums++;
+			UART_ConsumeBytes(1);
+			continue;
 		}
 		// consume whole packet (but don't touch next one, if any)
 		UART_ConsumeBytes(len);
-		return ret;
+		g_tuyaParserStats.frames++;
+		return len;
 	}
-	return 0;
 }
 
+commandResult_t TuyaMCU_ParserStats(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	if (args && !stricmp(args, "reset")) {
+		memset(&g_tuyaParserStats, 0, sizeof(g_tuyaParserStats));
+	}
+	ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU frames %i, bad checksums %i, oversize %i, resyncs %i, skipped bytes %i\n",
+		g_tuyaParserStats.frames, g_tuyaParserStats.badChecksums, g_tuyaParserStats.oversizeFrames,
+		g_tuyaParserStats.resyncs, g_tuyaParserStats.skippedBytes);
+	return CMD_RES_OK;
+}
 
 
 
+
+static void TuyaMCU_InitUARTIfNeeded() {
+	if (g_tuyaUARTBaudRate == g_baudRate && g_tuyaUARTInitCounter == g_uart_init_counter) {
+		return;
+	}
+	g_tuyaUARTInitCounter = UART_InitUART(g_baudRate);
+	g_tuyaUARTBaudRate = g_baudRate;
+}
+
 // append header, len, everything, checksum
-void TuyaMCU_SendCommandWithData(byte cmdType, byte* data, int payload_len) {
+static void TuyaMCU_WriteFrame(byte cmdType, const byte* data, int payload_len) {
 	int i;
 
 	byte check_sum = (0xFF + cmdType + (payload_len >> 8) + (payload_len & 0xFF));
-	UART_InitUART(g_baudRate);
+	TuyaMCU_InitUARTIfNeeded();
 	UART_SendByte(0x55);
 	UART_SendByte(0xAA);
 	UART_SendByte(0x00);         // version 00
@@ -342,6 +419,273 @@ void TuyaMCU_SendCommandWithData(byte cmdType, byte* data, int payload_len) {
 	UART_SendByte(check_sum);
 }
 
+// DP writes (0x06) go through a queue, so that a fast moving dimmer slider
+// does not flood the MCU. Writes are sent at least g_tuyaTxIntervalMs apart.
+// A write of a dpId that is still waiting in the queue only replaces its
+// value, so the MCU gets the latest one, and writes of different dpIds
+// keep their order. If g_tuyaTxAckTimeoutMs is set, the next write also
+// waits until the MCU reports the written dpId back (0x07), and the write
+// is repeated if the report does not come in time.
+// Other commands are sent right away.
+#define TUYAMCU_TX_QUEUE_LEN		8
+#define TUYAMCU_TX_MAX_PAYLOAD		64
+
+typedef struct tuyaMCUTxFrame_s {
+	// dpId of a single DP write, -1 if it can't be merged with another one
+	short dpId;
+	short len;
+	// set once sent, while waiting for the report
+	byte bSent;
+	byte retries;
+	unsigned int queuedAt;
+	unsigned int sentAt;
+	byte data[TUYAMCU_TX_MAX_PAYLOAD];
+} tuyaMCUTxFrame_t;
+
+static tuyaMCUTxFrame_t g_tuyaTxQueue[TUYAMCU_TX_QUEUE_LEN];
+static int g_tuyaTxFirst = 0;
+static int g_tuyaTxCount = 0;
+// advanced by TuyaMCU_RunQuickTick
+static unsigned int g_tuyaTxTimeMs = 0;
+static unsigned int g_tuyaTxLastSendMs = 0;
+static bool g_tuyaTxSentAny = false;
+static int g_tuyaTxIntervalMs = 50;
+// 0 disables waiting for the reports
+static int g_tuyaTxAckTimeoutMs = 0;
+static int g_tuyaTxMaxRetries = 2;
+static tuyaMCUTxStats_t g_tuyaTxStats;
+// DP writes are queued from command, MQTT and HTTP threads,
+// while the quick tick sends them and the parser pops them
+static SemaphoreHandle_t g_tuyaTxMutex = 0;
+
+const tuyaMCUTxStats_t* TuyaMCU_GetTxStats() {
+	return &g_tuyaTxStats;
+}
+
+static bool TuyaMCU_TxMutex_Take(int del) {
+	int taken;
+
+	if (g_tuyaTxMutex == 0)
+	{
+		g_tuyaTxMutex = xSemaphoreCreateMutex();
+	}
+	taken = xSemaphoreTake(g_tuyaTxMutex, del);
+	if (taken == pdTRUE) {
+		return true;
+	}
+	return false;
+}
+
+static void TuyaMCU_TxMutex_Free() {
+	xSemaphoreGive(g_tuyaTxMutex);
+}
+
+static tuyaMCUTxFrame_t* TuyaMCU_TxAt(int index) {
+	return &g_tuyaTxQueue[(g_tuyaTxFirst + index) % TUYAMCU_TX_QUEUE_LEN];
+}
+
+static void TuyaMCU_TxPop() {
+	g_tuyaTxFirst = (g_tuyaTxFirst + 1) % TUYAMCU_TX_QUEUE_LEN;
+	g_tuyaTxCount--;
+	g_tuyaTxStats.depth = g_tuyaTxCount;
+}
+
+static bool TuyaMCU_TxCanSend() {
+	if (g_tuyaTxSentAny == false) {
+		return true;
+	}
+	return (int)(g_tuyaTxTimeMs - g_tuyaTxLastSendMs) >= g_tuyaTxIntervalMs;
+}
+
+static void TuyaMCU_TxSend(tuyaMCUTxFrame_t* f) {
+	int latency;
+
+	if (f->bSent == false) {
+		latency = g_tuyaTxTimeMs - f->queuedAt;
+		g_tuyaTxStats.totalLatencyMs += latency;
+		if (latency > g_tuyaTxStats.maxLatencyMs) {
+			g_tuyaTxStats.maxLatencyMs = latency;
+		}
+	}
+	TuyaMCU_WriteFrame(TUYA_CMD_SET_DP, f->data, f->len);
+	g_tuyaTxStats.sent++;
+	g_tuyaTxLastSendMs = g_tuyaTxTimeMs;
+	g_tuyaTxSentAny = true;
+	f->bSent = true;
+	f->sentAt = g_tuyaTxTimeMs;
+	// without reports to wait for, the write is done
+	if (g_tuyaTxAckTimeoutMs <= 0 || f->dpId < 0) {
+		TuyaMCU_TxPop();
+	}
+}
+
+static void TuyaMCU_TxRun() {
+	tuyaMCUTxFrame_t* f;
+
+	while (g_tuyaTxCount > 0) {
+		f = TuyaMCU_TxAt(0);
+		if (f->bSent) {
+			if ((int)(g_tuyaTxTimeMs - f->sentAt) < g_tuyaTxAckTimeoutMs) {
+				return;
+			}
+			if (f->retries >= g_tuyaTxMaxRetries) {
+				ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU no report for dpId %i, giving up\n", f->dpId);
+				g_tuyaTxStats.ackTimeouts++;
+				TuyaMCU_TxPop();
+				continue;
+			}
+			f->retries++;
+			g_tuyaTxStats.retries++;
+		}
+		if (TuyaMCU_TxCanSend() == false) {
+			return;
+		}
+		TuyaMCU_TxSend(f);
+	}
+}
+
+// called for every dpId in a state report from the MCU
+static void TuyaMCU_TxOnReport(int dpId) {
+	tuyaMCUTxFrame_t* f;
+
+	if (TuyaMCU_TxMutex_Take(100) == false) {
+		return;
+	}
+	if (g_tuyaTxCount > 0) {
+		f = TuyaMCU_TxAt(0);
+		if (f->bSent && f->dpId == dpId) {
+			TuyaMCU_TxPop();
+			TuyaMCU_TxRun();
+		}
+	}
+	TuyaMCU_TxMutex_Free();
+}
+
+// must be called with g_tuyaTxMutex taken
+static void TuyaMCU_QueueDPWrite(const byte* data, int payload_len) {
+	tuyaMCUTxFrame_t* f;
+	int dpId;
+	int i;
+
+	// a single DP has a 4 byte header with its own length
+	dpId = -1;
+	if (payload_len >= 4 && payload_len == 4 + ((data[2] << 8) | data[3])) {
+		dpId = data[0];
+	}
+	if (dpId >= 0) {
+		for (i = 0; i < g_tuyaTxCount; i++) {
+			f = TuyaMCU_TxAt(i);
+			if (f->dpId == dpId && f->bSent == false) {
+				memcpy(f->data, data, payload_len);
+				f->len = payload_len;
+				g_tuyaTxStats.coalesced++;
+				return;
+			}
+		}
+	}
+	if (g_tuyaTxCount >= TUYAMCU_TX_QUEUE_LEN) {
+		// never lose a write, send the oldest one now
+		g_tuyaTxStats.overflows++;
+		f = TuyaMCU_TxAt(0);
+		if (f->bSent) {
+			TuyaMCU_TxPop();
+		}
+		else {
+			TuyaMCU_TxSend(f);
+			if (g_tuyaTxCount >= TUYAMCU_TX_QUEUE_LEN) {
+				TuyaMCU_TxPop();
+			}
+		}
+	}
+	f = TuyaMCU_TxAt(g_tuyaTxCount);
+	f->dpId = dpId;
+	f->len = payload_len;
+	f->bSent = false;
+	f->retries = 0;
+	f->queuedAt = g_tuyaTxTimeMs;
+	memcpy(f->data, data, payload_len);
+	g_tuyaTxCount++;
+	g_tuyaTxStats.depth = g_tuyaTxCount;
+	if (g_tuyaTxCount > g_tuyaTxStats.maxDepth) {
+		g_tuyaTxStats.maxDepth = g_tuyaTxCount;
+	}
+	TuyaMCU_TxRun();
+}
+
+void TuyaMCU_SendCommandWithData(byte cmdType, byte* data, int payload_len) {
+	// if the queue can't be locked, the write is sent right away instead
+	if (cmdType == TUYA_CMD_SET_DP && payload_len <= TUYAMCU_TX_MAX_PAYLOAD
+		&& TuyaMCU_TxMutex_Take(100)) {
+		TuyaMCU_QueueDPWrite(data, payload_len);
+		TuyaMCU_TxMutex_Free();
+		return;
+	}
+	TuyaMCU_WriteFrame(cmdType, data, payload_len);
+}
+
+void TuyaMCU_RunReceive();
+
+void TuyaMCU_RunQuickTick() {
+	bool bWaitingForReport;
+
+	g_tuyaTxTimeMs += g_deltaTimeMS;
+	// don't block the quick tick, try again on the next one
+	if (TuyaMCU_TxMutex_Take(0) == false) {
+		return;
+	}
+	bWaitingForReport = g_tuyaTxCount > 0 && TuyaMCU_TxAt(0)->bSent;
+	TuyaMCU_TxMutex_Free();
+	// received data is normally parsed once a second, but a write
+	// waiting for its report should not wait that long.
+	// Parsing takes the queue mutex on its own, and may queue writes.
+	if (bWaitingForReport) {
+		TuyaMCU_RunReceive();
+	}
+	if (TuyaMCU_TxMutex_Take(0) == false) {
+		return;
+	}
+	TuyaMCU_TxRun();
+	TuyaMCU_TxMutex_Free();
+}
+
+commandResult_t TuyaMCU_SetTxTiming(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	int interval, ackTimeout, maxRetries;
+
+	Tokenizer_TokenizeString(args, 0);
+	// following check must be done after 'Tokenizer_TokenizeString',
+	// so we know arguments count in Tokenizer. 'cmd' argument is
+	// only for warning display
+	if (Tokenizer_CheckArgsCountAndPrintWarning(cmd, 1)) {
+		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
+	}
+	interval = Tokenizer_GetArgInteger(0);
+	ackTimeout = Tokenizer_GetArgIntegerDefault(1, 0);
+	maxRetries = Tokenizer_GetArgIntegerDefault(2, 2);
+	if (interval < 0 || ackTimeout < 0 || maxRetries < 0) {
+		return CMD_RES_BAD_ARGUMENT;
+	}
+	g_tuyaTxIntervalMs = interval;
+	g_tuyaTxAckTimeoutMs = ackTimeout;
+	g_tuyaTxMaxRetries = maxRetries;
+	return CMD_RES_OK;
+}
+
+commandResult_t TuyaMCU_TxStats(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	if (args && !stricmp(args, "reset") && TuyaMCU_TxMutex_Take(100)) {
+		memset(&g_tuyaTxStats, 0, sizeof(g_tuyaTxStats));
+		g_tuyaTxStats.depth = g_tuyaTxCount;
+		TuyaMCU_TxMutex_Free();
+	}
+	ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU DP writes sent %i, coalesced %i, overflows %i, retries %i, ack timeouts %i\n",
+		g_tuyaTxStats.sent, g_tuyaTxStats.coalesced, g_tuyaTxStats.overflows,
+		g_tuyaTxStats.retries, g_tuyaTxStats.ackTimeouts);
+	ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU queue depth %i, max %i, latency avg %i ms, max %i ms\n",
+		g_tuyaTxStats.depth, g_tuyaTxStats.maxDepth,
+		g_tuyaTxStats.sent > g_tuyaTxStats.retries ? g_tuyaTxStats.totalLatencyMs / (g_tuyaTxStats.sent - g_tuyaTxStats.retries) : 0,
+		g_tuyaTxStats.maxLatencyMs);
+	return CMD_RES_OK;
+}
+
 void TuyaMCU_SendState(uint8_t id, uint8_t type, uint8_t* value)
 {
 	uint16_t payload_len = 4;
@@ -544,11 +888,11 @@ void TuyaMCU_Send_SetTime(struct tm* pTime) {
 struct tm* TuyaMCU_Get_NTP_Time() {
 	struct tm* ptm;
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "MCU time to set: %i\n", g_ntpTime);
+	ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "MCU time to set: %i\n", g_ntpTime);
 	ptm = gmtime((time_t*)&g_ntpTime);
 	if (ptm != 0) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "ptime ->gmtime => tm_hour: %i\n", ptm->tm_hour);
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "ptime ->gmtime => tm_min: %i\n", ptm->tm_min);
+		ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "ptime ->gmtime => tm_hour: %i\n", ptm->tm_hour);
+		ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "ptime ->gmtime => tm_min: %i\n", ptm->tm_min);
 	}
 	return ptm;
 }
@@ -633,7 +977,7 @@ commandResult_t TuyaMCU_LinkTuyaMCUOutputToChannel(const void* context, const ch
 			dpType = atoi(dpTypeString);
 		}
 		else {
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_LinkTuyaMCUOutputToChannel: %s is not a valid var type\n", dpTypeString);
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_LinkTuyaMCUOutputToChannel: %s is not a valid var type\n", dpTypeString);
 			return CMD_RES_BAD_ARGUMENT;
 		}
 	}
@@ -683,7 +1027,7 @@ void TuyaMCU_Send(byte* data, int size) {
 	}
 	UART_SendByte(check_sum);
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "\nWe sent %i bytes to Tuya MCU\n", size + 1);
+	ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "\nWe sent %i bytes to Tuya MCU\n", size + 1);
 }
 
 commandResult_t TuyaMCU_SetDimmerRange(const void* context, const char* cmd, const char* args, int cmdFlags) {
@@ -765,7 +1109,7 @@ void TuyaMCU_SendNetworkStatus()
 	else if (Main_HasWiFiConnected() != 0) {
 		state = Main_HasMQTTConnected() != 0 ? TUYA_NETWORK_STATUS_CONNECTED_TO_CLOUD : TUYA_NETWORK_STATUS_CONNECTED_TO_ROUTER;
 	}
-	addLogAdv(LOG_DEBUG, LOG_FEATURE_TUYAMCU, "TuyaMCU_SendNetworkStatus: sending status 0x%X to MCU \n", state);
+	ADDLOG_DEBUG(LOG_FEATURE_TUYAMCU, "TuyaMCU_SendNetworkStatus: sending status 0x%X to MCU \n", state);
 	TuyaMCU_SendCommandWithData(0x2B, &state, 1);
 }
 void TuyaMCU_ForcePublishChannelValues() {
@@ -796,7 +1140,7 @@ void TuyaMCU_ApplyMapping(int fnID, int value) {
 	mapping = TuyaMCU_FindDefForID(fnID);
 
 	if (mapping == 0) {
-		addLogAdv(LOG_DEBUG, LOG_FEATURE_TUYAMCU, "TuyaMCU_ApplyMapping: id %i with value %i is not mapped\n", fnID, value);
+		ADDLOG_DEBUG(LOG_FEATURE_TUYAMCU, "TuyaMCU_ApplyMapping: id %i with value %i is not mapped\n", fnID, value);
 		return;
 	}
 
@@ -820,7 +1164,7 @@ void TuyaMCU_ApplyMapping(int fnID, int value) {
 	}
 
 	if (value != mappedValue) {
-		addLogAdv(LOG_DEBUG, LOG_FEATURE_TUYAMCU, "TuyaMCU_ApplyMapping: mapped value %d (TuyaMCU range) to %d (OpenBK7321T_App range)\n", value, mappedValue);
+		ADDLOG_DEBUG(LOG_FEATURE_TUYAMCU, "TuyaMCU_ApplyMapping: mapped value %d (TuyaMCU range) to %d (OpenBK7321T_App range)\n", value, mappedValue);
 	}
 
 	mapping->prevValue = mappedValue;
@@ -881,7 +1225,7 @@ void TuyaMCU_OnChannelChanged(int channel, int iVal) {
 	}
 
 	if (iVal != mappediVal) {
-		addLogAdv(LOG_DEBUG, LOG_FEATURE_TUYAMCU, "TuyaMCU_OnChannelChanged: mapped value %d (OpenBK7321T_App range) to %d (TuyaMCU range)\n", iVal, mappediVal);
+		ADDLOG_DEBUG(LOG_FEATURE_TUYAMCU, "TuyaMCU_OnChannelChanged: mapped value %d (OpenBK7321T_App range) to %d (TuyaMCU range)\n", iVal, mappediVal);
 	}
 
 	// send value to TuyaMCU
@@ -900,7 +1244,7 @@ void TuyaMCU_OnChannelChanged(int channel, int iVal) {
 		break;
 
 	default:
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_OnChannelChanged: channel %d: unsupported data point type %d-%s\n", channel, mapping->dpType, TuyaMCU_GetDataTypeString(mapping->dpType));
+		ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_OnChannelChanged: channel %d: unsupported data point type %d-%s\n", channel, mapping->dpType, TuyaMCU_GetDataTypeString(mapping->dpType));
 		break;
 	}
 }
@@ -915,7 +1259,7 @@ void TuyaMCU_ParseQueryProductInformation(const byte* data, int len) {
 	memcpy(name, data, useLen);
 	name[useLen] = 0;
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseQueryProductInformation: received %s\n", name);
+	ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseQueryProductInformation: received %s\n", name);
 
 	if (g_sensorMode) {
 		if (g_tuyaBatteryPoweredState == TM0_STATE_AWAITING_INFO) {
@@ -965,11 +1309,11 @@ void TuyaMCU_ParseWeatherData(const byte* data, int len) {
 			else {
 				iValue = 0;
 			}
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseWeatherData: key %s, val integer %i\n", buffer, iValue);
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseWeatherData: key %s, val integer %i\n", buffer, iValue);
 		}
 		else {
 			// string
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseWeatherData: key %s, string not yet handled\n", buffer);
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseWeatherData: key %s, string not yet handled\n", buffer);
 		}
 		ofs += stringLen;
 	}
@@ -1015,19 +1359,19 @@ void TuyaMCU_V0_ParseRealTimeWithRecordStorage(const byte* data, int len, bool b
 		sectorLen = data[ofs + 2] << 8 | data[ofs + 3];
 		fnId = data[ofs];
 		dataType = data[ofs + 1];
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_V0_ParseRealTimeWithRecordStorage: processing dpId %i, dataType %i-%s and %i data bytes\n",
+		ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_V0_ParseRealTimeWithRecordStorage: processing dpId %i, dataType %i-%s and %i data bytes\n",
 			fnId, dataType, TuyaMCU_GetDataTypeString(dataType), sectorLen);
 
 
 		if (sectorLen == 1) {
 			int iVal = (int)data[ofs + 4];
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_V0_ParseRealTimeWithRecordStorage: raw data 1 byte: %c\n", iVal);
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_V0_ParseRealTimeWithRecordStorage: raw data 1 byte: %c\n", iVal);
 			// apply to channels
 			TuyaMCU_ApplyMapping(fnId, iVal);
 		}
 		if (sectorLen == 4) {
 			int iVal = data[ofs + 4] << 24 | data[ofs + 5] << 16 | data[ofs + 6] << 8 | data[ofs + 7];
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_V0_ParseRealTimeWithRecordStorage: raw data 4 int: %i\n", iVal);
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_V0_ParseRealTimeWithRecordStorage: raw data 4 int: %i\n", iVal);
 			// apply to channels
 			TuyaMCU_ApplyMapping(fnId, iVal);
 		}
@@ -1062,19 +1406,20 @@ void TuyaMCU_ParseStateMessage(const byte* data, int len) {
 		sectorLen = data[ofs + 2] << 8 | data[ofs + 3];
 		fnId = data[ofs];
 		dataType = data[ofs + 1];
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseStateMessage: processing dpId %i, dataType %i-%s and %i data bytes\n",
+		ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseStateMessage: processing dpId %i, dataType %i-%s and %i data bytes\n",
 			fnId, dataType, TuyaMCU_GetDataTypeString(dataType), sectorLen);
+		TuyaMCU_TxOnReport(fnId);
 
 
 		if (sectorLen == 1) {
 			iVal = (int)data[ofs + 4];
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseStateMessage: raw data 1 byte: %c\n", iVal);
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseStateMessage: raw data 1 byte: %c\n", iVal);
 			// apply to channels
 			TuyaMCU_ApplyMapping(fnId, iVal);
 		}
 		else if (sectorLen == 4) {
 			iVal = data[ofs + 4] << 24 | data[ofs + 5] << 16 | data[ofs + 6] << 8 | data[ofs + 7];
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseStateMessage: raw data 4 int: %i\n", iVal);
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ParseStateMessage: raw data 4 int: %i\n", iVal);
 			// apply to channels
 			TuyaMCU_ApplyMapping(fnId, iVal);
 		}
@@ -1095,7 +1440,7 @@ void TuyaMCU_ParseStateMessage(const byte* data, int len) {
 						day = data[ofs + 4 + 1];
 						// consumption
 						iVal = data[ofs + 6 + 4] << 8 | data[ofs + 7 + 4];
-						addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TAC2121C_YESTERDAY: day %i, month %i, val %i\n",
+						ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TAC2121C_YESTERDAY: day %i, month %i, val %i\n",
 							day, month, iVal);
 
 					}
@@ -1111,7 +1456,7 @@ void TuyaMCU_ParseStateMessage(const byte* data, int len) {
 						month = data[ofs + 4 + 1];
 						// consumption
 						iVal = data[ofs + 6 + 4] << 8 | data[ofs + 7 + 4];
-						addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "DP_TYPE_RAW_TAC2121C_LASTMONTH: month %i, year %i, val %i\n",
+						ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "DP_TYPE_RAW_TAC2121C_LASTMONTH: month %i, year %i, val %i\n",
 							month, year, iVal);
 
 					}
@@ -1266,14 +1611,14 @@ void TuyaMCU_ProcessIncoming(const byte* data, int len) {
 	byte version;
 
 	if (data[0] != 0x55 || data[1] != 0xAA) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: discarding packet with bad ident and len %i\n", len);
+		ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: discarding packet with bad ident and len %i\n", len);
 		return;
 	}
 	version = data[2];
-	checkLen = data[5] | data[4] >> 8;
+	checkLen = (data[4] << 8) | data[5];
 	checkLen = checkLen + 2 + 1 + 1 + 2 + 1;
 	if (checkLen != len) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: discarding packet bad expected len, expected %i and got len %i\n", checkLen, len);
+		ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: discarding packet bad expected len, expected %i and got len %i\n", checkLen, len);
 		return;
 	}
 	checkCheckSum = 0;
@@ -1281,11 +1626,11 @@ void TuyaMCU_ProcessIncoming(const byte* data, int len) {
 		checkCheckSum += data[i];
 	}
 	if (checkCheckSum != data[len - 1]) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: discarding packet bad expected checksum, expected %i and got checksum %i\n", (int)data[len - 1], (int)checkCheckSum);
+		ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: discarding packet bad expected checksum, expected %i and got checksum %i\n", (int)data[len - 1], (int)checkCheckSum);
 		return;
 	}
 	cmd = data[3];
-	addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming[ver=%i]: processing command %i (%s) with %i bytes\n", version, cmd, TuyaMCU_GetCommandTypeLabel(cmd), len);
+	ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming[ver=%i]: processing command %i (%s) with %i bytes\n", version, cmd, TuyaMCU_GetCommandTypeLabel(cmd), len);
 	switch (cmd)
 	{
 	case TUYA_CMD_HEARTBEAT:
@@ -1316,10 +1661,10 @@ void TuyaMCU_ProcessIncoming(const byte* data, int len) {
 			self_processing_mode = false;
 		}
 		if (5 + dataCount + 2 != len) {
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: TUYA_CMD_MCU_CONF had wrong data lenght?");
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: TUYA_CMD_MCU_CONF had wrong data lenght?");
 		}
 		else {
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: TUYA_CMD_MCU_CONF, TODO!");
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: TUYA_CMD_MCU_CONF, TODO!");
 		}
 		if (g_sensorMode) {
 			if (g_tuyaBatteryPoweredState == TM0_STATE_AWAITING_WIFI) {
@@ -1346,7 +1691,7 @@ void TuyaMCU_ProcessIncoming(const byte* data, int len) {
 		g_sendQueryStatePackets = 0;
 		break;
 	case TUYA_CMD_SET_TIME:
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: received TUYA_CMD_SET_TIME, so sending back time");
+		ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: received TUYA_CMD_SET_TIME, so sending back time");
 		TuyaMCU_Send_SetTime(TuyaMCU_Get_NTP_Time());
 		break;
 		// 55 AA 00 01 00 ${"p":"e7dny8zvmiyhqerw","v":"1.0.0"}$
@@ -1392,7 +1737,7 @@ void TuyaMCU_ProcessIncoming(const byte* data, int len) {
 		// This is send by TH06, S09
 		// Info:TuyaMCU:TUYAMCU received: 55 AA 03 24 00 00 26
 		if (version == 3) {
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: received TUYA_CMD_SET_RSSI, so sending back signal strength");
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: received TUYA_CMD_SET_RSSI, so sending back signal strength");
 			TuyaMCU_Send_RSSI(HAL_GetWifiStrength());
 		}
 		break;
@@ -1402,12 +1747,12 @@ void TuyaMCU_ProcessIncoming(const byte* data, int len) {
 		//Info:TuyaMCU:TUYAMCU received: 55 AA 03 2B 00 00 2D
 		//
 		if (version == 3) {
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: (test for S09 calendar/IR device) received TUYA_CMD_NETWORK_STATUS 0x2B ");
+			ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: (test for S09 calendar/IR device) received TUYA_CMD_NETWORK_STATUS 0x2B ");
 			TuyaMCU_SendNetworkStatus();
 		}
 		break;
 	default:
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: unhandled type %i", cmd);
+		ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_ProcessIncoming: unhandled type %i", cmd);
 		break;
 	}
 	EventHandlers_FireEvent(CMD_EVENT_TUYAMCU_PARSED, cmd);
@@ -1417,7 +1762,7 @@ commandResult_t TuyaMCU_FakePacket(const void* context, const char* cmd, const c
 	byte packet[256];
 	int c = 0;
 	if (!(*args)) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TuyaMCU_FakePacket: requires 1 argument (hex string, like FFAABB00CCDD\n");
+		ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TuyaMCU_FakePacket: requires 1 argument (hex string, like FFAABB00CCDD\n");
 		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
 	}
 	while (*args) {
@@ -1441,7 +1786,7 @@ void TuyaMCU_RunWiFiUpdateAndPackets() {
 	{
 		if ((wifi_state == false) || (wifi_state_timer == 0))
 		{
-			addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_TUYAMCU, "Will send SetWiFiState 4.\n");
+			ADDLOG_EXTRADEBUG(LOG_FEATURE_TUYAMCU, "Will send SetWiFiState 4.\n");
 			Tuya_SetWifiState(4);
 			wifi_state = true;
 			wifi_state_timer++;
@@ -1450,7 +1795,7 @@ void TuyaMCU_RunWiFiUpdateAndPackets() {
 	else {
 		if ((wifi_state == true) || (wifi_state_timer == 0))
 		{
-			addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_TUYAMCU, "Will send SetWiFiState %i.\n", (int)g_defaultTuyaMCUWiFiState);
+			ADDLOG_EXTRADEBUG(LOG_FEATURE_TUYAMCU, "Will send SetWiFiState %i.\n", (int)g_defaultTuyaMCUWiFiState);
 
 			Tuya_SetWifiState(g_defaultTuyaMCUWiFiState);
 			wifi_state = false;
@@ -1468,32 +1813,34 @@ void TuyaMCU_RunWiFiUpdateAndPackets() {
 	}
 }
 void TuyaMCU_RunReceive() {
+	static const char hexDigits[] = "0123456789ABCDEF";
 	byte data[128];
-	char buffer_for_log[256];
-	char buffer2[4];
+	char buffer_for_log[sizeof(data) * 2 + 1];
+	bool bLog, bEvent;
 	int len, i;
 	while (1)
 	{
 		len = UART_TryToGetNextTuyaPacket(data, sizeof(data));
 		if (len > 0) {
-			buffer_for_log[0] = 0;
-			for (i = 0; i < len; i++) {
-				snprintf(buffer2, sizeof(buffer2), "%02X ", data[i]);
-				strcat_safe(buffer_for_log, buffer2, sizeof(buffer_for_log));
-			}
-			addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "TUYAMCU received: %s\n", buffer_for_log);
-#if 1
-			// redo sprintf without spaces
-			buffer_for_log[0] = 0;
-			for (i = 0; i < len; i++) {
-				snprintf(buffer2, sizeof(buffer2), "%02X", data[i]);
-				strcat_safe(buffer_for_log, buffer2, sizeof(buffer_for_log));
+			// the hex string is only built if it will be logged or
+			// there are OnUART event handlers to match it against
+			bLog = LOG_IsEnabled(LOG_INFO, LOG_FEATURE_TUYAMCU);
+			bEvent = EventHandlers_HasHandlers(CMD_EVENT_ON_UART);
+			if (bLog || bEvent) {
+				for (i = 0; i < len; i++) {
+					buffer_for_log[i * 2] = hexDigits[data[i] >> 4];
+					buffer_for_log[i * 2 + 1] = hexDigits[data[i] & 0x0F];
+				}
+				buffer_for_log[len * 2] = 0;
+				if (bLog) {
+					ADDLOG_INFO(LOG_FEATURE_TUYAMCU, "TUYAMCU received: %s\n", buffer_for_log);
+				}
+				// This is so we can have event handlers that fire
+				// when an UART string is received...
+				if (bEvent) {
+					EventHandlers_FireEvent_String(CMD_EVENT_ON_UART, buffer_for_log);
+				}
 			}
-			// fire string event, as we already have it sprintfed
-			// This is so we can have event handlers that fire
-			// when an UART string is received...
-			EventHandlers_FireEvent_String(CMD_EVENT_ON_UART, buffer_for_log);
-#endif
 			TuyaMCU_ProcessIncoming(data, len);
 		}
 		else {
@@ -1506,7 +1853,7 @@ void TuyaMCU_RunStateMachine_V3() {
 	//addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU,"UART ring buffer state: %i %i\n",g_recvBufIn,g_recvBufOut);
 
 	// extraDebug log level
-	addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_TUYAMCU, "TuyaMCU heartbeat_valid = %i, product_information_valid=%i,"
+	ADDLOG_EXTRADEBUG(LOG_FEATURE_TUYAMCU, "TuyaMCU heartbeat_valid = %i, product_information_valid=%i,"
 		" self_processing_mode = %i, wifi_state_valid = %i, wifi_state_timer=%i\n",
 		(int)heartbeat_valid, (int)product_information_valid, (int)self_processing_mode,
 		(int)wifi_state_valid, (int)wifi_state_timer);
@@ -1545,13 +1892,13 @@ void TuyaMCU_RunStateMachine_V3() {
 			/* Connection Active */
 			if (product_information_valid == false)
 			{
-				addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_TUYAMCU, "Will send TUYA_CMD_QUERY_PRODUCT.\n");
+				ADDLOG_EXTRADEBUG(LOG_FEATURE_TUYAMCU, "Will send TUYA_CMD_QUERY_PRODUCT.\n");
 				/* Request production information */
 				TuyaMCU_SendCommandWithData(TUYA_CMD_QUERY_PRODUCT, NULL, 0);
 			}
 			else if (working_mode_valid == false)
 			{
-				addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_TUYAMCU, "Will send TUYA_CMD_MCU_CONF.\n");
+				ADDLOG_EXTRADEBUG(LOG_FEATURE_TUYAMCU, "Will send TUYA_CMD_MCU_CONF.\n");
 				/* Request working mode */
 				TuyaMCU_SendCommandWithData(TUYA_CMD_MCU_CONF, NULL, 0);
 			}
@@ -1559,7 +1906,7 @@ void TuyaMCU_RunStateMachine_V3() {
 			{
 				/* Reset wifi state -> Aquirring network connection */
 				Tuya_SetWifiState(g_defaultTuyaMCUWiFiState);
-				addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_TUYAMCU, "Will send TUYA_CMD_WIFI_STATE.\n");
+				ADDLOG_EXTRADEBUG(LOG_FEATURE_TUYAMCU, "Will send TUYA_CMD_WIFI_STATE.\n");
 				TuyaMCU_SendCommandWithData(TUYA_CMD_WIFI_STATE, NULL, 0);
 			}
 			else if (state_updated == false)
@@ -1571,7 +1918,7 @@ void TuyaMCU_RunStateMachine_V3() {
 				}
 				else {
 					/* Request first state of all DP - this should list all existing DP */
-					addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE_TUYAMCU, "Will send TUYA_CMD_QUERY_STATE (state_updated==false, try %i).\n",
+					ADDLOG_EXTRADEBUG(LOG_FEATURE_TUYAMCU, "Will send TUYA_CMD_QUERY_STATE (state_updated==false, try %i).\n",
 						g_sendQueryStatePackets);
 					TuyaMCU_SendCommandWithData(TUYA_CMD_QUERY_STATE, NULL, 0);
 				}
@@ -1659,7 +2006,7 @@ commandResult_t TuyaMCU_SetBaudRate(const void* context, const char* cmd, const
 	}
 
 	g_baudRate = Tokenizer_GetArgInteger(0);
-	UART_InitUART(g_baudRate);
+	TuyaMCU_InitUARTIfNeeded();
 
 	return CMD_RES_OK;
 }
@@ -1676,15 +2023,26 @@ void TuyaMCU_Init()
 		tmp = nxt;
 	}
 	g_tuyaMappings = 0;
+	memset(g_tuyaMappingsByID, 0, sizeof(g_tuyaMappingsByID));
+	memset(g_tuyaMappingsByChannel, 0, sizeof(g_tuyaMappingsByChannel));
 
 	g_resetWiFiEvents = 0;
 	g_tuyaNextRequestDelay = 1;
 	g_tuyaBatteryPoweredState = 0; 
 	g_tuyaMCUConfirmationsToSend_0x05 = 0;
 	g_tuyaMCUConfirmationsToSend_0x08 = 0;
-
-	UART_InitUART(g_baudRate);
-	UART_InitReceiveRingBuffer(256);
+	memset(&g_tuyaParserStats, 0, sizeof(g_tuyaParserStats));
+	if (TuyaMCU_TxMutex_Take(100)) {
+		g_tuyaTxFirst = 0;
+		g_tuyaTxCount = 0;
+		g_tuyaTxSentAny = false;
+		memset(&g_tuyaTxStats, 0, sizeof(g_tuyaTxStats));
+		TuyaMCU_TxMutex_Free();
+	}
+
+	g_tuyaUARTInitCounter = UART_InitUART(g_baudRate);
+	g_tuyaUARTBaudRate = g_baudRate;
+	UART_InitReceiveRingBuffer(TUYAMCU_UART_RECEIVE_BUFFER_SIZE);
 	// uartSendHex 55AA0008000007
 	//cmddetail:{"name":"tuyaMcu_testSendTime","args":"",
 	//cmddetail:"descr":"Sends a example date by TuyaMCU to clock/callendar MCU",
@@ -1752,6 +2110,21 @@ void TuyaMCU_Init()
 	//cmddetail:"fn":"Cmd_TuyaMCU_Send_RSSI","file":"driver/drv_tuyaMCU.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("tuyaMcu_defWiFiState", Cmd_TuyaMCU_Set_DefaultWiFiState, NULL);
+	//cmddetail:{"name":"tuyaMcu_parserStats","args":"[reset-Optional]",
+	//cmddetail:"descr":"Prints how many TuyaMCU frames were received, and how many were dropped for a bad checksum or a too large length, and how often the parser had to skip data to find the next frame header. Use 'reset' to clear the counters.",
+	//cmddetail:"fn":"TuyaMCU_ParserStats","file":"driver/drv_tuyaMCU.c","requires":"",
+	//cmddetail:"examples":""}
+	CMD_RegisterCommand("tuyaMcu_parserStats", TuyaMCU_ParserStats, NULL);
+	//cmddetail:{"name":"tuyaMcu_setTxTiming","args":"[MinIntervalMs][AckTimeoutMs-Optional][MaxRetries-Optional]",
+	//cmddetail:"descr":"Sets how DP writes are paced. Writes are sent at least MinIntervalMs apart (default 50), and a write of a dpId that is still queued only replaces its value. If AckTimeoutMs is not 0, the next write also waits for the MCU to report the written dpId back, and a write is repeated up to MaxRetries times (default 2) if the report does not come.",
+	//cmddetail:"fn":"TuyaMCU_SetTxTiming","file":"driver/drv_tuyaMCU.c","requires":"",
+	//cmddetail:"examples":"tuyaMcu_setTxTiming 50 300 2"}
+	CMD_RegisterCommand("tuyaMcu_setTxTiming", TuyaMCU_SetTxTiming, NULL);
+	//cmddetail:{"name":"tuyaMcu_txStats","args":"[reset-Optional]",
+	//cmddetail:"descr":"Prints how many DP writes were sent, merged with a newer write or repeated, the queue depth and the time writes waited in the queue. Use 'reset' to clear the counters.",
+	//cmddetail:"fn":"TuyaMCU_TxStats","file":"driver/drv_tuyaMCU.c","requires":"",
+	//cmddetail:"examples":""}
+	CMD_RegisterCommand("tuyaMcu_txStats", TuyaMCU_TxStats, NULL);
 }
 
 // Door sensor with TuyaMCU version 0 (not 3), so all replies have x00 and not 0x03 byte
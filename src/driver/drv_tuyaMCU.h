@@ -1,10 +1,45 @@
+#ifndef __DRV_TUYAMCU_H__
+#define __DRV_TUYAMCU_H__
 
+typedef struct tuyaMCUParserStats_s {
+	// frames with a good checksum
+	int frames;
+	int badChecksums;
+	// frames larger than the receive buffer, or with a damaged length
+	int oversizeFrames;
+	// how many times data had to be skipped to find a header
+	int resyncs;
+	int skippedBytes;
+} tuyaMCUParserStats_t;
+
+typedef struct tuyaMCUTxStats_s {
+	// DP writes put on the wire, retries included
+	int sent;
+	// DP writes that replaced a queued write of the same dpId
+	int coalesced;
+	// writes sent ahead of their time because the queue was full
+	int overflows;
+	int retries;
+	// writes given up after the last retry got no report
+	int ackTimeouts;
+	int depth;
+	int maxDepth;
+	// time from queueing to the first send
+	int totalLatencyMs;
+	int maxLatencyMs;
+} tuyaMCUTxStats_t;
 
 void TuyaMCU_Init();
 void TuyaMCU_RunFrame();
+void TuyaMCU_RunQuickTick();
 void TuyaMCU_Send(byte *data, int size);
 void TuyaMCU_OnChannelChanged(int channel,int iVal);
 void TuyaMCU_Send_RawBuffer(byte *data, int len);
 bool TuyaMCU_IsChannelUsedByTuyaMCU(int channelIndex);
 void TuyaMCU_ForcePublishChannelValues();
+void TuyaMCU_V0_SendDPCacheReply();
+
+const tuyaMCUParserStats_t* TuyaMCU_GetParserStats();
+const tuyaMCUTxStats_t* TuyaMCU_GetTxStats();
 
+#endif // __DRV_TUYAMCU_H__
@@ -5,6 +5,7 @@
 #include "../cmnds/cmd_public.h"
 #include "../cmnds/cmd_local.h"
 #include "../logging/logging.h"
+#include "drv_uart.h"
 
 
 #if PLATFORM_BK7231T | PLATFORM_BK7231N
@@ -94,57 +95,156 @@ int fd_console = -1;
 #else
 #endif
 
+// Receive ring buffer. Size is always a power of two, so positions are
+// free running counters and the buffer index is just (pos & mask).
+// Only the RX interrupt moves g_recvBufIn and only the driver moves
+// g_recvBufOut, so no locking is needed and whole buffer can be used.
 static byte *g_recvBuf = 0;
-static int g_recvBufSize = 0;
-static int g_recvBufIn = 0;
-static int g_recvBufOut = 0;
+static unsigned int g_recvBufSize = 0;
+static unsigned int g_recvBufMask = 0;
+static volatile unsigned int g_recvBufIn = 0;
+static volatile unsigned int g_recvBufOut = 0;
+// size requested with uartRxBufferSize, 0 if driver default is used
+static int g_recvBufSizeOverride = 0;
+// size requested by the driver, the buffer is never made smaller than that
+static int g_recvBufSizeDriver = 0;
+static uartStats_t g_uartStats;
 // used to detect uart reinit
 int g_uart_init_counter = 0;
 // used to detect uart manual mode
 int g_uart_manualInitCounter = -1;
 
+const uartStats_t* UART_GetStats() {
+	return &g_uartStats;
+}
+int UART_GetReceiveRingBufferSize() {
+	return g_recvBufSize;
+}
 void UART_InitReceiveRingBuffer(int size){
-	if(g_recvBuf!=0)
-		free(g_recvBuf);
-	g_recvBuf = (byte*)malloc(size);
-	memset(g_recvBuf,0,size);
-	g_recvBufSize = size;
+	unsigned int realSize;
+	byte *old;
+
+	g_recvBufSizeDriver = size;
+	if (g_recvBufSizeOverride > size) {
+		size = g_recvBufSizeOverride;
+	}
+	realSize = UART_MIN_RECEIVE_BUFFER_SIZE;
+	while (realSize < size && realSize < UART_MAX_RECEIVE_BUFFER_SIZE) {
+		realSize <<= 1;
+	}
+	if (g_recvBuf == 0 || realSize != g_recvBufSize) {
+		// stop interrupt from writing to old buffer before freeing it
+		old = g_recvBuf;
+		g_recvBuf = 0;
+		if (old != 0)
+			free(old);
+		g_recvBuf = (byte*)malloc(realSize);
+		if (g_recvBuf == 0) {
+			g_recvBufSize = 0;
+			g_recvBufMask = 0;
+			return;
+		}
+		g_recvBufSize = realSize;
+		g_recvBufMask = realSize - 1;
+	}
 	g_recvBufIn = 0;
 	g_recvBufOut = 0;
 }
 int UART_GetDataSize()
 {
-    int remain_buf_size = 0;
-
-    if(g_recvBufIn >= g_recvBufOut) {
-        remain_buf_size = g_recvBufIn - g_recvBufOut;
-    }else {
-        remain_buf_size = g_recvBufIn + g_recvBufSize - g_recvBufOut;
-    }
-
-    return remain_buf_size;
+	return g_recvBufIn - g_recvBufOut;
 }
 byte UART_GetNextByte(int index) {
-	int realIndex = g_recvBufOut + index;
-	if(realIndex > g_recvBufSize)
-		realIndex -= g_recvBufSize;
-
-	return g_recvBuf[realIndex];
+	return g_recvBuf[(g_recvBufOut + index) & g_recvBufMask];
 }
 void UART_ConsumeBytes(int idx) {
+	int cs;
+
+	cs = UART_GetDataSize();
+	if (idx > cs)
+		idx = cs;
 	g_recvBufOut += idx;
-	if(g_recvBufOut > g_recvBufSize)
-		g_recvBufOut -= g_recvBufSize;
 }
-
+int UART_PeekSpan(int offset, const byte **data) {
+	int cs;
+	unsigned int start;
+	int len;
+
+	cs = UART_GetDataSize();
+	if (offset >= cs) {
+		*data = 0;
+		return 0;
+	}
+	start = (g_recvBufOut + offset) & g_recvBufMask;
+	len = cs - offset;
+	// stop at the physical end of the ring, rest is at the start of buffer
+	if (start + len > g_recvBufSize) {
+		len = g_recvBufSize - start;
+	}
+	*data = g_recvBuf + start;
+	return len;
+}
+int UART_ReadSpan(byte *out, int maxLen) {
+	const byte *data;
+	int total, len;
+
+	total = 0;
+	while (total < maxLen) {
+		len = UART_PeekSpan(0, &data);
+		if (len == 0)
+			break;
+		if (len > maxLen - total)
+			len = maxLen - total;
+		memcpy(out + total, data, len);
+		total += len;
+		g_recvBufOut += len;
+	}
+	return total;
+}
+int UART_FindByte(int offset, byte b) {
+	const byte *data;
+	const byte *found;
+	int cs;
+	int len;
+
+	cs = UART_GetDataSize();
+	while (offset < cs) {
+		len = UART_PeekSpan(offset, &data);
+		found = (const byte*)memchr(data, b, len);
+		if (found) {
+			return offset + (int)(found - data);
+		}
+		offset += len;
+	}
+	return cs;
+}
 void UART_AppendByteToCircularBuffer(int rc) {
-    if(UART_GetDataSize() < (g_recvBufSize-1))
-    {
-        g_recvBuf[g_recvBufIn++] = rc;
-        if(g_recvBufIn >= g_recvBufSize){
-            g_recvBufIn = 0;
-        }
-   }
+	int cs;
+
+	if (g_recvBuf == 0)
+		return;
+	cs = UART_GetDataSize();
+	if (cs >= g_recvBufSize) {
+		g_uartStats.droppedBytes++;
+		if (g_uartStats.lastDropCounter != g_uartStats.receivedBytes) {
+			g_uartStats.overflows++;
+		}
+		g_uartStats.lastDropCounter = g_uartStats.receivedBytes;
+		return;
+	}
+	g_recvBuf[g_recvBufIn & g_recvBufMask] = rc;
+	g_recvBufIn++;
+	g_uartStats.receivedBytes++;
+	if (cs + 1 > g_uartStats.maxFill) {
+		g_uartStats.maxFill = cs + 1;
+	}
+}
+void UART_AppendBytesToCircularBuffer(const byte *data, int len) {
+	int i;
+
+	for (i = 0; i < len; i++) {
+		UART_AppendByteToCircularBuffer(data[i]);
+	}
 }
 #if PLATFORM_BK7231T | PLATFORM_BK7231N
 void test_ty_read_uart_data_to_buffer(int port, void* param)
@@ -181,17 +281,12 @@ static void console_cb_read(int fd, void *param)
 {
 	char buffer[64];  /* adapt to usb cdc since usb fifo is 64 bytes */
 	int ret;
-	int i;
 
 	ret = aos_read(fd, buffer, sizeof(buffer));
 	if (ret > 0) {
-		if (ret < sizeof(buffer)) {
+		if (ret <= sizeof(buffer)) {
 			fd_console = fd;
-			buffer[ret] = 0;
-			addLogAdv(LOG_INFO, LOG_FEATURE_ENERGYMETER, "BL602 received: %s\n", buffer);
-			for (i = 0; i < ret; i++) {
-				UART_AppendByteToCircularBuffer(buffer[i]);
-			}
+			UART_AppendBytesToCircularBuffer((const byte*)buffer, ret);
 		}
 		else {
 			printf("-------------BUG from aos_read for ret\r\n");
@@ -275,10 +370,10 @@ backlog startDriver TuyaMCU; uartFakeHex 55 AA 00 05 00 05 01 04 00 01 01 10 55
 */
 commandResult_t CMD_UART_FakeHex(const void *context, const char *cmd, const char *args, int cmdFlags) {
 	//const char *args = CMD_GetArg(1);
-	//byte rawData[128];
-	//int curCnt;
+	byte rawData[64];
+	int curCnt;
 
-	//curCnt = 0;
+	curCnt = 0;
 	if (!(*args)) {
 		addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU, "CMD_UART_FakeHex: requires 1 argument (hex string, like FFAABB00CCDD\n");
 		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
@@ -291,17 +386,17 @@ commandResult_t CMD_UART_FakeHex(const void *context, const char *cmd, const cha
 		}
 		b = hexbyte(args);
 
-		//rawData[curCnt] = b;
-		//curCnt++;
-		//if(curCnt>=sizeof(rawData)) {
-		//  addLogAdv(LOG_INFO, LOG_FEATURE_TUYAMCU,"CMD_UART_FakeHex: sorry, given string is too long\n");
-		//  return -1;
-		//}
-
-		UART_AppendByteToCircularBuffer(b);
+		// deliver in chunks, like the RX interrupt does
+		rawData[curCnt] = b;
+		curCnt++;
+		if (curCnt >= sizeof(rawData)) {
+			UART_AppendBytesToCircularBuffer(rawData, curCnt);
+			curCnt = 0;
+		}
 
 		args += 2;
 	}
+	UART_AppendBytesToCircularBuffer(rawData, curCnt);
 	return 1;
 }
 // uartSendASCII test123
@@ -423,6 +518,36 @@ commandResult_t CMD_UART_Init(const void *context, const char *cmd, const char *
 
 	return CMD_RES_OK;
 }
+// uartRxBufferSize 1024
+commandResult_t CMD_UART_RxBufferSize(const void *context, const char *cmd, const char *args, int cmdFlags) {
+	Tokenizer_TokenizeString(args, 0);
+	// following check must be done after 'Tokenizer_TokenizeString',
+	// so we know arguments count in Tokenizer. 'cmd' argument is
+	// only for warning display
+	if (Tokenizer_CheckArgsCountAndPrintWarning(cmd, 1)) {
+		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
+	}
+	g_recvBufSizeOverride = Tokenizer_GetArgInteger(0);
+	// resize now if a driver is already using the UART, pending data is dropped,
+	// but not below the size that driver asked for
+	if (g_recvBuf != 0) {
+		UART_InitReceiveRingBuffer(g_recvBufSizeDriver);
+	}
+	addLogAdv(LOG_INFO, LOG_FEATURE_CMD, "UART RX buffer size is %i\n", g_recvBufSize);
+	return CMD_RES_OK;
+}
+// uartStats
+// uartStats reset
+commandResult_t CMD_UART_Stats(const void *context, const char *cmd, const char *args, int cmdFlags) {
+	if (args && !stricmp(args, "reset")) {
+		memset(&g_uartStats, 0, sizeof(g_uartStats));
+	}
+	addLogAdv(LOG_INFO, LOG_FEATURE_CMD, "UART RX buffer %i bytes, %i pending, max fill %i\n",
+		g_recvBufSize, UART_GetDataSize(), g_uartStats.maxFill);
+	addLogAdv(LOG_INFO, LOG_FEATURE_CMD, "UART RX %u bytes, %u dropped in %u overflows\n",
+		g_uartStats.receivedBytes, g_uartStats.droppedBytes, g_uartStats.overflows);
+	return CMD_RES_OK;
+}
 void UART_AddCommands() {
 	//cmddetail:{"name":"uartSendHex","args":"[HexString]",
 	//cmddetail:"descr":"Sends raw data by UART, can be used to send TuyaMCU data, but you must write whole packet with checksum yourself",
@@ -444,6 +569,16 @@ void UART_AddCommands() {
 	//cmddetail:"fn":"CMD_UART_Init","file":"driver/drv_uart.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("uartInit", CMD_UART_Init, NULL);
+	//cmddetail:{"name":"uartRxBufferSize","args":"[Bytes]",
+	//cmddetail:"descr":"Sets the minimum size of UART receive buffer, rounded up to a power of two. The buffer is never smaller than the size the driver asks for. Drivers that start later use at least this size, running driver gets its buffer resized now (pending data is dropped). Use it when uartStats reports overflows.",
+	//cmddetail:"fn":"CMD_UART_RxBufferSize","file":"driver/drv_uart.c","requires":"",
+	//cmddetail:"examples":""}
+	CMD_RegisterCommand("uartRxBufferSize", CMD_UART_RxBufferSize, NULL);
+	//cmddetail:{"name":"uartStats","args":"[reset-Optional]",
+	//cmddetail:"descr":"Logs UART receive buffer size and fill level, number of received bytes and how many bytes were dropped because buffer was full. Use 'reset' to clear the counters.",
+	//cmddetail:"fn":"CMD_UART_Stats","file":"driver/drv_uart.c","requires":"",
+	//cmddetail:"examples":""}
+	CMD_RegisterCommand("uartStats", CMD_UART_Stats, NULL);
 }
 
 
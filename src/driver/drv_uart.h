@@ -1,19 +1,49 @@
+#ifndef __DRV_UART_H__
+#define __DRV_UART_H__
 
 
+// receive buffer size is rounded up to power of two within these limits
+#define UART_MIN_RECEIVE_BUFFER_SIZE	64
+#define UART_MAX_RECEIVE_BUFFER_SIZE	4096
+
+typedef struct uartStats_s {
+	unsigned int receivedBytes;
+	// bytes lost because receive buffer was full
+	unsigned int droppedBytes;
+	// number of separate runs of dropped bytes
+	unsigned int overflows;
+	unsigned int lastDropCounter;
+	int maxFill;
+} uartStats_t;
 
 void UART_InitReceiveRingBuffer(int size);
+int UART_GetReceiveRingBufferSize();
 int UART_GetDataSize();
 byte UART_GetNextByte(int index);
 void UART_ConsumeBytes(int idx);
+// Returns the number of received bytes that are stored contiguously
+// starting at given offset from the read position, and sets data to
+// point at them. Does not consume; call again with a larger offset to
+// get the part that wrapped to the start of the ring.
+int UART_PeekSpan(int offset, const byte **data);
+// copies up to maxLen received bytes to out and consumes them
+int UART_ReadSpan(byte *out, int maxLen);
+// offset of the first received byte equal to b at or after offset,
+// or the number of received bytes if there is none
+int UART_FindByte(int offset, byte b);
 void UART_AppendByteToCircularBuffer(int rc);
+void UART_AppendBytesToCircularBuffer(const byte *data, int len);
+const uartStats_t* UART_GetStats();
 void UART_SendByte(byte b);
-void UART_InitUART(int baud);
+// returns the new g_uart_init_counter
+int UART_InitUART(int baud);
 void UART_AddCommands();
+#if WINDOWS
+void UART_ResetForSimulator();
+#endif
 void UART_RunEverySecond();
 
 // used to detect uart reinit/takeover by driver
 extern int g_uart_init_counter;
 
-
-
-
+#endif /* __DRV_UART_H__ */
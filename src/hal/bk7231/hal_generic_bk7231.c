@@ -1,8 +1,19 @@
-
+#include "../../new_common.h"
+#include <rtos_pub.h>
 
 // from wlan_ui.c
 void bk_reboot(void);
 
 void HAL_RebootModule() {
 	bk_reboot();
+}
+
+unsigned int HAL_GetTimeUs() {
+	// rtos_get_time is in milliseconds
+	return rtos_get_time() * 1000;
+}
+
+unsigned int HAL_GetTimeUsResolution() {
+	// rtos_get_time only advances once per tick
+	return portTICK_RATE_MS * 1000;
 }
\ No newline at end of file
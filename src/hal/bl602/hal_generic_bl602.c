@@ -2,6 +2,7 @@
 
 #include "../../new_common.h"
 #include <hal_sys.h>
+#include <bl_timer.h>
 
 void HAL_RebootModule() {
 
@@ -9,4 +10,12 @@ void HAL_RebootModule() {
 
 }
 
+unsigned int HAL_GetTimeUs() {
+	return bl_timer_now_us();
+}
+
+unsigned int HAL_GetTimeUsResolution() {
+	return 1;
+}
+
 #endif // PLATFORM_XR809
\ No newline at end of file
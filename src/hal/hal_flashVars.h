@@ -51,5 +51,16 @@ int HAL_GetEnergyMeterStatus(ENERGY_METERING_DATA* data);
 int HAL_SetEnergyMeterStatus(ENERGY_METERING_DATA* data);
 void HAL_FlashVars_SaveTotalConsumption(float total_consumption);
 
+#if WINDOWS
+// simulated flash vars sectors, see hal_flashVars_win32.c
+void SIM_FlashVars_Clear();
+void SIM_FlashVars_Reload();
+void SIM_FlashVars_WriteLegacy(int count);
+int SIM_FlashVars_GetLegacySize();
+void SIM_FlashVars_SetPowerLossAfter(int bytes);
+int SIM_FlashVars_GetEraseCount();
+int SIM_FlashVars_GetJournalOffset();
+#endif
+
 #endif /* __HALK_FLASH_VARS_H__ */
 
@@ -0,0 +1,430 @@
+/*
+	Flash vars journal, shared by the platforms that write flash vars sectors themselves.
+
+	The platform file includes this after defining:
+	FLASH_JOURNAL_SECTOR_LEN - erase size, the journal uses two such sectors
+	flash_vars_raw_read(offset, data, size)
+	flash_vars_raw_write(offset, data, size)
+	flash_vars_raw_erase(sector)
+	where offsets are zero based from the start of the sector pair.
+
+	Design:
+	sectors are used in turn. A sector starts with a header holding the
+	magic and a sequence number, written only after a snapshot of the whole
+	FLASH_VARS_STRUCTURE was written behind it, so a sector with a valid
+	header always starts with a full copy of the variables.
+	Changes are appended as records with their own CRC. Energy counter
+	commits only store the deltas of total and today consumption, so they
+	take 12 bytes instead of a whole structure.
+	When the active sector is full, the other one is erased and started
+	with a fresh snapshot and the next sequence number. The old sector is
+	left untouched until the next rotation, so a power loss at any point
+	leaves at least one sector with the last committed state.
+	At boot, the sector with the newest sequence is replayed up to the first
+	erased or damaged record. Nothing can be appended after a damaged
+	record, so the journal is moved to the other sector right away.
+	The single log of older versions is converted once, see
+	flash_journal_convert_legacy.
+*/
+#ifndef __HAL_FLASH_VARS_JOURNAL_H__
+#define __HAL_FLASH_VARS_JOURNAL_H__
+
+#define FLASH_JOURNAL_MAGIC 0x4a564b4f
+#define FLASH_JOURNAL_AREA_LEN (2 * FLASH_JOURNAL_SECTOR_LEN)
+// older versions kept a single log over both sectors, starting with this magic
+#define FLASH_VARS_MAGIC 0xfefefefe
+// where a structure straddling both sectors is copied before the conversion,
+// it can not overlap the end of that structure
+#define FLASH_JOURNAL_LEGACY_COPY (FLASH_JOURNAL_SECTOR_LEN + (int)sizeof(FLASH_VARS_STRUCTURE))
+#define FLASH_JOURNAL_ALIGN(x) (((x) + 3) & ~3)
+
+enum {
+	FLASH_JOURNAL_VARS = 1,
+	FLASH_JOURNAL_ENERGY = 2,
+};
+
+typedef struct flashJournalHeader_s {
+	unsigned int magic;
+	unsigned int sequence;
+} flashJournalHeader_t;
+
+typedef struct flashJournalRecord_s {
+	unsigned char type;
+	// payload length, the record is padded to 4 bytes
+	unsigned char len;
+	// CRC16 of type, len and payload
+	unsigned short crc;
+} flashJournalRecord_t;
+
+typedef struct flashJournalEnergy_s {
+	float total;
+	float today;
+} flashJournalEnergy_t;
+
+typedef struct flashJournal_s {
+	// active sector, -1 if none was started yet
+	int sector;
+	unsigned int sequence;
+	// first free byte in the active sector
+	int offset;
+	// energy data as it was last stored, deltas are taken against it
+	ENERGY_METERING_DATA energy;
+	int rotations;
+	int damagedRecords;
+} flashJournal_t;
+
+static flashJournal_t flash_journal = { -1 };
+
+static unsigned short flash_journal_crc(unsigned short crc, const unsigned char* data, int len) {
+	int i;
+
+	while (len--) {
+		crc ^= (unsigned short)(*data++) << 8;
+		for (i = 0; i < 8; i++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+static unsigned short flash_journal_record_crc(const flashJournalRecord_t* rec, const void* payload) {
+	unsigned short crc;
+
+	// type and len are next to each other
+	crc = flash_journal_crc(0xFFFF, &rec->type, 2);
+	return flash_journal_crc(crc, (const unsigned char*)payload, rec->len);
+}
+
+// returns the record size, or -1 if it could not be written
+static int flash_journal_write_record(int offset, int type, const void* payload, int len) {
+	unsigned char buf[sizeof(flashJournalRecord_t) + FLASH_JOURNAL_ALIGN(sizeof(FLASH_VARS_STRUCTURE))];
+	flashJournalRecord_t rec;
+	int size;
+
+	size = sizeof(rec) + FLASH_JOURNAL_ALIGN(len);
+	rec.type = type;
+	rec.len = len;
+	rec.crc = flash_journal_record_crc(&rec, payload);
+	// padding is left erased
+	memset(buf, 0xFF, size);
+	memcpy(buf, &rec, sizeof(rec));
+	memcpy(buf + sizeof(rec), payload, len);
+	if (flash_vars_raw_write(offset, buf, size) < 0) {
+		return -1;
+	}
+	return size;
+}
+
+static void flash_journal_apply(FLASH_VARS_STRUCTURE* data, const flashJournalRecord_t* rec, const unsigned char* payload) {
+	flashJournalEnergy_t delta;
+
+	if (rec->type == FLASH_JOURNAL_VARS) {
+		// a structure saved by an older version may be shorter
+		memset(data, 0, sizeof(*data));
+		memcpy(data, payload, rec->len < sizeof(*data) ? rec->len : sizeof(*data));
+		data->len = sizeof(*data);
+	}
+	else {
+		memcpy(&delta, payload, sizeof(delta));
+		data->emetering.TotalConsumption += delta.total;
+		data->emetering.TodayConsumpion += delta.today;
+		data->emetering.save_counter++;
+	}
+}
+
+// Replays a sector into data. Returns the offset of the first free byte,
+// or -1 if the sector does not start with a snapshot. *damaged is set if
+// the replay stopped at a record that is not valid.
+static int flash_journal_replay(int sector, FLASH_VARS_STRUCTURE* data, int* damaged) {
+	flashJournalRecord_t rec;
+	unsigned char payload[255];
+	int base = sector * FLASH_JOURNAL_SECTOR_LEN;
+	int offset = sizeof(flashJournalHeader_t);
+	int records = 0;
+	int size;
+
+	*damaged = 0;
+	while (offset + (int)sizeof(rec) <= FLASH_JOURNAL_SECTOR_LEN) {
+		flash_vars_raw_read(base + offset, &rec, sizeof(rec));
+		if (rec.type == 0xFF && rec.len == 0xFF && rec.crc == 0xFFFF) {
+			// erased, end of journal
+			break;
+		}
+		size = sizeof(rec) + FLASH_JOURNAL_ALIGN(rec.len);
+		if (offset + size > FLASH_JOURNAL_SECTOR_LEN
+			|| (rec.type != FLASH_JOURNAL_VARS && rec.type != FLASH_JOURNAL_ENERGY)
+			|| (rec.type == FLASH_JOURNAL_ENERGY && (records == 0 || rec.len != sizeof(flashJournalEnergy_t)))) {
+			*damaged = 1;
+			break;
+		}
+		flash_vars_raw_read(base + offset + sizeof(rec), payload, rec.len);
+		if (flash_journal_record_crc(&rec, payload) != rec.crc) {
+			*damaged = 1;
+			break;
+		}
+		flash_journal_apply(data, &rec, payload);
+		records++;
+		offset += size;
+	}
+	if (records == 0) {
+		return -1;
+	}
+	return offset;
+}
+
+// starts a sector with a snapshot of data
+static int flash_journal_start(int sector, const FLASH_VARS_STRUCTURE* data) {
+	flashJournalHeader_t hdr;
+	int base;
+	int size;
+
+	base = sector * FLASH_JOURNAL_SECTOR_LEN;
+	if (flash_vars_raw_erase(sector) < 0) {
+		return -1;
+	}
+	size = flash_journal_write_record(base + sizeof(hdr), FLASH_JOURNAL_VARS, data, sizeof(*data));
+	if (size < 0) {
+		return -1;
+	}
+	// the header goes last, it makes the sector valid
+	hdr.magic = FLASH_JOURNAL_MAGIC;
+	hdr.sequence = flash_journal.sequence + 1;
+	if (flash_vars_raw_write(base, &hdr, sizeof(hdr)) < 0) {
+		return -1;
+	}
+	flash_journal.sector = sector;
+	flash_journal.sequence = hdr.sequence;
+	flash_journal.offset = sizeof(hdr) + size;
+	flash_journal.energy = data->emetering;
+	flash_journal.rotations++;
+	return 0;
+}
+
+// starts the other sector with a snapshot of data
+static int flash_journal_rotate(const FLASH_VARS_STRUCTURE* data) {
+	return flash_journal_start((flash_journal.sector == 0) ? 1 : 0, data);
+}
+
+// Loads data from the newest valid sector. Returns 0 if there is none,
+// then the caller should set up data and call flash_journal_rotate.
+static int flash_journal_open(FLASH_VARS_STRUCTURE* data) {
+	flashJournalHeader_t hdr[2];
+	FLASH_VARS_STRUCTURE tmp;
+	int newest;
+	int i, sector;
+	int offset;
+	int damaged;
+
+	flash_journal.sector = -1;
+	flash_vars_raw_read(0, &hdr[0], sizeof(hdr[0]));
+	flash_vars_raw_read(FLASH_JOURNAL_SECTOR_LEN, &hdr[1], sizeof(hdr[1]));
+	newest = 0;
+	if (hdr[0].magic != FLASH_JOURNAL_MAGIC
+		|| (hdr[1].magic == FLASH_JOURNAL_MAGIC && (int)(hdr[1].sequence - hdr[0].sequence) > 0)) {
+		newest = 1;
+	}
+	// first the sectors with a header, newest first, then a sector where
+	// the power was lost after its snapshot but before its header
+	for (i = 0; i < 4; i++) {
+		sector = (i & 1) ? !newest : newest;
+		if ((hdr[sector].magic == FLASH_JOURNAL_MAGIC) != (i < 2)) {
+			continue;
+		}
+		os_memset(&tmp, 0, sizeof(tmp));
+		offset = flash_journal_replay(sector, &tmp, &damaged);
+		if (offset < 0) {
+			continue;
+		}
+		*data = tmp;
+		flash_journal.sector = sector;
+		flash_journal.sequence = (i < 2) ? hdr[sector].sequence : 0;
+		flash_journal.offset = offset;
+		flash_journal.energy = data->emetering;
+		ADDLOG_INFO(LOG_FEATURE_CFG, "flash vars journal sector %i, sequence %u, %i bytes used",
+			sector, flash_journal.sequence, offset);
+		if (i >= 2) {
+			ADDLOG_ERROR(LOG_FEATURE_CFG, "flash vars journal header missing, compacting");
+			flash_journal_rotate(data);
+		}
+		else if (damaged) {
+			ADDLOG_ERROR(LOG_FEATURE_CFG, "flash vars journal damaged at %i, compacting", offset);
+			flash_journal.damagedRecords++;
+			flash_journal_rotate(data);
+		}
+		return 1;
+	}
+	return 0;
+}
+
+// offset of the last byte in [start, end) that is not erased, -1 if none
+static int flash_journal_last_used(int start, int end) {
+	unsigned char buf[64];
+	int n;
+
+	while (end > start) {
+		n = (end - start < (int)sizeof(buf)) ? end - start : (int)sizeof(buf);
+		end -= n;
+		flash_vars_raw_read(end, buf, n);
+		while (n--) {
+			if (buf[n] != 0xFF) {
+				return end + n;
+			}
+		}
+	}
+	return -1;
+}
+
+// Finds the last structure in [start, end) stored by older versions, which
+// is followed by its len. Returns its offset and sets *len, or returns -1.
+static int flash_journal_find_legacy(int start, int end, int* len) {
+	unsigned char b;
+	int last;
+
+	last = flash_journal_last_used(start, end);
+	if (last < 0) {
+		return -1;
+	}
+	flash_vars_raw_read(last, &b, 1);
+	*len = b;
+	if (*len > (int)sizeof(FLASH_VARS_STRUCTURE) || last + 1 - *len < start) {
+		ADDLOG_ERROR(LOG_FEATURE_CFG, "len (%d) in flash_var greater than current structure len (%d)", *len, sizeof(FLASH_VARS_STRUCTURE));
+		return -1;
+	}
+	return last + 1 - *len;
+}
+
+// true if the data at FLASH_JOURNAL_LEGACY_COPY is a copy, maybe cut short,
+// of the structure at offset
+static int flash_journal_is_legacy_copy(int offset, int len) {
+	unsigned char a[sizeof(FLASH_VARS_STRUCTURE)];
+	unsigned char b[sizeof(FLASH_VARS_STRUCTURE)];
+	int n;
+
+	n = flash_journal_last_used(FLASH_JOURNAL_LEGACY_COPY, FLASH_JOURNAL_AREA_LEN) + 1 - FLASH_JOURNAL_LEGACY_COPY;
+	if (n <= 0 || n > len) {
+		return 0;
+	}
+	flash_vars_raw_read(offset, a, n);
+	flash_vars_raw_read(FLASH_JOURNAL_LEGACY_COPY, b, n);
+	return memcmp(a, b, n) == 0;
+}
+
+// Reads the newest structure stored by older versions, see
+// flash_journal_convert_legacy for the states a conversion can leave.
+// Returns its offset and sets *len, or returns -1.
+static int flash_journal_read_legacy(FLASH_VARS_STRUCTURE* data, int* len) {
+	unsigned int magic;
+	int start, end;
+	int offset;
+	int prev, prevLen;
+
+	flash_vars_raw_read(0, &magic, sizeof(magic));
+	if (magic == FLASH_VARS_MAGIC) {
+		start = sizeof(magic);
+		// an erased header in sector 1 means that the journal is being started there
+		end = (flash_journal_last_used(FLASH_JOURNAL_SECTOR_LEN, FLASH_JOURNAL_SECTOR_LEN + sizeof(flashJournalHeader_t)) < 0)
+			? FLASH_JOURNAL_SECTOR_LEN : FLASH_JOURNAL_AREA_LEN;
+	}
+	else if ((magic | 0x01010101) == 0xFFFFFFFF) {
+		// sector 0 is being erased for the journal, the newest structure was left in sector 1
+		start = FLASH_JOURNAL_SECTOR_LEN;
+		end = FLASH_JOURNAL_AREA_LEN;
+	}
+	else {
+		return -1;
+	}
+	offset = flash_journal_find_legacy(start, end, len);
+	if (start < FLASH_JOURNAL_SECTOR_LEN && end == FLASH_JOURNAL_AREA_LEN) {
+		// the copy of a structure straddling both sectors may have been cut short
+		prev = flash_journal_find_legacy(start, FLASH_JOURNAL_LEGACY_COPY, &prevLen);
+		if (prev >= 0 && prev < FLASH_JOURNAL_SECTOR_LEN && prev + prevLen > FLASH_JOURNAL_SECTOR_LEN
+			&& flash_journal_is_legacy_copy(prev, prevLen)) {
+			offset = prev;
+			*len = prevLen;
+		}
+	}
+	if (offset < 0 || *len < 1) {
+		return -1;
+	}
+	// clear result, and read the DATA portion into the structure
+	os_memset(data, 0, sizeof(*data));
+	flash_vars_raw_read(offset, data, *len - 1);
+	// set the len to the latest revision's len
+	data->len = sizeof(*data);
+	return offset;
+}
+
+// Converts the structure stored by older versions into the journal.
+// Returns 1 if it was found, 0 if not, -1 if the journal could not be started.
+// The older store must stay readable until the journal header is written,
+// so the journal is started in the sector that does not hold the newest
+// structure. A structure straddling both sectors is first copied behind
+// itself to FLASH_JOURNAL_LEGACY_COPY, so that sector 1 holds all of it.
+static int flash_journal_convert_legacy(FLASH_VARS_STRUCTURE* data) {
+	unsigned char copy[sizeof(FLASH_VARS_STRUCTURE)];
+	int offset, len;
+
+	offset = flash_journal_read_legacy(data, &len);
+	if (offset < 0) {
+		return 0;
+	}
+	if (offset + len <= FLASH_JOURNAL_SECTOR_LEN) {
+		return flash_journal_start(1, data) < 0 ? -1 : 1;
+	}
+	if (offset < FLASH_JOURNAL_SECTOR_LEN) {
+		flash_vars_raw_read(offset, copy, len);
+		if (flash_vars_raw_write(FLASH_JOURNAL_LEGACY_COPY, copy, len) < 0) {
+			return -1;
+		}
+	}
+	return flash_journal_start(0, data) < 0 ? -1 : 1;
+}
+
+static int flash_journal_append(int type, const void* payload, int len, const FLASH_VARS_STRUCTURE* data) {
+	int size;
+
+	size = sizeof(flashJournalRecord_t) + FLASH_JOURNAL_ALIGN(len);
+	if (flash_journal.sector < 0 || flash_journal.offset + size > FLASH_JOURNAL_SECTOR_LEN) {
+		return flash_journal_rotate(data);
+	}
+	size = flash_journal_write_record(flash_journal.sector * FLASH_JOURNAL_SECTOR_LEN + flash_journal.offset,
+		type, payload, len);
+	if (size < 0) {
+		// nothing can follow a damaged record, so the next write rotates
+		flash_journal.offset = FLASH_JOURNAL_SECTOR_LEN;
+		return -1;
+	}
+	flash_journal.offset += size;
+	flash_journal.energy = data->emetering;
+	return 0;
+}
+
+// stores the whole structure
+static int flash_journal_write_vars(const FLASH_VARS_STRUCTURE* data) {
+	return flash_journal_append(FLASH_JOURNAL_VARS, data, sizeof(*data), data);
+}
+
+// Stores data with new energy metering values. If only the counters have
+// moved on since the last commit, only their deltas are stored, and the
+// counters in data are set to exactly what a replay will give.
+static int flash_journal_write_energy(FLASH_VARS_STRUCTURE* data) {
+	ENERGY_METERING_DATA* last = &flash_journal.energy;
+	ENERGY_METERING_DATA* em = &data->emetering;
+	flashJournalEnergy_t delta;
+
+	if (flash_journal.sector < 0
+		|| em->save_counter != last->save_counter + 1
+		|| em->YesterdayConsumption != last->YesterdayConsumption
+		|| memcmp(em->ConsumptionHistory, last->ConsumptionHistory, sizeof(em->ConsumptionHistory))
+		|| em->ConsumptionResetTime != last->ConsumptionResetTime
+		|| em->actual_mday != last->actual_mday) {
+		return flash_journal_write_vars(data);
+	}
+	delta.total = em->TotalConsumption - last->TotalConsumption;
+	delta.today = em->TodayConsumpion - last->TodayConsumpion;
+	em->TotalConsumption = last->TotalConsumption + delta.total;
+	em->TodayConsumpion = last->TodayConsumpion + delta.today;
+	return flash_journal_append(FLASH_JOURNAL_ENERGY, &delta, sizeof(delta), data);
+}
+
+#endif /* __HAL_FLASH_VARS_JOURNAL_H__ */
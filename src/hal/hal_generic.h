@@ -1,2 +1,7 @@
 
 void HAL_RebootModule();
+// free running microsecond counter for profiling, wraps around.
+// On platforms without a finer timer it only advances once per RTOS tick.
+unsigned int HAL_GetTimeUs();
+// smallest step of HAL_GetTimeUs in microseconds, 1 if it is a real us timer
+unsigned int HAL_GetTimeUsResolution();
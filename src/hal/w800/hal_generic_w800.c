@@ -1,9 +1,18 @@
 #if defined(PLATFORM_W800) || defined(PLATFORM_W600) 
 
+#include "../../new_common.h"
 #include "wm_include.h"
 
 void HAL_RebootModule() {
     tls_sys_reset();
 }
 
+unsigned int HAL_GetTimeUs() {
+    return xTaskGetTickCount() * (1000000 / configTICK_RATE_HZ);
+}
+
+unsigned int HAL_GetTimeUsResolution() {
+    return 1000000 / configTICK_RATE_HZ;
+}
+
 #endif
@@ -6,6 +6,9 @@
 // TODO
 #define MY_ADDR_OF_BK_PARTITION_NET_PARAM 0x1e1000
 
+extern UINT32 flash_read(char *user_buf, UINT32 count, UINT32 address);
+extern UINT32 flash_write(char *user_buf, UINT32 count, UINT32 address);
+
 int HAL_Configuration_ReadConfigMemory(void *target, int dataLen){
 	//FILE *f;
 
@@ -1,9 +1,139 @@
+
 #ifdef WINDOWS
 
+#include <stddef.h>
 #include "../hal_flashConfig.h"
 #include "../hal_flashVars.h"
 #include "../../logging/logging.h"
 
+// Energy metering data is kept in a simulated sector pair with the same
+// journal as on Beken, so it survives SIM_FlashVars_Reload and simulated
+// power losses. Boot counters and channels are not kept, so selftests
+// never end up in safe mode.
+#define FLASH_JOURNAL_SECTOR_LEN 0x1000
+
+static unsigned char sim_flashVars[2 * FLASH_JOURNAL_SECTOR_LEN];
+static bool sim_flashVars_erased = false;
+// bytes that can still be written before the simulated power loss, -1 for no limit
+static int sim_flashVars_powerLossAfter = -1;
+static int sim_flashVars_eraseCount = 0;
+static FLASH_VARS_STRUCTURE flash_vars;
+static int flash_vars_initialised = 0;
+
+// the power is lost after a part of the data got written
+static int sim_flashVars_use(int size) {
+	if (sim_flashVars_powerLossAfter < 0) {
+		return size;
+	}
+	if (size > sim_flashVars_powerLossAfter) {
+		size = sim_flashVars_powerLossAfter;
+	}
+	sim_flashVars_powerLossAfter -= size;
+	return size;
+}
+
+static int flash_vars_raw_read(unsigned int off_set, void* data, unsigned int size) {
+	if (off_set + size > sizeof(sim_flashVars)) {
+		return -1;
+	}
+	memcpy(data, sim_flashVars + off_set, size);
+	return 0;
+}
+
+static int flash_vars_raw_write(unsigned int off_set, const void* data, unsigned int size) {
+	const unsigned char* p = (const unsigned char*)data;
+	int allowed;
+	int i;
+
+	if (off_set + size > sizeof(sim_flashVars)) {
+		return -1;
+	}
+	allowed = sim_flashVars_use(size);
+	// like on NOR flash, writing can only clear bits
+	for (i = 0; i < allowed; i++) {
+		sim_flashVars[off_set + i] &= p[i];
+	}
+	return allowed == size ? 0 : -1;
+}
+
+static int flash_vars_raw_erase(int sector) {
+	int allowed;
+
+	sim_flashVars_eraseCount++;
+	allowed = sim_flashVars_use(FLASH_JOURNAL_SECTOR_LEN);
+	memset(sim_flashVars + sector * FLASH_JOURNAL_SECTOR_LEN, 0xFF, allowed);
+	return allowed == FLASH_JOURNAL_SECTOR_LEN ? 0 : -1;
+}
+
+#include "../hal_flashVars_journal.h"
+
+static void flash_vars_init() {
+	if (flash_vars_initialised) {
+		return;
+	}
+	if (sim_flashVars_erased == false) {
+		memset(sim_flashVars, 0xFF, sizeof(sim_flashVars));
+		sim_flashVars_erased = true;
+	}
+	flash_journal.sequence = 0;
+	if (flash_journal_open(&flash_vars) == 0 && flash_journal_convert_legacy(&flash_vars) == 0) {
+		memset(&flash_vars, 0, sizeof(flash_vars));
+		flash_vars.len = sizeof(flash_vars);
+		flash_vars.emetering.actual_mday = -1;
+		flash_journal_rotate(&flash_vars);
+	}
+	flash_vars_initialised = 1;
+}
+
+void SIM_FlashVars_Clear() {
+	memset(sim_flashVars, 0xFF, sizeof(sim_flashVars));
+	sim_flashVars_erased = true;
+	sim_flashVars_powerLossAfter = -1;
+	sim_flashVars_eraseCount = 0;
+	memset(&flash_journal, 0, sizeof(flash_journal));
+	flash_journal.sector = -1;
+	flash_vars_initialised = 0;
+}
+// lays out the single log of older versions with the given number of
+// structures, each one counting one more kWh than the one before
+void SIM_FlashVars_WriteLegacy(int count) {
+	FLASH_VARS_STRUCTURE tmp;
+	unsigned int magic = FLASH_VARS_MAGIC;
+	int size = SIM_FlashVars_GetLegacySize();
+	int i;
+
+	SIM_FlashVars_Clear();
+	memcpy(sim_flashVars, &magic, sizeof(magic));
+	for (i = 0; i < count && sizeof(magic) + (i + 1) * size <= sizeof(sim_flashVars); i++) {
+		memset(&tmp, 0, sizeof(tmp));
+		tmp.boot_count = i + 1;
+		tmp.emetering.TotalConsumption = i + 1;
+		tmp.emetering.save_counter = i + 1;
+		tmp.emetering.actual_mday = -1;
+		tmp.len = size;
+		memcpy(sim_flashVars + sizeof(magic) + i * size, &tmp, size);
+	}
+}
+// on Beken len is the last byte of the structure, here it may be followed by padding
+int SIM_FlashVars_GetLegacySize() {
+	return offsetof(FLASH_VARS_STRUCTURE, len) + 1;
+}
+// restores the power and forgets everything not stored, like a reboot would
+void SIM_FlashVars_Reload() {
+	sim_flashVars_powerLossAfter = -1;
+	flash_vars_initialised = 0;
+	flash_vars_init();
+}
+void SIM_FlashVars_SetPowerLossAfter(int bytes) {
+	sim_flashVars_powerLossAfter = bytes;
+}
+int SIM_FlashVars_GetEraseCount() {
+	return sim_flashVars_eraseCount;
+}
+int SIM_FlashVars_GetJournalOffset() {
+	return flash_journal.offset;
+}
+
 void HAL_FlashVars_SaveBootComplete(){
 }
 
@@ -32,22 +162,28 @@ void HAL_FlashVars_ReadLED(byte *mode, short *brightness, short *temperature, by
 
 int HAL_GetEnergyMeterStatus(ENERGY_METERING_DATA *data)
 {
-    /* default values */
-    if (data != NULL)
-    {
-        memset(data, 0, sizeof(ENERGY_METERING_DATA));
-        data->actual_mday = -1;
-    }
-    return 0;
+	flash_vars_init();
+	if (data != NULL)
+	{
+		memcpy(data, &flash_vars.emetering, sizeof(ENERGY_METERING_DATA));
+	}
+	return 0;
 }
 
 int HAL_SetEnergyMeterStatus(ENERGY_METERING_DATA *data)
 {
-    return 0;
+	if (data != NULL)
+	{
+		flash_vars_init();
+		memcpy(&flash_vars.emetering, data, sizeof(ENERGY_METERING_DATA));
+		flash_journal_write_energy(&flash_vars);
+	}
+	return 0;
 }
 
 void HAL_FlashVars_SaveTotalConsumption(float total_consumption)
 {
+	flash_vars.emetering.TotalConsumption = total_consumption;
 }
 
 #endif // WINDOWS
@@ -1,9 +1,32 @@
 #ifdef WINDOWS
 
+#include "../../new_common.h"
 
 void HAL_RebootModule() {
 
 
 }
 
+unsigned int HAL_GetTimeUs() {
+#if LINUX
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned int)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#else
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	if (freq.QuadPart == 0) {
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&now);
+	return (unsigned int)(now.QuadPart * 1000000 / freq.QuadPart);
+#endif
+}
+
+unsigned int HAL_GetTimeUsResolution() {
+	return 1;
+}
+
 #endif // WINDOWS
\ No newline at end of file
@@ -1,5 +1,7 @@
 #ifdef PLATFORM_XR809
 
+#include "../../new_common.h"
+
 void HAL_WDG_Reboot();
 
 void HAL_RebootModule() {
@@ -8,4 +10,15 @@ void HAL_RebootModule() {
 	HAL_WDG_Reboot();
 }
 
+unsigned int HAL_GetTimeUs() {
+	return OS_TicksToMSecs(OS_GetTicks()) * 1000;
+}
+
+unsigned int HAL_GetTimeUsResolution() {
+	unsigned int tickMs = OS_TicksToMSecs(1);
+
+	// the tick is converted to whole milliseconds
+	return (tickMs > 1 ? tickMs : 1) * 1000;
+}
+
 #endif // PLATFORM_XR809
\ No newline at end of file
@@ -1,14 +1,12 @@
-
 #include "../new_common.h"
 #include "lwip/sockets.h"
 #include "lwip/ip_addr.h"
 #include "lwip/inet.h"
 #include "../logging/logging.h"
 #include "new_http.h"
+#include "http_tcp_server.h"
 
 #define HTTP_SERVER_PORT            80
-#define REPLY_BUFFER_SIZE			2048
-#define INCOMING_BUFFER_SIZE		1024
 
 
 // it was 0x800 - 2048 - until 23 10 2022
@@ -22,19 +20,37 @@
 #define HTTP_CLIENT_STACK_SIZE 2048
 #endif
 
-#define CREATE_THREAD_PER_EACH_HTTP_CLIENT
-
-#ifdef CREATE_THREAD_PER_EACH_HTTP_CLIENT
-
-
+// Accepted connections are queued for a fixed pool of worker threads,
+// each with its own buffers, instead of a new thread per client.
+// When the queue is full the server thread waits, so new clients wait
+// in the listen backlog, and workers stop keeping idle connections
+// open while other clients are queued.
+#ifndef HTTP_WORKER_COUNT
 #if PLATFORM_XR809
+// right now, I am getting OS_ThreadCreate everytime on XR809 platform,
+// so clients are served by the server thread (blocking all other clients)
+#define HTTP_WORKER_COUNT 0
+#else
+#define HTTP_WORKER_COUNT 2
+#endif
+#endif
+#define HTTP_ACCEPT_QUEUE_LENGTH	4
 
-#define DISABLE_SEPARATE_THREAD_FOR_EACH_TCP_CLIENT 1
+// how long a connection may stay idle waiting for the next request
+#define HTTP_IDLE_TIMEOUT_MS		5000
+// idle connections check for queued clients this often
+#define HTTP_IDLE_SLICE_MS			100
+// requests served on a single connection before it is closed
+#define HTTP_KEEPALIVE_MAX_REQUESTS	100
 
-#endif
+static xQueueHandle g_http_acceptQueue = NULL;
+
+// the simulator has its own server in http_tcp_server_nonblocking.c,
+// selftests only use the request handling below
+#if !WINDOWS
 
 static void tcp_server_thread(beken_thread_arg_t arg);
-static void tcp_client_thread(beken_thread_arg_t arg);
+static void tcp_worker_thread(beken_thread_arg_t arg);
 
 
 xTaskHandle g_http_thread = NULL;
@@ -42,6 +58,25 @@ xTaskHandle g_http_thread = NULL;
 void HTTPServer_Start()
 {
 	OSStatus err = kNoErr;
+	int i;
+
+#if HTTP_WORKER_COUNT > 0
+	g_http_acceptQueue = xQueueCreate(HTTP_ACCEPT_QUEUE_LENGTH, sizeof(int));
+	if (g_http_acceptQueue == NULL) {
+		ADDLOG_ERROR(LOG_FEATURE_HTTP, "HTTP accept queue creation failed, serving clients in server thread");
+	}
+	for (i = 0; g_http_acceptQueue && i < HTTP_WORKER_COUNT; i++) {
+		err = rtos_create_thread(NULL, BEKEN_APPLICATION_PRIORITY,
+			"HTTP Worker",
+			(beken_thread_function_t)tcp_worker_thread,
+			HTTP_CLIENT_STACK_SIZE,
+			(beken_thread_arg_t)i);
+		if (err != kNoErr)
+		{
+			ADDLOG_ERROR(LOG_FEATURE_HTTP, "create \"HTTP Worker\" thread failed with %i!\r\n", err);
+		}
+	}
+#endif
 
 	err = rtos_create_thread(&g_http_thread, BEKEN_APPLICATION_PRIORITY,
 		"TCP_server",
@@ -54,219 +89,201 @@ void HTTPServer_Start()
 	}
 }
 
+#else
 
-int sendfn(int fd, char* data, int len) {
-	if (fd) {
-		return send(fd, data, len, 0);
+xQueueHandle HTTP_GetAcceptQueue() {
+	if (g_http_acceptQueue == NULL) {
+		g_http_acceptQueue = xQueueCreate(HTTP_ACCEPT_QUEUE_LENGTH, sizeof(int));
 	}
-	return -1;
+	return g_http_acceptQueue;
 }
 
-static void tcp_client_thread(beken_thread_arg_t arg)
-{
-	OSStatus err = kNoErr;
-	int fd = (int)arg;
-	//fd_set readfds, errfds, readfds2;
-	char* buf = NULL;
-	char* reply = NULL;
-	int replyBufferSize = REPLY_BUFFER_SIZE;
-	//int res;
-	//char reply[8192];
-
-  //my_fd = fd;
-	rtos_delay_milliseconds(20);
-
-	reply = (char*)os_malloc(replyBufferSize);
-	buf = (char*)os_malloc(INCOMING_BUFFER_SIZE);
-
-	if (buf == 0 || reply == 0)
-	{
-		ADDLOG_ERROR(LOG_FEATURE_HTTP, "TCP Client failed to malloc buffer");
-		goto exit;
-	}
-	http_request_t request;
-	os_memset(&request, 0, sizeof(request));
-
-	request.fd = fd;
-	request.received = buf;
-	request.receivedLenmax = INCOMING_BUFFER_SIZE - 2;
-	request.responseCode = HTTP_RESPONSE_OK;
-	request.receivedLen = recv(fd, request.received, request.receivedLenmax, 0);
-	request.received[request.receivedLen] = 0;
-
-	request.reply = reply;
-	request.replylen = 0;
-	reply[0] = '\0';
-
-	request.replymaxlen = replyBufferSize - 1;
+#endif
 
-	if (request.receivedLen <= 0)
-	{
-		ADDLOG_ERROR(LOG_FEATURE_HTTP, "TCP Client is disconnected, fd: %d", fd);
-		goto exit;
-	}
 
-	//addLog( "TCP received string %s\n",buf );
-	// returns length to be sent if any
-	 // ADDLOG_DEBUG(LOG_FEATURE_HTTP,  "TCP will process packet of len %i\n", request.receivedLen );
-	int lenret = HTTP_ProcessPacket(&request);
-	if (lenret > 0) {
-		ADDLOG_DEBUG(LOG_FEATURE_HTTP, "TCP sending reply len %i\n", lenret);
-		send(fd, reply, lenret, 0);
+int sendfn(int fd, char* data, int len) {
+	if (fd) {
+		return send(fd, data, len, 0);
 	}
-
-	//rtos_delay_milliseconds(10);
-
-exit:
-	if (err != kNoErr)
-		ADDLOG_ERROR(LOG_FEATURE_HTTP, "TCP client thread exit with err: %d", err);
-
-	if (buf != NULL)
-		os_free(buf);
-	if (reply != NULL)
-		os_free(reply);
-
-	lwip_close(fd);;
-#if DISABLE_SEPARATE_THREAD_FOR_EACH_TCP_CLIENT
-
-#else
-	rtos_delete_thread(NULL);
-#endif
+	return -1;
 }
 
-/* TCP server listener thread */
-static void tcp_server_thread(beken_thread_arg_t arg)
-{
-	(void)(arg);
-	OSStatus err = kNoErr;
-	struct sockaddr_in server_addr, client_addr;
-	socklen_t sockaddr_t_size = sizeof(client_addr);
-	char client_ip_str[16];
-	int tcp_listen_fd = -1, client_fd = -1;
+// Waits in short slices, so that with bYield an idle connection is given
+// up as soon as another client is queued for the workers.
+static bool HTTP_WaitReadable(int fd, int timeoutMs, bool bYield) {
 	fd_set readfds;
+	struct timeval tv;
+	int slice;
+	int res;
 
-	tcp_listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-
-	server_addr.sin_family = AF_INET;
-	server_addr.sin_addr.s_addr = INADDR_ANY;/* Accept conenction request on all network interface */
-	server_addr.sin_port = htons(HTTP_SERVER_PORT);/* Server listen on port: 20000 */
-	err = bind(tcp_listen_fd, (struct sockaddr*)&server_addr, sizeof(server_addr));
-
-	err = listen(tcp_listen_fd, 0);
-
-	while (1)
-	{
+	while (timeoutMs > 0) {
+		if (bYield && g_http_acceptQueue && uxQueueMessagesWaiting(g_http_acceptQueue) > 0) {
+			return false;
+		}
+		slice = timeoutMs < HTTP_IDLE_SLICE_MS ? timeoutMs : HTTP_IDLE_SLICE_MS;
 		FD_ZERO(&readfds);
-		FD_SET(tcp_listen_fd, &readfds);
-
-		select(tcp_listen_fd + 1, &readfds, NULL, NULL, NULL);
-
-		if (FD_ISSET(tcp_listen_fd, &readfds))
-		{
-			client_fd = accept(tcp_listen_fd, (struct sockaddr*)&client_addr, &sockaddr_t_size);
-			if (client_fd >= 0)
-			{
-#if PLATFORM_XR809
-#if DISABLE_SEPARATE_THREAD_FOR_EACH_TCP_CLIENT
-
-#else
-				OS_Thread_t clientThreadUnused;
-#endif
-#endif
-				os_strcpy(client_ip_str, inet_ntoa(client_addr.sin_addr));
-				//  ADDLOG_DEBUG(LOG_FEATURE_HTTP,  "TCP Client %s:%d connected, fd: %d", client_ip_str, client_addr.sin_port, client_fd );
-#if DISABLE_SEPARATE_THREAD_FOR_EACH_TCP_CLIENT
-				// Use main server thread (blocking all other clients)
-				// right now, I am getting OS_ThreadCreate everytime on XR809 platform
-				tcp_client_thread((beken_thread_arg_t)client_fd);
-#else
-				// delay each accept by 20ms
-				// this allows previous to finish if
-				// in a loop of sends from the browser, e.g. OTA
-				// and we MUST get some IDLE thread time, else
-				// thread resources are not deleted.
-				rtos_delay_milliseconds(20);
-				// Create separate thread for client
-				if (kNoErr !=
-#if PLATFORM_XR809
-					OS_ThreadCreate(&clientThreadUnused,
-						"HTTP Client",
-						tcp_client_thread,
-						client_fd,
-						OS_THREAD_PRIO_CONSOLE,
-						0x400)
-
-#else
-					rtos_create_thread(NULL, BEKEN_APPLICATION_PRIORITY,
-						"HTTP Client",
-						(beken_thread_function_t)tcp_client_thread,
-						HTTP_CLIENT_STACK_SIZE,
-						(beken_thread_arg_t)client_fd)
-
-#endif
-					)
-				{
-					ADDLOG_DEBUG(LOG_FEATURE_HTTP, "TCP Client %s:%d thread creation failed! fd: %d", client_ip_str, client_addr.sin_port, client_fd);
-					lwip_close(client_fd);
-					client_fd = -1;
-				}
-#endif
-			}
+		FD_SET(fd, &readfds);
+		tv.tv_sec = slice / 1000;
+		tv.tv_usec = (slice % 1000) * 1000;
+		res = select(fd + 1, &readfds, NULL, NULL, &tv);
+		if (res != 0) {
+			return res > 0;
 		}
+		timeoutMs -= slice;
 	}
+	return false;
+}
 
-	if (err != kNoErr)
-		ADDLOG_ERROR(LOG_FEATURE_HTTP, "Server listerner thread exit with err: %d", err);
-
-	lwip_close(tcp_listen_fd);
-
-	rtos_delete_thread(NULL);
+// returns the offset of the body, or -1 if headers are not complete yet
+static int HTTP_FindBody(const char* buf, int len) {
+	int i;
 
+	for (i = 0; i + 4 <= len; i++) {
+		if (buf[i] == '\r' && !memcmp(buf + i, "\r\n\r\n", 4)) {
+			return i + 4;
+		}
+	}
+	return -1;
 }
 
-#else
-
+static int HTTP_GetContentLength(const char* buf, int headersLen) {
+	const char* p = buf;
+	const char* end = buf + headersLen;
+	int len;
 
-xTaskHandle g_http_thread = NULL;
+	while (p < end) {
+		if (!my_strnicmp(p, "Content-Length:", 15)) {
+			len = atoi(p + 15);
+			return len > 0 ? len : 0;
+		}
+		while (p < end && *p != '\n') {
+			p++;
+		}
+		p++;
+	}
+	return 0;
+}
 
-int sendfn(int fd, char* data, int len) {
-	if (fd) {
-		return send(fd, data, len, 0);
+// Receives until buf holds the whole request (headers, and the body if
+// Content-Length is given) or is full. Bytes left from an earlier recv
+// are used first. Returns the request length, or 0 if the client has
+// closed the connection or stayed idle. A kept-alive connection (bIdle)
+// that has not started its next request is also given up for queued clients.
+int HTTP_ReceiveRequest(int fd, char* buf, int* have, bool* bComplete, bool bIdle) {
+	int maxLen = INCOMING_BUFFER_SIZE - 2;
+	int body;
+	int contentLength;
+	int len;
+
+	while (1) {
+		body = HTTP_FindBody(buf, *have);
+		if (body >= 0) {
+			contentLength = HTTP_GetContentLength(buf, body);
+			if (*have - body >= contentLength) {
+				*bComplete = true;
+				return body + contentLength;
+			}
+		}
+		if (*have >= maxLen) {
+			// handlers like OTA read the rest of the body from the socket
+			*bComplete = false;
+			return *have;
+		}
+		if (HTTP_WaitReadable(fd, HTTP_IDLE_TIMEOUT_MS, bIdle && *have == 0) == false) {
+			return 0;
+		}
+		len = recv(fd, buf + *have, maxLen - *have, 0);
+		if (len <= 0) {
+			return 0;
+		}
+		*have += len;
 	}
-	return -1;
 }
 
-static void tcp_client_thread(int fd, char* buf, char* reply)
+// serves requests on a client connection until it is closed
+void HTTP_ServeClient(int fd, char* buf, char* reply, bool bAllowKeepAlive)
 {
-	//OSStatus err = kNoErr;
-
 	http_request_t request;
-	os_memset(&request, 0, sizeof(request));
+	int have = 0;
+	int requestLen;
+	int served = 0;
+	bool bComplete;
+	bool bKeepOpen;
+	char next;
+
+	do {
+		requestLen = HTTP_ReceiveRequest(fd, buf, &have, &bComplete, served > 0);
+		if (requestLen <= 0)
+		{
+			if (served == 0) {
+				ADDLOG_ERROR(LOG_FEATURE_HTTP, "TCP Client is disconnected, fd: %d", fd);
+			}
+			break;
+		}
+		os_memset(&request, 0, sizeof(request));
+
+		request.fd = fd;
+		request.received = buf;
+		request.receivedLenmax = INCOMING_BUFFER_SIZE - 2;
+		request.responseCode = HTTP_RESPONSE_OK;
+		request.receivedLen = requestLen;
+		// a pipelined request may follow, keep its first byte
+		next = buf[requestLen];
+		request.received[request.receivedLen] = 0;
+
+		request.reply = reply;
+		request.replylen = 0;
+		reply[0] = '\0';
+
+		request.replymaxlen = REPLY_BUFFER_SIZE - 1;
+		request.keepAlive = bAllowKeepAlive && bComplete && (served + 1 < HTTP_KEEPALIVE_MAX_REQUESTS);
+
+		// ADDLOG_DEBUG(LOG_FEATURE_HTTP,  "TCP will process packet of len %i\n", request.receivedLen );
+		HTTP_ProcessPacket(&request);
+		bKeepOpen = HTTP_FinishReply(&request);
+		served++;
+		ADDLOG_DEBUG(LOG_FEATURE_HTTP, "TCP sent reply len %i, keep-alive %i\n", request.replySent, bKeepOpen);
+
+		buf[requestLen] = next;
+		have -= requestLen;
+		memmove(buf, buf + requestLen, have);
+
+		// let the queued clients have this worker
+		if (g_http_acceptQueue && uxQueueMessagesWaiting(g_http_acceptQueue) > 0) {
+			bKeepOpen = false;
+		}
+	} while (bKeepOpen);
 
-	request.fd = fd;
-	request.received = buf;
-	request.receivedLenmax = INCOMING_BUFFER_SIZE - 1;
-	request.responseCode = HTTP_RESPONSE_OK;
-	request.receivedLen = recv(fd, request.received, request.receivedLenmax, 0);
-	request.received[request.receivedLen] = 0;
+	lwip_close(fd);
+}
 
-	request.reply = reply;
-	request.replylen = 0;
-	reply[0] = '\0';
+#if !WINDOWS
 
-	request.replymaxlen = REPLY_BUFFER_SIZE - 1;
+static void tcp_worker_thread(beken_thread_arg_t arg)
+{
+	char* buf;
+	char* reply;
+	int fd;
 
-	if (request.receivedLen <= 0)
+	reply = (char*)os_malloc(REPLY_BUFFER_SIZE);
+	buf = (char*)os_malloc(INCOMING_BUFFER_SIZE);
+	if (buf == 0 || reply == 0)
 	{
-		ADDLOG_ERROR(LOG_FEATURE_HTTP, "TCP Client is disconnected, fd: %d", fd);
+		ADDLOG_ERROR(LOG_FEATURE_HTTP, "HTTP Worker %i failed to malloc buffer", (int)arg);
+		if (buf != NULL)
+			os_free(buf);
+		if (reply != NULL)
+			os_free(reply);
+		rtos_delete_thread(NULL);
 		return;
 	}
-	int lenret = HTTP_ProcessPacket(&request);
-	if (lenret > 0) {
-		send(fd, reply, lenret, 0);
-	}
-	rtos_delay_milliseconds(10);
 
+	while (1)
+	{
+		if (xQueueReceive(g_http_acceptQueue, &fd, portMAX_DELAY) == pdTRUE) {
+			HTTP_ServeClient(fd, buf, reply, true);
+		}
+	}
 }
 
 /* TCP server listener thread */
@@ -276,7 +293,6 @@ static void tcp_server_thread(beken_thread_arg_t arg)
 	OSStatus err = kNoErr;
 	struct sockaddr_in server_addr, client_addr;
 	socklen_t sockaddr_t_size = sizeof(client_addr);
-	char client_ip_str[16];
 	int tcp_listen_fd = -1, client_fd = -1;
 	fd_set readfds;
 	char* buf = NULL;
@@ -289,10 +305,17 @@ static void tcp_server_thread(beken_thread_arg_t arg)
 	server_addr.sin_port = htons(HTTP_SERVER_PORT);/* Server listen on port: 20000 */
 	err = bind(tcp_listen_fd, (struct sockaddr*)&server_addr, sizeof(server_addr));
 
-	err = listen(tcp_listen_fd, 0);
+	err = listen(tcp_listen_fd, HTTP_ACCEPT_QUEUE_LENGTH);
 
-	reply = (char*)os_malloc(REPLY_BUFFER_SIZE);
-	buf = (char*)os_malloc(INCOMING_BUFFER_SIZE);
+	if (g_http_acceptQueue == NULL) {
+		reply = (char*)os_malloc(REPLY_BUFFER_SIZE);
+		buf = (char*)os_malloc(INCOMING_BUFFER_SIZE);
+		if (buf == 0 || reply == 0)
+		{
+			ADDLOG_ERROR(LOG_FEATURE_HTTP, "TCP server failed to malloc buffer");
+			goto exit;
+		}
+	}
 
 	while (1)
 	{
@@ -306,40 +329,31 @@ static void tcp_server_thread(beken_thread_arg_t arg)
 			client_fd = accept(tcp_listen_fd, (struct sockaddr*)&client_addr, &sockaddr_t_size);
 			if (client_fd >= 0)
 			{
-				os_strcpy(client_ip_str, inet_ntoa(client_addr.sin_addr));
-				//  ADDLOG_DEBUG(LOG_FEATURE_HTTP,  "TCP Client %s:%d connected, fd: %d", client_ip_str, client_addr.sin_port, client_fd );
-
-				tcp_client_thread(client_fd, reply, buf);
-
-				lwip_close(client_fd);
+				//  ADDLOG_DEBUG(LOG_FEATURE_HTTP,  "TCP Client %s:%d connected, fd: %d", inet_ntoa(client_addr.sin_addr), client_addr.sin_port, client_fd );
+				if (g_http_acceptQueue == NULL) {
+					HTTP_ServeClient(client_fd, buf, reply, false);
+				}
+				else {
+					// blocks while all workers are busy and the queue is full
+					xQueueSend(g_http_acceptQueue, &client_fd, portMAX_DELAY);
+				}
 			}
 		}
 	}
 
+exit:
 	if (err != kNoErr)
 		ADDLOG_ERROR(LOG_FEATURE_HTTP, "Server listerner thread exit with err: %d", err);
 
+	if (buf != NULL)
+		os_free(buf);
+	if (reply != NULL)
+		os_free(reply);
+
 	lwip_close(tcp_listen_fd);
 
 	rtos_delete_thread(NULL);
 
 }
 
-void HTTPServer_Start()
-{
-	OSStatus err = kNoErr;
-
-	err = rtos_create_thread(&g_http_thread, BEKEN_APPLICATION_PRIORITY,
-		"TCP_server",
-		(beken_thread_function_t)tcp_server_thread,
-		0x800,
-		(beken_thread_arg_t)0);
-	if (err != kNoErr)
-	{
-		ADDLOG_ERROR(LOG_FEATURE_HTTP, "create \"TCP_server\" thread failed with %i!\r\n", err);
-	}
-}
-
-
 #endif
-
@@ -1,2 +1,17 @@
+#ifndef __HTTP_TCP_SERVER_H__
+#define __HTTP_TCP_SERVER_H__
 
 void HTTPServer_Start();
+
+#define REPLY_BUFFER_SIZE			2048
+#define INCOMING_BUFFER_SIZE		1024
+
+#if WINDOWS
+// request handling of the firmware server, used by selftests on socket pairs
+xQueueHandle HTTP_GetAcceptQueue();
+int HTTP_ReceiveRequest(int fd, char* buf, int* have, bool* bComplete, bool bIdle);
+// buf holds INCOMING_BUFFER_SIZE and reply REPLY_BUFFER_SIZE bytes
+void HTTP_ServeClient(int fd, char* buf, char* reply, bool bAllowKeepAlive);
+#endif
+
+#endif
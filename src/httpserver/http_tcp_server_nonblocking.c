@@ -6,7 +6,9 @@
 #include "lwip/inet.h"
 #include "../logging/logging.h"
 #include "new_http.h"
+#if !LINUX
 #include <timeapi.h>
+#endif
 
  SOCKET ListenSocket = INVALID_SOCKET;
 
@@ -42,7 +44,7 @@ int HTTPServer_Start() {
     // Create a SOCKET for connecting to server
     ListenSocket = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
     if (ListenSocket == INVALID_SOCKET) {
-        printf("socket failed with error: %ld\n", WSAGetLastError());
+        printf("socket failed with error: %d\n", WSAGetLastError());
         freeaddrinfo(result);
         WSACleanup();
         return 1;
@@ -76,6 +78,7 @@ int HTTPServer_Start() {
         printf("ioctlsocket() error %d\n", WSAGetLastError());
         return 1;
     }
+    return 0;
 }
 #define DEFAULT_BUFLEN 10000
 void HTTPServer_RunQuickTick() {
@@ -148,7 +151,7 @@ void HTTPServer_RunQuickTick() {
 					if (iSendResult == SOCKET_ERROR) {
 						printf("send failed with error: %d\n", WSAGetLastError());
 						closesocket(ClientSocket);
-						return 1;
+						return;
 					}
 					printf("HTTP Server for Windows: Bytes sent: %d\n", iSendResult);
 				}
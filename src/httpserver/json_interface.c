@@ -259,11 +259,21 @@ static int http_tasmota_json_ENERGY(void* request, jsonCb_t printer) {
 	}
 }
 */
+static int g_sht3xID = DRV_ID_NOT_FOUND_YET;
+static int g_cht8305ID = DRV_ID_NOT_FOUND_YET;
+static int g_sgpID = DRV_ID_NOT_FOUND_YET;
+#if defined(PLATFORM_BEKEN)
+static int g_batteryID = DRV_ID_NOT_FOUND_YET;
+#endif
+
 static int http_tasmota_json_SENSOR(void* request, jsonCb_t printer) {
 	float chan_val1, chan_val2;
 	int channel_1, channel_2, g_pin_1 = 0;
 	printer(request, ",");
-	if (DRV_IsRunning("SHT3X")) {
+	if (DRV_HasRunningDriverWithFlag(DRV_FLAG_SENSOR) == false) {
+		return 0;
+	}
+	if (DRV_IsRunningCached(&g_sht3xID, "SHT3X")) {
 		g_pin_1 = PIN_FindPinIndexForRole(IOR_SHT3X_DAT, g_pin_1);
 		channel_1 = g_cfg.pins.channels[g_pin_1];
 		channel_2 = g_cfg.pins.channels2[g_pin_1];
@@ -280,7 +290,7 @@ static int http_tasmota_json_SENSOR(void* request, jsonCb_t printer) {
 		// close ENERGY block
 		printer(request, "},");
 	}
-	if (DRV_IsRunning("CHT8305")) {
+	if (DRV_IsRunningCached(&g_cht8305ID, "CHT8305")) {
 		g_pin_1 = PIN_FindPinIndexForRole(IOR_CHT8305_DAT, g_pin_1);
 		channel_1 = g_cfg.pins.channels[g_pin_1];
 		channel_2 = g_cfg.pins.channels2[g_pin_1];
@@ -297,7 +307,7 @@ static int http_tasmota_json_SENSOR(void* request, jsonCb_t printer) {
 		// close ENERGY block
 		printer(request, "},");
 	}
-	if (DRV_IsRunning("SGP")) {
+	if (DRV_IsRunningCached(&g_sgpID, "SGP")) {
 		g_pin_1 = PIN_FindPinIndexForRole(IOR_SGP_DAT, g_pin_1);
 		channel_1 = g_cfg.pins.channels[g_pin_1];
 		channel_2 = g_cfg.pins.channels2[g_pin_1];
@@ -423,7 +433,7 @@ static int http_tasmota_json_status_STS(void* request, jsonCb_t printer, bool bA
 	JSON_PrintKeyValue_Int(request, printer, "LoadAvg", 99, true);
 	JSON_PrintKeyValue_Int(request, printer, "MqttCount", 23, true);
 #if defined(PLATFORM_BEKEN)
-	if (DRV_IsRunning("Battery")) {
+	if (DRV_IsRunningCached(&g_batteryID, "Battery")) {
 		printer(request, "\"Vcc\":%.4f,", Battery_lastreading(OBK_BATT_VOLTAGE) / 1000.00);
 	}
 #endif
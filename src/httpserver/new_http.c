@@ -73,50 +73,113 @@ const char* methodNames[] = {
 
 void misc_formatUpTimeString(int totalSeconds, char* o);
 
-typedef struct http_callback_tag {
-	char* url;
-	int method;
+// All pages are dispatched through a single table sorted by path and
+// method, so a request is routed with a binary search.
+// Paths are kept without the leading '/'. A path ending with '/' is
+// a prefix and matches everything below it, other paths match the
+// URL up to the query string.
+typedef struct http_route_tag {
+	const char* path;
 	http_callback_fn callback;
-} http_callback_t;
-
-#define MAX_HTTP_CALLBACKS 32
-static http_callback_t* callbacks[MAX_HTTP_CALLBACKS];
-static int numCallbacks = 0;
+	int method;
+} http_route_t;
 
-int HTTP_RegisterCallback(const char* url, int method, http_callback_fn callback) {
-	int i;
+#define MAX_HTTP_ROUTES 96
+static http_route_t routes[MAX_HTTP_ROUTES];
+static int numRoutes = 0;
+static bool bBuiltinRoutesAdded = false;
 
-	if (!url || !callback) {
-		return -1;
+static int http_compareRoute(const http_route_t* route, const char* path, int pathLen, int method) {
+	int res = strncmp(route->path, path, pathLen);
+	if (res == 0 && route->path[pathLen] != 0) {
+		res = 1;
 	}
-	if (numCallbacks >= MAX_HTTP_CALLBACKS) {
-		return -4;
+	if (res == 0) {
+		res = route->method - method;
 	}
-	for (i = 0; i < MAX_HTTP_CALLBACKS; i++) {
-		if (callbacks[i]) {
-			if (callbacks[i]->callback == callback && !strcmp(callbacks[i]->url, url)
-				&& callbacks[i]->method == method) {
-				return i;
-			}
+	return res;
+}
+
+// returns the index of the route, or -1 and where it would be inserted
+static int http_findRouteIndex(const char* path, int pathLen, int method, int* insertAt) {
+	int low = 0;
+	int high = numRoutes - 1;
+	int mid;
+	int res;
+
+	while (low <= high) {
+		mid = (low + high) / 2;
+		res = http_compareRoute(&routes[mid], path, pathLen, method);
+		if (res == 0) {
+			return mid;
+		}
+		if (res < 0) {
+			low = mid + 1;
+		}
+		else {
+			high = mid - 1;
 		}
 	}
-	callbacks[numCallbacks] = (http_callback_t*)os_malloc(sizeof(http_callback_t));
-	if (!callbacks[numCallbacks]) {
-		return -2;
+	if (insertAt) {
+		*insertAt = low;
+	}
+	return -1;
+}
+
+static int http_addRoute(const char* path, int method, http_callback_fn callback) {
+	int i;
+	int at;
+
+	i = http_findRouteIndex(path, strlen(path), method, &at);
+	if (i >= 0) {
+		// registering again replaces the callback
+		routes[i].callback = callback;
+		return i;
 	}
-	callbacks[numCallbacks]->url = (char*)os_malloc(strlen(url) + 1);
-	if (!callbacks[numCallbacks]->url) {
-		os_free(callbacks[numCallbacks]);
-		return -3;
+	if (numRoutes >= MAX_HTTP_ROUTES) {
+		ADDLOG_ERROR(LOG_FEATURE_HTTP, "Too many HTTP routes, /%s not added", path);
+		return -4;
 	}
-	strcpy(callbacks[numCallbacks]->url, url);
-	callbacks[numCallbacks]->callback = callback;
-	callbacks[numCallbacks]->method = method;
+	memmove(&routes[at + 1], &routes[at], (numRoutes - at) * sizeof(routes[0]));
+	routes[at].path = path;
+	routes[at].method = method;
+	routes[at].callback = callback;
+	numRoutes++;
+	return at;
+}
 
-	numCallbacks++;
+static int http_fn_routes(http_request_t* request);
+static int http_fn_httpstats(http_request_t* request);
+static void http_addBuiltinRoutes();
 
-	// success
-	return 0;
+int HTTP_RegisterCallback(const char* url, int method, http_callback_fn callback) {
+	if (!url || !callback || url[0] != '/') {
+		return -1;
+	}
+	http_addBuiltinRoutes();
+	return http_addRoute(url + 1, method, callback);
+}
+
+http_callback_fn HTTP_FindRoute(const char* url, int method) {
+	int len;
+	int i;
+
+	http_addBuiltinRoutes();
+	len = strcspn(url, "?");
+	i = http_findRouteIndex(url, len, method, 0);
+	if (i < 0) {
+		i = http_findRouteIndex(url, len, HTTP_ANY, 0);
+	}
+	// the longest prefix route wins
+	for (len--; i < 0 && len > 0; len--) {
+		if (url[len - 1] == '/') {
+			i = http_findRouteIndex(url, len, method, 0);
+			if (i < 0) {
+				i = http_findRouteIndex(url, len, HTTP_ANY, 0);
+			}
+		}
+	}
+	return i < 0 ? 0 : routes[i].callback;
 }
 
 int my_strnicmp(const char* a, const char* b, int len) {
@@ -239,6 +302,19 @@ void http_setup(http_request_t* request, const char* type) {
 	poststr(request, "\r\n");
 }
 
+// style and script are served gzipped from their own URLs, so browsers
+// can cache them, see the end of this file
+#define HTTP_ASSET_STYLE	0
+#define HTTP_ASSET_SCRIPT	1
+static unsigned int http_getAssetETag(int asset);
+static int http_fn_asset(http_request_t* request, int asset);
+static int http_fn_style(http_request_t* request) {
+	return http_fn_asset(request, HTTP_ASSET_STYLE);
+}
+static int http_fn_script(http_request_t* request) {
+	return http_fn_asset(request, HTTP_ASSET_SCRIPT);
+}
+
 void http_html_start(http_request_t* request, const char* pagename) {
 	poststr(request, htmlDoctype);
 	poststr(request, "<head><title>");
@@ -249,7 +325,7 @@ void http_html_start(http_request_t* request, const char* pagename) {
 	poststr(request, "</title>");
 	poststr(request, htmlShortcutIcon);
 	poststr(request, htmlHeadMeta);
-	poststr(request, htmlHeadStyle);
+	hprintf255(request, "<link rel='stylesheet' href='/style.css?v=%08x'>", http_getAssetETag(HTTP_ASSET_STYLE));
 	poststr(request, "</head>");
 	poststr(request, htmlBodyStart);
 	poststr(request, CFG_GetDeviceName());
@@ -275,7 +351,7 @@ void http_html_end(http_request_t* request) {
 	poststr(request, upTimeStr);
 
 	poststr(request, htmlBodyEnd);
-	poststr(request, pageScript);
+	hprintf255(request, "<script src='/script.js?v=%08x'></script>", http_getAssetETag(HTTP_ASSET_SCRIPT));
 }
 
 const char* http_checkArg(const char* p, const char* n) {
@@ -503,56 +579,183 @@ void setupAllWB2SPinsAsButtons() {
 	PIN_SetPinChannelForPinIndex(27, 1);
 }
 
+#if WINDOWS
+// selftests fake the client with fd == 0, this gets what would be sent
+static int (*g_simulatorSend)(const char* data, int len) = 0;
+void HTTP_SetSimulatorSendCallback(int (*cb)(const char* data, int len)) {
+	g_simulatorSend = cb;
+}
+#endif
+
+// Sends all of data, waiting only while the socket can not take more.
+// After an error, the rest of the reply is dropped.
+static void http_send(http_request_t* request, const char* data, int len) {
+	int sent;
+	int retries = 0;
+
+	while (len > 0 && request->sendFailed == 0) {
+		// fd will be NULL for unit tests where HTTP packet is faked locally
+		if (request->fd == 0) {
+#if WINDOWS
+			sent = g_simulatorSend ? g_simulatorSend(data, len) : len;
+#else
+			sent = len;
+#endif
+		}
+		else {
+			sent = send(request->fd, data, len, 0);
+		}
+		if (sent > 0) {
+			data += sent;
+			len -= sent;
+			request->replySent += sent;
+			retries = 0;
+		}
+		else if (sent < 0 && errno == EAGAIN && retries++ < 1000) {
+			rtos_delay_milliseconds(1);
+		}
+		else {
+			request->sendFailed = 1;
+		}
+	}
+}
+
+static void http_sendChunk(http_request_t* request, const char* data, int len) {
+	char chunkHeader[12];
+
+	if (len <= 0) {
+		return;
+	}
+	snprintf(chunkHeader, sizeof(chunkHeader), "%x\r\n", len);
+	http_send(request, chunkHeader, strlen(chunkHeader));
+	http_send(request, data, len);
+	http_send(request, "\r\n", 2);
+}
+
+// Finds our "Connection: close" header in a reply whose headers are
+// all still in the buffer. Returns the body offset, or -1.
+static int http_findCloseHeader(http_request_t* request, char** closeAt) {
+	static const char closeHeader[] = "Connection: close\r\n";
+	int closeLen = sizeof(closeHeader) - 1;
+	char* reply = request->reply;
+	int i;
+
+	*closeAt = 0;
+	for (i = 0; i + 4 <= request->replylen; i++) {
+		if (!memcmp(reply + i, "\r\n\r\n", 4)) {
+			return *closeAt ? i + 4 : -1;
+		}
+		if (*closeAt == 0 && i + closeLen <= request->replylen && !memcmp(reply + i, closeHeader, closeLen)) {
+			*closeAt = reply + i;
+		}
+	}
+	return -1;
+}
+
+// Replaces the "Connection: close" header with headers. Returns the new
+// body offset, or -1 if the reply can only be ended by closing.
+static int http_replaceCloseHeader(http_request_t* request, const char* headers) {
+	char* at;
+	int body = http_findCloseHeader(request, &at);
+	int closeLen = strlen("Connection: close\r\n");
+	int len = strlen(headers);
+
+	if (body < 0 || request->replylen + len - closeLen >= request->replymaxlen) {
+		return -1;
+	}
+	memmove(at + len, at + closeLen, request->replylen - (at + closeLen - request->reply));
+	memcpy(at, headers, len);
+	request->replylen += len - closeLen;
+	return body + len - closeLen;
+}
+
+// Called before the first bytes of a reply are sent. A keep-alive reply
+// that does not fit the buffer is sent in chunks, if it has our headers.
+static void http_startReply(http_request_t* request) {
+	static const char chunkedHeaders[] = "Connection: keep-alive\r\nTransfer-Encoding: chunked\r\n";
+	char* at;
+	char* rest;
+	int body;
+
+	if (request->keepAlive == 0) {
+		return;
+	}
+	body = http_findCloseHeader(request, &at);
+	// HTTP/1.0 clients do not know chunks, the body is ended by closing
+	if (body < 0 || request->version < 11) {
+		request->keepAlive = 0;
+		return;
+	}
+	request->chunked = 1;
+	// headers are sent around the replaced line, the buffer may be full
+	rest = at + strlen("Connection: close\r\n");
+	http_send(request, request->reply, at - request->reply);
+	http_send(request, chunkedHeaders, sizeof(chunkedHeaders) - 1);
+	http_send(request, rest, request->reply + body - rest);
+	request->replylen -= body;
+	memmove(request->reply, request->reply + body, request->replylen);
+}
+
+// sends what is in the reply buffer
+static void http_flushReply(http_request_t* request) {
+	if (request->replySent == 0) {
+		http_startReply(request);
+	}
+	if (request->chunked) {
+		http_sendChunk(request, request->reply, request->replylen);
+	}
+	else if (request->replylen > 0) {
+		http_send(request, request->reply, request->replylen);
+	}
+	request->reply[0] = 0;
+	request->replylen = 0;
+}
+
 // add some more output safely, sending if necessary.
 // call with str == NULL to force send. - can be binary.
 // supply length
 int postany(http_request_t* request, const char* str, int len) {
 #if PLATFORM_BL602
-	send(request->fd, str, len, 0);
+	http_send(request, str, len);
 	return 0;
 #else
-	int currentlen;
-	int addlen = len;
-
 	if (NULL == str) {
 		// fd will be NULL for unit tests where HTTP packet is faked locally
-		if (request->fd == 0) {
+		if (request->fd == 0
+#if WINDOWS
+			&& g_simulatorSend == 0
+#endif
+			) {
 			return request->replylen;
 		}
-		if (request->replylen > 0) {
-			send(request->fd, request->reply, request->replylen, 0);
+		// while the whole reply is still buffered, keep it, so it can be
+		// sent with a Content-Length and the connection kept open
+		if (request->keepAlive && request->replySent == 0) {
+			return 0;
 		}
-		request->reply[0] = 0;
-		request->replylen = 0;
+		http_flushReply(request);
 		return 0;
 	}
 
-	currentlen = request->replylen;
-	if (currentlen + addlen >= request->replymaxlen) {
-		send(request->fd, request->reply, request->replylen, 0);
-		request->reply[0] = 0;
-		request->replylen = 0;
-		currentlen = 0;
-	}
-	while (addlen >= request->replymaxlen) {
-		if (request->replylen > 0) {
-			send(request->fd, request->reply, request->replylen, 0);
-			request->replylen = 0;
+	if (request->replylen + len >= request->replymaxlen) {
+		http_flushReply(request);
+		// too large for the buffer, send it as it is
+		if (len >= request->replymaxlen) {
+			if (request->chunked) {
+				http_sendChunk(request, str, len);
+			}
+			else {
+				http_send(request, str, len);
+			}
+			return 0;
 		}
-		send(request->fd, str, (request->replymaxlen - 1), 0);
-		addlen -= (request->replymaxlen - 1);
-		str += (request->replymaxlen - 1);
-
-		rtos_delay_milliseconds(1);
 	}
-
-	memcpy(request->reply + request->replylen, str, addlen);
-	request->replylen += addlen;
-	return (currentlen + addlen);
+	memcpy(request->reply + request->replylen, str, len);
+	request->replylen += len;
+	return request->replylen;
 #endif
 }
 
-
 // add some more output safely, sending if necessary.
 // call with str == NULL to force send.
 int poststr(http_request_t* request, const char* str) {
@@ -564,13 +767,40 @@ int poststr(http_request_t* request, const char* str) {
 
 int hprintf255(http_request_t* request, const char* fmt, ...) {
 	va_list argList;
-	//BaseType_t taken;
+#if PLATFORM_BL602
 	char tmp[256];
-	memset(tmp, 0, sizeof(tmp));
 	va_start(argList, fmt);
 	vsnprintf(tmp, 255, fmt, argList);
 	va_end(argList);
 	return postany(request, tmp, strlen(tmp));
+#else
+	int len;
+	int room;
+
+	// format straight into the reply buffer, if it does not fit
+	// there, send the buffer and format again
+	room = request->replymaxlen - request->replylen;
+	if (room > 256) {
+		room = 256;
+	}
+	va_start(argList, fmt);
+	len = vsnprintf(request->reply + request->replylen, room, fmt, argList);
+	va_end(argList);
+	if (len >= room && room < 256) {
+		http_flushReply(request);
+		va_start(argList, fmt);
+		len = vsnprintf(request->reply + request->replylen, 256, fmt, argList);
+		va_end(argList);
+	}
+	if (len < 0) {
+		len = 0;
+	}
+	else if (len > 255) {
+		len = 255;
+	}
+	request->replylen += len;
+	return request->replylen;
+#endif
 }
 
 
@@ -582,12 +812,15 @@ int HTTP_ProcessPacket(http_request_t* request) {
 	//int bChanged = 0;
 	char* urlStr = "";
 	char* recvbuf;
+	bool bClientKeepAlive = true;
+	http_callback_fn callback;
 
 	if (request->received == 0) {
 		ADDLOGF_ERROR("You gave request with NULL input");
 		return 0;
 	}
 	recvbuf = request->received;
+	request->startTick = xTaskGetTickCount();
 	for (i = 0; i < sizeof(methodNames) / sizeof(*methodNames); i++) {
 		if (http_startsWith(recvbuf, methodNames[i])) {
 			urlStr = recvbuf + strlen(methodNames[i]) + 2; // skip method name plus space, plus slash
@@ -647,6 +880,16 @@ int HTTP_ProcessPacket(http_request_t* request) {
 			return 0;
 		}
 	}
+	if (protocol != 0 && !strcmp(protocol, "HTTP/1.1")) {
+		request->version = 11;
+	}
+	else {
+		request->version = 10;
+	}
+	// HTTP/1.1 keeps the connection by default, HTTP/1.0 only if asked to
+	if (request->version < 11) {
+		bClientKeepAlive = false;
+	}
 	// i.e. not received
 	request->contentLength = -1;
 	headers = p;
@@ -663,6 +906,12 @@ int HTTP_ProcessPacket(http_request_t* request) {
 					if (!my_strnicmp(headers, "Content-Length:", 15)) {
 						request->contentLength = atoi(headers + 15);
 					}
+					if (!my_strnicmp(headers, "Connection:", 11)) {
+						const char* v = headers + 11;
+						while (*v == ' ')
+							v++;
+						bClientKeepAlive = !my_strnicmp(v, "keep-alive", 10);
+					}
 
 					*p = 0;
 					p++; // past \r
@@ -683,6 +932,10 @@ int HTTP_ProcessPacket(http_request_t* request) {
 		} while (1);
 	}
 
+	if (!bClientKeepAlive) {
+		request->keepAlive = 0;
+	}
+
 	if (p == 0) {
 		request->bodystart = 0;
 		request->bodylen = 0;
@@ -698,56 +951,189 @@ int HTTP_ProcessPacket(http_request_t* request) {
 	return http_fn_empty_url(request);
 #endif
 
-	// look for a callback with this URL and method, or HTTP_ANY
-	for (i = 0; i < numCallbacks; i++) {
-		char* url = callbacks[i]->url;
-		if (http_startsWith(urlStr, &url[1])) {
-			int method = callbacks[i]->method;
-			if (method == HTTP_ANY || method == request->method) {
-				return callbacks[i]->callback(request);
-			}
-		}
+	// look for a route with this URL and method, or HTTP_ANY
+	callback = HTTP_FindRoute(urlStr, request->method);
+	if (callback) {
+		return callback(request);
+	}
+	return http_fn_other(request);
+}
+
+// built-in pages match any method
+static void http_addBuiltinRoutes() {
+	if (bBuiltinRoutesAdded) {
+		return;
 	}
-	if (http_checkUrlBase(urlStr, "")) return http_fn_empty_url(request);
+	bBuiltinRoutesAdded = true;
+	http_addRoute("", HTTP_ANY, http_fn_empty_url);
 
-	if (http_checkUrlBase(urlStr, "testmsg")) return http_fn_testmsg(request);
-	if (http_checkUrlBase(urlStr, "index")) return http_fn_index(request);
+	http_addRoute("testmsg", HTTP_ANY, http_fn_testmsg);
+	http_addRoute("index", HTTP_ANY, http_fn_index);
 
-	if (http_checkUrlBase(urlStr, "about")) return http_fn_about(request);
+	http_addRoute("about", HTTP_ANY, http_fn_about);
 
-	if (http_checkUrlBase(urlStr, "cfg_mqtt")) return http_fn_cfg_mqtt(request);
-	if (http_checkUrlBase(urlStr, "cfg_ip")) return http_fn_cfg_ip(request);
-	if (http_checkUrlBase(urlStr, "cfg_mqtt_set")) return http_fn_cfg_mqtt_set(request);
+	http_addRoute("style.css", HTTP_ANY, http_fn_style);
+	http_addRoute("script.js", HTTP_ANY, http_fn_script);
 
-	if (http_checkUrlBase(urlStr, "cfg_webapp")) return http_fn_cfg_webapp(request);
-	if (http_checkUrlBase(urlStr, "cfg_webapp_set")) return http_fn_cfg_webapp_set(request);
+	http_addRoute("cfg_mqtt", HTTP_ANY, http_fn_cfg_mqtt);
+	http_addRoute("cfg_ip", HTTP_ANY, http_fn_cfg_ip);
+	http_addRoute("cfg_mqtt_set", HTTP_ANY, http_fn_cfg_mqtt_set);
 
-	if (http_checkUrlBase(urlStr, "cfg_wifi")) return http_fn_cfg_wifi(request);
-	if (http_checkUrlBase(urlStr, "cfg_name")) return http_fn_cfg_name(request);
-	if (http_checkUrlBase(urlStr, "cfg_wifi_set")) return http_fn_cfg_wifi_set(request);
+	http_addRoute("cfg_webapp", HTTP_ANY, http_fn_cfg_webapp);
+	http_addRoute("cfg_webapp_set", HTTP_ANY, http_fn_cfg_webapp_set);
 
-	if (http_checkUrlBase(urlStr, "cfg_loglevel_set")) return http_fn_cfg_loglevel_set(request);
-	if (http_checkUrlBase(urlStr, "cfg_mac")) return http_fn_cfg_mac(request);
+	http_addRoute("cfg_wifi", HTTP_ANY, http_fn_cfg_wifi);
+	http_addRoute("cfg_name", HTTP_ANY, http_fn_cfg_name);
+	http_addRoute("cfg_wifi_set", HTTP_ANY, http_fn_cfg_wifi_set);
 
-//	if (http_checkUrlBase(urlStr, "flash_read_tool")) return http_fn_flash_read_tool(request);
-	if (http_checkUrlBase(urlStr, "cmd_tool")) return http_fn_cmd_tool(request);
-	if (http_checkUrlBase(urlStr, "startup_command")) return http_fn_startup_command(request);
-	if (http_checkUrlBase(urlStr, "cfg_generic")) return http_fn_cfg_generic(request);
-	if (http_checkUrlBase(urlStr, "cfg_startup")) return http_fn_cfg_startup(request);
-	if (http_checkUrlBase(urlStr, "cfg_dgr")) return http_fn_cfg_dgr(request);
+	http_addRoute("cfg_loglevel_set", HTTP_ANY, http_fn_cfg_loglevel_set);
+	http_addRoute("cfg_mac", HTTP_ANY, http_fn_cfg_mac);
 
-	if (http_checkUrlBase(urlStr, "ha_cfg")) return http_fn_ha_cfg(request);
-	if (http_checkUrlBase(urlStr, "ha_discovery")) return http_fn_ha_discovery(request);
-	if (http_checkUrlBase(urlStr, "cfg")) return http_fn_cfg(request);
+//	http_addRoute("flash_read_tool", HTTP_ANY, http_fn_flash_read_tool);
+	http_addRoute("cmd_tool", HTTP_ANY, http_fn_cmd_tool);
+	http_addRoute("startup_command", HTTP_ANY, http_fn_startup_command);
+	http_addRoute("cfg_generic", HTTP_ANY, http_fn_cfg_generic);
+	http_addRoute("cfg_startup", HTTP_ANY, http_fn_cfg_startup);
+	http_addRoute("cfg_dgr", HTTP_ANY, http_fn_cfg_dgr);
 
-	if (http_checkUrlBase(urlStr, "cfg_pins")) return http_fn_cfg_pins(request);
-	if (http_checkUrlBase(urlStr, "cfg_ping")) return http_fn_cfg_ping(request);
+	http_addRoute("ha_cfg", HTTP_ANY, http_fn_ha_cfg);
+	http_addRoute("ha_discovery", HTTP_ANY, http_fn_ha_discovery);
+	http_addRoute("cfg", HTTP_ANY, http_fn_cfg);
 
-	if (http_checkUrlBase(urlStr, "ota")) return http_fn_ota(request);
-	if (http_checkUrlBase(urlStr, "ota_exec")) return http_fn_ota_exec(request);
-	if (http_checkUrlBase(urlStr, "cm")) return http_fn_cm(request);
+	http_addRoute("cfg_pins", HTTP_ANY, http_fn_cfg_pins);
+	http_addRoute("cfg_ping", HTTP_ANY, http_fn_cfg_ping);
 
-	return http_fn_other(request);
+	http_addRoute("ota", HTTP_ANY, http_fn_ota);
+	http_addRoute("ota_exec", HTTP_ANY, http_fn_ota_exec);
+	http_addRoute("cm", HTTP_ANY, http_fn_cm);
+
+
+	http_addRoute("api/routes", HTTP_GET, http_fn_routes);
+	http_addRoute("api/httpstats", HTTP_GET, http_fn_httpstats);
+}
+
+// lists the route table as JSON
+static int http_fn_routes(http_request_t* request) {
+	int i;
+
+	http_setup(request, httpMimeTypeJson);
+	poststr(request, "[");
+	for (i = 0; i < numRoutes; i++) {
+		hprintf255(request, "%s{\"path\":\"/%s\",\"method\":\"%s\"}", i ? "," : "",
+			routes[i].path, routes[i].method == HTTP_ANY ? "ANY" : methodNames[routes[i].method]);
+	}
+	poststr(request, "]");
+	poststr(request, NULL);
+	return 0;
+}
+
+// Returns the value of a request header, or NULL if it was not sent.
+const char* HTTP_GetHeader(http_request_t* request, const char* name) {
+	int len = strlen(name);
+	const char* v;
+	int i;
+
+	for (i = 0; i < request->numheaders; i++) {
+		if (!my_strnicmp(request->headers[i], name, len) && request->headers[i][len] == ':') {
+			v = request->headers[i] + len + 1;
+			while (*v == ' ')
+				v++;
+			return v;
+		}
+	}
+	return 0;
+}
+
+// response sizes and times, see /api/httpstats
+static const int g_httpTimeLimits[HTTP_TIME_BUCKETS - 1] = { 10, 25, 50, 100, 250, 500, 1000 };
+static httpStats_t g_httpStats;
+
+static void http_recordStats(http_request_t* request, int bytes) {
+	int ms = (xTaskGetTickCount() - request->startTick) * portTICK_PERIOD_MS;
+	int i;
+
+	g_httpStats.responses++;
+	if (request->chunked) {
+		g_httpStats.chunkedResponses++;
+	}
+	g_httpStats.bytes += bytes;
+	if (ms > g_httpStats.maxMs) {
+		g_httpStats.maxMs = ms;
+	}
+	for (i = 0; i < HTTP_TIME_BUCKETS - 1 && ms >= g_httpTimeLimits[i]; i++) {
+	}
+	g_httpStats.timeBuckets[i]++;
+}
+
+const httpStats_t* HTTP_GetStats() {
+	return &g_httpStats;
+}
+
+static int http_fn_httpstats(http_request_t* request) {
+	int i;
+
+	if (http_getArgInteger(request->url, "reset")) {
+		memset(&g_httpStats, 0, sizeof(g_httpStats));
+	}
+	http_setup(request, httpMimeTypeJson);
+	hprintf255(request, "{\"responses\":%i,\"chunked\":%i,\"bytes\":%u,\"maxMs\":%i,\"timeMs\":[",
+		g_httpStats.responses, g_httpStats.chunkedResponses, g_httpStats.bytes, g_httpStats.maxMs);
+	for (i = 0; i < HTTP_TIME_BUCKETS; i++) {
+		if (i < HTTP_TIME_BUCKETS - 1) {
+			hprintf255(request, "%s{\"below\":%i,\"count\":%i}", i ? "," : "", g_httpTimeLimits[i], g_httpStats.timeBuckets[i]);
+		}
+		else {
+			hprintf255(request, ",{\"count\":%i}]}", g_httpStats.timeBuckets[i]);
+		}
+	}
+	poststr(request, NULL);
+	return 0;
+}
+
+// Sends what is left of the reply. Returns 1 if the connection can be
+// used for another request. That needs either the whole reply still
+// in the buffer, so its length can be given to the client, or a reply
+// that was already sent in chunks.
+int HTTP_FinishReply(http_request_t* request) {
+	char keepHeader[64];
+	int bKeep = 0;
+	int bytes;
+
+	if (request->keepAlive && request->replySent == 0 && request->replylen > 0) {
+		char* at;
+		int body = http_findCloseHeader(request, &at);
+		if (body >= 0) {
+			snprintf(keepHeader, sizeof(keepHeader), "Connection: keep-alive\r\nContent-Length: %i\r\n",
+				request->replylen - body);
+			bKeep = http_replaceCloseHeader(request, keepHeader) >= 0;
+		}
+	}
+	// fd will be NULL for unit tests where HTTP packet is faked locally
+	if (request->fd == 0
+#if WINDOWS
+		&& g_simulatorSend == 0
+#endif
+		) {
+		http_recordStats(request, request->replylen);
+		return bKeep;
+	}
+	// no room left to add the length, send it as a single chunk
+	if (request->keepAlive && request->replySent == 0 && bKeep == 0) {
+		http_startReply(request);
+	}
+	if (request->chunked) {
+		http_sendChunk(request, request->reply, request->replylen);
+		http_send(request, "0\r\n\r\n", 5);
+		bKeep = 1;
+	}
+	else if (request->replylen > 0) {
+		http_send(request, request->reply, request->replylen);
+	}
+	request->reply[0] = 0;
+	request->replylen = 0;
+	bytes = request->replySent;
+	http_recordStats(request, bytes);
+	return bKeep && request->sendFailed == 0;
 }
 
 /*
@@ -767,6 +1153,176 @@ const char htmlHeadStyle[] = "<style>div,fieldset,input,select{padding:5px;font-
 const char pageScript[] = "<script type='text/javascript'>var firstTime,lastTime,onlineFor,req=null,onlineForEl=null,getElement=e=>document.getElementById(e);function showState(){clearTimeout(firstTime),clearTimeout(lastTime),null!=req&&req.abort(),(req=new XMLHttpRequest).onreadystatechange=()=>{var e;4==req.readyState&&\"OK\"==req.statusText&&((\"INPUT\"!=document.activeElement.tagName||\"number\"!=document.activeElement.type&&\"color\"!=document.activeElement.type)&&(e=getElement(\"state\"))&&(e.innerHTML=req.responseText),clearTimeout(firstTime),clearTimeout(lastTime),lastTime=setTimeout(showState,3e3))},req.open(\"GET\",\"index?state=1\",!0),req.send(),firstTime=setTimeout(showState,3e3)}function fmtUpTime(e){var t,n,o=Math.floor(e/86400);return e%=86400,t=Math.floor(e/3600),e%=3600,n=Math.floor(e/60),e=e%60,0<o?o+` days, ${t} hours, ${n} minutes and ${e} seconds`:0<t?t+` hours, ${n} minutes and ${e} seconds`:0<n?n+` minutes and ${e} seconds`:`just ${e} seconds`}function updateOnlineFor(){onlineForEl.textContent=fmtUpTime(++onlineFor)}function onLoad(){(onlineForEl=getElement(\"onlineFor\"))&&(onlineFor=parseInt(onlineForEl.dataset.initial,10))&&setInterval(updateOnlineFor,1e3),showState()}function submitTemperature(e){var t=getElement(\"form132\");getElement(\"kelvin132\").value=Math.round(1e6/parseInt(e.value)),t.submit()}window.addEventListener(\"load\",onLoad),history.pushState(null,\"\",window.location.pathname.slice(1)),setTimeout(()=>{var e=getElement(\"changed\");e&&(e.innerHTML=\"\")},5e3);</script>";
 //region_end pageScript
 
+//region_start htmlHeadStyleGz
+const unsigned char htmlHeadStyleGz[] = {
+0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x75,0x54,0x61,0x6f,0xa3,0x30,
+0x0c,0xfd,0x2b,0x3d,0x55,0x93,0xee,0x24,0x40,0x50,0x4a,0xb7,0x81,0xee,0x97,0x9c,
+0xf6,0xc1,0x10,0x07,0xa2,0x41,0xc2,0x85,0xb0,0xb6,0x43,0xf9,0xef,0xe7,0xd0,0xb0,
+0x83,0xaa,0x1b,0xd2,0xd4,0x24,0xb6,0x9f,0xfd,0x9e,0x6d,0x26,0x3e,0x02,0x2e,0xb0,
+0x65,0x03,0x9a,0x40,0xc8,0x7e,0x34,0xc1,0x80,0x2d,0x56,0x66,0xea,0x81,0x31,0x21,
+0xeb,0x3c,0xeb,0x2f,0x05,0x57,0xd2,0x84,0x83,0xf8,0xc4,0x3c,0xc1,0xae,0xe8,0x40,
+0xd7,0x42,0xe6,0xf1,0x2e,0xde,0x45,0x07,0xec,0xec,0xe2,0x3f,0x95,0x50,0xbd,0xd7,
+0x5a,0x8d,0x92,0xe5,0xfb,0x23,0x77,0x9f,0xed,0x27,0x6f,0x1d,0x65,0xd8,0xed,0x62,
+0x3b,0x43,0x4c,0x67,0xc1,0x4c,0x93,0x27,0x71,0xfc,0x54,0x94,0xea,0xe2,0x22,0x3b,
+0xa4,0x52,0x69,0x86,0x3a,0xa4,0x9b,0x22,0x3c,0x63,0xf9,0x2e,0x4c,0xf8,0xcd,0x6b,
+0xa7,0x3e,0xbf,0x79,0x5a,0xa7,0xc0,0x18,0x2b,0x2a,0xd5,0x2a,0x9d,0xef,0xe3,0x38,
+0xb6,0x5c,0xe9,0xce,0x67,0x43,0xa6,0xc6,0xa8,0x6e,0x4e,0xea,0x96,0xd2,0x1f,0x73,
+0xed,0xf1,0x77,0xd5,0x60,0xf5,0x4e,0x61,0xde,0x82,0xd5,0xa5,0x06,0x26,0xd4,0xdb,
+0x92,0xf3,0x57,0xfd,0xa1,0x16,0x75,0x63,0xf2,0x13,0xd1,0xf3,0x81,0xda,0x88,0x0a,
+0xda,0x10,0x5a,0x51,0xcb,0x3c,0x4c,0xfa,0x8b,0xdd,0x04,0x90,0x35,0x2e,0x01,0x5e,
+0x5f,0x9f,0xac,0x67,0x78,0xcd,0xc2,0xf7,0x69,0x1b,0xbc,0x18,0xd0,0x08,0x93,0xc6,
+0x59,0x81,0x05,0xac,0xf0,0xf1,0x5e,0x9e,0x8a,0x06,0xe7,0x54,0xd2,0xe4,0x85,0x92,
+0x59,0xeb,0xa6,0xc8,0x98,0xb7,0xea,0x9c,0xc3,0x68,0xd4,0x06,0x24,0xe1,0xee,0x5b,
+0x70,0x4e,0x59,0x95,0x24,0x99,0x2d,0x15,0xbb,0x4e,0x0e,0xcf,0x17,0x52,0xa1,0x34,
+0xa8,0x6f,0xea,0x73,0xe8,0x44,0x7b,0x75,0xe8,0x0c,0x24,0x04,0x03,0xc8,0x21,0x1c,
+0x50,0x0b,0x3e,0x7b,0x05,0x4d,0xb2,0x83,0x8d,0xfe,0x87,0x24,0x4d,0x53,0x5c,0x00,
+0x10,0xdc,0x67,0x0d,0xfb,0x6a,0xab,0xd8,0x96,0x23,0x69,0x20,0xd7,0x4c,0x0f,0x63,
+0xd9,0x09,0xf3,0x36,0xdd,0xf4,0xcc,0xe3,0xc2,0x0b,0xeb,0x14,0x18,0x87,0x3c,0x4a,
+0x35,0xb1,0xbf,0xad,0x02,0x52,0xac,0x16,0x10,0x0e,0x9c,0xfe,0x8a,0x56,0x48,0x0c,
+0x3d,0x25,0x87,0xe8,0xe8,0x7c,0x56,0xfd,0x1b,0x1d,0xdc,0x45,0x35,0xea,0x81,0x5c,
+0x7a,0x25,0x5c,0x85,0xf6,0x41,0x0e,0x2b,0x71,0x0c,0x09,0x38,0x08,0x23,0x94,0x0c,
+0xd9,0xa8,0xc1,0xfd,0xc8,0xa3,0xe3,0xf0,0xc0,0x2b,0x6f,0x1c,0xe3,0x1b,0x1e,0x62,
+0x7c,0x8e,0xe1,0x68,0xa3,0x52,0x23,0xdb,0x3c,0xb0,0x63,0x9a,0xa5,0xd9,0x0f,0xd1,
+0xf5,0x4a,0x1b,0x90,0xe6,0x66,0xf2,0x20,0xc2,0x6b,0xea,0xa4,0xda,0x18,0xd6,0x5a,
+0x6e,0x87,0xed,0xb9,0x3a,0x9c,0x4e,0xf7,0x26,0x0f,0x62,0x65,0x00,0xfc,0xb4,0x8e,
+0x05,0x93,0x27,0xcf,0x53,0x39,0xab,0xcf,0xb0,0x52,0xbe,0x4e,0xa9,0x24,0xda,0xa8,
+0x9f,0xa8,0x8b,0xc0,0xe4,0x2d,0x72,0x53,0xac,0x1a,0xc4,0x9d,0x6d,0xf4,0xd7,0xbf,
+0xce,0x03,0xb1,0x7e,0x9e,0x2f,0x6c,0xa4,0xa7,0x7b,0x1d,0x49,0x81,0xa5,0x0f,0x0e,
+0xd4,0xa6,0x7e,0x45,0xd0,0x28,0xed,0xdc,0x71,0x95,0xb0,0xd3,0x12,0x74,0x58,0x3b,
+0x4f,0x6a,0xc6,0x9f,0xaf,0x31,0xc3,0x3a,0xd8,0x73,0x0e,0x34,0x1a,0xc1,0x1e,0x4e,
+0x2c,0xe1,0xfc,0x97,0x8d,0x1a,0x3e,0x31,0x31,0xf4,0x2d,0x5c,0x7d,0xc6,0x0d,0x13,
+0x1f,0xcb,0xc4,0x65,0x4f,0xc5,0xb9,0x11,0x06,0xc3,0xa1,0x87,0x0a,0xc9,0xe0,0xac,
+0xa1,0x27,0x13,0x9a,0x42,0x6f,0x72,0x48,0x62,0xc2,0x5d,0x22,0x08,0x39,0xb7,0x50,
+0xd9,0xaa,0xea,0x7d,0x19,0x76,0x57,0xa9,0xcb,0xd5,0x52,0xdc,0xfd,0x60,0xc0,0xe0,
+0xaa,0x93,0xdd,0x5d,0xd5,0xb8,0x29,0x5f,0xf5,0xf7,0x32,0x95,0x87,0xd4,0x7b,0x75,
+0x20,0xe4,0x74,0x47,0xde,0x63,0xcc,0xcd,0xd0,0x14,0x1d,0xc1,0xdf,0xd2,0x4c,0x8f,
+0xf1,0xcc,0xd6,0xc5,0x9f,0x5f,0x62,0x3a,0x5b,0x03,0x25,0x15,0x32,0xff,0x0f,0x29,
+0x94,0x1a,0x4d,0xce,0xc5,0x05,0x59,0xf1,0xbf,0x85,0x6d,0xe4,0x70,0x42,0x47,0xcd,
+0x1d,0x4f,0xf3,0xfd,0x0d,0x7c,0x7a,0x94,0x8b,0x8d,0x06,0xe0,0xe8,0x9b,0x84,0xfa,
+0x73,0xde,0xa2,0x91,0x90,0x8c,0xd4,0x58,0x6a,0xbd,0x91,0x93,0x90,0x7c,0xb6,0x15,
+0xcb,0xbe,0xa7,0xf5,0x43,0xeb,0x3e,0x52,0x9c,0x07,0x91,0x92,0xdf,0x6d,0x95,0x79,
+0x26,0xb3,0x23,0x79,0x3a,0xa3,0xf9,0xea,0x7c,0xa3,0xed,0x99,0x56,0xdf,0x3f,0xb0,
+0xd4,0x79,0x7e,0x9d,0x06,0x00,0x00,
+};
+//region_end htmlHeadStyleGz
+
+//region_start pageScriptGz
+const unsigned char pageScriptGz[] = {
+0x1f,0x8b,0x08,0x00,0x00,0x00,0x00,0x00,0x02,0x03,0x8d,0x54,0x6b,0x4f,0xdb,0x30,
+0x14,0xfd,0x2b,0xc1,0x1a,0x95,0x2d,0xac,0xd0,0xae,0xac,0x9a,0x56,0x4c,0xa5,0x4d,
+0xdd,0x40,0x14,0x98,0xb6,0x22,0xed,0x23,0x26,0xb9,0xa5,0xd9,0x12,0x3b,0xf8,0xd1,
+0x52,0x95,0xfe,0xf7,0xdd,0x24,0x6d,0x92,0x22,0x31,0xf6,0xa5,0x72,0xcf,0x3d,0xf1,
+0x39,0xf7,0xe5,0x85,0x34,0xc1,0x2c,0x31,0xd6,0x4d,0x93,0x0c,0x78,0x2a,0xb7,0x07,
+0xad,0xd2,0x44,0xc1,0x57,0x6d,0xb8,0x81,0x47,0xa1,0x7c,0x9a,0x36,0xd0,0x38,0xad,
+0x80,0x07,0x70,0xe3,0x14,0x32,0x50,0x4e,0x80,0x38,0x8b,0x75,0xe4,0x8b,0x73,0xd8,
+0xc0,0x9f,0x57,0x17,0x31,0x05,0x36,0x9c,0x79,0x15,0xb9,0x44,0xab,0xc0,0xce,0xf5,
+0xf2,0xa7,0x93,0x0e,0x28,0x5b,0x47,0x29,0x48,0x53,0x68,0x69,0xef,0x68,0xed,0x80,
+0xf1,0x3d,0x7c,0xe7,0x87,0xf1,0x42,0xf1,0x40,0xa0,0x99,0x4e,0x07,0x7f,0x42,0x79,
+0xaf,0x8d,0xa3,0x8c,0xd3,0xd2,0x1e,0x2c,0x83,0x5f,0x57,0x93,0x73,0xe7,0xf2,0x1f,
+0xf0,0xe8,0xc1,0x3a,0x16,0x6a,0x65,0x40,0xc6,0x2b,0x5b,0xa8,0x45,0x73,0xa9,0x1e,
+0x40,0x50,0x26,0xce,0xd6,0x0b,0xcc,0x17,0x86,0x27,0xa2,0xb8,0x2a,0x2c,0x29,0xa5,
+0xa1,0x4e,0x87,0xdc,0x5c,0x92,0x0a,0x2d,0xbe,0xf1,0x76,0x0a,0x4f,0xae,0xd3,0xa1,
+0x94,0x5c,0x5c,0x7f,0xbf,0x9d,0x92,0x03,0x51,0x27,0x28,0x31,0x99,0x05,0x6c,0x73,
+0x0c,0x9d,0x7c,0xb8,0x96,0x19,0x3c,0x3f,0x13,0xe5,0xb3,0x7b,0x30,0xff,0x60,0xae,
+0xf2,0x42,0x27,0xd2,0xa9,0x7e,0x83,0xc5,0x50,0x18,0x44,0x53,0x48,0x4a,0xca,0x3c,
+0x08,0x2b,0x03,0x61,0xa2,0x14,0x98,0xf3,0xe9,0xd5,0x64,0x9b,0x84,0xcd,0xb5,0xb2,
+0x50,0x18,0x7e,0x51,0xbe,0xb7,0xcb,0xba,0x3b,0x09,0x0b,0x6e,0x17,0xad,0xbb,0xc4,
+0xfb,0xd0,0x67,0x6c,0x53,0x8c,0x40,0xa8,0x73,0x50,0x94,0x7c,0x1b,0x4f,0x09,0x27,
+0x89,0x8a,0xe1,0x69,0x54,0x5a,0x12,0x3d,0xc2,0x0f,0xba,0xac,0xa4,0x58,0x50,0x31,
+0xb6,0xa4,0x16,0x7d,0xfd,0xce,0x4d,0x3d,0x11,0xb3,0xcc,0xdd,0xe6,0x05,0x09,0xe7,
+0xa4,0xec,0x8d,0xe3,0x8a,0x6b,0x71,0x25,0xdd,0x3c,0x9c,0xa5,0x5a,0x1b,0x0a,0xc7,
+0x1f,0x07,0x27,0xdd,0x2e,0x1b,0x1a,0x70,0xde,0xa8,0x00,0x0e,0x45,0x09,0x70,0xb7,
+0xcf,0xea,0x0f,0x90,0xc4,0x31,0x5a,0x1c,0xb8,0xda,0x0f,0x0e,0x8a,0x90,0x80,0xc3,
+0x41,0x97,0x77,0x4f,0xf5,0x48,0x1f,0xdd,0x05,0xb1,0x5c,0x59,0x1e,0xbc,0x5b,0xbb,
+0x4d,0x30,0xd7,0xde,0x94,0x67,0xb5,0x09,0xb2,0x44,0x79,0x07,0x36,0x90,0x2a,0x46,
+0x00,0x36,0x81,0x85,0x48,0xab,0xd8,0xde,0x7d,0xea,0x9e,0xba,0x91,0xc3,0x0f,0xff,
+0x97,0xad,0x46,0x0a,0xd9,0xaf,0x33,0xee,0x7e,0x7b,0xeb,0xf6,0xb1,0xa6,0x2e,0x3e,
+0x8f,0xb1,0x58,0x37,0xbb,0x95,0xc3,0x7d,0x69,0xad,0x5f,0xe8,0xb0,0xd5,0x5f,0xb4,
+0x72,0xc5,0xea,0x35,0x15,0x3c,0x3a,0xaa,0x39,0xad,0x0a,0x6b,0x35,0xd1,0x12,0xfb,
+0xb2,0xa6,0xed,0x05,0x6e,0xcf,0x56,0x8d,0x57,0xf3,0x55,0xff,0x15,0xb9,0x34,0x16,
+0x2e,0x90,0xd2,0xd6,0x46,0x5f,0x12,0x1b,0x8b,0x43,0x98,0xb8,0x44,0xa6,0xbc,0xd7,
+0x2d,0xbe,0x42,0x04,0x89,0x60,0x16,0x32,0xa5,0x2f,0xbc,0xf3,0x1e,0x76,0x9c,0xb7,
+0x56,0xbf,0xf1,0x66,0xfd,0x7d,0x96,0xb8,0x29,0x64,0x39,0x18,0xdc,0x39,0xd3,0x4c,
+0xc1,0x9e,0xc1,0x99,0x36,0x59,0xaf,0xff,0x9e,0xb0,0x61,0x1b,0xfd,0x03,0xe9,0x22,
+0x51,0x25,0x1e,0xa2,0xac,0x87,0xaa,0xe5,0x46,0x7b,0x1c,0xc3,0x1e,0x0c,0x8e,0x6b,
+0xfb,0x50,0xc5,0x19,0xe3,0x2e,0xac,0x24,0xd1,0xc4,0x12,0xa7,0x58,0x2f,0x43,0x19,
+0xc7,0xe3,0x05,0xde,0x37,0x49,0x2c,0x96,0x13,0x0c,0x25,0x29,0x96,0x8b,0xf0,0xaa,
+0x6c,0x8c,0xcf,0x11,0xd7,0x66,0x15,0xe6,0xde,0xce,0x2b,0xff,0xe5,0xdb,0x47,0x08,
+0xdf,0x5e,0x90,0xea,0x48,0x16,0xc9,0x84,0x39,0xaa,0x2b,0x7c,0x09,0x42,0x9b,0x26,
+0x11,0xd0,0x1e,0xca,0xb5,0x16,0xa0,0x79,0x7c,0xf6,0x52,0xab,0x9e,0xa6,0x18,0x53,
+0x83,0x17,0xab,0x4d,0x08,0x6e,0xde,0x07,0x2c,0xdd,0xf0,0x2f,0xc1,0x19,0x54,0x13,
+0xa3,0x05,0x00,0x00,
+};
+//region_end pageScriptGz
+
 //region_start ha_discovery_script
 const char ha_discovery_script[] = "<script type='text/javascript'>function send_ha_disc(){var e=new XMLHttpRequest;e.open(\"GET\",\"/ha_discovery?prefix=\"+document.getElementById(\"ha_disc_topic\").value,!1),e.onload=function(){200===e.status?alert(e.responseText):404===e.status&&alert(\"Error invoking ha_discovery\")},e.onerror=function(){alert(\"Error invoking ha_discovery\")},e.send()}</script>";
 //region_end ha_discovery_script
+
+typedef struct httpAsset_s {
+	const char* mimeType;
+	const unsigned char* gz;
+	int gzLen;
+	// the same content as a C string in HTML tags, for clients without gzip
+	const char* plain;
+	int plainTagLen;
+	int plainEndTagLen;
+} httpAsset_t;
+
+static const httpAsset_t g_httpAssets[] = {
+	{ "text/css", htmlHeadStyleGz, sizeof(htmlHeadStyleGz), htmlHeadStyle,
+		sizeof("<style>") - 1, sizeof("</style>") - 1 },
+	{ "application/javascript", pageScriptGz, sizeof(pageScriptGz), pageScript,
+		sizeof("<script type='text/javascript'>") - 1, sizeof("</script>") - 1 },
+};
+static unsigned int g_httpAssetETags[sizeof(g_httpAssets) / sizeof(g_httpAssets[0])];
+
+// FNV-1a of the gzipped content, it only changes with a new build
+static unsigned int http_getAssetETag(int asset) {
+	const httpAsset_t* a = &g_httpAssets[asset];
+	unsigned int hash;
+	int i;
+
+	if (g_httpAssetETags[asset] == 0) {
+		hash = 2166136261u;
+		for (i = 0; i < a->gzLen; i++) {
+			hash ^= a->gz[i];
+			hash *= 16777619u;
+		}
+		g_httpAssetETags[asset] = hash;
+	}
+	return g_httpAssetETags[asset];
+}
+
+static int http_fn_asset(http_request_t* request, int asset) {
+	const httpAsset_t* a = &g_httpAssets[asset];
+	const char* acceptEncoding = HTTP_GetHeader(request, "Accept-Encoding");
+	const char* ifNoneMatch = HTTP_GetHeader(request, "If-None-Match");
+	bool bGzip = acceptEncoding && strstr(acceptEncoding, "gzip");
+	char etag[20];
+
+	snprintf(etag, sizeof(etag), "\"%08x%s\"", http_getAssetETag(asset), bGzip ? "" : "-id");
+	if (ifNoneMatch && strstr(ifNoneMatch, etag)) {
+		poststr(request, "HTTP/1.1 304 Not Modified\r\n");
+	}
+	else {
+		ifNoneMatch = 0;
+		poststr(request, "HTTP/1.1 200 OK\r\n");
+	}
+	hprintf255(request, "Content-type: %s\r\n%s\r\n", a->mimeType, httpCorsHeaders);
+	hprintf255(request, "ETag: %s\r\nCache-Control: public, max-age=31536000\r\nVary: Accept-Encoding\r\n", etag);
+	if (bGzip) {
+		poststr(request, "Content-Encoding: gzip\r\n");
+	}
+	poststr(request, "Connection: close\r\n\r\n");
+	if (ifNoneMatch == 0) {
+		if (bGzip) {
+			postany(request, (const char*)a->gz, a->gzLen);
+		}
+		else {
+			postany(request, a->plain + a->plainTagLen, strlen(a->plain) - a->plainTagLen - a->plainEndTagLen);
+		}
+	}
+	poststr(request, NULL);
+	return 0;
+}
@@ -48,16 +48,45 @@ typedef struct http_request_tag {
 	int bodylen;
 	int contentLength;
 	int responseCode;
+	// HTTP version of the request, 10 for HTTP/1.0 and 11 for HTTP/1.1
+	int version;
 
 	// used to respond
 	char* reply;
 	int replylen;
 	int replymaxlen;
 	int fd;
+	// set by the server if the connection may be kept open after this
+	// request; cleared if the client does not want it
+	int keepAlive;
+	// bytes of the reply already sent on fd
+	int replySent;
+	// set when a keep-alive reply is too large for the buffer and is
+	// sent with chunked transfer encoding, HTTP/1.1 only
+	int chunked;
+	int sendFailed;
+	int startTick;
 } http_request_t;
 
+// response times histogram, the last bucket is for 1 second and more
+#define HTTP_TIME_BUCKETS 8
+typedef struct httpStats_s {
+	int responses;
+	int chunkedResponses;
+	unsigned int bytes;
+	int maxMs;
+	int timeBuckets[HTTP_TIME_BUCKETS];
+} httpStats_t;
 
+
+int my_strnicmp(const char* a, const char* b, int len);
 int HTTP_ProcessPacket(http_request_t* request);
+const char* HTTP_GetHeader(http_request_t* request, const char* name);
+int HTTP_FinishReply(http_request_t* request);
+const httpStats_t* HTTP_GetStats();
+#if WINDOWS
+void HTTP_SetSimulatorSendCallback(int (*cb)(const char* data, int len));
+#endif
 void http_setup(http_request_t* request, const char* type);
 void http_html_start(http_request_t* request, const char* pagename);
 void http_html_end(http_request_t* request);
@@ -83,9 +112,12 @@ typedef enum {
 
 // callback function for http
 typedef int (*http_callback_fn)(http_request_t* request);
-// url MUST start with '/'
-// urls must be unique (i.e. you can't have /about and /aboutme or /about/me)
+// url MUST start with '/' and is not copied, so it must stay valid (use a literal)
+// url ending with '/' handles everything below it (i.e. /api/ gets /api/xyz),
+// other urls are matched up to the query string ('?')
 int HTTP_RegisterCallback(const char* url, int method, http_callback_fn callback);
+// returns the callback for given url (without the leading '/'), or NULL
+http_callback_fn HTTP_FindRoute(const char* url, int method);
 
 #endif
 
@@ -92,6 +92,11 @@ static int http_rest_post_flash(http_request_t* request, int startaddr, int maxa
 static int http_rest_get_flash(http_request_t* request, int startaddr, int len);
 static int http_rest_get_flash_advanced(http_request_t* request);
 static int http_rest_post_flash_advanced(http_request_t* request);
+#ifdef ENABLE_LITTLEFS
+static int http_rest_get_fsblock(http_request_t* request);
+static int http_rest_post_fsblock(http_request_t* request);
+#endif
+static int http_rest_post_ota(http_request_t* request);
 
 static int http_rest_get_info(http_request_t* request);
 
@@ -107,9 +112,36 @@ static int http_rest_post_cmd(http_request_t* request);
 
 
 void init_rest() {
+	// anything else below /api/ gets a page saying what was asked for
 	HTTP_RegisterCallback("/api/", HTTP_GET, http_rest_get);
 	HTTP_RegisterCallback("/api/", HTTP_POST, http_rest_post);
 	HTTP_RegisterCallback("/app", HTTP_GET, http_rest_app);
+
+	HTTP_RegisterCallback("/api/channels", HTTP_GET, http_rest_get_channels);
+	HTTP_RegisterCallback("/api/channels", HTTP_POST, http_rest_post_channels);
+	HTTP_RegisterCallback("/api/pins", HTTP_GET, http_rest_get_pins);
+	HTTP_RegisterCallback("/api/pins", HTTP_POST, http_rest_post_pins);
+	HTTP_RegisterCallback("/api/channelTypes", HTTP_GET, http_rest_get_channelTypes);
+	HTTP_RegisterCallback("/api/channelTypes", HTTP_POST, http_rest_post_channelTypes);
+	HTTP_RegisterCallback("/api/logconfig", HTTP_GET, http_rest_get_logconfig);
+	HTTP_RegisterCallback("/api/logconfig", HTTP_POST, http_rest_post_logconfig);
+	HTTP_RegisterCallback("/api/seriallog", HTTP_GET, http_rest_get_seriallog);
+	HTTP_RegisterCallback("/api/info", HTTP_GET, http_rest_get_info);
+	HTTP_RegisterCallback("/api/flash/", HTTP_GET, http_rest_get_flash_advanced);
+	HTTP_RegisterCallback("/api/flash/", HTTP_POST, http_rest_post_flash_advanced);
+	HTTP_RegisterCallback("/api/dumpconfig", HTTP_GET, http_rest_get_dumpconfig);
+	HTTP_RegisterCallback("/api/testconfig", HTTP_GET, http_rest_get_testconfig);
+	HTTP_RegisterCallback("/api/testflashvars", HTTP_GET, http_rest_get_flash_vars_test);
+	HTTP_RegisterCallback("/api/reboot", HTTP_POST, http_rest_post_reboot);
+	HTTP_RegisterCallback("/api/ota", HTTP_POST, http_rest_post_ota);
+	HTTP_RegisterCallback("/api/cmnd", HTTP_POST, http_rest_post_cmd);
+#ifdef ENABLE_LITTLEFS
+	HTTP_RegisterCallback("/api/fsblock", HTTP_GET, http_rest_get_fsblock);
+	HTTP_RegisterCallback("/api/fsblock", HTTP_POST, http_rest_post_fsblock);
+	HTTP_RegisterCallback("/api/lfs/", HTTP_GET, http_rest_get_lfs_file);
+	HTTP_RegisterCallback("/api/lfs/", HTTP_POST, http_rest_post_lfs_file);
+	HTTP_RegisterCallback("/api/del/", HTTP_GET, http_rest_get_lfs_delete);
+#endif
 }
 
 /* Extracts string token value into outBuffer (128 char). Returns true if the operation was successful. */
@@ -131,76 +163,72 @@ bool tryGetTokenString(const char* json, jsmntok_t* tok, char* outBuffer) {
 	return true;
 }
 
-static int http_rest_get(http_request_t* request) {
-	ADDLOG_DEBUG(LOG_FEATURE_API, "GET of %s", request->url);
+#ifdef ENABLE_LITTLEFS
+static int http_rest_get_fsblock(http_request_t* request) {
+	uint32_t newsize = CFG_GetLFS_Size();
+	uint32_t newstart = (LFS_BLOCKS_END - newsize);
 
-	if (!strcmp(request->url, "api/channels")) {
-		return http_rest_get_channels(request);
-	}
+	newsize = (newsize / LFS_BLOCK_SIZE) * LFS_BLOCK_SIZE;
 
-	if (!strcmp(request->url, "api/pins")) {
-		return http_rest_get_pins(request);
+	// double check again that we're within bounds - don't want
+	// boot overwrite or anything nasty....
+	if (newstart < LFS_BLOCKS_START_MIN) {
+		return http_rest_error(request, -20, "LFS Size mismatch");
 	}
-	if (!strcmp(request->url, "api/channelTypes")) {
-		return http_rest_get_channelTypes(request);
+	if ((newstart + newsize > LFS_BLOCKS_END) ||
+		(newstart + newsize < LFS_BLOCKS_START_MIN)) {
+		return http_rest_error(request, -20, "LFS Size mismatch");
 	}
-	if (!strcmp(request->url, "api/logconfig")) {
-		return http_rest_get_logconfig(request);
-	}
-
-	if (!strncmp(request->url, "api/seriallog", 13)) {
-		return http_rest_get_seriallog(request);
-	}
-
-#ifdef ENABLE_LITTLEFS
-	if (!strcmp(request->url, "api/fsblock")) {
-		uint32_t newsize = CFG_GetLFS_Size();
-		uint32_t newstart = (LFS_BLOCKS_END - newsize);
-
-		newsize = (newsize / LFS_BLOCK_SIZE) * LFS_BLOCK_SIZE;
 
-		// double check again that we're within bounds - don't want
-		// boot overwrite or anything nasty....
-		if (newstart < LFS_BLOCKS_START_MIN) {
-			return http_rest_error(request, -20, "LFS Size mismatch");
-		}
-		if ((newstart + newsize > LFS_BLOCKS_END) ||
-			(newstart + newsize < LFS_BLOCKS_START_MIN)) {
-			return http_rest_error(request, -20, "LFS Size mismatch");
-		}
+	return http_rest_get_flash(request, newstart, newsize);
+}
 
-		return http_rest_get_flash(request, newstart, newsize);
+static int http_rest_post_fsblock(http_request_t* request) {
+	if (lfs_present()) {
+		release_lfs();
 	}
-#endif
+	uint32_t newsize = CFG_GetLFS_Size();
+	uint32_t newstart = (LFS_BLOCKS_END - newsize);
 
-#ifdef ENABLE_LITTLEFS
-	if (!strncmp(request->url, "api/lfs/", 8)) {
-		return http_rest_get_lfs_file(request);
-	}
-	if (!strncmp(request->url, "api/del/", 8)) {
-		return http_rest_get_lfs_delete(request);
-	}
-#endif
+	newsize = (newsize / LFS_BLOCK_SIZE) * LFS_BLOCK_SIZE;
 
-	if (!strcmp(request->url, "api/info")) {
-		return http_rest_get_info(request);
+	// double check again that we're within bounds - don't want
+	// boot overwrite or anything nasty....
+	if (newstart < LFS_BLOCKS_START_MIN) {
+		return http_rest_error(request, -20, "LFS Size mismatch");
 	}
-
-	if (!strncmp(request->url, "api/flash/", 10)) {
-		return http_rest_get_flash_advanced(request);
+	if ((newstart + newsize > LFS_BLOCKS_END) ||
+		(newstart + newsize < LFS_BLOCKS_START_MIN)) {
+		return http_rest_error(request, -20, "LFS Size mismatch");
 	}
 
-	if (!strcmp(request->url, "api/dumpconfig")) {
-		return http_rest_get_dumpconfig(request);
-	}
+	// we are writing the lfs block
+	int res = http_rest_post_flash(request, newstart, LFS_BLOCKS_END);
+	// initialise the filesystem, it should be there now.
+	// don't create if it does not mount
+	init_lfs(0);
+	return res;
+}
+#endif
 
-	if (!strcmp(request->url, "api/testconfig")) {
-		return http_rest_get_testconfig(request);
-	}
+static int http_rest_post_ota(http_request_t* request) {
+#if PLATFORM_BK7231T
+	return http_rest_post_flash(request, START_ADR_OF_BK_PARTITION_OTA, LFS_BLOCKS_END);
+#elif PLATFORM_BK7231N
+	return http_rest_post_flash(request, START_ADR_OF_BK_PARTITION_OTA, LFS_BLOCKS_END);
+#elif PLATFORM_W600
+	return http_rest_post_flash(request, -1, -1);
+#elif PLATFORM_BL602
+	return http_rest_post_flash(request, -1, -1);
+#else
+	// TODO
+	return http_rest_post(request);
+#endif
+}
 
-	if (!strncmp(request->url, "api/testflashvars", 17)) {
-		return http_rest_get_flash_vars_test(request);
-	}
+// endpoints are registered in init_rest, this is for the rest of /api/
+static int http_rest_get(http_request_t* request) {
+	ADDLOG_DEBUG(LOG_FEATURE_API, "GET of %s", request->url);
 
 	http_setup(request, httpMimeTypeHTML);
 	http_html_start(request, "GET REST API");
@@ -215,77 +243,6 @@ static int http_rest_post(http_request_t* request) {
 	char tmp[20];
 	ADDLOG_DEBUG(LOG_FEATURE_API, "POST to %s", request->url);
 
-	if (!strcmp(request->url, "api/channels")) {
-		return http_rest_post_channels(request);
-	}
-	
-	if (!strcmp(request->url, "api/pins")) {
-		return http_rest_post_pins(request);
-	}
-	if (!strcmp(request->url, "api/channelTypes")) {
-		return http_rest_post_channelTypes(request);
-	}
-	if (!strcmp(request->url, "api/logconfig")) {
-		return http_rest_post_logconfig(request);
-	}
-
-	if (!strcmp(request->url, "api/reboot")) {
-		return http_rest_post_reboot(request);
-	}
-	if (!strcmp(request->url, "api/ota")) {
-#if PLATFORM_BK7231T
-		return http_rest_post_flash(request, START_ADR_OF_BK_PARTITION_OTA, LFS_BLOCKS_END);
-#elif PLATFORM_BK7231N
-		return http_rest_post_flash(request, START_ADR_OF_BK_PARTITION_OTA, LFS_BLOCKS_END);
-#elif PLATFORM_W600
-		return http_rest_post_flash(request, -1, -1);
-#elif PLATFORM_BL602
-		return http_rest_post_flash(request, -1, -1);
-#else
-		// TODO
-#endif
-	}
-	if (!strncmp(request->url, "api/flash/", 10)) {
-		return http_rest_post_flash_advanced(request);
-	}
-
-	if (!strcmp(request->url, "api/cmnd")) {
-		return http_rest_post_cmd(request);
-	}
-
-
-#ifdef ENABLE_LITTLEFS
-	if (!strcmp(request->url, "api/fsblock")) {
-		if (lfs_present()) {
-			release_lfs();
-		}
-		uint32_t newsize = CFG_GetLFS_Size();
-		uint32_t newstart = (LFS_BLOCKS_END - newsize);
-
-		newsize = (newsize / LFS_BLOCK_SIZE) * LFS_BLOCK_SIZE;
-
-		// double check again that we're within bounds - don't want
-		// boot overwrite or anything nasty....
-		if (newstart < LFS_BLOCKS_START_MIN) {
-			return http_rest_error(request, -20, "LFS Size mismatch");
-		}
-		if ((newstart + newsize > LFS_BLOCKS_END) ||
-			(newstart + newsize < LFS_BLOCKS_START_MIN)) {
-			return http_rest_error(request, -20, "LFS Size mismatch");
-		}
-
-		// we are writing the lfs block
-		int res = http_rest_post_flash(request, newstart, LFS_BLOCKS_END);
-		// initialise the filesystem, it should be there now.
-		// don't create if it does not mount
-		init_lfs(0);
-		return res;
-	}
-	if (!strncmp(request->url, "api/lfs/", 8)) {
-		return http_rest_post_lfs_file(request);
-	}
-#endif
-
 	http_setup(request, httpMimeTypeHTML);
 	http_html_start(request, "POST REST API");
 	poststr(request, "POST to ");
@@ -1244,7 +1201,7 @@ static int http_rest_post_flash(http_request_t* request, int startaddr, int maxa
 	tls_mem_free(Buffer);
 
 	if (nRetCode != 0) {
-		ADDLOG_ERROR(LOG_FEATURE_OTA, error_message);
+		ADDLOG_ERROR(LOG_FEATURE_OTA, "%s", error_message);
 		socket_fwup_err(0, nRetCode);
 		return http_rest_error(request, nRetCode, error_message);
 	}
@@ -15,6 +15,7 @@
 #include "../new_cfg.h"
 #include "../new_cfg.h"
 #include "../cmnds/cmd_public.h"
+#include "../hal/hal_generic.h"
 
 
 
@@ -73,15 +74,33 @@ struct lfs_config cfg = {
     .sync  = lfs_sync,
 
     // block device configuration
-    .read_size = 1,
-    .prog_size = 1,
+    .read_size = LFS_READ_SIZE,
+    .prog_size = LFS_PROG_SIZE,
     .block_size = LFS_BLOCK_SIZE,
     .block_count = (LFS_BLOCKS_DEFAULT_LEN/LFS_BLOCK_SIZE),
-    .cache_size = 16,
-    .lookahead_size = 16,
+    .cache_size = LFS_CACHE_SIZE,
+    .lookahead_size = LFS_LOOKAHEAD_SIZE,
     .block_cycles = 500,
 };
 
+static lfsFlashStats_t g_lfsFlashStats;
+
+const lfsFlashStats_t* LFS_GetFlashStats() {
+    return &g_lfsFlashStats;
+}
+
+static void LFS_AccountIrqOff(unsigned int start, unsigned int bytes) {
+    unsigned int delta = HAL_GetTimeUs() - start;
+
+    g_lfsFlashStats.irqOffWindows++;
+    if (delta > g_lfsFlashStats.maxIrqOffUs) {
+        g_lfsFlashStats.maxIrqOffUs = delta;
+    }
+    if (bytes > g_lfsFlashStats.maxIrqOffBytes) {
+        g_lfsFlashStats.maxIrqOffBytes = bytes;
+    }
+}
+
 int lfs_present(){
     return lfs_initialised;
 }
@@ -203,7 +222,7 @@ static commandResult_t CMD_LFS_Append_Internal(lcdPrintType_t type, bool bLine,
 	const char *str;
 	float f;
 	int i;
-	char buffer[8];
+	char buffer[32];
 
 	Tokenizer_TokenizeString(args, 0);
 
@@ -264,6 +283,27 @@ static commandResult_t CMD_LFS_Append(const void *context, const char *cmd, cons
 static commandResult_t CMD_LFS_AppendLine(const void *context, const char *cmd, const char *args, int cmdFlags) {
 	return CMD_LFS_Append_Internal(LCD_PRINT_DEFAULT, true, true, args);
 }
+// lfs_stats
+// lfs_stats reset
+static commandResult_t CMD_LFS_Stats(const void *context, const char *cmd, const char *args, int cmdFlags) {
+    if (args && !stricmp(args, "reset")) {
+        memset(&g_lfsFlashStats, 0, sizeof(g_lfsFlashStats));
+    }
+    ADDLOG_INFO(LOG_FEATURE_CMD, "LFS read %i cache %i prog %i lookahead %i",
+        LFS_READ_SIZE, LFS_CACHE_SIZE, LFS_PROG_SIZE, LFS_LOOKAHEAD_SIZE);
+    ADDLOG_INFO(LOG_FEATURE_CMD, "LFS flash: %u reads (%u bytes), %u progs (%u bytes), %u erases",
+        g_lfsFlashStats.reads, g_lfsFlashStats.readBytes,
+        g_lfsFlashStats.progs, g_lfsFlashStats.progBytes, g_lfsFlashStats.erases);
+    if (HAL_GetTimeUsResolution() > 1) {
+        // a tick based clock does not even advance while interrupts are off
+        ADDLOG_INFO(LOG_FEATURE_CMD, "LFS irq off: %u times, max %u bytes, not timed with a %u us clock",
+            g_lfsFlashStats.irqOffWindows, g_lfsFlashStats.maxIrqOffBytes, HAL_GetTimeUsResolution());
+    } else {
+        ADDLOG_INFO(LOG_FEATURE_CMD, "LFS irq off: %u times, max %u us, max %u bytes",
+            g_lfsFlashStats.irqOffWindows, g_lfsFlashStats.maxIrqOffUs, g_lfsFlashStats.maxIrqOffBytes);
+    }
+    return CMD_RES_OK;
+}
 static commandResult_t CMD_LFS_Remove(const void *context, const char *cmd, const char *args, int cmdFlags) {
 	const char *fileName;
 	int res;
@@ -339,6 +379,11 @@ void LFSAddCmds(){
 	//cmddetail:"fn":"CMD_LFS_WriteLine","file":"cmnds/cmd_main.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("lfs_writeLine", CMD_LFS_WriteLine, NULL);
+	//cmddetail:{"name":"lfs_stats","args":"[reset-Optional]",
+	//cmddetail:"descr":"Logs LFS geometry and how many flash reads, programs and erases LFS did, with the longest time interrupts were disabled for them. That time is only shown where the clock has microsecond resolution. Use 'reset' to clear the counters.",
+	//cmddetail:"fn":"CMD_LFS_Stats","file":"littlefs/our_lfs.c","requires":"",
+	//cmddetail:"examples":""}
+	CMD_RegisterCommand("lfs_stats", CMD_LFS_Stats, NULL);
 
 }
 
@@ -429,39 +474,84 @@ void release_lfs(){
 
 // Read a region in a block. Negative error codes are propogated
 // to the user.
+// Large reads (file data bypasses the cache) are done in chunks, so
+// interrupts are never disabled for more than LFS_FLASH_IRQ_CHUNK bytes.
 static int lfs_read(const struct lfs_config *c, lfs_block_t block,
         lfs_off_t off, void *buffer, lfs_size_t size){
-    int res;
+    int res = 0;
+    unsigned int chunk;
+    unsigned int start;
+    char *p = (char *)buffer;
     unsigned int startAddr = LFS_Start;
     startAddr += block*LFS_BLOCK_SIZE;
     startAddr += off;
     GLOBAL_INT_DECLARATION();
-    GLOBAL_INT_DISABLE();
-    res = flash_read((char *)buffer, size, startAddr);
-    GLOBAL_INT_RESTORE();
+
+    g_lfsFlashStats.reads++;
+    g_lfsFlashStats.readBytes += size;
+    while (size > 0) {
+        chunk = size;
+        if (chunk > LFS_FLASH_IRQ_CHUNK) {
+            chunk = LFS_FLASH_IRQ_CHUNK;
+        }
+        start = HAL_GetTimeUs();
+        GLOBAL_INT_DISABLE();
+        res = flash_read(p, chunk, startAddr);
+        GLOBAL_INT_RESTORE();
+        LFS_AccountIrqOff(start, chunk);
+        if (res) {
+            break;
+        }
+        p += chunk;
+        startAddr += chunk;
+        size -= chunk;
+    }
     return res;
 }
 
 // Program a region in a block. The block must have previously
 // been erased. Negative error codes are propogated to the user.
 // May return LFS_ERR_CORRUPT if the block should be considered bad.
+// Data comes from the program cache, so it is at most LFS_CACHE_SIZE
+// bytes, but it is still chunked in case the cache is made larger.
+// Flash is unprotected only for the time of each chunk.
 static int lfs_write(const struct lfs_config *c, lfs_block_t block,
         lfs_off_t off, const void *buffer, lfs_size_t size){
-    int res;
-    int protect = FLASH_PROTECT_NONE;
+    int res = 0;
+    int protect;
+    unsigned int chunk;
+    unsigned int start;
+    char *p = (char *)buffer;
     unsigned int startAddr = LFS_Start;
     GLOBAL_INT_DECLARATION();
 
     startAddr += block*LFS_BLOCK_SIZE;
     startAddr += off;
 
-    GLOBAL_INT_DISABLE();
-    flash_ctrl(CMD_FLASH_SET_PROTECT, &protect);
-    flash_ctrl(CMD_FLASH_WRITE_ENABLE, (void *)0);
-    res = flash_write((char *)buffer , size, startAddr);
-    protect = FLASH_PROTECT_ALL;
-    flash_ctrl(CMD_FLASH_SET_PROTECT, &protect);
-    GLOBAL_INT_RESTORE();
+    g_lfsFlashStats.progs++;
+    g_lfsFlashStats.progBytes += size;
+    while (size > 0) {
+        chunk = size;
+        if (chunk > LFS_FLASH_IRQ_CHUNK) {
+            chunk = LFS_FLASH_IRQ_CHUNK;
+        }
+        start = HAL_GetTimeUs();
+        GLOBAL_INT_DISABLE();
+        protect = FLASH_PROTECT_NONE;
+        flash_ctrl(CMD_FLASH_SET_PROTECT, &protect);
+        flash_ctrl(CMD_FLASH_WRITE_ENABLE, (void *)0);
+        res = flash_write(p, chunk, startAddr);
+        protect = FLASH_PROTECT_ALL;
+        flash_ctrl(CMD_FLASH_SET_PROTECT, &protect);
+        GLOBAL_INT_RESTORE();
+        LFS_AccountIrqOff(start, chunk);
+        if (res) {
+            break;
+        }
+        p += chunk;
+        startAddr += chunk;
+        size -= chunk;
+    }
 
     return res;
 }
@@ -473,10 +563,14 @@ static int lfs_write(const struct lfs_config *c, lfs_block_t block,
 static int lfs_erase(const struct lfs_config *c, lfs_block_t block){
     int res;
     int protect = FLASH_PROTECT_NONE;
+    unsigned int start;
     unsigned int startAddr = LFS_Start;
     GLOBAL_INT_DECLARATION();
 
     startAddr += block*LFS_BLOCK_SIZE;
+    g_lfsFlashStats.erases++;
+    // sector erase can not be split
+    start = HAL_GetTimeUs();
     GLOBAL_INT_DISABLE();
     flash_ctrl(CMD_FLASH_SET_PROTECT, &protect);
     flash_ctrl(CMD_FLASH_WRITE_ENABLE, (void *)0);
@@ -484,6 +578,7 @@ static int lfs_erase(const struct lfs_config *c, lfs_block_t block){
     protect = FLASH_PROTECT_ALL;
     flash_ctrl(CMD_FLASH_SET_PROTECT, &protect);
     GLOBAL_INT_RESTORE();
+    LFS_AccountIrqOff(start, 0);
     return res;
 }
 
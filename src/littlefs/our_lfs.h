@@ -43,6 +43,42 @@
 
 #define LFS_BLOCK_SIZE 0x1000
 
+// LittleFS geometry, each can be overridden from the build flags.
+// Program size must stay 1 for file systems that were formatted with it,
+// metadata commits there are only 1 byte aligned.
+#ifndef LFS_READ_SIZE
+#define LFS_READ_SIZE 1
+#endif
+#ifndef LFS_PROG_SIZE
+#define LFS_PROG_SIZE 1
+#endif
+// one flash page; read cache, program cache and every open file use that much RAM
+#ifndef LFS_CACHE_SIZE
+#define LFS_CACHE_SIZE 256
+#endif
+// one bit per block, big enough to cover the largest allowed LFS
+// so free blocks are found in a single scan
+#ifndef LFS_LOOKAHEAD_SIZE
+#define LFS_LOOKAHEAD_SIZE ((((LFS_BLOCKS_MAX_LEN / LFS_BLOCK_SIZE) + 63) / 64) * 8)
+#endif
+// largest flash read or program done with interrupts disabled,
+// longer operations are split into chunks of this size
+#ifndef LFS_FLASH_IRQ_CHUNK
+#define LFS_FLASH_IRQ_CHUNK 256
+#endif
+
+typedef struct lfsFlashStats_s {
+	unsigned int reads;
+	unsigned int readBytes;
+	unsigned int progs;
+	unsigned int progBytes;
+	unsigned int erases;
+	// number of times interrupts were disabled for flash access
+	unsigned int irqOffWindows;
+	unsigned int maxIrqOffUs;
+	unsigned int maxIrqOffBytes;
+} lfsFlashStats_t;
+
 
 extern int boot_count;
 extern lfs_t lfs;
@@ -53,4 +89,5 @@ void LFSAddCmds();
 void init_lfs(int create);
 void release_lfs();
 int lfs_present();
+const lfsFlashStats_t* LFS_GetFlashStats();
 #endif
\ No newline at end of file
@@ -40,6 +40,9 @@ unsigned int logfeatures = (
 	);
 static int log_delay = 0;
 
+unsigned int logEmittedCount[LOG_FEATURE_MAX];
+unsigned int logSuppressedCount[LOG_FEATURE_MAX];
+
 // must match header definitions in logging.h
 char* loglevelnames[] = {
 	"NONE:",
@@ -89,7 +92,13 @@ char* logfeaturenames[] = {
 volatile int direct_serial_log = DEFAULT_DIRECT_SERIAL_LOG;
 
 static int g_extraSocketToSendLOG = 0;
+// used by the writer to pack arguments and by the readers to format records,
+// always under logMemory.mutex
 static char g_loggingBuffer[LOGGING_BUFFER_SIZE];
+// g_loggingBuffer may still hold the text of the record with this sequence number
+static bool g_loggingBufferValid = false;
+static unsigned int g_loggingBufferSeq;
+static int g_loggingBufferLen;
 
 #define MAX_TCP_LOG_PORTS 2
 int tcp_log_ports[MAX_TCP_LOG_PORTS] = {-1};
@@ -115,12 +124,44 @@ static void startLogServer();
 
 int logTcpPort = LOGPORT;
 
+// The log memory stores records, not text. A record is the format pointer
+// and the arguments packed in the order the format consumes them, so
+// formatting is only done when a consumer (serial, TCP, HTTP) pulls it.
+// This is why addLogAdv must be given a literal (or static) format string.
+typedef struct logRecord_s {
+	// whole record size with this header; 0 marks a wrap to the buffer start
+	unsigned short size;
+	unsigned char level;
+	unsigned char feature;
+	unsigned int timestamp;
+	const char* fmt;
+	// packed arguments follow
+} logRecord_t;
+
+// read position of a single log consumer
+typedef struct logCursor_s {
+	unsigned int seq;
+	int offset;
+	// bytes of the current record text already consumed
+	int linePos;
+} logCursor_t;
+
+enum {
+	LOG_CURSOR_SERIAL,
+	LOG_CURSOR_TCP,
+	LOG_CURSOR_HTTP,
+	LOG_CURSOR_COUNT
+};
+
 static struct tag_logMemory {
 	char log[LOGSIZE];
+	// offset and sequence number of the next record to write
 	int head;
-	int tailserial;
-	int tailtcp;
-	int tailhttp;
+	unsigned int headSeq;
+	// offset and sequence number of the oldest stored record
+	int tail;
+	unsigned int tailSeq;
+	logCursor_t cursors[LOG_CURSOR_COUNT];
 	SemaphoreHandle_t mutex;
 } logMemory;
 
@@ -129,6 +170,7 @@ static int initialised = 0;
 static int tcpLogStarted = 0;
 
 commandResult_t log_command(const void* context, const char* cmd, const char* args, int cmdFlags);
+static commandResult_t log_stats(const void* context, const char* cmd, const char* args, int cmdFlags);
 
 #if PLATFORM_BEKEN
 // to get uart.h
@@ -179,7 +221,10 @@ logPort 1
 static void initLog(void)
 {
 	bk_printf("Entering initLog()...\r\n");
-	logMemory.head = logMemory.tailserial = logMemory.tailtcp = logMemory.tailhttp = 0;
+	logMemory.head = logMemory.tail = 0;
+	logMemory.headSeq = logMemory.tailSeq = 0;
+	memset(logMemory.cursors, 0, sizeof(logMemory.cursors));
+	g_loggingBufferValid = false;
 	logMemory.mutex = xSemaphoreCreateMutex();
 	initialised = 1;
 	startSerialLog();
@@ -206,6 +251,11 @@ static void initLog(void)
 	//cmddetail:"fn":"log_command","file":"logging/logging.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("logdelay", log_command, NULL);
+	//cmddetail:{"name":"logstats","args":"[reset]",
+	//cmddetail:"descr":"Prints, for each log feature, how many lines were logged and how many were dropped by the loglevel/logfeature filters. Use 'logstats reset' to clear the counters.",
+	//cmddetail:"fn":"log_stats","file":"logging/logging.c","requires":"",
+	//cmddetail:"examples":""}
+	CMD_RegisterCommand("logstats", log_stats, NULL);
 #if PLATFORM_BEKEN
 	//cmddetail:{"name":"logport","args":"[Index]",
 	//cmddetail:"descr":"Allows you to change log output port. On Beken, the UART1 is used for flashing and for TuyaMCU/BL0942, while UART2 is for log. Sometimes it might be easier for you to have log on UART1, so now you can just use this command like backlog uartInit 115200; logport 1 to enable logging on UART1..",
@@ -271,70 +321,473 @@ void LOG_SetCommandHTTPRedirectReply(http_request_t* request) {
 	}
 #endif
 
-// adds a log to the log memory
-// if head collides with either tail, move the tails on.
-void addLogAdv(int level, int feature, const char* fmt, ...)
-{
-	char* tmp;
-	char* t;
+// printf conversion, as far as packing and formatting need to know it
+typedef struct logSpec_s {
+	// points at the '%'
+	const char* start;
 	int len;
-	va_list argList;
-	BaseType_t taken;
-	int i;
+	char conv;
+	// 0, 'h', 'l', 'q' (ll), 'L', 'z', 'j' or 't'
+	char lengthMod;
+	char widthStar;
+	char precStar;
+	// -1 if not given
+	int precision;
+} logSpec_t;
+
+enum {
+	LOG_ARG_NONE,
+	LOG_ARG_INT,
+	LOG_ARG_LONG,
+	LOG_ARG_LLONG,
+	LOG_ARG_SIZE,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_LDOUBLE,
+	LOG_ARG_STR,
+	LOG_ARG_PTR,
+	// %n, consumes a pointer but stores nothing
+	LOG_ARG_SKIP,
+};
 
-	if (fmt == 0)
-	{
-		return;
+// p points just past the '%'
+static const char* LOG_ParseSpec(const char* p, logSpec_t* spec) {
+	spec->start = p - 1;
+	spec->lengthMod = 0;
+	spec->widthStar = 0;
+	spec->precStar = 0;
+	spec->precision = -1;
+	while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+		p++;
 	}
-	if (!((1 << feature) & logfeatures)) {
-		return;
+	if (*p == '*') {
+		spec->widthStar = 1;
+		p++;
 	}
-	if (level > loglevel) {
-		return;
+	else {
+		while (*p >= '0' && *p <= '9') {
+			p++;
+		}
 	}
+	if (*p == '.') {
+		p++;
+		spec->precision = 0;
+		if (*p == '*') {
+			spec->precStar = 1;
+			p++;
+		}
+		else {
+			while (*p >= '0' && *p <= '9') {
+				spec->precision = spec->precision * 10 + (*p - '0');
+				p++;
+			}
+		}
+	}
+	if (*p == 'h') {
+		spec->lengthMod = 'h';
+		p++;
+		if (*p == 'h') {
+			p++;
+		}
+	}
+	else if (*p == 'l') {
+		spec->lengthMod = 'l';
+		p++;
+		if (*p == 'l') {
+			spec->lengthMod = 'q';
+			p++;
+		}
+	}
+	else if (*p == 'L' || *p == 'z' || *p == 'j' || *p == 't') {
+		spec->lengthMod = *p;
+		p++;
+	}
+	spec->conv = *p;
+	if (*p) {
+		p++;
+	}
+	spec->len = p - spec->start;
+	return p;
+}
 
-	// if not initialised, direct output
-	if (!initialised) {
-		initLog();
+static int LOG_SpecArgType(const logSpec_t* spec) {
+	switch (spec->conv) {
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		if (spec->lengthMod == 'q' || spec->lengthMod == 'j')
+			return LOG_ARG_LLONG;
+		if (spec->lengthMod == 'l')
+			return LOG_ARG_LONG;
+		if (spec->lengthMod == 'z' || spec->lengthMod == 't')
+			return LOG_ARG_SIZE;
+		return LOG_ARG_INT;
+	case 'c':
+		return LOG_ARG_INT;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		if (spec->lengthMod == 'L')
+			return LOG_ARG_LDOUBLE;
+		return LOG_ARG_DOUBLE;
+	case 's':
+		return LOG_ARG_STR;
+	case 'p':
+		return LOG_ARG_PTR;
+	case 'n':
+		return LOG_ARG_SKIP;
 	}
-	if (g_StartupDelayOver && !tcpLogStarted){
-		inittcplog();
+	return LOG_ARG_NONE;
+}
+
+#define LOG_PACK_ARG(type) { \
+		type v = va_arg(argList, type); \
+		if (used + (int)sizeof(v) > outSize) \
+			return used; \
+		memcpy(out + used, &v, sizeof(v)); \
+		used += sizeof(v); \
 	}
 
+// Packs the arguments consumed by fmt into out. Packing stops at the first
+// argument that does not fit, formatting will then stop at the same place.
+// Strings are copied, since the caller's buffer may be gone by the time
+// the record is formatted.
+static int LOG_PackArgs(char* out, int outSize, const char* fmt, va_list argList) {
+	logSpec_t spec;
+	int used = 0;
+	int star[2];
+	int stars;
+	int precision;
+	int len;
+	const char* s;
+
+	while (*fmt) {
+		if (*fmt++ != '%')
+			continue;
+		fmt = LOG_ParseSpec(fmt, &spec);
+		stars = 0;
+		if (spec.widthStar)
+			star[stars++] = va_arg(argList, int);
+		if (spec.precStar)
+			star[stars++] = va_arg(argList, int);
+		if (used + stars * (int)sizeof(int) > outSize)
+			return used;
+		memcpy(out + used, star, stars * sizeof(int));
+		used += stars * sizeof(int);
+		precision = spec.precStar ? star[stars - 1] : spec.precision;
+
+		switch (LOG_SpecArgType(&spec)) {
+		case LOG_ARG_INT:
+			LOG_PACK_ARG(int);
+			break;
+		case LOG_ARG_LONG:
+			LOG_PACK_ARG(long);
+			break;
+		case LOG_ARG_LLONG:
+			LOG_PACK_ARG(long long);
+			break;
+		case LOG_ARG_SIZE:
+			LOG_PACK_ARG(size_t);
+			break;
+		case LOG_ARG_DOUBLE:
+			LOG_PACK_ARG(double);
+			break;
+		case LOG_ARG_LDOUBLE:
+			LOG_PACK_ARG(long double);
+			break;
+		case LOG_ARG_PTR:
+			LOG_PACK_ARG(void*);
+			break;
+		case LOG_ARG_SKIP:
+			va_arg(argList, void*);
+			break;
+		case LOG_ARG_STR:
+			s = va_arg(argList, const char*);
+			if (s == 0)
+				s = "(null)";
+			len = 0;
+			while (s[len] && (precision < 0 || len < precision)) {
+				len++;
+			}
+			if (len > outSize - used - 1) {
+				len = outSize - used - 1;
+				if (len < 0)
+					return used;
+				memcpy(out + used, s, len);
+				out[used + len] = 0;
+				return used + len + 1;
+			}
+			memcpy(out + used, s, len);
+			out[used + len] = 0;
+			used += len + 1;
+			break;
+		}
+	}
+	return used;
+}
 
-	taken = xSemaphoreTake(logMemory.mutex, 100);
-	tmp = g_loggingBuffer;
-	memset(tmp, 0, LOGGING_BUFFER_SIZE);
-	t = tmp;
+#define LOG_FORMAT_ARG(type) { \
+		type v; \
+		if (argsEnd - args < (int)sizeof(v)) \
+			goto done; \
+		memcpy(&v, args, sizeof(v)); \
+		args += sizeof(v); \
+		n = snprintf(out + pos, room - pos, mini, v); \
+	}
 
+static int LOG_WritePrefix(char* out, int level, int feature) {
+	char* t = out;
+
+	*t = 0;
 	if (feature == LOG_FEATURE_RAW)
 	{
 		// raw means no prefixes
 	}
 	else {
-		strncpy(t, loglevelnames[level], (LOGGING_BUFFER_SIZE - (3 + t - tmp)));
+		strncpy(t, loglevelnames[level], (LOGGING_BUFFER_SIZE - (3 + t - out)));
 		t += strlen(t);
 		if (feature < sizeof(logfeaturenames) / sizeof(*logfeaturenames))
 		{
-			strncpy(t, logfeaturenames[feature], (LOGGING_BUFFER_SIZE - (3 + t - tmp)));
+			strncpy(t, logfeaturenames[feature], (LOGGING_BUFFER_SIZE - (3 + t - out)));
 			t += strlen(t);
 		}
 	}
+	return t - out;
+}
 
-	va_start(argList, fmt);
-	//vsnprintf3(t, (LOGGING_BUFFER_SIZE - (3 + t - tmp)), fmt, argList);
-	//vsnprintf2(t, (LOGGING_BUFFER_SIZE - (3 + t - tmp)), fmt, argList);
-	vsnprintf(t, (LOGGING_BUFFER_SIZE - (3 + t - tmp)), fmt, argList);
-	va_end(argList);
-	if (tmp[strlen(tmp) - 1] == '\n') tmp[strlen(tmp) - 1] = '\0';
-	if (tmp[strlen(tmp) - 1] == '\r') tmp[strlen(tmp) - 1] = '\0';
+// replaces any line ending with \r\n, there must be 3 bytes left for it
+static int LOG_TerminateLine(char* tmp) {
+	int len;
 
-	len = strlen(tmp); // save 3 bytes at end for /r/n/0
+	len = strlen(tmp);
+	if (len && tmp[len - 1] == '\n') tmp[--len] = '\0';
+	if (len && tmp[len - 1] == '\r') tmp[--len] = '\0';
 	tmp[len++] = '\r';
 	tmp[len++] = '\n';
 	tmp[len] = '\0';
+	return len;
+}
+
+// Formats a stored record into out (LOGGING_BUFFER_SIZE bytes), giving the
+// same text addLogAdv used to put in the ring.
+static int LOG_FormatRecord(const char* recordData, char* out) {
+	logRecord_t rec;
+	logSpec_t spec;
+	const char* fmt;
+	const char* args;
+	const char* argsEnd;
+	char mini[32];
+	int room;
+	int pos;
+	int n;
+	int i, m;
+	int star[2];
+	int stars;
+
+	memcpy(&rec, recordData, sizeof(rec));
+	args = recordData + sizeof(rec);
+	argsEnd = recordData + rec.size;
+	room = LOGGING_BUFFER_SIZE - 2;
+	pos = LOG_WritePrefix(out, rec.level, rec.feature);
+
+	fmt = rec.fmt;
+	while (*fmt && pos < room - 1) {
+		if (*fmt != '%') {
+			out[pos++] = *fmt++;
+			continue;
+		}
+		fmt = LOG_ParseSpec(fmt + 1, &spec);
+		if (spec.conv == '%') {
+			out[pos++] = '%';
+			continue;
+		}
+		stars = spec.widthStar + spec.precStar;
+		if (LOG_SpecArgType(&spec) == LOG_ARG_NONE) {
+			// not something we know how to format, print it as it is
+			n = spec.len;
+			if (n > room - 1 - pos)
+				n = room - 1 - pos;
+			memcpy(out + pos, spec.start, n);
+			pos += n;
+			continue;
+		}
+		if (argsEnd - args < stars * (int)sizeof(int))
+			goto done;
+		memcpy(star, args, stars * sizeof(int));
+		args += stars * sizeof(int);
+		// rebuild the conversion with '*' replaced by the stored values
+		m = 0;
+		stars = 0;
+		for (i = 0; i < spec.len && m < sizeof(mini) - 12; i++) {
+			if (spec.start[i] == '*') {
+				m += sprintf(mini + m, "%i", star[stars++]);
+			}
+			else {
+				mini[m++] = spec.start[i];
+			}
+		}
+		mini[m] = 0;
+		if (i < spec.len)
+			goto done;
+
+		n = 0;
+		switch (LOG_SpecArgType(&spec)) {
+		case LOG_ARG_INT:
+			LOG_FORMAT_ARG(int);
+			break;
+		case LOG_ARG_LONG:
+			LOG_FORMAT_ARG(long);
+			break;
+		case LOG_ARG_LLONG:
+			LOG_FORMAT_ARG(long long);
+			break;
+		case LOG_ARG_SIZE:
+			LOG_FORMAT_ARG(size_t);
+			break;
+		case LOG_ARG_DOUBLE:
+			LOG_FORMAT_ARG(double);
+			break;
+		case LOG_ARG_LDOUBLE:
+			LOG_FORMAT_ARG(long double);
+			break;
+		case LOG_ARG_PTR:
+			LOG_FORMAT_ARG(void*);
+			break;
+		case LOG_ARG_STR:
+			if (args >= argsEnd || memchr(args, 0, argsEnd - args) == 0)
+				goto done;
+			n = snprintf(out + pos, room - pos, mini, args);
+			args += strlen(args) + 1;
+			break;
+		}
+		if (n > room - 1 - pos)
+			n = room - 1 - pos;
+		if (n > 0)
+			pos += n;
+	}
+done:
+	out[pos] = 0;
+	return LOG_TerminateLine(out);
+}
+
+// offset of the record stored at (or wrapped from) the given offset
+static int LOG_RecordOffset(int offset) {
+	unsigned short size;
+
+	if (LOGSIZE - offset < (int)sizeof(logRecord_t))
+		return 0;
+	memcpy(&size, logMemory.log + offset, sizeof(size));
+	if (size == 0)
+		return 0;
+	return offset;
+}
+
+static int LOG_RecordSize(int offset) {
+	unsigned short size;
+
+	memcpy(&size, logMemory.log + offset, sizeof(size));
+	return size;
+}
+
+static void LOG_DropOldest() {
+	logMemory.tail += LOG_RecordSize(logMemory.tail);
+	logMemory.tailSeq++;
+	if (logMemory.tailSeq == logMemory.headSeq) {
+		logMemory.tail = logMemory.head;
+	}
+	else {
+		logMemory.tail = LOG_RecordOffset(logMemory.tail);
+	}
+}
+
+// makes room for a record of given size at the head, dropping the oldest
+// records if needed; records are never split across the buffer end
+static int LOG_ReserveRecord(int size) {
+	int offset;
+	int i;
+
+	if (LOGSIZE - logMemory.head < size) {
+		// everything stored between head and the end of buffer is lost by wrapping
+		while (logMemory.tailSeq != logMemory.headSeq && logMemory.tail >= logMemory.head) {
+			LOG_DropOldest();
+		}
+		if (LOGSIZE - logMemory.head >= (int)sizeof(unsigned short)) {
+			memset(logMemory.log + logMemory.head, 0, sizeof(unsigned short));
+		}
+		logMemory.head = 0;
+		if (logMemory.tailSeq == logMemory.headSeq) {
+			logMemory.tail = 0;
+		}
+		// consumers that have read everything will find the next record at the start
+		for (i = 0; i < LOG_CURSOR_COUNT; i++) {
+			if (logMemory.cursors[i].seq == logMemory.headSeq) {
+				logMemory.cursors[i].offset = 0;
+			}
+		}
+	}
+	while (logMemory.tailSeq != logMemory.headSeq && logMemory.tail >= logMemory.head
+		&& logMemory.tail < logMemory.head + size) {
+		LOG_DropOldest();
+	}
+	offset = logMemory.head;
+	logMemory.head += size;
+	return offset;
+}
+
+// moves a consumer that fell behind to the oldest stored record,
+// returns 1 if it has missed some records
+static int LOG_SyncCursor(logCursor_t* cursor) {
+	if ((int)(cursor->seq - logMemory.tailSeq) >= 0)
+		return 0;
+	cursor->seq = logMemory.tailSeq;
+	cursor->offset = logMemory.tail;
+	cursor->linePos = 0;
+	return 1;
+}
+
+static void LOG_AdvanceCursor(logCursor_t* cursor) {
+	cursor->offset += LOG_RecordSize(cursor->offset);
+	cursor->seq++;
+	cursor->linePos = 0;
+	if (cursor->seq != logMemory.headSeq) {
+		cursor->offset = LOG_RecordOffset(cursor->offset);
+	}
+}
+
+// formats the record under the cursor into g_loggingBuffer, returns text length
+static int LOG_GetCursorText(logCursor_t* cursor) {
+	if (g_loggingBufferValid == false || g_loggingBufferSeq != cursor->seq) {
+		g_loggingBufferLen = LOG_FormatRecord(logMemory.log + cursor->offset, g_loggingBuffer);
+		g_loggingBufferSeq = cursor->seq;
+		g_loggingBufferValid = true;
+	}
+	return g_loggingBufferLen;
+}
+
+// outputs that want each line as soon as it is logged
+static bool LOG_HasImmediateOutput() {
 #if WINDOWS
-	printf(tmp);
+	if (direct_serial_log != LOGTYPE_NONE)
+		return true;
+#endif
+#if PLATFORM_XR809
+	return true;
+#endif
+	return g_log_alsoPrintToHTTP || g_extraSocketToSendLOG || log_delay < 0;
+}
+
+static void LOG_SendImmediate(const char* tmp, int len) {
+#if WINDOWS
+	if (direct_serial_log != LOGTYPE_NONE) {
+		printf("%s", tmp);
+	}
 #endif
 #if PLATFORM_XR809
 	printf(tmp);
@@ -357,10 +810,60 @@ void addLogAdv(int level, int feature, const char* fmt, ...)
 	}
 	if (g_extraSocketToSendLOG)
 	{
-		send(g_extraSocketToSendLOG, tmp, strlen(tmp), 0);
+		send(g_extraSocketToSendLOG, tmp, len, 0);
 	}
+}
+
+// adds a log record to the log memory
+// if head reaches the oldest records, they are dropped; consumers
+// that did not read them yet will skip to the oldest one left.
+void addLogAdv(int level, int feature, const char* fmt, ...)
+{
+	char* tmp;
+	int len;
+	int size;
+	int offset;
+	logRecord_t rec;
+	va_list argList;
+	BaseType_t taken;
+
+	if (fmt == 0)
+	{
+		return;
+	}
+	if (!((1 << feature) & logfeatures)) {
+		LOG_CountSuppressed(feature);
+		return;
+	}
+	if (level > loglevel || level > LOG_COMPILE_LEVEL) {
+		LOG_CountSuppressed(feature);
+		return;
+	}
+	if ((unsigned int)feature < LOG_FEATURE_MAX) {
+		logEmittedCount[feature]++;
+	}
+
+	// if not initialised, direct output
+	if (!initialised) {
+		initLog();
+	}
+	if (g_StartupDelayOver && !tcpLogStarted){
+		inittcplog();
+	}
+
+
+	taken = xSemaphoreTake(logMemory.mutex, 100);
+	tmp = g_loggingBuffer;
+	g_loggingBufferValid = false;
 
 	if (direct_serial_log == LOGTYPE_DIRECT) {
+		// direct log does not go to the log memory, so format it right away
+		len = LOG_WritePrefix(tmp, level, feature);
+		va_start(argList, fmt);
+		vsnprintf(tmp + len, (LOGGING_BUFFER_SIZE - (3 + len)), fmt, argList);
+		va_end(argList);
+		len = LOG_TerminateLine(tmp);
+		LOG_SendImmediate(tmp, len);
 		bk_printf("%s", tmp);
 		if (taken == pdTRUE) {
 			xSemaphoreGive(logMemory.mutex);
@@ -377,22 +880,27 @@ void addLogAdv(int level, int feature, const char* fmt, ...)
 		return;
 	}
 
-	for ( i = 0; i < len; i++)
-	{
-		logMemory.log[logMemory.head] = tmp[i];
-		logMemory.head = (logMemory.head + 1) % LOGSIZE;
-		if (logMemory.tailserial == logMemory.head)
-		{
-			logMemory.tailserial = (logMemory.tailserial + 1) % LOGSIZE;
-		}
-		if (logMemory.tailtcp == logMemory.head)
-		{
-			logMemory.tailtcp = (logMemory.tailtcp + 1) % LOGSIZE;
-		}
-		if (logMemory.tailhttp == logMemory.head)
-		{
-			logMemory.tailhttp = (logMemory.tailhttp + 1) % LOGSIZE;
-		}
+	va_start(argList, fmt);
+	size = sizeof(rec) + LOG_PackArgs(tmp + sizeof(rec), LOGGING_BUFFER_SIZE - sizeof(rec), fmt, argList);
+	va_end(argList);
+	rec.size = size;
+	rec.level = level;
+	rec.feature = feature;
+	rec.timestamp = xTaskGetTickCount();
+	rec.fmt = fmt;
+	memcpy(tmp, &rec, sizeof(rec));
+
+	offset = LOG_ReserveRecord(size);
+	memcpy(logMemory.log + offset, tmp, size);
+	logMemory.headSeq++;
+
+	len = 0;
+	if (LOG_HasImmediateOutput()) {
+		len = LOG_FormatRecord(logMemory.log + offset, tmp);
+		g_loggingBufferSeq = logMemory.headSeq - 1;
+		g_loggingBufferLen = len;
+		g_loggingBufferValid = true;
+		LOG_SendImmediate(tmp, len);
 	}
 
 	if (taken == pdTRUE) {
@@ -400,14 +908,14 @@ void addLogAdv(int level, int feature, const char* fmt, ...)
 	}
 #ifdef PLATFORM_BEKEN
 	trigger_log_send();
-#endif	
-	if (log_delay != 0) 
+#endif
+	if (log_delay != 0)
     {
 		int timems = log_delay;
 		// is log_delay set -ve, then calculate delay
 		// required for the number of characters to TX
 		// plus 2ms to be sure.
-		if (log_delay < 0) 
+		if (log_delay < 0)
         {
 			int cps = (115200 / 8);
 			timems = (((1000 / portTICK_RATE_MS) * len) / cps) + 2;
@@ -419,27 +927,31 @@ void addLogAdv(int level, int feature, const char* fmt, ...)
 }
 
 
-static int getData(char* buff, int buffsize, int* tail) {
+static int getData(char* buff, int buffsize, logCursor_t* cursor) {
 	BaseType_t taken;
 	int count;
-	char* p;
+	int len;
+	int n;
 	if (!initialised)
 		return 0;
 	taken = xSemaphoreTake(logMemory.mutex, 100);
 
+	LOG_SyncCursor(cursor);
 	count = 0;
-	p = buff;
-	while (buffsize > 1) {
-		if (*tail == logMemory.head) {
-			break;
+	while (buffsize > 1 && cursor->seq != logMemory.headSeq) {
+		len = LOG_GetCursorText(cursor);
+		n = len - cursor->linePos;
+		if (n > buffsize - 1)
+			n = buffsize - 1;
+		memcpy(buff + count, g_loggingBuffer + cursor->linePos, n);
+		count += n;
+		buffsize -= n;
+		cursor->linePos += n;
+		if (cursor->linePos >= len) {
+			LOG_AdvanceCursor(cursor);
 		}
-		*p = logMemory.log[*tail];
-		p++;
-		(*tail) = ((*tail) + 1) % LOGSIZE;
-		buffsize--;
-		count++;
 	}
-	*p = 0;
+	buff[count] = 0;
 
 	if (taken == pdTRUE) {
 		xSemaphoreGive(logMemory.mutex);
@@ -455,31 +967,32 @@ static int getData(char* buff, int buffsize, int* tail) {
 // H/W TX fifo seems to be 256 bytes!!!
 static int getSerial2() {
 	if (!initialised) return 0;
-	int* tail = &logMemory.tailserial;
+	logCursor_t* cursor = &logMemory.cursors[LOG_CURSOR_SERIAL];
+	int len;
 	char c;
 	BaseType_t taken = xSemaphoreTake(logMemory.mutex, 100);
-	char overflow = 0;
-
 	// if we hit overflow
-	if (logMemory.tailserial == (logMemory.head + 1) % LOGSIZE) {
-		overflow = 1;
-	}
+	char overflow = LOG_SyncCursor(cursor);
 
-	while ((*tail != logMemory.head) && !uart_is_tx_fifo_full(UART_PORT)) {
-		c = logMemory.log[*tail];
+	while ((cursor->seq != logMemory.headSeq) && !uart_is_tx_fifo_full(UART_PORT)) {
+		len = LOG_GetCursorText(cursor);
+		c = g_loggingBuffer[cursor->linePos];
 		if (overflow) {
 			c = '^'; // replace the first char with ^ if we overflowed....
 			overflow = 0;
 		}
 
-		(*tail) = ((*tail) + 1) % LOGSIZE;
+		cursor->linePos++;
+		if (cursor->linePos >= len) {
+			LOG_AdvanceCursor(cursor);
+		}
 
 		if (direct_serial_log == LOGTYPE_THREAD) {
 			UART_WRITE_BYTE(UART_PORT_INDEX, c);
 		}
 	}
 
-	int remains = (*tail != logMemory.head);
+	int remains = (cursor->seq != logMemory.headSeq);
 
 	if (taken == pdTRUE) {
 		xSemaphoreGive(logMemory.mutex);
@@ -490,7 +1003,7 @@ static int getSerial2() {
 #else
 
 static int getSerial(char* buff, int buffsize) {
-	int len = getData(buff, buffsize, &logMemory.tailserial);
+	int len = getData(buff, buffsize, &logMemory.cursors[LOG_CURSOR_SERIAL]);
 	//bk_printf("got serial: %d:%s\r\n", len, buff);
 	return len;
 }
@@ -499,13 +1012,13 @@ static int getSerial(char* buff, int buffsize) {
 
 
 static int getTcp(char* buff, int buffsize) {
-	int len = getData(buff, buffsize, &logMemory.tailtcp);
+	int len = getData(buff, buffsize, &logMemory.cursors[LOG_CURSOR_TCP]);
 	//bk_printf("got tcp: %d:%s\r\n", len,buff);
 	return len;
 }
 
 static int getHttp(char* buff, int buffsize) {
-	int len = getData(buff, buffsize, &logMemory.tailhttp);
+	int len = getData(buff, buffsize, &logMemory.cursors[LOG_CURSOR_HTTP]);
 	//printf("got tcp: %d:%s\r\n", len,buff);
 	return len;
 }
@@ -606,7 +1119,7 @@ void log_server_thread(beken_thread_arg_t arg)
                         "Logging TCP Client",
                         (beken_thread_function_t)log_client_thread,
                         0x800,
-                        (beken_thread_arg_t)client_fd))
+                        (beken_thread_arg_t)(intptr_t)client_fd))
                 {
 					close(client_fd);
 					client_fd = -1;
@@ -665,7 +1178,7 @@ static void send_to_tcp(){
 // non-beken
 static void log_client_thread(beken_thread_arg_t arg)
 {
-	int fd = (int)arg;
+	int fd = (int)(intptr_t)arg;
 	while (1) {
 		int count = getTcp(tcplogbuf, TCPLOGBUFSIZE);
 		if (count) {
@@ -738,6 +1251,23 @@ static int http_getlog(http_request_t* request) {
 }
 
 
+static commandResult_t log_stats(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	int i;
+
+	if (args && !stricmp(args, "reset")) {
+		memset(logEmittedCount, 0, sizeof(logEmittedCount));
+		memset(logSuppressedCount, 0, sizeof(logSuppressedCount));
+		return CMD_RES_OK;
+	}
+	for (i = 0; i < LOG_FEATURE_MAX; i++) {
+		if (logEmittedCount[i] || logSuppressedCount[i]) {
+			ADDLOG_INFO(LOG_FEATURE_CMD, "%s logged %u, filtered %u", logfeaturenames[i],
+				logEmittedCount[i], logSuppressedCount[i]);
+		}
+	}
+	return CMD_RES_OK;
+}
+
 commandResult_t log_command(const void* context, const char* cmd, const char* args, int cmdFlags) {
 	int result = 0;
 	if (!cmd) return CMD_RES_NOT_ENOUGH_ARGUMENTS;
@@ -14,20 +14,47 @@
 #ifndef _OBK_LOGGING_H
 #define _OBK_LOGGING_H
 
+// fmt must be a string literal (or otherwise outlive the log memory),
+// the line is formatted later, when it is read from the log memory
 void addLogAdv(int level, int feature, const char *fmt, ...);
 void LOG_SetRawSocketCallback(int newFD);
+void LOG_DeInit();
 
-#define ADDLOG_ERROR(x, fmt, ...) addLogAdv(LOG_ERROR, x, fmt, ##__VA_ARGS__)
-#define ADDLOG_WARN(x, fmt, ...)  addLogAdv(LOG_WARN, x, fmt, ##__VA_ARGS__)
-#define ADDLOG_INFO(x, fmt, ...)  addLogAdv(LOG_INFO, x, fmt, ##__VA_ARGS__)
-#define ADDLOG_DEBUG(x, fmt, ...) addLogAdv(LOG_DEBUG, x, fmt, ##__VA_ARGS__)
-#define ADDLOG_EXTRADEBUG(x, fmt, ...) addLogAdv(LOG_EXTRADEBUG, x, fmt, ##__VA_ARGS__)
+// Lowest priority level that is compiled in at all. ADDLOG_* lines above it
+// are removed by the compiler, eg. -DLOG_COMPILE_LEVEL=LOG_INFO drops all
+// DEBUG and EXTRADEBUG lines from the build.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_ALL
+#endif
+
+// true if a line with given level and feature would be logged;
+// can be used to skip preparing arguments for a log line
+#define LOG_IsEnabled(level, feature) ((level) <= LOG_COMPILE_LEVEL && (level) <= loglevel && ((1 << (feature)) & logfeatures))
+
+#define LOG_CountSuppressed(feature) { if ((unsigned int)(feature) < LOG_FEATURE_MAX) logSuppressedCount[feature]++; }
 
-#define ADDLOGF_ERROR(fmt, ...) addLogAdv(LOG_ERROR, LOG_FEATURE, fmt, ##__VA_ARGS__)
-#define ADDLOGF_WARN(fmt, ...)  addLogAdv(LOG_WARN, LOG_FEATURE, fmt, ##__VA_ARGS__)
-#define ADDLOGF_INFO(fmt, ...)  addLogAdv(LOG_INFO, LOG_FEATURE, fmt, ##__VA_ARGS__)
-#define ADDLOGF_DEBUG(fmt, ...) addLogAdv(LOG_DEBUG, LOG_FEATURE, fmt, ##__VA_ARGS__)
-#define ADDLOGF_EXTRADEBUG(fmt, ...) addLogAdv(LOG_EXTRADEBUG, LOG_FEATURE, fmt, ##__VA_ARGS__)
+// level and feature filters are checked inline, so a filtered line
+// costs neither the call nor the evaluation of its arguments
+#define ADDLOG_LEVEL(level, x, fmt, ...) do { \
+		if ((level) <= LOG_COMPILE_LEVEL) { \
+			if ((level) <= loglevel && ((1 << (x)) & logfeatures)) \
+				addLogAdv(level, x, fmt, ##__VA_ARGS__); \
+			else \
+				LOG_CountSuppressed(x); \
+		} \
+	} while (0)
+
+#define ADDLOG_ERROR(x, fmt, ...) ADDLOG_LEVEL(LOG_ERROR, x, fmt, ##__VA_ARGS__)
+#define ADDLOG_WARN(x, fmt, ...)  ADDLOG_LEVEL(LOG_WARN, x, fmt, ##__VA_ARGS__)
+#define ADDLOG_INFO(x, fmt, ...)  ADDLOG_LEVEL(LOG_INFO, x, fmt, ##__VA_ARGS__)
+#define ADDLOG_DEBUG(x, fmt, ...) ADDLOG_LEVEL(LOG_DEBUG, x, fmt, ##__VA_ARGS__)
+#define ADDLOG_EXTRADEBUG(x, fmt, ...) ADDLOG_LEVEL(LOG_EXTRADEBUG, x, fmt, ##__VA_ARGS__)
+
+#define ADDLOGF_ERROR(fmt, ...) ADDLOG_LEVEL(LOG_ERROR, LOG_FEATURE, fmt, ##__VA_ARGS__)
+#define ADDLOGF_WARN(fmt, ...)  ADDLOG_LEVEL(LOG_WARN, LOG_FEATURE, fmt, ##__VA_ARGS__)
+#define ADDLOGF_INFO(fmt, ...)  ADDLOG_LEVEL(LOG_INFO, LOG_FEATURE, fmt, ##__VA_ARGS__)
+#define ADDLOGF_DEBUG(fmt, ...) ADDLOG_LEVEL(LOG_DEBUG, LOG_FEATURE, fmt, ##__VA_ARGS__)
+#define ADDLOGF_EXTRADEBUG(fmt, ...) ADDLOG_LEVEL(LOG_EXTRADEBUG, LOG_FEATURE, fmt, ##__VA_ARGS__)
 
 
 extern int loglevel;
@@ -36,6 +63,11 @@ extern char *loglevelnames[];
 extern unsigned int logfeatures;
 extern char *logfeaturenames[];
 
+// per feature count of lines logged and lines dropped by the filters
+// (lines removed by LOG_COMPILE_LEVEL are not counted)
+extern unsigned int logEmittedCount[];
+extern unsigned int logSuppressedCount[];
+
 extern volatile int direct_serial_log;
 
 typedef enum logType_e {
@@ -56,58 +56,100 @@ static short g_teleSensor_interval = 3;
 // mqtt receive buffer, so we can action in our threads, not
 // in tcp_thread
 //
+// Received messages are stored as whole records, each one a contiguous span:
+// [topicLen hi][topicLen lo][dataLen hi][dataLen lo][topic][0][data][0]
+// A record never wraps; if it doesn't fit at the end, a wrap marker is left
+// there and it goes to the start. Consumer reads topic and data in place.
+//
 #define MQTT_RX_BUFFER_MAX 4096
-unsigned char mqtt_rx_buffer[MQTT_RX_BUFFER_MAX];
-int mqtt_rx_buffer_head;
-int mqtt_rx_buffer_tail;
-int mqtt_rx_buffer_count;
-unsigned char temp_topic[128];
-unsigned char temp_data[2048];
-
-int addLenData(int len, const unsigned char *data){
-	mqtt_rx_buffer[mqtt_rx_buffer_head] = (len >> 8) & 0xff;
-	mqtt_rx_buffer_head = (mqtt_rx_buffer_head + 1) % MQTT_RX_BUFFER_MAX;
-	mqtt_rx_buffer_count++;
-	mqtt_rx_buffer[mqtt_rx_buffer_head] = (len) & 0xff;
-	mqtt_rx_buffer_head = (mqtt_rx_buffer_head + 1) % MQTT_RX_BUFFER_MAX;
-	mqtt_rx_buffer_count++;
-	for (int i = 0; i < len; i++){
-		mqtt_rx_buffer[mqtt_rx_buffer_head] = data[i];
-		mqtt_rx_buffer_head = (mqtt_rx_buffer_head + 1) % MQTT_RX_BUFFER_MAX;
-		mqtt_rx_buffer_count++;
-	}
-	return len + 2;
-}
-
-int getLenData(int *len, unsigned char *data, int maxlen){
-	int l;
-	l = mqtt_rx_buffer[mqtt_rx_buffer_tail];
-	mqtt_rx_buffer_tail = (mqtt_rx_buffer_tail + 1) % MQTT_RX_BUFFER_MAX;
-	mqtt_rx_buffer_count--;
-	l = l<<8;
-	l |= mqtt_rx_buffer[mqtt_rx_buffer_tail];
-	mqtt_rx_buffer_tail = (mqtt_rx_buffer_tail + 1) % MQTT_RX_BUFFER_MAX;
-	mqtt_rx_buffer_count--;
-
-	for (int i = 0; i < l; i++){
-		if (i < maxlen){
-			data[i] = mqtt_rx_buffer[mqtt_rx_buffer_tail];
-		}
-		mqtt_rx_buffer_tail = (mqtt_rx_buffer_tail + 1) % MQTT_RX_BUFFER_MAX;
-		mqtt_rx_buffer_count--;
+#define MQTT_RX_RECORD_HEADER 4
+#define MQTT_RX_WRAP_MARKER 0xFFFF
+static unsigned char mqtt_rx_buffer[MQTT_RX_BUFFER_MAX];
+static int mqtt_rx_buffer_head;
+static int mqtt_rx_buffer_tail;
+// bytes in use, including the unused end of the buffer before a wrap
+static int mqtt_rx_buffer_count;
+// messages that didn't fit in free space
+static int mqtt_rx_overflows = 0;
+// messages that were lost for any reason (overflow, too large for buffer)
+static int mqtt_rx_drops = 0;
+
+static int MQTT_RxRecordSize(int topiclen, int datalen) {
+	return MQTT_RX_RECORD_HEADER + topiclen + 1 + datalen + 1;
+}
+// returns 0 if there is no contiguous space for the record; called with mutex taken
+static unsigned char *MQTT_RxReserve(int size) {
+	unsigned char *r;
+	int endSpace;
+
+	if (mqtt_rx_buffer_count == 0) {
+		// empty - start from beginning, so there is the most contiguous space
+		mqtt_rx_buffer_head = mqtt_rx_buffer_tail = 0;
+	}
+	if (mqtt_rx_buffer_count == 0 || mqtt_rx_buffer_head > mqtt_rx_buffer_tail) {
+		endSpace = MQTT_RX_BUFFER_MAX - mqtt_rx_buffer_head;
+		if (size > endSpace) {
+			// wrap; the start must have room and must not meet the tail
+			if (size > mqtt_rx_buffer_tail) {
+				return 0;
+			}
+			if (endSpace >= 2) {
+				mqtt_rx_buffer[mqtt_rx_buffer_head] = (MQTT_RX_WRAP_MARKER >> 8) & 0xff;
+				mqtt_rx_buffer[mqtt_rx_buffer_head + 1] = MQTT_RX_WRAP_MARKER & 0xff;
+			}
+			mqtt_rx_buffer_count += endSpace;
+			mqtt_rx_buffer_head = 0;
+		}
+	}
+	else if (size > mqtt_rx_buffer_tail - mqtt_rx_buffer_head) {
+		return 0;
+	}
+	r = mqtt_rx_buffer + mqtt_rx_buffer_head;
+	mqtt_rx_buffer_head += size;
+	mqtt_rx_buffer_count += size;
+	if (mqtt_rx_buffer_head == MQTT_RX_BUFFER_MAX) {
+		mqtt_rx_buffer_head = 0;
+	}
+	return r;
+}
+// skips wrap marker or unused end, returns record at tail or 0 if empty; called with mutex taken
+static unsigned char *MQTT_RxFront() {
+	unsigned char *r;
+	int endSpace;
+
+	if (mqtt_rx_buffer_count == 0) {
+		return 0;
+	}
+	endSpace = MQTT_RX_BUFFER_MAX - mqtt_rx_buffer_tail;
+	r = mqtt_rx_buffer + mqtt_rx_buffer_tail;
+	if (endSpace < 2 || ((r[0] << 8) | r[1]) == MQTT_RX_WRAP_MARKER) {
+		mqtt_rx_buffer_count -= endSpace;
+		mqtt_rx_buffer_tail = 0;
+		if (mqtt_rx_buffer_count <= 0) {
+			return 0;
+		}
+		r = mqtt_rx_buffer;
+	}
+	return r;
+}
+// called with mutex taken
+static void MQTT_RxRelease(int size) {
+	mqtt_rx_buffer_tail += size;
+	mqtt_rx_buffer_count -= size;
+	if (mqtt_rx_buffer_tail == MQTT_RX_BUFFER_MAX) {
+		mqtt_rx_buffer_tail = 0;
 	}
 	if (mqtt_rx_buffer_count < 0){
-		addLogAdv(LOG_ERROR, LOG_FEATURE_MQTT, "MQTT_rx buffer underflow!!!");
+		ADDLOG_ERROR(LOG_FEATURE_MQTT, "MQTT_rx buffer underflow!!!");
 		mqtt_rx_buffer_count = 0;
 		mqtt_rx_buffer_tail = mqtt_rx_buffer_head = 0;
 	}
-
-	if (l > maxlen){
-		*len = maxlen;
-	} else {
-		*len = l;
-	}
-	return l + 2;
+}
+int MQTT_GetReceiveOverflowCounter(void) {
+	return mqtt_rx_overflows;
+}
+int MQTT_GetReceiveDropCounter(void) {
+	return mqtt_rx_drops;
 }
 
 static SemaphoreHandle_t g_mutex = 0;
@@ -138,16 +180,37 @@ static void MQTT_Mutex_Free()
 // system can use it to spoof MQTT packets to check if MQTT commands
 // are working...
 int MQTT_Post_Received(const char *topic, int topiclen, const unsigned char *data, int datalen){
+	unsigned char *r;
+	int size;
+
+	size = MQTT_RxRecordSize(topiclen, datalen);
 	MQTT_Mutex_Take(100);
-	if ((MQTT_RX_BUFFER_MAX - 1 - mqtt_rx_buffer_count) < topiclen + datalen + 2 + 2){
-		addLogAdv(LOG_ERROR, LOG_FEATURE_MQTT, "MQTT_rx buffer overflow for topic %s", topic);
+	if (size > MQTT_RX_BUFFER_MAX) {
+		ADDLOG_ERROR(LOG_FEATURE_MQTT, "MQTT_rx message too large (%i) for topic %s", datalen, topic);
+		mqtt_rx_drops++;
+		r = 0;
 	} else {
-		addLenData(topiclen, (unsigned char *)topic);
-		addLenData(datalen, data);
+		r = MQTT_RxReserve(size);
+		if (r == 0) {
+			ADDLOG_ERROR(LOG_FEATURE_MQTT, "MQTT_rx buffer overflow for topic %s", topic);
+			mqtt_rx_overflows++;
+			mqtt_rx_drops++;
+		}
+	}
+	if (r) {
+		r[0] = (topiclen >> 8) & 0xff;
+		r[1] = topiclen & 0xff;
+		r[2] = (datalen >> 8) & 0xff;
+		r[3] = datalen & 0xff;
+		r += MQTT_RX_RECORD_HEADER;
+		memcpy(r, topic, topiclen);
+		r[topiclen] = 0;
+		r += topiclen + 1;
+		memcpy(r, data, datalen);
+		r[datalen] = 0;
 	}
 	MQTT_Mutex_Free();
 
-
 #ifdef PLATFORM_BEKEN
 	MQTT_TriggerRead();
 #endif
@@ -156,20 +219,23 @@ int MQTT_Post_Received(const char *topic, int topiclen, const unsigned char *dat
 int MQTT_Post_Received_Str(const char *topic, const char *data) {
 	return MQTT_Post_Received(topic, strlen(topic), (const unsigned char*)data, strlen(data));
 }
-int get_received(char **topic, int *topiclen, unsigned char **data, int *datalen){
-	int res = 0;
+// Views of the oldest received message, in place; terminated with 0.
+// Returns record size to pass to MQTT_RxRelease, or 0 if there is nothing.
+static int get_received(const char **topic, int *topiclen, const unsigned char **data, int *datalen){
+	unsigned char *r;
+	int size = 0;
+
 	MQTT_Mutex_Take(100);
-	if (mqtt_rx_buffer_tail != mqtt_rx_buffer_head){
-		getLenData(topiclen, temp_topic, sizeof(temp_topic)-1);
-		temp_topic[*topiclen] = 0;
-		getLenData(datalen, temp_data, sizeof(temp_data)-1);
-		temp_data[*datalen] = 0;
-		*topic = (char *)temp_topic;
-		*data = temp_data;
-		res = 1;
-	}
+	r = MQTT_RxFront();
 	MQTT_Mutex_Free();
-	return res;
+	if (r) {
+		*topiclen = (r[0] << 8) | r[1];
+		*datalen = (r[2] << 8) | r[3];
+		*topic = (const char *)(r + MQTT_RX_RECORD_HEADER);
+		*data = r + MQTT_RX_RECORD_HEADER + *topiclen + 1;
+		size = MQTT_RxRecordSize(*topiclen, *datalen);
+	}
+	return size;
 }
 //
 //////////////////////////////////////////////////////////////////////
@@ -194,6 +260,36 @@ static char mqtt_status_message[256];
 static int mqtt_published_events = 0;
 static int mqtt_publish_errors = 0;
 static int mqtt_received_events = 0;
+// publishes that had to allocate their topic on heap
+static int mqtt_publish_allocs = 0;
+
+// classes of publishes that can have their own QoS
+enum {
+	MQTT_PUBLISH_CLASS_CHANNEL,	// <client>/<channel>/get
+	MQTT_PUBLISH_CLASS_MAIN,	// other <client>/<name>/get values, like sensor readings
+	MQTT_PUBLISH_CLASS_TELE,
+	MQTT_PUBLISH_CLASS_STAT,
+	MQTT_PUBLISH_CLASS_OTHER,	// publish command, queued publishes, benchmark
+	MQTT_PUBLISH_CLASS_COUNT
+};
+static const char* g_mqttPublishClassNames[MQTT_PUBLISH_CLASS_COUNT] = {
+	"channel", "main", "tele", "stat", "other"
+};
+static byte g_mqttPublishQoS[MQTT_PUBLISH_CLASS_COUNT] = { 2, 2, 2, 2, 2 };
+
+// pre-rendered topics, rebuilt when client ID changes.
+// Longest template is client ID with "/63/get" appended, or "tele/" prepended
+#define MQTT_TOPIC_TEMPLATE_MAX	(CGF_MQTT_CLIENT_ID_SIZE + 8)
+// room for every channel plus tele and stat
+#define MQTT_TOPIC_ARENA_SIZE	((CHANNEL_MAX + 2) * MQTT_TOPIC_TEMPLATE_MAX)
+// topics longer than that are rendered on heap
+#define MQTT_TOPIC_STACK_SIZE	128
+static char g_mqttTopicArena[MQTT_TOPIC_ARENA_SIZE];
+// offsets into g_mqttTopicArena, -1 if there was no space left
+static short g_mqttChannelTopics[CHANNEL_MAX];
+static short g_mqttTeleTopic = -1;
+static short g_mqttStatTopic = -1;
+static bool g_mqttTopicTemplatesBuilt = false;
 
 static int g_just_connected = 0;
 
@@ -202,14 +298,41 @@ typedef struct mqtt_callback_tag {
 	char* topic;
 	char* subscriptionTopic;
 	int ID;
+	// registration order, matched callbacks are called in this order
+	int order;
 	mqtt_callback_fn callback;
+	struct mqtt_callback_tag* next;
+	// next callback ending at the same topic trie node
+	struct mqtt_callback_tag* nextInNode;
+	struct mqtt_topicNode_tag* node;
 } mqtt_callback_t;
 
-#define MAX_MQTT_CALLBACKS 32
-static mqtt_callback_t* callbacks[MAX_MQTT_CALLBACKS];
-static int numCallbacks = 0;
+// one topic level of the subscription trie, level is a literal text, "+" or "#"
+typedef struct mqtt_topicNode_tag {
+	struct mqtt_topicNode_tag* children;
+	struct mqtt_topicNode_tag* sibling;
+	mqtt_callback_t* callbacks;
+	char level[1];
+} mqtt_topicNode_t;
+
+typedef struct mqtt_topicMatch_tag {
+	mqtt_callback_t* cb;
+	// start of the topic level that matched the first wildcard
+	const char* wildcard;
+} mqtt_topicMatch_t;
+
+static mqtt_callback_t* g_mqttCallbacks = 0;
+static mqtt_topicNode_t* g_mqttTopicTrie = 0;
+static int g_mqttCallbackOrder = 0;
+// grows when a single topic matches more callbacks than ever before
+static mqtt_topicMatch_t* g_mqttMatches = 0;
+static int g_mqttMatchesSize = 0;
+static int g_mqttMatchesCount;
+// bumped on every change, so routing can stop if a callback changed the callbacks
+static int g_mqttCallbacksGeneration = 0;
 // note: only one incomming can be processed at a time.
 static obk_mqtt_request_t g_mqtt_request;
+static char g_mqtt_request_topic[128];
 static obk_mqtt_request_t g_mqtt_request_cb;
 
 #define LOOPS_WITH_DISCONNECTED 15
@@ -286,6 +409,11 @@ int MQTT_GetPublishErrorCounter(void)
 	return mqtt_publish_errors;
 }
 
+int MQTT_GetPublishAllocCounter(void)
+{
+	return mqtt_publish_allocs;
+}
+
 int MQTT_GetReceivedEventCounter(void)
 {
 	return mqtt_received_events;
@@ -358,102 +486,294 @@ char* MQTT_GetStatusMessage(void)
 	return mqtt_status_message;
 }
 
-void MQTT_ClearCallbacks() {
-	int i;
-	for (i = 0; i < MAX_MQTT_CALLBACKS; i++) {
-		if (callbacks[i]) {
-			free(callbacks[i]->topic);
-			free(callbacks[i]->subscriptionTopic);
-			free(callbacks[i]);
-			callbacks[i] = 0;
+// length of the topic level starting at p
+static int MQTT_TopicLevelLen(const char* p) {
+	const char* end = strchr(p, '/');
+	if (end == 0)
+		return strlen(p);
+	return end - p;
+}
+static bool MQTT_IsWildcardLevel(const mqtt_topicNode_t* n, char c) {
+	return n->level[0] == c && n->level[1] == 0;
+}
+// finds or creates the trie node for the last level of the pattern
+static mqtt_topicNode_t* MQTT_Trie_GetNode(const char* pattern) {
+	mqtt_topicNode_t** link = &g_mqttTopicTrie;
+	mqtt_topicNode_t* n;
+	const char* p = pattern;
+	int len;
+
+	while (1) {
+		len = MQTT_TopicLevelLen(p);
+		for (n = *link; n; n = n->sibling) {
+			if (!strncmp(n->level, p, len) && n->level[len] == 0)
+				break;
 		}
+		if (n == 0) {
+			n = (mqtt_topicNode_t*)os_malloc(sizeof(mqtt_topicNode_t) + len);
+			if (n == 0)
+				return 0;
+			memset(n, 0, sizeof(mqtt_topicNode_t));
+			memcpy(n->level, p, len);
+			n->level[len] = 0;
+			n->sibling = *link;
+			*link = n;
+		}
+		if (p[len] == 0)
+			return n;
+		p += len + 1;
+		link = &n->children;
 	}
 }
-// this can REPLACE callbacks, since we MAY wish to change the root topic....
-// in which case we would re-resigster all callbacks?
-int MQTT_RegisterCallback(const char* basetopic, const char* subscriptiontopic, int ID, mqtt_callback_fn callback) {
-	int index;
-	int i;
-	int subscribechange = 0;
-	if (!basetopic || !subscriptiontopic || !callback) {
-		return -1;
+// frees the nodes that have neither callbacks nor children left
+static void MQTT_Trie_Prune(mqtt_topicNode_t** link) {
+	mqtt_topicNode_t* n;
+
+	while ((n = *link) != 0) {
+		MQTT_Trie_Prune(&n->children);
+		if (n->children == 0 && n->callbacks == 0) {
+			*link = n->sibling;
+			os_free(n);
+		}
+		else {
+			link = &n->sibling;
+		}
 	}
-	addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "MQTT_RegisterCallback called for bT %s subT %s", basetopic, subscriptiontopic);
+}
+static int MQTT_Trie_Link(mqtt_callback_t* cb) {
+	mqtt_topicNode_t* n;
+	char* pattern;
+	int len;
 
-	// find existing to replace
-	for (index = 0; index < numCallbacks; index++) {
-		if (callbacks[index]) {
-			if (callbacks[index]->ID == ID) {
-				break;
-			}
+	if (cb->subscriptionTopic[0]) {
+		n = MQTT_Trie_GetNode(cb->subscriptionTopic);
+	}
+	else {
+		// no subscription - base topic is used as a prefix, like "base/#"
+		len = strlen(cb->topic);
+		pattern = (char*)os_malloc(len + 3);
+		if (pattern == 0)
+			return 0;
+		strcpy(pattern, cb->topic);
+		if (len && pattern[len - 1] != '/') {
+			pattern[len++] = '/';
 		}
+		strcpy(pattern + len, "#");
+		n = MQTT_Trie_GetNode(pattern);
+		os_free(pattern);
 	}
+	if (n == 0)
+		return 0;
+	cb->node = n;
+	cb->nextInNode = n->callbacks;
+	n->callbacks = cb;
+	return 1;
+}
+static void MQTT_Trie_Unlink(mqtt_callback_t* cb) {
+	mqtt_callback_t** link;
 
-	// find empty if any (empty by MQTT_RemoveCallback)
-	if (index == numCallbacks) {
-		for (index = 0; index < numCallbacks; index++) {
-			if (!callbacks[index]) {
-				break;
-			}
+	if (cb->node == 0)
+		return;
+	for (link = &cb->node->callbacks; *link; link = &(*link)->nextInNode) {
+		if (*link == cb) {
+			*link = cb->nextInNode;
+			break;
 		}
 	}
+	cb->node = 0;
+	cb->nextInNode = 0;
+}
+static int MQTT_Trie_AddMatches(mqtt_topicNode_t* n, const char* wildcard) {
+	mqtt_callback_t* cb;
+	mqtt_topicMatch_t* grown;
+	int found = 0;
+
+	for (cb = n->callbacks; cb; cb = cb->nextInNode) {
+		found++;
+		if (g_mqttMatchesCount >= g_mqttMatchesSize) {
+			grown = (mqtt_topicMatch_t*)realloc(g_mqttMatches, (g_mqttMatchesSize + 8) * sizeof(mqtt_topicMatch_t));
+			if (grown == 0)
+				return found;
+			g_mqttMatches = grown;
+			g_mqttMatchesSize += 8;
+		}
+		g_mqttMatches[g_mqttMatchesCount].cb = cb;
+		g_mqttMatches[g_mqttMatchesCount].wildcard = wildcard;
+		g_mqttMatchesCount++;
+	}
+	return found;
+}
+// walks the trie along the topic levels, "+" matches a single level, "#" all remaining levels.
+// Matches are appended to g_mqttMatches.
+static int MQTT_Trie_Match(mqtt_topicNode_t* n, const char* p, const char* wildcard) {
+	mqtt_topicNode_t* c;
+	const char* w;
+	int len = MQTT_TopicLevelLen(p);
+	int found = 0;
 
-	if (index >= MAX_MQTT_CALLBACKS) {
-		return -4;
+	for (; n; n = n->sibling) {
+		if (MQTT_IsWildcardLevel(n, '#')) {
+			found += MQTT_Trie_AddMatches(n, wildcard ? wildcard : p);
+			continue;
+		}
+		if (MQTT_IsWildcardLevel(n, '+')) {
+			w = wildcard ? wildcard : p;
+		}
+		else if (strncmp(n->level, p, len) || n->level[len]) {
+			continue;
+		}
+		else {
+			w = wildcard;
+		}
+		if (p[len]) {
+			found += MQTT_Trie_Match(n->children, p + len + 1, w);
+			continue;
+		}
+		found += MQTT_Trie_AddMatches(n, w);
+		// "a/#" matches "a" as well
+		for (c = n->children; c; c = c->sibling) {
+			if (MQTT_IsWildcardLevel(c, '#')) {
+				found += MQTT_Trie_AddMatches(c, w ? w : p + len);
+			}
+		}
 	}
-	if (!callbacks[index]) {
-		callbacks[index] = (mqtt_callback_t*)os_malloc(sizeof(mqtt_callback_t));
-		if (callbacks[index] != 0) {
-			memset(callbacks[index], 0, sizeof(mqtt_callback_t));
+	return found;
+}
+// matched callbacks are called in the order they were registered
+static void MQTT_SortMatches() {
+	mqtt_topicMatch_t tmp;
+	int i, j;
+
+	for (i = 1; i < g_mqttMatchesCount; i++) {
+		tmp = g_mqttMatches[i];
+		for (j = i; j > 0 && g_mqttMatches[j - 1].cb->order > tmp.cb->order; j--) {
+			g_mqttMatches[j] = g_mqttMatches[j - 1];
 		}
+		g_mqttMatches[j] = tmp;
 	}
-	if (!callbacks[index]) {
-		return -2;
+}
+// topic level parsed as a channel index, -1 if it is not a plain number
+static int MQTT_ParseChannelLevel(const char* p) {
+	int len, i;
+
+	if (p == 0)
+		return -1;
+	len = MQTT_TopicLevelLen(p);
+	if (len == 0 || len > 9)
+		return -1;
+	for (i = 0; i < len; i++) {
+		if (p[i] < '0' || p[i] > '9')
+			return -1;
 	}
-	if (!callbacks[index]->topic || strcmp(callbacks[index]->topic, basetopic)) {
-		if (callbacks[index]->topic) {
-			os_free(callbacks[index]->topic);
+	return atoi(p);
+}
+static void MQTT_FreeCallback(mqtt_callback_t* cb) {
+	MQTT_Trie_Unlink(cb);
+	if (cb->topic) {
+		os_free(cb->topic);
+	}
+	if (cb->subscriptionTopic) {
+		os_free(cb->subscriptionTopic);
+	}
+	os_free(cb);
+}
+void MQTT_ClearCallbacks() {
+	mqtt_callback_t* cb;
+
+	while (g_mqttCallbacks) {
+		cb = g_mqttCallbacks;
+		g_mqttCallbacks = cb->next;
+		MQTT_FreeCallback(cb);
+	}
+	MQTT_Trie_Prune(&g_mqttTopicTrie);
+	g_mqttCallbacksGeneration++;
+}
+// this can REPLACE callbacks, since we MAY wish to change the root topic....
+// in which case we would re-resigster all callbacks?
+int MQTT_RegisterCallback(const char* basetopic, const char* subscriptiontopic, int ID, mqtt_callback_fn callback) {
+	mqtt_callback_t** link;
+	mqtt_callback_t* cb;
+	mqtt_callback_t* other;
+	char* str;
+	int subscribechange = 0;
+	if (!basetopic || !subscriptiontopic || !callback) {
+		return -1;
+	}
+	ADDLOG_INFO(LOG_FEATURE_MQTT, "MQTT_RegisterCallback called for bT %s subT %s", basetopic, subscriptiontopic);
+
+	// find existing to replace
+	for (link = &g_mqttCallbacks; *link; link = &(*link)->next) {
+		if ((*link)->ID == ID) {
+			break;
 		}
-		callbacks[index]->topic = (char*)os_malloc(strlen(basetopic) + 1);
-		if (!callbacks[index]->topic) {
-			os_free(callbacks[index]);
+	}
+	cb = *link;
+	if (!cb) {
+		cb = (mqtt_callback_t*)os_malloc(sizeof(mqtt_callback_t));
+		if (!cb) {
+			return -2;
+		}
+		memset(cb, 0, sizeof(mqtt_callback_t));
+		cb->ID = ID;
+		cb->order = ++g_mqttCallbackOrder;
+	}
+	if (!cb->topic || strcmp(cb->topic, basetopic)) {
+		str = (char*)os_malloc(strlen(basetopic) + 1);
+		if (!str) {
+			if (!*link) {
+				MQTT_FreeCallback(cb);
+			}
 			return -3;
 		}
-		strcpy(callbacks[index]->topic, basetopic);
+		strcpy(str, basetopic);
+		if (cb->topic) {
+			os_free(cb->topic);
+		}
+		cb->topic = str;
 	}
 
-	if (!callbacks[index]->subscriptionTopic || strcmp(callbacks[index]->subscriptionTopic, subscriptiontopic)) {
-		if (callbacks[index]->subscriptionTopic) {
-			os_free(callbacks[index]->subscriptionTopic);
-		}
-		callbacks[index]->subscriptionTopic = (char*)os_malloc(strlen(subscriptiontopic) + 1);
-		callbacks[index]->subscriptionTopic[0] = '\0';
-		if (!callbacks[index]->subscriptionTopic) {
-			os_free(callbacks[index]->topic);
-			os_free(callbacks[index]);
+	if (!cb->subscriptionTopic || strcmp(cb->subscriptionTopic, subscriptiontopic)) {
+		str = (char*)os_malloc(strlen(subscriptiontopic) + 1);
+		if (!str) {
+			if (!*link) {
+				MQTT_FreeCallback(cb);
+			}
 			return -3;
 		}
+		strcpy(str, subscriptiontopic);
 
 		// find out if this subscription is new.
-		for (i = 0; i < numCallbacks; i++) {
-			if (callbacks[i]) {
-				if (callbacks[i]->subscriptionTopic &&
-					!strcmp(callbacks[i]->subscriptionTopic, subscriptiontopic)) {
-					break;
-				}
+		for (other = g_mqttCallbacks; other; other = other->next) {
+			if (!strcmp(other->subscriptionTopic, subscriptiontopic)) {
+				break;
 			}
 		}
-		strcpy(callbacks[index]->subscriptionTopic, subscriptiontopic);
 		// if this subscription is new, must reconnect
-		if (i == numCallbacks) {
+		if (!other) {
 			subscribechange++;
 		}
+		if (cb->subscriptionTopic) {
+			os_free(cb->subscriptionTopic);
+		}
+		cb->subscriptionTopic = str;
 	}
 
-	callbacks[index]->callback = callback;
-	if (index == numCallbacks) {
-		numCallbacks++;
+	MQTT_Trie_Unlink(cb);
+	if (!MQTT_Trie_Link(cb)) {
+		if (*link) {
+			*link = cb->next;
+		}
+		MQTT_FreeCallback(cb);
+		MQTT_Trie_Prune(&g_mqttTopicTrie);
+		g_mqttCallbacksGeneration++;
+		return -2;
 	}
+	MQTT_Trie_Prune(&g_mqttTopicTrie);
+	cb->callback = callback;
+	if (!*link) {
+		*link = cb;
+	}
+	g_mqttCallbacksGeneration++;
 
 	if (subscribechange) {
 		if (mqtt_client) {
@@ -465,26 +785,20 @@ int MQTT_RegisterCallback(const char* basetopic, const char* subscriptiontopic,
 }
 
 int MQTT_RemoveCallback(int ID) {
-	int index;
-
-	for (index = 0; index < numCallbacks; index++) {
-		if (callbacks[index]) {
-			if (callbacks[index]->ID == ID) {
-				if (callbacks[index]->topic) {
-					os_free(callbacks[index]->topic);
-					callbacks[index]->topic = NULL;
-				}
-				if (callbacks[index]->subscriptionTopic) {
-					os_free(callbacks[index]->subscriptionTopic);
-					callbacks[index]->subscriptionTopic = NULL;
-				}
-				os_free(callbacks[index]);
-				callbacks[index] = NULL;
-				if (mqtt_client) {
-					mqtt_reconnect = 8;
-				}
-				return 1;
+	mqtt_callback_t** link;
+	mqtt_callback_t* cb;
+
+	for (link = &g_mqttCallbacks; *link; link = &(*link)->next) {
+		if ((*link)->ID == ID) {
+			cb = *link;
+			*link = cb->next;
+			MQTT_FreeCallback(cb);
+			MQTT_Trie_Prune(&g_mqttTopicTrie);
+			g_mqttCallbacksGeneration++;
+			if (mqtt_client) {
+				mqtt_reconnect = 8;
 			}
+			return 1;
 		}
 	}
 	return 0;
@@ -546,15 +860,16 @@ int channelGet(obk_mqtt_request_t* request) {
 		return 1;
 	}
 
-	addLogAdv(LOG_DEBUG, LOG_FEATURE_MQTT, "channelGet topic %i with arg %s", request->topic, request->received);
+	ADDLOG_DEBUG(LOG_FEATURE_MQTT, "channelGet topic %i with arg %s", request->topic, request->received);
 
-	p = MQTT_RemoveClientFromTopic(request->topic,0);
+	// <xxx>/get, already split by the topic trie
+	p = request->subTopic;
 
 	if (p == NULL) {
 		return 0;
 	}
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "channelGet part topic %s", p);
+	ADDLOG_INFO(LOG_FEATURE_MQTT, "channelGet part topic %s", p);
 
 	if (stribegins(p, "led_enableAll")) {
 		LED_SendEnableAllState();
@@ -577,10 +892,9 @@ int channelGet(obk_mqtt_request_t* request) {
 		return 1;
 	}
 
-	// atoi won't parse any non-decimal chars, so it should skip over the rest of the topic.
-	channel = atoi(p);
+	channel = request->channel;
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "channelGet channel %i", channel);
+	ADDLOG_INFO(LOG_FEATURE_MQTT, "channelGet channel %i", channel);
 
 	// if channel out of range, stop here.
 	if ((channel < 0) || (channel > 32)) {
@@ -598,21 +912,13 @@ int channelSet(obk_mqtt_request_t* request) {
 	//int len = request->receivedLen;
 	int channel = 0;
 	int iValue = 0;
-	const char* p;
 	const char *argument;
 
-	addLogAdv(LOG_DEBUG, LOG_FEATURE_MQTT, "channelSet topic %i with arg %s", request->topic, request->received);
-
-	p = MQTT_RemoveClientFromTopic(request->topic,0);
-
-	if (p == NULL) {
-		return 0;
-	}
-
-	//addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "channelSet part topic %s", p);
+	ADDLOG_DEBUG(LOG_FEATURE_MQTT, "channelSet topic %i with arg %s", request->topic, request->received);
 
-	// atoi won't parse any non-decimal chars, so it should skip over the rest of the topic.
-	channel = atoi(p);
+	// the subscription is <client>/+/set, so the topic trie already
+	// checked the '/set' part and parsed the channel from the '+' level
+	channel = request->channel;
 
 	//addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "channelSet channel %i", channel);
 
@@ -621,16 +927,7 @@ int channelSet(obk_mqtt_request_t* request) {
 		return 0;
 	}
 
-	// make sure the topic ends with '/set'.
-	p = strchr(p, '/');
-
-	// if not /set, then stop here
-	if (strcmp(p, "/set")) {
-		//addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "channelSet NOT 'set'");
-		return 0;
-	}
-
-	addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "MQTT client in mqtt_incoming_data_cb data is %.*s for ch %i\n", MQTT_MAX_DATA_LOG_LENGTH, request->received, channel);
+	ADDLOG_INFO(LOG_FEATURE_MQTT, "MQTT client in mqtt_incoming_data_cb data is %.*s for ch %i\n", MQTT_MAX_DATA_LOG_LENGTH, request->received, channel);
 
 	argument = ((const char*)request->received);
 
@@ -718,16 +1015,8 @@ int tasCmnd(obk_mqtt_request_t* request) {
 	const char *p, *args;
     //const char *p2;
 
-	p = MQTT_RemoveClientFromTopic(request->topic, "cmnd");
-	if (p == 0) {
-		p = MQTT_RemoveClientFromTopic(request->topic, "tele");
-		if (p == 0) {
-			p = MQTT_RemoveClientFromTopic(request->topic, "stat");
-			if (p == 0) {
-
-			}
-		}
-	}
+	// command name is the '+' level of cmnd/<clientId>/+ (or tele, stat)
+	p = request->subTopic;
 	if (p == 0)
 		return 1;
 
@@ -791,19 +1080,17 @@ static void mqtt_pub_request_cb(void* arg, err_t result)
 {
 	if (result != ERR_OK)
 	{
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "Publish result: %d(%s)\n", result, get_error_name(result));
+		ADDLOG_INFO(LOG_FEATURE_MQTT, "Publish result: %d(%s)\n", result, get_error_name(result));
 		mqtt_publish_errors++;
 	}
 }
 
-// This publishes value to the specified topic/channel.
-static OBK_Publish_Result MQTT_PublishTopicToClient(mqtt_client_t* client, const char* sTopic, const char* sChannel, const char* sVal, int flags, bool appendGet)
+// This publishes value to an already rendered topic.
+static OBK_Publish_Result MQTT_PublishRenderedTopic(mqtt_client_t* client, const char* pub_topic, const char* sVal, int flags, int publishClass)
 {
 	err_t err;
-	u8_t qos = 2; /* 0 1 or 2, see MQTT specification */
 	u8_t retain = 0; /* No don't retain such crappy payload... */
 	size_t sVal_len;
-	char* pub_topic;
 
 	if (client == 0)
 		return OBK_PUBLISH_WAS_DISCONNECTED;
@@ -818,7 +1105,7 @@ static OBK_Publish_Result MQTT_PublishTopicToClient(mqtt_client_t* client, const
 	else {
 		if (MQTT_Mutex_Take(500) == 0)
 		{
-			addLogAdv(LOG_ERROR, LOG_FEATURE_MQTT, "MQTT_PublishTopicToClient: mutex failed for %s=%s\r\n", sChannel, sVal);
+			ADDLOG_ERROR(LOG_FEATURE_MQTT, "MQTT_PublishTopicToClient: mutex failed for %s=%s\r\n", pub_topic, sVal);
 			return OBK_PUBLISH_MUTEX_FAIL;
 		}
 	}
@@ -831,11 +1118,6 @@ static OBK_Publish_Result MQTT_PublishTopicToClient(mqtt_client_t* client, const
 	{
 		retain = 1;
 	}
-	if (flags & OBK_PUBLISH_FLAG_FORCE_REMOVE_GET)
-	{
-		appendGet = false;
-	}
-
 
 	LOCK_TCPIP_CORE();
 	int res = mqtt_client_is_connected(client);
@@ -850,50 +1132,133 @@ static OBK_Publish_Result MQTT_PublishTopicToClient(mqtt_client_t* client, const
 
 	g_timeSinceLastMQTTPublish = 0;
 
-	pub_topic = (char*)os_malloc(strlen(sTopic) + 1 + strlen(sChannel) + 5 + 1); //5 for /get
-	if ((pub_topic != NULL) && (sVal != NULL))
+	if (sVal == NULL)
+	{
+		MQTT_Mutex_Free();
+		return OBK_PUBLISH_MEM_FAIL;
+	}
+	sVal_len = strlen(sVal);
+	// don't even build the arguments if the log would drop the line anyway
+	if (LOG_IsEnabled(LOG_INFO, LOG_FEATURE_MQTT))
 	{
-		sVal_len = strlen(sVal);
-		sprintf(pub_topic, "%s/%s%s", sTopic, sChannel, (appendGet == true ? "/get" : ""));
 		if (sVal_len < 128)
 		{
-			addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "Publishing val %s to %s retain=%i\n", sVal, pub_topic, retain);
+			ADDLOG_INFO(LOG_FEATURE_MQTT, "Publishing val %s to %s retain=%i\n", sVal, pub_topic, retain);
 		}
 		else {
-			addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "Publishing val (%d bytes) to %s retain=%i\n", sVal_len, pub_topic, retain);
+			ADDLOG_INFO(LOG_FEATURE_MQTT, "Publishing val (%d bytes) to %s retain=%i\n", sVal_len, pub_topic, retain);
 		}
+	}
 
+	LOCK_TCPIP_CORE();
+	err = mqtt_publish(client, pub_topic, sVal, sVal_len, g_mqttPublishQoS[publishClass], retain, mqtt_pub_request_cb, 0);
+	UNLOCK_TCPIP_CORE();
 
-		LOCK_TCPIP_CORE();
-		err = mqtt_publish(client, pub_topic, sVal, strlen(sVal), qos, retain, mqtt_pub_request_cb, 0);
-		UNLOCK_TCPIP_CORE();
-		os_free(pub_topic);
-
-		if (err != ERR_OK)
+	if (err != ERR_OK)
+	{
+		if (err == ERR_CONN)
 		{
-			if (err == ERR_CONN)
-			{
-				addLogAdv(LOG_ERROR, LOG_FEATURE_MQTT, "Publish err: ERR_CONN aka %d\n", err);
-			}
-			else if (err == ERR_MEM) {
-				addLogAdv(LOG_ERROR, LOG_FEATURE_MQTT, "Publish err: ERR_MEM aka %d\n", err);
-				g_memoryErrorsThisSession++;
-			}
-			else {
-				addLogAdv(LOG_ERROR, LOG_FEATURE_MQTT, "Publish err: %d\n", err);
-			}
-			mqtt_publish_errors++;
-			MQTT_Mutex_Free();
-			return OBK_PUBLISH_MEM_FAIL;
+			ADDLOG_ERROR(LOG_FEATURE_MQTT, "Publish err: ERR_CONN aka %d\n", err);
 		}
-		mqtt_published_events++;
-		MQTT_Mutex_Free();
-		return OBK_PUBLISH_OK;
-	}
-	else {
+		else if (err == ERR_MEM) {
+			ADDLOG_ERROR(LOG_FEATURE_MQTT, "Publish err: ERR_MEM aka %d\n", err);
+			g_memoryErrorsThisSession++;
+		}
+		else {
+			ADDLOG_ERROR(LOG_FEATURE_MQTT, "Publish err: %d\n", err);
+		}
+		mqtt_publish_errors++;
 		MQTT_Mutex_Free();
 		return OBK_PUBLISH_MEM_FAIL;
 	}
+	mqtt_published_events++;
+	MQTT_Mutex_Free();
+	return OBK_PUBLISH_OK;
+}
+
+// This publishes value to the specified topic/channel.
+// Topic is rendered on stack, heap is used only for unusually long topics.
+static OBK_Publish_Result MQTT_PublishTopicToClient(mqtt_client_t* client, const char* sTopic, const char* sChannel, const char* sVal, int flags, bool appendGet, int publishClass)
+{
+	char stackTopic[MQTT_TOPIC_STACK_SIZE];
+	char* pub_topic = stackTopic;
+	int topicLen, channelLen;
+	OBK_Publish_Result result;
+
+	if (client == 0)
+		return OBK_PUBLISH_WAS_DISCONNECTED;
+
+	if (flags & OBK_PUBLISH_FLAG_FORCE_REMOVE_GET)
+	{
+		appendGet = false;
+	}
+
+	topicLen = strlen(sTopic);
+	channelLen = strlen(sChannel);
+	if (topicLen + 1 + channelLen + 4 + 1 > sizeof(stackTopic)) //4 for /get
+	{
+		pub_topic = (char*)os_malloc(topicLen + 1 + channelLen + 4 + 1);
+		if (pub_topic == NULL)
+			return OBK_PUBLISH_MEM_FAIL;
+		mqtt_publish_allocs++;
+	}
+	memcpy(pub_topic, sTopic, topicLen);
+	pub_topic[topicLen] = '/';
+	memcpy(pub_topic + topicLen + 1, sChannel, channelLen + 1);
+	if (appendGet)
+	{
+		memcpy(pub_topic + topicLen + 1 + channelLen, "/get", 5);
+	}
+
+	result = MQTT_PublishRenderedTopic(client, pub_topic, sVal, flags, publishClass);
+	if (pub_topic != stackTopic)
+		os_free(pub_topic);
+	return result;
+}
+
+// returns a pre-rendered topic, or NULL if it has to be rendered again
+static const char* MQTT_GetTopicTemplate(int offset)
+{
+	// client ID has changed, templates are rebuilt by MQTT_InitCallbacks
+	if (g_mqtt_bBaseTopicDirty || g_mqttTopicTemplatesBuilt == false || offset < 0)
+		return NULL;
+	return g_mqttTopicArena + offset;
+}
+static int MQTT_AddTopicTemplate(int* used, const char* fmt, const char* clientId, int index)
+{
+	int start = *used;
+	int len;
+
+	if (start >= MQTT_TOPIC_ARENA_SIZE)
+		return -1;
+	len = snprintf(g_mqttTopicArena + start, MQTT_TOPIC_ARENA_SIZE - start, fmt, clientId, index);
+	if (len < 0 || start + len + 1 > MQTT_TOPIC_ARENA_SIZE) {
+		*used = MQTT_TOPIC_ARENA_SIZE;
+		return -1;
+	}
+	*used = start + len + 1;
+	return start;
+}
+// renders topics used for every publish once, so they are not sprintf'ed each time.
+// The arena is sized for all of them, failed ones are just rendered on stack when published.
+static void MQTT_BuildTopicTemplates()
+{
+	const char* clientId = CFG_GetMQTTClientId();
+	int used = 0;
+	int i;
+
+	g_mqttTeleTopic = MQTT_AddTopicTemplate(&used, "tele/%s", clientId, 0);
+	g_mqttStatTopic = MQTT_AddTopicTemplate(&used, "stat/%s", clientId, 0);
+	for (i = 0; i < CHANNEL_MAX; i++) {
+		g_mqttChannelTopics[i] = MQTT_AddTopicTemplate(&used, "%s/%i/get", clientId, i);
+	}
+	g_mqttTopicTemplatesBuilt = true;
+}
+bool MQTT_HasChannelTopicTemplate(int channel)
+{
+	if (channel < 0 || channel >= CHANNEL_MAX)
+		return false;
+	return MQTT_GetTopicTemplate(g_mqttChannelTopics[channel]) != NULL;
 }
 
 // This is used to publish channel values in "obk0696FB33/1/get" format with numerical value,
@@ -901,19 +1266,27 @@ static OBK_Publish_Result MQTT_PublishTopicToClient(mqtt_client_t* client, const
 // for example, "obk0696FB33/voltage/get" is used to publish voltage from the sensor
 static OBK_Publish_Result MQTT_PublishMain(mqtt_client_t* client, const char* sChannel, const char* sVal, int flags, bool appendGet)
 {
-	return MQTT_PublishTopicToClient(mqtt_client, CFG_GetMQTTClientId(), sChannel, sVal, flags, appendGet);
+	return MQTT_PublishTopicToClient(mqtt_client, CFG_GetMQTTClientId(), sChannel, sVal, flags, appendGet, MQTT_PUBLISH_CLASS_MAIN);
 }
 OBK_Publish_Result MQTT_PublishTele(const char* teleName, const char* teleValue)
 {
 	char topic[64];
-	snprintf(topic, sizeof(topic), "tele/%s", CFG_GetMQTTClientId());
-	return MQTT_PublishTopicToClient(mqtt_client, topic, teleName, teleValue, 0, false);
+	const char* tmpl = MQTT_GetTopicTemplate(g_mqttTeleTopic);
+	if (tmpl == NULL) {
+		snprintf(topic, sizeof(topic), "tele/%s", CFG_GetMQTTClientId());
+		tmpl = topic;
+	}
+	return MQTT_PublishTopicToClient(mqtt_client, tmpl, teleName, teleValue, 0, false, MQTT_PUBLISH_CLASS_TELE);
 }
 OBK_Publish_Result MQTT_PublishStat(const char* statName, const char* statValue)
 {
 	char topic[64];
-	snprintf(topic,sizeof(topic),"stat/%s", CFG_GetMQTTClientId());
-	return MQTT_PublishTopicToClient(mqtt_client, topic, statName, statValue, 0, false);
+	const char* tmpl = MQTT_GetTopicTemplate(g_mqttStatTopic);
+	if (tmpl == NULL) {
+		snprintf(topic, sizeof(topic), "stat/%s", CFG_GetMQTTClientId());
+		tmpl = topic;
+	}
+	return MQTT_PublishTopicToClient(mqtt_client, tmpl, statName, statValue, 0, false, MQTT_PUBLISH_CLASS_STAT);
 }
 /// @brief Publish a MQTT message immediately.
 /// @param sTopic 
@@ -923,11 +1296,11 @@ OBK_Publish_Result MQTT_PublishStat(const char* statName, const char* statValue)
 /// @return 
 OBK_Publish_Result MQTT_Publish(const char* sTopic, const char* sChannel, const char* sVal, int flags)
 {
-	return MQTT_PublishTopicToClient(mqtt_client, sTopic, sChannel, sVal, flags, false);
+	return MQTT_PublishTopicToClient(mqtt_client, sTopic, sChannel, sVal, flags, false, MQTT_PUBLISH_CLASS_OTHER);
 }
 
 void MQTT_OBK_Printf(char* s) {
-	addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, s);
+	ADDLOG_INFO(LOG_FEATURE_MQTT, "%s", s);
 }
 
 ////////////////////////////////////////
@@ -935,74 +1308,71 @@ void MQTT_OBK_Printf(char* s) {
 // we should do callbacks from one of our threads?
 static void mqtt_incoming_data_cb(void* arg, const u8_t* data, u16_t len, u8_t flags)
 {
-	int i;
 	// unused - left here as example
 	//const struct mqtt_connect_client_info_t* client_info = (const struct mqtt_connect_client_info_t*)arg;
 
-	// if we stored a topic in g_mqtt_request, then we found a matching callback, so use it.
-	if (g_mqtt_request.topic[0])
+	// if we stored a topic in g_mqtt_request, then post the data with it.
+	if (g_mqtt_request_topic[0])
 	{
 		// note: data is NOT terminated (it may be binary...).
 		g_mqtt_request.received = data;
 		g_mqtt_request.receivedLen = len;
 
+		g_mqtt_request.topic = g_mqtt_request_topic;
 		//addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "MQTT in topic %s", g_mqtt_request.topic);
 		mqtt_received_events++;
 
-		for (i = 0; i < numCallbacks; i++)
-		{
-			if (callbacks[i] == 0)
-				continue;
-			char* cbtopic = callbacks[i]->topic;
-			if (!strncmp(g_mqtt_request.topic, cbtopic, strlen(cbtopic)))
-			{
-				MQTT_Post_Received(g_mqtt_request.topic, strlen(g_mqtt_request.topic), data, len);
-				// if ANYONE is interested, store it.
-				break;
-				// note - callback must return 1 to say it ate the mqtt, else further processing can be performed.
-				// i.e. multiple people can get each topic if required.
-				//if (callbacks[i]->callback(&g_mqtt_request))
-				//{
-				//	return;
-				//}
-			}
-		}
-		//addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "MQTT topic not handled: %s", g_mqtt_request.topic);
+		// callbacks are matched and called later from MQTT_process_received
+		MQTT_Post_Received(g_mqtt_request.topic, strlen(g_mqtt_request.topic), data, len);
 	}
 }
 
 
 // run from userland (quicktick or wakeable thread)
 int MQTT_process_received(){
-	char *topic;
+	const char *topic;
 	int topiclen;
-	unsigned char *data;
+	const unsigned char *data;
 	int datalen;
-	int found = 0;
+	int size;
 	int count = 0;
+	int generation;
+	int i;
+	mqtt_topicMatch_t* m;
 	do{
-		found = get_received(&topic, &topiclen, &data, &datalen);
-		if (found){
+		size = get_received(&topic, &topiclen, &data, &datalen);
+		if (size){
 			count++;
-			strncpy(g_mqtt_request_cb.topic, topic, sizeof(g_mqtt_request_cb.topic));
+			g_mqtt_request_cb.topic = topic;
+			g_mqtt_request_cb.topicLen = topiclen;
 			g_mqtt_request_cb.received = data;
 			g_mqtt_request_cb.receivedLen = datalen;
-			for (int i = 0; i < numCallbacks; i++)
+			g_mqttMatchesCount = 0;
+			MQTT_Trie_Match(g_mqttTopicTrie, topic, 0);
+			MQTT_SortMatches();
+			generation = g_mqttCallbacksGeneration;
+			for (i = 0; i < g_mqttMatchesCount; i++)
 			{
-				char* cbtopic = callbacks[i]->topic;
-				if (!strncmp(topic, cbtopic, strlen(cbtopic)))
+				m = &g_mqttMatches[i];
+				g_mqtt_request_cb.subTopic = m->wildcard;
+				g_mqtt_request_cb.channel = MQTT_ParseChannelLevel(m->wildcard);
+				// note - callback must return 1 to say it ate the mqtt, else further processing can be performed.
+				// i.e. multiple people can get each topic if required.
+				if (m->cb->callback(&g_mqtt_request_cb))
 				{
-					// note - callback must return 1 to say it ate the mqtt, else further processing can be performed.
-					// i.e. multiple people can get each topic if required.
-					if (callbacks[i]->callback(&g_mqtt_request_cb))
-					{
-						// if no further processing, then break this loop.
-						break;
-					}
+					// if no further processing, then break this loop.
+					break;
 				}
+				// matches may point to freed callbacks now
+				if (generation != g_mqttCallbacksGeneration)
+					break;
 			}
+			// done with the views, free the record
+			MQTT_Mutex_Take(100);
+			MQTT_RxRelease(size);
+			MQTT_Mutex_Free();
 		}
-	} while (found);
+	} while (size);
 
 	return count;
 }
@@ -1013,30 +1383,21 @@ int MQTT_process_received(){
 static void mqtt_incoming_publish_cb(void* arg, const char* topic, u32_t tot_len)
 {
 	//const char *p;
-	int i;
 	// unused - left here as example
 	//const struct mqtt_connect_client_info_t* client_info = (const struct mqtt_connect_client_info_t*)arg;
 
-	// look for a callback with this URL and method, or HTTP_ANY
-	g_mqtt_request.topic[0] = '\0';
-	for (i = 0; i < numCallbacks; i++)
-	{
-		char* cbtopic = callbacks[i]->topic;
-		if (strncmp(topic, cbtopic, strlen(cbtopic)))
-		{
-			strncpy(g_mqtt_request.topic, topic, sizeof(g_mqtt_request.topic) - 1);
-			g_mqtt_request.topic[sizeof(g_mqtt_request.topic) - 1] = 0;
-			break;
-		}
-	}
-	addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "MQTT client in mqtt_incoming_publish_cb topic %s\n", topic);
+	// store the topic, it is matched against the callbacks later in MQTT_process_received.
+	// The trie is changed by the main thread, so it must not be walked here.
+	strncpy(g_mqtt_request_topic, topic, sizeof(g_mqtt_request_topic) - 1);
+	g_mqtt_request_topic[sizeof(g_mqtt_request_topic) - 1] = 0;
+	ADDLOG_INFO(LOG_FEATURE_MQTT, "MQTT client in mqtt_incoming_publish_cb topic %s\n", topic);
 }
 
 static void mqtt_request_cb(void* arg, err_t err)
 {
 	const struct mqtt_connect_client_info_t* client_info = (const struct mqtt_connect_client_info_t*)arg;
 	if (err != 0) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_MQTT, "MQTT client \"%s\" request cb: err %d\n", client_info->client_id, (int)err);
+		ADDLOG_ERROR(LOG_FEATURE_MQTT, "MQTT client \"%s\" request cb: err %d\n", client_info->client_id, (int)err);
 	}
 }
 
@@ -1044,19 +1405,19 @@ static void mqtt_request_cb(void* arg, err_t err)
 // should be called in tcp_thread context.
 static void mqtt_connection_cb(mqtt_client_t* client, void* arg, mqtt_connection_status_t status)
 {
-	int i;
+	mqtt_callback_t* cb;
 	char tmp[CGF_MQTT_CLIENT_ID_SIZE + 16];
 	const char* clientId;
 	err_t err = ERR_OK;
 	const struct mqtt_connect_client_info_t* client_info = (const struct mqtt_connect_client_info_t*)arg;
 	LWIP_UNUSED_ARG(client);
 
-	//   addLogAdv(LOG_INFO,LOG_FEATURE_MQTT,"MQTT client < removed name > connection cb: status %d\n",  (int)status);
-	 //  addLogAdv(LOG_INFO,LOG_FEATURE_MQTT,"MQTT client \"%s\" connection cb: status %d\n", client_info->client_id, (int)status);
+	//   ADDLOG_INFO(LOG_FEATURE_MQTT,"MQTT client < removed name > connection cb: status %d\n",  (int)status);
+	 //  ADDLOG_INFO(LOG_FEATURE_MQTT,"MQTT client \"%s\" connection cb: status %d\n", client_info->client_id, (int)status);
 
 	if (status == MQTT_CONNECT_ACCEPTED)
 	{
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "mqtt_connection_cb: Successfully connected\n");
+		ADDLOG_INFO(LOG_FEATURE_MQTT, "mqtt_connection_cb: Successfully connected\n");
 
 		//LOCK_TCPIP_CORE();
 		mqtt_set_inpub_callback(mqtt_client,
@@ -1068,19 +1429,17 @@ static void mqtt_connection_cb(mqtt_client_t* client, void* arg, mqtt_connection
 		// subscribe to all callback subscription topics
 		// this makes a BIG assumption that we can subscribe multiple times to the same one?
 		// TODO - check that subscribing multiple times to the same topic is not BAD
-		for (i = 0; i < numCallbacks; i++) {
-			if (callbacks[i]) {
-				if (callbacks[i]->subscriptionTopic && callbacks[i]->subscriptionTopic[0]) {
-					err = mqtt_sub_unsub(client,
-						callbacks[i]->subscriptionTopic, 1,
-						mqtt_request_cb, LWIP_CONST_CAST(void*, client_info),
-						1);
-					if (err != ERR_OK) {
-						addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "mqtt_subscribe to %s return: %d\n", callbacks[i]->subscriptionTopic, err);
-					}
-					else {
-						addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "mqtt_subscribed to %s\n", callbacks[i]->subscriptionTopic);
-					}
+		for (cb = g_mqttCallbacks; cb; cb = cb->next) {
+			if (cb->subscriptionTopic[0]) {
+				err = mqtt_sub_unsub(client,
+					cb->subscriptionTopic, 1,
+					mqtt_request_cb, LWIP_CONST_CAST(void*, client_info),
+					1);
+				if (err != ERR_OK) {
+					ADDLOG_INFO(LOG_FEATURE_MQTT, "mqtt_subscribe to %s return: %d\n", cb->subscriptionTopic, err);
+				}
+				else {
+					ADDLOG_INFO(LOG_FEATURE_MQTT, "mqtt_subscribed to %s\n", cb->subscriptionTopic);
 				}
 			}
 		}
@@ -1092,7 +1451,7 @@ static void mqtt_connection_cb(mqtt_client_t* client, void* arg, mqtt_connection
 		err = mqtt_publish(client, tmp, "online", strlen("online"), 2, true, mqtt_pub_request_cb, 0);
 		//UNLOCK_TCPIP_CORE();
 		if (err != ERR_OK) {
-			addLogAdv(LOG_ERROR, LOG_FEATURE_MQTT, "Publish err: %d\n", err);
+			ADDLOG_ERROR(LOG_FEATURE_MQTT, "Publish err: %d\n", err);
 			if (err == ERR_CONN) {
 				// g_my_reconnect_mqtt_after_time = 5;
 			}
@@ -1110,7 +1469,7 @@ static void mqtt_connection_cb(mqtt_client_t* client, void* arg, mqtt_connection
 		//        1);
 	}
 	else {
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "mqtt_connection_cb: Disconnected, reason: %d(%s)\n", status, get_callback_error(status));
+		ADDLOG_INFO(LOG_FEATURE_MQTT, "mqtt_connection_cb: Disconnected, reason: %d(%s)\n", status, get_callback_error(status));
 	}
 }
 
@@ -1125,7 +1484,7 @@ static int MQTT_do_connect(mqtt_client_t* client)
 	mqtt_host = CFG_GetMQTTHost();
 
 	if (!mqtt_host[0]) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "mqtt_host empty, not starting mqtt\r\n");
+		ADDLOG_INFO(LOG_FEATURE_MQTT, "mqtt_host empty, not starting mqtt\r\n");
 		snprintf(mqtt_status_message, sizeof(mqtt_status_message), "mqtt_host empty, not starting mqtt");
 		return 0;
 	}
@@ -1135,7 +1494,7 @@ static int MQTT_do_connect(mqtt_client_t* client)
 	mqtt_clientID = CFG_GetMQTTClientId();
 	mqtt_port = CFG_GetMQTTPort();
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "mqtt_userName %s\r\nmqtt_pass %s\r\nmqtt_clientID %s\r\nmqtt_host %s:%d\r\n",
+	ADDLOG_INFO(LOG_FEATURE_MQTT, "mqtt_userName %s\r\nmqtt_pass %s\r\nmqtt_clientID %s\r\nmqtt_host %s:%d\r\n",
 		mqtt_userName,
 		mqtt_pass,
 		mqtt_clientID,
@@ -1170,13 +1529,13 @@ static int MQTT_do_connect(mqtt_client_t* client)
 		if (hostEntry->h_addr_list && hostEntry->h_addr_list[0]) {
 			int len = hostEntry->h_length;
 			if (len > 4) {
-				addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "mqtt_host resolves to addr len > 4\r\n");
+				ADDLOG_INFO(LOG_FEATURE_MQTT, "mqtt_host resolves to addr len > 4\r\n");
 				len = 4;
 			}
 			memcpy(&mqtt_ip, hostEntry->h_addr_list[0], len);
 		}
 		else {
-			addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "mqtt_host resolves no addresses?\r\n");
+			ADDLOG_INFO(LOG_FEATURE_MQTT, "mqtt_host resolves no addresses?\r\n");
 			snprintf(mqtt_status_message, sizeof(mqtt_status_message), "mqtt_host resolves no addresses?");
 			return 0;
 		}
@@ -1198,7 +1557,7 @@ static int MQTT_do_connect(mqtt_client_t* client)
 		mqtt_connect_result = res;
 		if (res != ERR_OK)
 		{
-			addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "Connect error in mqtt_client_connect - code: %d (%s)\n", res, get_error_name(res));
+			ADDLOG_INFO(LOG_FEATURE_MQTT, "Connect error in mqtt_client_connect - code: %d (%s)\n", res, get_error_name(res));
 			snprintf(mqtt_status_message, sizeof(mqtt_status_message), "mqtt_client_connect connect failed");
 			if (res == ERR_ISCONN)
 			{
@@ -1211,7 +1570,7 @@ static int MQTT_do_connect(mqtt_client_t* client)
 		return res;
 	}
 	else {
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "mqtt_host %s not found by gethostbyname\r\n", mqtt_host);
+		ADDLOG_INFO(LOG_FEATURE_MQTT, "mqtt_host %s not found by gethostbyname\r\n", mqtt_host);
 		snprintf(mqtt_status_message, sizeof(mqtt_status_message), "mqtt_host %s not found by gethostbyname", mqtt_host);
 	}
 	return 0;
@@ -1250,26 +1609,28 @@ OBK_Publish_Result MQTT_ChannelPublish(int channel, int flags)
 {
 	char channelNameStr[8];
 	char valueStr[16];
+	const char* tmpl;
 
 	if (CFG_HasFlag(OBK_FLAG_PUBLISH_MULTIPLIED_VALUES)) {
 		float dVal = CHANNEL_GetFinalValue(channel);
 		// Float value
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "Channel has changed! Publishing %f to channel %i \n", dVal, channel);
+		if (LOG_IsEnabled(LOG_INFO, LOG_FEATURE_MQTT)) {
+			ADDLOG_INFO(LOG_FEATURE_MQTT, "Channel has changed! Publishing %f to channel %i \n", dVal, channel);
+		}
 		sprintf(valueStr, "%f", dVal);
 	}
 	else {
 		int iVal = CHANNEL_Get(channel);
 		// Integer value
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "Channel has changed! Publishing %i to channel %i \n", iVal, channel);
+		if (LOG_IsEnabled(LOG_INFO, LOG_FEATURE_MQTT)) {
+			ADDLOG_INFO(LOG_FEATURE_MQTT, "Channel has changed! Publishing %i to channel %i \n", iVal, channel);
+		}
 		sprintf(valueStr, "%i", iVal);
 	}
 
 	MQTT_BroadcastTasmotaTeleSTATE();
 	MQTT_BroadcastTasmotaTeleSENSOR();
 
-	// String from channel number
-	sprintf(channelNameStr, "%i", channel);
-
 	// This will set RETAIN flag for all channels that are used for RELAY
 	if (CFG_HasFlag(OBK_FLAG_MQTT_RETAIN_POWER_CHANNELS)) {
 		if (CHANNEL_IsPowerRelayChannel(channel)) {
@@ -1277,7 +1638,17 @@ OBK_Publish_Result MQTT_ChannelPublish(int channel, int flags)
 		}
 	}
 
-	return MQTT_PublishMain(mqtt_client, channelNameStr, valueStr, flags, true);
+	if (channel >= 0 && channel < CHANNEL_MAX && !(flags & OBK_PUBLISH_FLAG_FORCE_REMOVE_GET)) {
+		tmpl = MQTT_GetTopicTemplate(g_mqttChannelTopics[channel]);
+		if (tmpl) {
+			return MQTT_PublishRenderedTopic(mqtt_client, tmpl, valueStr, flags, MQTT_PUBLISH_CLASS_CHANNEL);
+		}
+	}
+
+	// String from channel number
+	sprintf(channelNameStr, "%i", channel);
+
+	return MQTT_PublishTopicToClient(mqtt_client, CFG_GetMQTTClientId(), channelNameStr, valueStr, flags, true, MQTT_PUBLISH_CLASS_CHANNEL);
 }
 // This console command will trigger a publish of all used variables (channels and extra stuff)
 commandResult_t MQTT_PublishAll(const void* context, const char* cmd, const char* args, int cmdFlags) {
@@ -1310,7 +1681,7 @@ commandResult_t MQTT_PublishCommand(const void* context, const char* cmd, const
 	Tokenizer_TokenizeString(args, 0);
 
 	if (Tokenizer_GetArgsCount() < 2) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "Publish command requires two arguments (topic and value)");
+		ADDLOG_INFO(LOG_FEATURE_MQTT, "Publish command requires two arguments (topic and value)");
 		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
 	}
 	topic = Tokenizer_GetArg(0);
@@ -1330,7 +1701,7 @@ commandResult_t MQTT_PublishCommandInteger(const void* context, const char* cmd,
 	Tokenizer_TokenizeString(args, 0);
 
 	if (Tokenizer_GetArgsCount() < 2) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "Publish command requires two arguments (topic and value)");
+		ADDLOG_INFO(LOG_FEATURE_MQTT, "Publish command requires two arguments (topic and value)");
 		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
 	}
 	topic = Tokenizer_GetArg(0);
@@ -1351,7 +1722,7 @@ commandResult_t MQTT_PublishCommandFloat(const void* context, const char* cmd, c
 	Tokenizer_TokenizeString(args, 0);
 
 	if (Tokenizer_GetArgsCount() < 2) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "Publish command requires two arguments (topic and value)");
+		ADDLOG_INFO(LOG_FEATURE_MQTT, "Publish command requires two arguments (topic and value)");
 		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
 	}
 	topic = Tokenizer_GetArg(0);
@@ -1372,10 +1743,13 @@ typedef struct BENCHMARK_TEST_INFO
 	portTickType TestStopTick;
 	long msg_cnt;
 	long msg_num;
-	char topic[256];
 	char value[256];
 	float bench_time;
 	float bench_rate;
+	// ticks spent inside publish calls, summed over many publishes
+	// it averages out to real time even with coarse ticks
+	portTickType publish_ticks;
+	int allocs_at_start;
 	bool report_published;
 } BENCHMARK_TEST_INFO;
 
@@ -1387,9 +1761,9 @@ void MQTT_Test_Tick(void* param)
 {
 	BENCHMARK_TEST_INFO* info = (BENCHMARK_TEST_INFO*)param;
 	int block = 1;
-	err_t err;
-	int qos = 2;
-	int retain = 0;
+	OBK_Publish_Result err;
+	portTickType start;
+	int usPerPublish;
 
 	if (info != NULL)
 	{
@@ -1406,10 +1780,12 @@ void MQTT_Test_Tick(void* param)
 			{
 				sprintf(info->value, "TestMSG: %li/%li Time: %i s, Rate: %i msg/s", info->msg_cnt, info->msg_num,
 					(int)info->bench_time, (int)info->bench_rate);
-				LOCK_TCPIP_CORE();
-				err = mqtt_publish(mqtt_client, info->topic, info->value, strlen(info->value), qos, retain, mqtt_pub_request_cb, 0);
-				UNLOCK_TCPIP_CORE();
-				if (err == ERR_OK)
+				// goes through the same path as every other publish
+				start = xTaskGetTickCount();
+				err = MQTT_PublishTopicToClient(mqtt_client, CFG_GetMQTTClientId(), "benchmark", info->value,
+					OBK_PUBLISH_FLAG_MUTEX_SILENT, false, MQTT_PUBLISH_CLASS_OTHER);
+				info->publish_ticks += xTaskGetTickCount() - start;
+				if (err == OBK_PUBLISH_OK)
 				{
 					/* MSG published */
 					info->msg_cnt++;
@@ -1434,15 +1810,19 @@ void MQTT_Test_Tick(void* param)
 				if (info->report_published == false)
 				{
 					/* Publish report */
-					sprintf(info->value, "Benchmark completed. %li msg published. Total Time: %i s MsgRate: %i msg/s",
-						info->msg_cnt, (int)info->bench_time, (int)info->bench_rate);
-					LOCK_TCPIP_CORE();
-					err = mqtt_publish(mqtt_client, info->topic, info->value, strlen(info->value), qos, retain, mqtt_pub_request_cb, 0);
-					UNLOCK_TCPIP_CORE();
-					if (err == ERR_OK)
+					usPerPublish = 0;
+					if (info->msg_cnt)
+						usPerPublish = (int)(info->publish_ticks * portTICK_RATE_MS * 1000 / info->msg_cnt);
+					sprintf(info->value, "Benchmark completed. %li msg published. Total Time: %i s MsgRate: %i msg/s "
+						"Time per publish: %i us Allocations: %i",
+						info->msg_cnt, (int)info->bench_time, (int)info->bench_rate,
+						usPerPublish, mqtt_publish_allocs - info->allocs_at_start);
+					err = MQTT_PublishTopicToClient(mqtt_client, CFG_GetMQTTClientId(), "benchmark", info->value,
+						OBK_PUBLISH_FLAG_MUTEX_SILENT, false, MQTT_PUBLISH_CLASS_OTHER);
+					if (err == OBK_PUBLISH_OK)
 					{
 						/* Report published */
-						addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, info->value);
+						ADDLOG_INFO(LOG_FEATURE_MQTT, "%s", info->value);
 						info->report_published = true;
 						/* Stop timer */
 					}
@@ -1453,6 +1833,32 @@ void MQTT_Test_Tick(void* param)
 	}
 }
 
+// mqtt_qos [Class] [QoS]
+commandResult_t MQTT_SetPublishQoS(const void* context, const char* cmd, const char* args, int cmdFlags)
+{
+	const char* className;
+	int qos;
+	int i;
+
+	Tokenizer_TokenizeString(args, 0);
+	if (Tokenizer_GetArgsCount() < 2) {
+		for (i = 0; i < MQTT_PUBLISH_CLASS_COUNT; i++) {
+			ADDLOG_INFO(LOG_FEATURE_MQTT, "QoS for %s publishes is %i", g_mqttPublishClassNames[i], g_mqttPublishQoS[i]);
+		}
+		return CMD_RES_OK;
+	}
+	className = Tokenizer_GetArg(0);
+	qos = Tokenizer_GetArgInteger(1);
+	if (qos < 0 || qos > 2) {
+		return CMD_RES_BAD_ARGUMENT;
+	}
+	for (i = 0; i < MQTT_PUBLISH_CLASS_COUNT; i++) {
+		if (!stricmp(className, g_mqttPublishClassNames[i]) || !stricmp(className, "all")) {
+			g_mqttPublishQoS[i] = qos;
+		}
+	}
+	return CMD_RES_OK;
+}
 commandResult_t MQTT_SetTasTeleIntervals(const void* context, const char* cmd, const char* args, int cmdFlags)
 {
 	Tokenizer_TokenizeString(args, 0);
@@ -1529,6 +1935,8 @@ commandResult_t MQTT_StartMQTTTestThread(const void* context, const char* cmd, c
 		/* try to restart */
 		info->TestStartTick = xTaskGetTickCount();
 		info->msg_cnt = 0;
+		info->publish_ticks = 0;
+		info->allocs_at_start = mqtt_publish_allocs;
 		info->report_published = false;
 		return CMD_RES_OK;
 	}
@@ -1542,7 +1950,7 @@ commandResult_t MQTT_StartMQTTTestThread(const void* context, const char* cmd, c
 	memset(info, 0, sizeof(BENCHMARK_TEST_INFO));
 	info->TestStartTick = xTaskGetTickCount();
 	info->msg_num = 1000;
-	sprintf(info->topic, "%s/benchmark", CFG_GetMQTTClientId());
+	info->allocs_at_start = mqtt_publish_allocs;
 
 #if WINDOWS
 
@@ -1580,6 +1988,7 @@ void MQTT_InitCallbacks() {
 	const char* groupId;
 
 	MQTT_ClearCallbacks();
+	MQTT_BuildTopicTemplates();
 	g_mqtt_bBaseTopicDirty = 0;
 
 	clientId = CFG_GetMQTTClientId();
@@ -1702,6 +2111,11 @@ void MQTT_init()
 	//cmddetail:"fn":"MQTT_SetTasTeleIntervals","file":"mqtt/new_mqtt.c","requires":"",
 	//cmddetail:"examples":""}
 	CMD_RegisterCommand("TasTeleInterval", MQTT_SetTasTeleIntervals, NULL);
+	//cmddetail:{"name":"mqtt_qos","args":"[Class][QoS]",
+	//cmddetail:"descr":"Sets MQTT QoS (0, 1 or 2) used for a class of publishes. Class can be channel (channel values), main (other values published as [client]/[name]/get), tele, stat, other (publish command and the rest) or all. Default is 2 for all of them. Without arguments, current values are printed.",
+	//cmddetail:"fn":"MQTT_SetPublishQoS","file":"mqtt/new_mqtt.c","requires":"",
+	//cmddetail:"examples":"mqtt_qos channel 0"}
+	CMD_RegisterCommand("mqtt_qos", MQTT_SetPublishQoS, NULL);
 }
 
 OBK_Publish_Result MQTT_DoItemPublishString(const char* sChannel, const char* valueStr)
@@ -1863,7 +2277,7 @@ int MQTT_RunEverySecondUpdate()
 		return 0;
 	}
 	if (g_mqtt_bBaseTopicDirty) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "MQTT base topic is dirty, will reinit callbacks and reconnect\n");
+		ADDLOG_INFO(LOG_FEATURE_MQTT, "MQTT base topic is dirty, will reinit callbacks and reconnect\n");
 		MQTT_InitCallbacks();
 		mqtt_reconnect = 5;
 	}
@@ -1871,7 +2285,7 @@ int MQTT_RunEverySecondUpdate()
 	// reconnect if went into MQTT library ERR_MEM forever loop
 	if (g_memoryErrorsThisSession >= 5)
 	{
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "MQTT will reconnect soon to fix ERR_MEM errors\n");
+		ADDLOG_INFO(LOG_FEATURE_MQTT, "MQTT will reconnect soon to fix ERR_MEM errors\n");
 		g_memoryErrorsThisSession = 0;
 		mqtt_reconnect = 5;
 	}
@@ -1886,13 +2300,13 @@ int MQTT_RunEverySecondUpdate()
 	if (mqtt_reconnect > 0)
 	{
 		mqtt_reconnect--;
-		addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "MQTT has pending reconnect in %i\n", mqtt_reconnect);
+		ADDLOG_INFO(LOG_FEATURE_MQTT, "MQTT has pending reconnect in %i\n", mqtt_reconnect);
 		if (mqtt_reconnect == 0)
 		{
 			// then if connected, disconnect, and then it will reconnect automatically in 2s
 			if (mqtt_client && res)
 			{
-				addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "MQTT will now do a forced reconnect\n");
+				ADDLOG_INFO(LOG_FEATURE_MQTT, "MQTT will now do a forced reconnect\n");
 				MQTT_disconnect(mqtt_client);
 				mqtt_loopsWithDisconnected = LOOPS_WITH_DISCONNECTED - 2;
 			}
@@ -1971,7 +2385,7 @@ int MQTT_RunEverySecondUpdate()
 #elif PLATFORM_BK7231N || PLATFORM_BK7231T
 		if (ota_progress() != -1)
 		{
-			addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "OTA started MQTT will be closed\n");
+			ADDLOG_INFO(LOG_FEATURE_MQTT, "OTA started MQTT will be closed\n");
 			LOCK_TCPIP_CORE();
 			mqtt_disconnect(mqtt_client);
 			UNLOCK_TCPIP_CORE();
@@ -2018,7 +2432,7 @@ int MQTT_RunEverySecondUpdate()
 					if (publishRes != OBK_PUBLISH_WAS_NOT_REQUIRED)
 					{
 						if (false) {
-							addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "[g_bPublishAllStatesNow] item %i result %i\n", g_publishItemIndex, publishRes);
+							ADDLOG_INFO(LOG_FEATURE_MQTT, "[g_bPublishAllStatesNow] item %i result %i\n", g_publishItemIndex, publishRes);
 						}
 					}
 					// There are several things that can happen now
@@ -2096,14 +2510,14 @@ MqttPublishItem_t* find_queue_reusable_item(MqttPublishItem_t* head) {
 void MQTT_QueuePublishWithCommand(const char* topic, const char* channel, const char* value, int flags, PostPublishCommands command) {
 	MqttPublishItem_t* newItem;
 	if (g_MqttPublishItemsQueued >= MQTT_MAX_QUEUE_SIZE) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_MQTT, "Unable to queue! %i items already present\r\n", g_MqttPublishItemsQueued);
+		ADDLOG_ERROR(LOG_FEATURE_MQTT, "Unable to queue! %i items already present\r\n", g_MqttPublishItemsQueued);
 		return;
 	}
 
 	if ((strlen(topic) > MQTT_PUBLISH_ITEM_TOPIC_LENGTH) ||
 		(strlen(channel) > MQTT_PUBLISH_ITEM_CHANNEL_LENGTH) ||
 		(strlen(value) > MQTT_PUBLISH_ITEM_VALUE_LENGTH)) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_MQTT, "Unable to queue! Topic (%i), channel (%i) or value (%i) exceeds size limit\r\n",
+		ADDLOG_ERROR(LOG_FEATURE_MQTT, "Unable to queue! Topic (%i), channel (%i) or value (%i) exceeds size limit\r\n",
 			strlen(topic), strlen(channel), strlen(value));
 		return;
 	}
@@ -2133,7 +2547,7 @@ void MQTT_QueuePublishWithCommand(const char* topic, const char* channel, const
 	newItem->flags = flags;
 
 	g_MqttPublishItemsQueued++;
-	addLogAdv(LOG_INFO, LOG_FEATURE_MQTT, "Queued topic=%s/%s, %i items in queue", newItem->topic, newItem->channel, g_MqttPublishItemsQueued);
+	ADDLOG_INFO(LOG_FEATURE_MQTT, "Queued topic=%s/%s, %i items in queue", newItem->topic, newItem->channel, g_MqttPublishItemsQueued);
 }
 
 /// @brief Add the specified command to the last entry in the queue.
@@ -2141,7 +2555,7 @@ void MQTT_QueuePublishWithCommand(const char* topic, const char* channel, const
 void MQTT_InvokeCommandAtEnd(PostPublishCommands command) {
 	MqttPublishItem_t* tail = get_queue_tail(g_MqttPublishQueueHead);
 	if (tail == NULL){
-		addLogAdv(LOG_ERROR, LOG_FEATURE_MQTT, "InvokeCommandAtEnd invoked but queue is empty");
+		ADDLOG_ERROR(LOG_FEATURE_MQTT, "InvokeCommandAtEnd invoked but queue is empty");
 	}
 	else {
 		tail->command = command;
@@ -2172,7 +2586,7 @@ OBK_Publish_Result PublishQueuedItems() {
 	while ((head != NULL) && (count < MQTT_QUEUED_ITEMS_PUBLISHED_AT_ONCE) && (g_MqttPublishItemsQueued > 0)) {
 		if (!MQTT_QUEUE_ITEM_IS_REUSABLE(head)) {  //Skip reusable entries
 			count++;
-			result = MQTT_PublishTopicToClient(mqtt_client, head->topic, head->channel, head->value, head->flags, false);
+			result = MQTT_PublishTopicToClient(mqtt_client, head->topic, head->channel, head->value, head->flags, false, MQTT_PUBLISH_CLASS_OTHER);
 			MQTT_QUEUE_ITEM_SET_REUSABLE(head); //Flag item as reusable
 			g_MqttPublishItemsQueued--;   //decrement queued count
 
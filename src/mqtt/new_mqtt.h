@@ -68,7 +68,14 @@ enum OBK_Publish_Result_e {
 typedef struct obk_mqtt_request_tag {
 	const unsigned char* received; // note: NOT terminated, may be binary
 	int receivedLen;
-	char topic[128];
+	// points into the receive buffer, valid only during the callback
+	const char* topic;
+	int topicLen;
+	// part of the topic from the level matched by the first wildcard
+	// of the subscription (so "5/set" for "obk/+/set"), or NULL
+	const char* subTopic;
+	// that level parsed as a number, -1 if it is not a number
+	int channel;
 } obk_mqtt_request_t;
 
 #define MQTT_PUBLISH_ITEM_TOPIC_LENGTH    64
@@ -115,7 +122,11 @@ int MQTT_GetConnectResult(void);
 char* MQTT_GetStatusMessage(void);
 int MQTT_GetPublishEventCounter(void);
 int MQTT_GetPublishErrorCounter(void);
+int MQTT_GetPublishAllocCounter(void);
+bool MQTT_HasChannelTopicTemplate(int channel);
 int MQTT_GetReceivedEventCounter(void);
+int MQTT_GetReceiveOverflowCounter(void);
+int MQTT_GetReceiveDropCounter(void);
 
 OBK_Publish_Result PublishQueuedItems();
 OBK_Publish_Result MQTT_ChannelPublish(int channel, int flags);
@@ -89,6 +89,7 @@ void CFG_MarkAsDirty() {
 }
 void CFG_ClearIO() {
 	memset(&g_cfg.pins, 0, sizeof(g_cfg.pins));
+	PIN_MarkPinIndexesDirty();
 	g_cfg_pendingChanges++;
 }
 void CFG_SetDefaultConfig() {
@@ -104,6 +105,7 @@ void CFG_SetDefaultConfig() {
 	g_configInitialized = 1;
 
 	memset(&g_cfg,0,sizeof(mainConfig_t));
+	PIN_MarkPinIndexesDirty();
 	g_cfg.version = MAIN_CFG_VERSION;
 	g_cfg.mqtt_port = 1883;
 	g_cfg.ident0 = CFG_IDENT_0;
@@ -431,6 +433,7 @@ void CFG_SetMQTTPass(const char *s) {
 }
 void CFG_ClearPins() {
 	memset(&g_cfg.pins,0,sizeof(g_cfg.pins));
+	PIN_MarkPinIndexesDirty();
 	g_cfg_pendingChanges++;
 }
 void CFG_IncrementOTACount() {
@@ -574,6 +577,9 @@ void PIN_SetPinChannelForPinIndex(int index, int ch) {
 	if(g_cfg.pins.channels[index] != ch) {
 		g_cfg_pendingChanges++;
 		g_cfg.pins.channels[index] = ch;
+		PIN_MarkPinIndexesDirty();
+		// a PWM pin takes the duty of its new channel
+		PIN_PWM_ApplyChannel(index);
 	}
 }
 void PIN_SetPinChannel2ForPinIndex(int index, int ch) {
@@ -584,6 +590,7 @@ void PIN_SetPinChannel2ForPinIndex(int index, int ch) {
 	if(g_cfg.pins.channels2[index] != ch) {
 		g_cfg_pendingChanges++;
 		g_cfg.pins.channels2[index] = ch;
+		PIN_MarkPinIndexesDirty();
 	}
 }
 //void CFG_ApplyStartChannelValues() {
@@ -669,6 +676,7 @@ void CFG_InitAndLoad() {
 	byte chkSum;
 
 	HAL_Configuration_ReadConfigMemory(&g_cfg,sizeof(g_cfg));
+	PIN_MarkPinIndexesDirty();
 	chkSum = CFG_CalcChecksum(&g_cfg);
 	if(g_cfg.ident0 != CFG_IDENT_0 || g_cfg.ident1 != CFG_IDENT_1 || g_cfg.ident2 != CFG_IDENT_2
 		|| chkSum != g_cfg.crc) {
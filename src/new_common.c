@@ -112,8 +112,8 @@ const char* strcasestr(const char* str1, const char* str2)
 // where is buffer with [64] bytes?
 // 2022-11-02 update: It was also causing crash on OpenBL602. Original strdup was crashing while my strdup works.
 // Let's just rename test_strdup to strdup and let it be our main correct strdup
-#if !defined(PLATFORM_W600) && !defined(PLATFORM_W800)
-// W600 and W800 already seem to have a strdup?
+#if !defined(PLATFORM_W600) && !defined(PLATFORM_W800) && !LINUX
+// W600 and W800 already seem to have a strdup? So does glibc.
 char *strdup(const char *s)
 {
     char *res;
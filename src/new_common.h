@@ -125,9 +125,14 @@ This platform is not supported, error!
 #define bk_printf printf
 
 // generic
+#if LINUX
+// littlefs pulls in <stdbool.h>, and on GCC the system one wins
+#include <stdbool.h>
+#else
 typedef int bool;
 #define true 1
 #define false 0
+#endif
 
 typedef int BaseType_t;
 typedef unsigned char u8;
@@ -176,15 +181,43 @@ typedef int SemaphoreHandle_t;
 #define pdTRUE 1
 #define pdFALSE 0
 typedef int OSStatus;
+typedef void *xQueueHandle;
+#define portMAX_DELAY 0xffffffff
+xQueueHandle xQueueCreate(int length, int itemSize);
+int xQueueSend(xQueueHandle handle, const void *item, portTickType ticks);
+int xQueueReceive(xQueueHandle handle, void *item, portTickType ticks);
+int uxQueueMessagesWaiting(xQueueHandle handle);
 
 enum {
 	kNoErr = 0,
 };
 
 typedef void * beken_thread_arg_t;
+typedef void * beken_thread_t;
 typedef int (*beken_thread_function_t)(void *p);
 #define BEKEN_APPLICATION_PRIORITY 1
 
+// simulator versions of the SDK calls, see win32/stubs/win_rtos_stub.c
+int xSemaphoreTake(SemaphoreHandle_t semaphore, int blockTime);
+SemaphoreHandle_t xSemaphoreCreateMutex();
+int xSemaphoreGive(SemaphoreHandle_t semaphore);
+int xTaskGetTickCount();
+int xPortGetFreeHeapSize();
+int rtos_delay_milliseconds(int ms);
+int delay_ms(int ms);
+int rtos_get_time();
+OSStatus rtos_create_thread(beken_thread_t* thread, int priority, const char* name,
+	beken_thread_function_t function, int stack_size, beken_thread_arg_t arg);
+OSStatus rtos_delete_thread(beken_thread_t* thread);
+int lwip_close(int socket);
+int lwip_close_force(int socket);
+int lwip_fcntl(int s, int cmd, int val);
+int hal_machw_time();
+int hal_machw_time_past(int tt);
+void doNothing();
+// debug_tuyaMCUsimulator.c
+void NewTuyaMCUSimulator_RunQuickTick(int deltaMS);
+
 #elif PLATFORM_BL602
 
 #include <FreeRTOS.h>
@@ -343,7 +376,46 @@ typedef unsigned char byte;
 
 
 
-#if WINDOWS
+#if WINDOWS && LINUX
+
+// headless Linux host build - map the few Win32/Winsock names the simulator uses onto POSIX
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <strings.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+typedef int SOCKET;
+typedef unsigned int DWORD;
+typedef unsigned int UINT32;
+typedef int WSADATA;
+#define INVALID_SOCKET			(-1)
+#define SOCKET_ERROR			(-1)
+#define WSAEWOULDBLOCK			EWOULDBLOCK
+#define SD_SEND					SHUT_WR
+#define WSAGetLastError()		(errno)
+#define WSAStartup(ver, data)	(0)
+#define WSACleanup()
+#define MAKEWORD(a, b)			(((b) << 8) | (a))
+#define ZeroMemory(p, len)		memset((p), 0, (len))
+#define closesocket				close
+#define ioctlsocket				ioctl
+#define __cdecl
+#define stricmp					strcasecmp
+// firmware usleep is a busy-wait of nops, not the POSIX one
+#define usleep					obk_usleep
+
+void Sleep(int ms);
+DWORD timeGetTime();
+
+#elif WINDOWS
 
 #undef UNICODE
 
@@ -398,6 +470,8 @@ void Main_OnEverySecond();
 int Main_HasMQTTConnected();
 int Main_HasWiFiConnected();
 void Main_OnPingCheckerReply(int ms);
+void Main_OnWiFiStatusChange(int code);
+void QuickTick(void* param);
 
 // new_ping.c
 void Main_SetupPingWatchDog(const char *target/*, int delayBetweenPings_Seconds*/);
@@ -16,6 +16,7 @@
 #include "hal/hal_flashVars.h"
 #include "hal/hal_pins.h"
 #include "hal/hal_adc.h"
+#include "hal/hal_generic.h"
 
 #ifdef PLATFORM_BEKEN
 #include <gpio_pub.h>
@@ -95,8 +96,116 @@ static byte g_lastValidState[PLATFORM_GPIO_MAX];
 uint32_t g_gpio_index_map[2] = { 0, 0 };
 uint32_t g_gpio_edge_map[2] = { 0, 0 }; // note: 0->rising, 1->falling
 
+// Reverse index from channel to the pins that use it, so channel queries
+// don't have to scan all PLATFORM_GPIO_MAX pins. Only pins with a role are
+// indexed. Pins of a channel are linked in ascending order, -1 ends a list.
+// It's rebuilt on first use after PIN_MarkPinIndexesDirty.
+#define PIN_ROLE_MASK_WORDS ((IOR_Total_Options + 31) / 32)
+
+static bool g_channelIndexDirty = true;
+// PIN_ticks pin list, see PIN_RebuildTickPins
+static bool g_tickPinsDirty = true;
+// by g_cfg.pins.channels
+static signed char g_channelFirstPin[CHANNEL_MAX];
+static signed char g_pinNextOnChannel[PLATFORM_GPIO_MAX];
+// by g_cfg.pins.channels2
+static signed char g_channel2FirstPin[CHANNEL_MAX];
+static signed char g_pinNextOnChannel2[PLATFORM_GPIO_MAX];
+// roles of pins in g_channelFirstPin lists
+static uint32_t g_channelRoles[CHANNEL_MAX][PIN_ROLE_MASK_WORDS];
+
+void PIN_MarkPinIndexesDirty() {
+	g_channelIndexDirty = true;
+	g_tickPinsDirty = true;
+}
+static void PIN_RebuildChannelIndex() {
+	int i, role, ch;
+
+	memset(g_channelFirstPin, -1, sizeof(g_channelFirstPin));
+	memset(g_channel2FirstPin, -1, sizeof(g_channel2FirstPin));
+	memset(g_channelRoles, 0, sizeof(g_channelRoles));
+	// go backwards, so prepending keeps the lists in pin order
+	for (i = PLATFORM_GPIO_MAX - 1; i >= 0; i--) {
+		role = g_cfg.pins.roles[i];
+		if (role == IOR_None) {
+			continue;
+		}
+		ch = g_cfg.pins.channels[i];
+		if (ch < CHANNEL_MAX) {
+			g_pinNextOnChannel[i] = g_channelFirstPin[ch];
+			g_channelFirstPin[ch] = i;
+			if (role < IOR_Total_Options) {
+				g_channelRoles[ch][role / 32] |= (1u << (role % 32));
+			}
+		}
+		ch = g_cfg.pins.channels2[i];
+		if (ch < CHANNEL_MAX) {
+			g_pinNextOnChannel2[i] = g_channel2FirstPin[ch];
+			g_channel2FirstPin[ch] = i;
+		}
+	}
+	g_channelIndexDirty = false;
+}
+static int PIN_FirstPinOnChannel(int ch) {
+	if (g_channelIndexDirty) {
+		PIN_RebuildChannelIndex();
+	}
+	return g_channelFirstPin[ch];
+}
+static int PIN_FirstPinOnChannel2(int ch) {
+	if (g_channelIndexDirty) {
+		PIN_RebuildChannelIndex();
+	}
+	return g_channel2FirstPin[ch];
+}
+static bool PIN_ChannelHasRole(int ch, int role) {
+	if (role < 0 || role >= IOR_Total_Options) {
+		return false;
+	}
+	if (g_channelIndexDirty) {
+		PIN_RebuildChannelIndex();
+	}
+	return (g_channelRoles[ch][role / 32] & (1u << (role % 32))) != 0;
+}
+
+// last duty written to each PWM pin, so that unchanged values are not
+// written again. Cleared when PWM is started or stopped on a pin.
+static float g_pwmDuty[PLATFORM_GPIO_MAX];
+static byte g_pwmDutyKnown[PLATFORM_GPIO_MAX];
+static pinTickStats_t g_pinTickStats;
+
+static void PIN_PWM_Update(int index, float duty) {
+	if (g_pwmDutyKnown[index] && g_pwmDuty[index] == duty) {
+		g_pinTickStats.pwmWritesSkipped++;
+		return;
+	}
+	g_pwmDuty[index] = duty;
+	g_pwmDutyKnown[index] = 1;
+	g_pinTickStats.pwmWrites++;
+	HAL_PIN_PWM_Update(index, duty);
+}
+// writes the value of the channel of a PWM pin, if the pin is a PWM
+void PIN_PWM_ApplyChannel(int index) {
+	int role = g_cfg.pins.roles[index];
+	float channelValue;
+
+	if (role != IOR_PWM && role != IOR_PWM_n) {
+		return;
+	}
+	channelValue = g_channelValuesFloats[PIN_GetPinChannelForPinIndex(index)];
+	if (role == IOR_PWM_n) {
+		// inversed PWM
+		PIN_PWM_Update(index, 100 - channelValue);
+	}
+	else {
+		PIN_PWM_Update(index, channelValue);
+	}
+}
+
 
 void setGPIActive(int index, int active, int falling) {
+	// PIN_ticks polls active inputs
+	g_tickPinsDirty = true;
 	if (active) {
 		if (index >= 32)
 			g_gpio_index_map[1] |= (1 << (index - 32));
@@ -160,7 +269,7 @@ void PINS_BeginDeepSleepWithPinWakeUp() {
 			setGPIActive(i, 1, falling);
 		}
 	}
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "Index map: %i, edge: %i", g_gpio_index_map[0], g_gpio_edge_map[0]);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "Index map: %i, edge: %i", g_gpio_index_map[0], g_gpio_edge_map[0]);
 #ifdef PLATFORM_BEKEN
 	// NOTE: this function:
 	// void bk_enter_deep_sleep(UINT32 gpio_index_map,UINT32 gpio_edge_map)
@@ -242,19 +351,19 @@ void PIN_SetupPins() {
     // TODO: better place to call?
     DHT_OnPinsConfigChanged();
 #endif
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "PIN_SetupPins pins have been set up.\r\n");
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "PIN_SetupPins pins have been set up.\r\n");
 }
 
 int PIN_GetPinRoleForPinIndex(int index) {
 	if (index < 0 || index >= PLATFORM_GPIO_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_CFG, "PIN_GetPinRoleForPinIndex: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_CFG, "PIN_GetPinRoleForPinIndex: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
 		return 0;
 	}
 	return g_cfg.pins.roles[index];
 }
 int PIN_GetPinChannelForPinIndex(int index) {
 	if (index < 0 || index >= PLATFORM_GPIO_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_CFG, "PIN_GetPinChannelForPinIndex: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_CFG, "PIN_GetPinChannelForPinIndex: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
 		return 0;
 	}
 	return g_cfg.pins.channels[index];
@@ -292,14 +401,14 @@ int PIN_FindPinIndexForRole(int role, int defaultIndexToReturnIfNotFound) {
 }
 int PIN_GetPinChannel2ForPinIndex(int index) {
 	if (index < 0 || index >= PLATFORM_GPIO_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_CFG, "PIN_GetPinChannel2ForPinIndex: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_CFG, "PIN_GetPinChannel2ForPinIndex: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
 		return 0;
 	}
 	return g_cfg.pins.channels2[index];
 }
 void RAW_SetPinValue(int index, int iVal) {
 	if (index < 0 || index >= PLATFORM_GPIO_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_CFG, "RAW_SetPinValue: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_CFG, "RAW_SetPinValue: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
 		return;
 	}
 	if (g_enable_pins) {
@@ -312,7 +421,7 @@ void Button_OnPressRelease(int index) {
 }
 void Button_OnInitialPressDown(int index)
 {
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "%i Button_OnInitialPressDown\r\n", index);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "%i Button_OnInitialPressDown\r\n", index);
 	EventHandlers_FireEvent(CMD_EVENT_PIN_ONPRESS, index);
 
 	// so-called SetOption13 - instant reaction to touch instead of waiting for release
@@ -354,7 +463,7 @@ void Button_OnInitialPressDown(int index)
 }
 void Button_OnShortClick(int index)
 {
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "%i key_short_press\r\n", index);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "%i key_short_press\r\n", index);
 	// fire event - button on pin <index> was clicked
 	EventHandlers_FireEvent(CMD_EVENT_PIN_ONCLICK, index);
 	// so-called SetOption13 - instant reaction to touch instead of waiting for release
@@ -394,7 +503,7 @@ void Button_OnShortClick(int index)
 }
 void Button_OnDoubleClick(int index)
 {
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "%i key_double_press\r\n", index);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "%i key_double_press\r\n", index);
 	if (g_cfg.pins.roles[index] == IOR_Button_ToggleAll || g_cfg.pins.roles[index] == IOR_Button_ToggleAll_n)
 	{
 		CHANNEL_DoSpecialToggleAll();
@@ -419,7 +528,7 @@ void Button_OnDoubleClick(int index)
 }
 void Button_OnTripleClick(int index)
 {
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "%i key_triple_press\r\n", index);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "%i key_triple_press\r\n", index);
 	// fire event - button on pin <index> was 3clicked
 	EventHandlers_FireEvent(CMD_EVENT_PIN_ON3CLICK, index);
 	if (g_cfg.pins.roles[index] == IOR_SmartButtonForLEDs || g_cfg.pins.roles[index] == IOR_SmartButtonForLEDs_n) {
@@ -430,18 +539,18 @@ void Button_OnTripleClick(int index)
 }
 void Button_OnQuadrupleClick(int index)
 {
-    addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "%i key_quadruple_press\r\n", index);
+    ADDLOG_INFO(LOG_FEATURE_GENERAL, "%i key_quadruple_press\r\n", index);
     // fire event - button on pin <index> was 4clicked
     EventHandlers_FireEvent(CMD_EVENT_PIN_ON4CLICK, index);
 }
 void Button_On5xClick(int index)
 {
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "%i key_5x_press\r\n", index);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "%i key_5x_press\r\n", index);
 	// fire event - button on pin <index> was 4clicked
 	EventHandlers_FireEvent(CMD_EVENT_PIN_ON5CLICK, index);
 }
 void Button_OnLongPressHold(int index) {
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "%i Button_OnLongPressHold\r\n", index);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "%i Button_OnLongPressHold\r\n", index);
 	// fire event - button on pin <index> was held
 	EventHandlers_FireEvent(CMD_EVENT_PIN_ONHOLD, index);
 
@@ -458,14 +567,14 @@ void Button_OnLongPressHold(int index) {
 	}
 }
 void Button_OnLongPressHoldStart(int index) {
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "%i Button_OnLongPressHoldStart\r\n", index);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "%i Button_OnLongPressHoldStart\r\n", index);
 	// fire event - button on pin <index> was held
 	EventHandlers_FireEvent(CMD_EVENT_PIN_ONHOLDSTART, index);
 }
 
 bool BTN_ShouldInvert(int index) {
 	if (index < 0 || index >= PLATFORM_GPIO_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_CFG, "BTN_ShouldInvert: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_CFG, "BTN_ShouldInvert: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
 		return false;
 	}
 	if (g_cfg.pins.roles[index] == IOR_Button_n || g_cfg.pins.roles[index] == IOR_Button_ToggleAll_n ||
@@ -501,7 +610,7 @@ static uint8_t button_generic_get_gpio_value(void* param)
 
 void NEW_button_init(pinButton_s* handle, uint8_t(*pin_level)(void* self), uint8_t active_level)
 {
-    memset(handle, sizeof(pinButton_s), 0);
+    memset(handle, 0, sizeof(pinButton_s));
 
     handle->event = (uint8_t)BTN_NONE_PRESS;
     handle->hal_button_Level = pin_level;
@@ -608,7 +717,7 @@ void PIN_SetPinRoleForPinIndex(int index, int role) {
 	bool bSampleInitialState = false;
 
 	if (index < 0 || index >= PLATFORM_GPIO_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_CFG, "PIN_SetPinRoleForPinIndex: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_CFG, "PIN_SetPinRoleForPinIndex: Pin index %i out of range <0,%i).", index, PLATFORM_GPIO_MAX);
 		return;
 	}
 #if 0
@@ -669,6 +778,7 @@ void PIN_SetPinRoleForPinIndex(int index, int role) {
 		case IOR_PWM:
 		{
 			HAL_PIN_PWM_Stop(index);
+			g_pwmDutyKnown[index] = 0;
 		}
 		break;
 		case IOR_BAT_ADC:
@@ -697,6 +807,7 @@ void PIN_SetPinRoleForPinIndex(int index, int role) {
 		}
 		g_cfg.pins.roles[index] = role;
 		g_cfg_pendingChanges++;
+		PIN_MarkPinIndexesDirty();
 	}
 
 	if (g_enable_pins) {
@@ -854,23 +965,10 @@ void PIN_SetPinRoleForPinIndex(int index, int role) {
 			break;
 		case IOR_PWM_n:
 		case IOR_PWM:
-		{
-			int channelIndex;
-			float channelValue;
-
-			channelIndex = PIN_GetPinChannelForPinIndex(index);
-			channelValue = g_channelValuesFloats[channelIndex];
 			HAL_PIN_PWM_Start(index);
-
-			if (role == IOR_PWM_n) {
-				// inversed PWM
-				HAL_PIN_PWM_Update(index, 100 - channelValue);
-			}
-			else {
-				HAL_PIN_PWM_Update(index, channelValue);
-			}
-		}
-		break;
+			g_pwmDutyKnown[index] = 0;
+			PIN_PWM_ApplyChannel(index);
+			break;
 
 		default:
 			break;
@@ -928,20 +1026,18 @@ static void Channel_OnChanged(int ch, int prevValue, int iFlags) {
     TuyaMCU_OnChannelChanged(ch, iVal);
 #endif
 
-	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
-		if (g_cfg.pins.channels[i] == ch) {
-			if (g_cfg.pins.roles[i] == IOR_Relay || g_cfg.pins.roles[i] == IOR_BAT_Relay || g_cfg.pins.roles[i] == IOR_LED) {
-				RAW_SetPinValue(i, bOn);
-			}
-			else if (g_cfg.pins.roles[i] == IOR_Relay_n || g_cfg.pins.roles[i] == IOR_LED_n) {
-				RAW_SetPinValue(i, !bOn);
-			}
-			else if (g_cfg.pins.roles[i] == IOR_PWM) {
-				HAL_PIN_PWM_Update(i, iVal);
-			}
-			else if (g_cfg.pins.roles[i] == IOR_PWM_n) {
-				HAL_PIN_PWM_Update(i, 100 - iVal);
-			}
+	for (i = PIN_FirstPinOnChannel(ch); i >= 0; i = g_pinNextOnChannel[i]) {
+		if (g_cfg.pins.roles[i] == IOR_Relay || g_cfg.pins.roles[i] == IOR_BAT_Relay || g_cfg.pins.roles[i] == IOR_LED) {
+			RAW_SetPinValue(i, bOn);
+		}
+		else if (g_cfg.pins.roles[i] == IOR_Relay_n || g_cfg.pins.roles[i] == IOR_LED_n) {
+			RAW_SetPinValue(i, !bOn);
+		}
+		else if (g_cfg.pins.roles[i] == IOR_PWM) {
+			PIN_PWM_Update(i, iVal);
+		}
+		else if (g_cfg.pins.roles[i] == IOR_PWM_n) {
+			PIN_PWM_Update(i, 100 - iVal);
 		}
 	}
 	if ((iFlags & CHANNEL_SET_FLAG_SKIP_MQTT) == 0) {
@@ -1006,7 +1102,7 @@ float CHANNEL_GetFinalValue(int channel) {
 }
 float CHANNEL_GetFloat(int ch) {
     if (ch < 0 || ch >= CHANNEL_MAX) {
-        addLogAdv(LOG_ERROR, LOG_FEATURE_GENERAL, "CHANNEL_Get: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
+        ADDLOG_ERROR(LOG_FEATURE_GENERAL, "CHANNEL_Get: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
         return 0;
     }
     return g_channelValuesFloats[ch];
@@ -1029,7 +1125,7 @@ int CHANNEL_Get(int ch) {
 		return HAL_FlashVars_GetChannelValue(ch - SPECIAL_CHANNEL_FLASHVARS_FIRST);
 	}
 	if (ch < 0 || ch >= CHANNEL_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_GENERAL, "CHANNEL_Get: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_GENERAL, "CHANNEL_Get: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
 		return 0;
 	}
 	return g_channelValues[ch];
@@ -1045,17 +1141,19 @@ void CHANNEL_ClearAllChannels() {
 void CHANNEL_Set_FloatPWM(int ch, float fVal, int iFlags) {
     int i;
 
+    if (ch < 0 || ch >= CHANNEL_MAX) {
+        ADDLOG_ERROR(LOG_FEATURE_GENERAL, "CHANNEL_Set_FloatPWM: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
+        return;
+    }
     g_channelValues[ch] = (int)fVal;
     g_channelValuesFloats[ch] = fVal;
 
-    for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
-        if (g_cfg.pins.channels[i] == ch) {
-            if (g_cfg.pins.roles[i] == IOR_PWM) {
-                HAL_PIN_PWM_Update(i, fVal);
-            }
-            else if (g_cfg.pins.roles[i] == IOR_PWM_n) {
-                HAL_PIN_PWM_Update(i, 100.0f - fVal);
-            }
+    for (i = PIN_FirstPinOnChannel(ch); i >= 0; i = g_pinNextOnChannel[i]) {
+        if (g_cfg.pins.roles[i] == IOR_PWM) {
+            PIN_PWM_Update(i, fVal);
+        }
+        else if (g_cfg.pins.roles[i] == IOR_PWM_n) {
+            PIN_PWM_Update(i, 100.0f - fVal);
         }
     }
 }
@@ -1089,7 +1187,7 @@ void CHANNEL_Set(int ch, int iVal, int iFlags) {
 	}
 	if (ch < 0 || ch >= CHANNEL_MAX) {
 		//if(bMustBeSilent==0) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_GENERAL, "CHANNEL_Set: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_GENERAL, "CHANNEL_Set: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
 		//}
 		return;
 	}
@@ -1097,13 +1195,13 @@ void CHANNEL_Set(int ch, int iVal, int iFlags) {
 	if (bForce == 0) {
 		if (prevValue == iVal) {
 			if (bSilent == 0) {
-				addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "No change in channel %i (still set to %i) - ignoring\n\r", ch, prevValue);
+				ADDLOG_INFO(LOG_FEATURE_GENERAL, "No change in channel %i (still set to %i) - ignoring\n\r", ch, prevValue);
 			}
 			return;
 		}
 	}
 	if (bSilent == 0) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "CHANNEL_Set channel %i has changed to %i (flags %i)\n\r", ch, iVal, iFlags);
+		ADDLOG_INFO(LOG_FEATURE_GENERAL, "CHANNEL_Set channel %i has changed to %i (flags %i)\n\r", ch, iVal, iFlags);
 	}
 	g_channelValues[ch] = iVal;
 
@@ -1113,7 +1211,7 @@ void CHANNEL_AddClamped(int ch, int iVal, int min, int max, int bWrapInsteadOfCl
 #if 0
 	int prevValue;
 	if (ch < 0 || ch >= CHANNEL_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_GENERAL, "CHANNEL_AddClamped: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_GENERAL, "CHANNEL_AddClamped: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
 		return;
 	}
 	prevValue = g_channelValues[ch];
@@ -1132,7 +1230,7 @@ void CHANNEL_AddClamped(int ch, int iVal, int min, int max, int bWrapInsteadOfCl
 			g_channelValues[ch] = min;
 	}
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "CHANNEL_AddClamped channel %i has changed to %i\n\r", ch, g_channelValues[ch]);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "CHANNEL_AddClamped channel %i has changed to %i\n\r", ch, g_channelValues[ch]);
 
 	Channel_OnChanged(ch, prevValue, 0);
 #else
@@ -1153,7 +1251,7 @@ void CHANNEL_AddClamped(int ch, int iVal, int min, int max, int bWrapInsteadOfCl
 			iVal = min;
 	}
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "CHANNEL_AddClamped channel %i has changed to %i\n\r", ch, iVal);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "CHANNEL_AddClamped channel %i has changed to %i\n\r", ch, iVal);
 
 	CHANNEL_Set(ch, iVal, 0);
 #endif
@@ -1162,37 +1260,28 @@ void CHANNEL_Add(int ch, int iVal) {
 #if 0
 	int prevValue;
 	if (ch < 0 || ch >= CHANNEL_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_GENERAL, "CHANNEL_Add: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_GENERAL, "CHANNEL_Add: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
 		return;
 	}
 	prevValue = g_channelValues[ch];
 	g_channelValues[ch] = g_channelValues[ch] + iVal;
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "CHANNEL_Add channel %i has changed to %i\n\r", ch, g_channelValues[ch]);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "CHANNEL_Add channel %i has changed to %i\n\r", ch, g_channelValues[ch]);
 
 	Channel_OnChanged(ch, prevValue, 0);
 #else
 	// we want to support special channel indexes, so it's better to use GET/SET interface
 	// Special channel indexes are used to access things like dimmer, led colors, etc
 	iVal = iVal + CHANNEL_Get(ch);
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "CHANNEL_Add channel %i has changed to %i\n\r", ch, iVal);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "CHANNEL_Add channel %i has changed to %i\n\r", ch, iVal);
 	CHANNEL_Set(ch, iVal, 0);
 #endif
 }
 
 int CHANNEL_FindMaxValueForChannel(int ch) {
-	int i;
-	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
-		// is pin tied to this channel?
-		if (g_cfg.pins.channels[i] == ch) {
-			// is it PWM?
-			if (g_cfg.pins.roles[i] == IOR_PWM) {
-				return 100;
-			}
-			if (g_cfg.pins.roles[i] == IOR_PWM_n) {
-				return 100;
-			}
-		}
+	// is any PWM pin tied to this channel?
+	if (PIN_ChannelHasRole(ch, IOR_PWM) || PIN_ChannelHasRole(ch, IOR_PWM_n)) {
+		return 100;
 	}
 	if (g_cfg.pins.channelTypes[ch] == ChType_Dimmer)
 		return 100;
@@ -1213,7 +1302,7 @@ void CHANNEL_Toggle(int ch) {
 		return;
 	}
 	if (ch < 0 || ch >= CHANNEL_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_GENERAL, "CHANNEL_Toggle: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_GENERAL, "CHANNEL_Toggle: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
 		return;
 	}
 	prev = g_channelValues[ch];
@@ -1225,35 +1314,23 @@ void CHANNEL_Toggle(int ch) {
 	Channel_OnChanged(ch, prev, 0);
 }
 int CHANNEL_HasChannelPinWithRoleOrRole(int ch, int iorType, int iorType2) {
-	int i;
-
 	if (ch < 0 || ch >= CHANNEL_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_GENERAL, "CHANNEL_HasChannelPinWithRole: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_GENERAL, "CHANNEL_HasChannelPinWithRole: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
 		return 0;
 	}
-	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
-		if (g_cfg.pins.channels[i] == ch) {
-			if (g_cfg.pins.roles[i] == iorType)
-				return 1;
-			else if (g_cfg.pins.roles[i] == iorType2)
-				return 1;
-		}
-	}
+	if (PIN_ChannelHasRole(ch, iorType))
+		return 1;
+	if (PIN_ChannelHasRole(ch, iorType2))
+		return 1;
 	return 0;
 }
 int CHANNEL_HasChannelPinWithRole(int ch, int iorType) {
-	int i;
-
 	if (ch < 0 || ch >= CHANNEL_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_GENERAL, "CHANNEL_HasChannelPinWithRole: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_GENERAL, "CHANNEL_HasChannelPinWithRole: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
 		return 0;
 	}
-	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
-		if (g_cfg.pins.channels[i] == ch) {
-			if (g_cfg.pins.roles[i] == iorType)
-				return 1;
-		}
-	}
+	if (PIN_ChannelHasRole(ch, iorType))
+		return 1;
 	return 0;
 }
 bool CHANNEL_Check(int ch) {
@@ -1261,7 +1338,7 @@ bool CHANNEL_Check(int ch) {
 		return LED_GetEnableAll();
 	}
 	if (ch < 0 || ch >= CHANNEL_MAX) {
-		addLogAdv(LOG_ERROR, LOG_FEATURE_GENERAL, "CHANNEL_Check: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
+		ADDLOG_ERROR(LOG_FEATURE_GENERAL, "CHANNEL_Check: Channel index %i is out of range <0,%i)\n\r", ch, CHANNEL_MAX);
 		return 0;
 	}
 	if (g_channelValues[ch] > 0)
@@ -1270,65 +1347,66 @@ bool CHANNEL_Check(int ch) {
 }
 
 bool CHANNEL_IsInUse(int ch) {
-	int i;
-
+	if (ch < 0 || ch >= CHANNEL_MAX) {
+		return false;
+	}
 	if (g_cfg.pins.channelTypes[ch] != ChType_Default) {
 		return true;
 	}
-
-	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
-		if (g_cfg.pins.roles[i] != IOR_None) {
-			if (g_cfg.pins.channels[i] == ch) {
-				return true;
-			}
-			if (g_cfg.pins.channels2[i] == ch) {
-				return true;
-			}
-		}
+	// only pins with a role are indexed
+	if (PIN_FirstPinOnChannel(ch) >= 0) {
+		return true;
+	}
+	if (PIN_FirstPinOnChannel2(ch) >= 0) {
+		return true;
 	}
 	return false;
 }
 
 
 bool CHANNEL_IsPowerRelayChannel(int ch) {
-	int i;
-	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
-		if (g_cfg.pins.channels[i] == ch) {
-			int role = g_cfg.pins.roles[i];
-			// NOTE: do not include Battery relay
-			if (role == IOR_Relay || role == IOR_Relay_n) {
-				return true;
-			}
-		}
+	if (ch < 0 || ch >= CHANNEL_MAX) {
+		return false;
+	}
+	// NOTE: do not include Battery relay
+	if (PIN_ChannelHasRole(ch, IOR_Relay) || PIN_ChannelHasRole(ch, IOR_Relay_n)) {
+		return true;
 	}
 	return false;
 }
 bool CHANNEL_ShouldBePublished(int ch) {
 	int i;
-	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
-		int role = g_cfg.pins.roles[i];
+	int role;
 
+	if (ch < 0 || ch >= CHANNEL_MAX) {
+		return false;
+	}
+	for (i = PIN_FirstPinOnChannel(ch); i >= 0; i = g_pinNextOnChannel[i]) {
+		role = g_cfg.pins.roles[i];
+		if (role == IOR_Relay || role == IOR_Relay_n
+			|| role == IOR_LED || role == IOR_LED_n
+			|| role == IOR_ADC || role == IOR_BAT_ADC || role == IOR_BAT_Relay
+			|| role == IOR_CHT8305_DAT || role == IOR_SHT3X_DAT || role == IOR_SGP_DAT
+			|| role == IOR_DigitalInput || role == IOR_DigitalInput_n
+			|| role == IOR_DoorSensorWithDeepSleep || role == IOR_DoorSensorWithDeepSleep_NoPup
+			|| role == IOR_DoorSensorWithDeepSleep_pd
+			|| IS_PIN_DHT_ROLE(role)
+			|| role == IOR_DigitalInput_NoPup || role == IOR_DigitalInput_NoPup_n) {
+			return true;
+		}
+	}
+	for (i = PIN_FirstPinOnChannel2(ch); i >= 0; i = g_pinNextOnChannel2[i]) {
+		// primary channel of this pin was already checked above
 		if (g_cfg.pins.channels[i] == ch) {
-			if (role == IOR_Relay || role == IOR_Relay_n
-				|| role == IOR_LED || role == IOR_LED_n
-				|| role == IOR_ADC || role == IOR_BAT_ADC || role == IOR_BAT_Relay
-				|| role == IOR_CHT8305_DAT || role == IOR_SHT3X_DAT || role == IOR_SGP_DAT
-				|| role == IOR_DigitalInput || role == IOR_DigitalInput_n
-				|| role == IOR_DoorSensorWithDeepSleep || role == IOR_DoorSensorWithDeepSleep_NoPup
-				|| role == IOR_DoorSensorWithDeepSleep_pd
-				|| IS_PIN_DHT_ROLE(role)
-				|| role == IOR_DigitalInput_NoPup || role == IOR_DigitalInput_NoPup_n) {
-				return true;
-			}
+			continue;
 		}
-		else if (g_cfg.pins.channels2[i] == ch) {
-			if (IS_PIN_DHT_ROLE(role)) {
-				return true;
-			}
-			// SGP, CHT8305 and SHT3X uses secondary channel for humidity
-			if (role == IOR_CHT8305_DAT || role == IOR_SHT3X_DAT || role == IOR_SGP_DAT) {
-				return true;
-			}
+		role = g_cfg.pins.roles[i];
+		if (IS_PIN_DHT_ROLE(role)) {
+			return true;
+		}
+		// SGP, CHT8305 and SHT3X uses secondary channel for humidity
+		if (role == IOR_CHT8305_DAT || role == IOR_SHT3X_DAT || role == IOR_SGP_DAT) {
+			return true;
 		}
 	}
 	if (g_cfg.pins.channelTypes[ch] != ChType_Default) {
@@ -1348,26 +1426,28 @@ bool CHANNEL_ShouldBePublished(int ch) {
 }
 int CHANNEL_GetRoleForOutputChannel(int ch) {
 	int i;
-	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
-		if (g_cfg.pins.channels[i] == ch) {
-			switch (g_cfg.pins.roles[i]) {
-			case IOR_BAT_Relay:
-			case IOR_Relay:
-			case IOR_Relay_n:
-			case IOR_LED:
-			case IOR_LED_n:
-			case IOR_PWM_n:
-			case IOR_PWM:
-				return g_cfg.pins.roles[i];
-			case IOR_BridgeForward:
-			case IOR_BridgeReverse:
-				return g_cfg.pins.roles[i];
-			case IOR_Button:
-			case IOR_Button_n:
-			case IOR_LED_WIFI:
-			case IOR_LED_WIFI_n:
-				break;
-			}
+
+	if (ch < 0 || ch >= CHANNEL_MAX) {
+		return IOR_None;
+	}
+	for (i = PIN_FirstPinOnChannel(ch); i >= 0; i = g_pinNextOnChannel[i]) {
+		switch (g_cfg.pins.roles[i]) {
+		case IOR_BAT_Relay:
+		case IOR_Relay:
+		case IOR_Relay_n:
+		case IOR_LED:
+		case IOR_LED_n:
+		case IOR_PWM_n:
+		case IOR_PWM:
+			return g_cfg.pins.roles[i];
+		case IOR_BridgeForward:
+		case IOR_BridgeReverse:
+			return g_cfg.pins.roles[i];
+		case IOR_Button:
+		case IOR_Button_n:
+		case IOR_LED_WIFI:
+		case IOR_LED_WIFI_n:
+			break;
 		}
 	}
 	return IOR_None;
@@ -1536,12 +1616,150 @@ static uint32_t g_time = 0;
 static uint32_t g_last_time = 0;
 static int activepoll_time = 0; // time to keep polling active until
 
+// PIN_ticks only visits pins with a role that has to be polled,
+// or which are marked as active inputs in g_gpio_index_map
+typedef void (*pinTickFunc_t)(int index, uint32_t t_diff, int debounceMS);
+typedef struct pinTickEntry_s {
+	byte index;
+	// NULL if the pin is only checked for being active
+	pinTickFunc_t func;
+} pinTickEntry_t;
+
+static pinTickEntry_t g_tickPins[PLATFORM_GPIO_MAX];
+static int g_tickPinsCount = 0;
+
+// PIN_ticks duration histogram, the last bucket is for 5 ms and more
+static const int g_pinTickTimeLimits[PIN_TICK_TIME_BUCKETS - 1] = { 50, 100, 250, 500, 1000, 2500, 5000 };
+
+static void PIN_Tick_Button(int i, uint32_t t_diff, int debounceMS) {
+	PIN_Input_Handler(i, t_diff);
+}
+static void PIN_Tick_DigitalInput(int i, uint32_t t_diff, int debounceMS) {
+	int value;
+
+	// read pin digital value (and already invert it if needed)
+	value = PIN_ReadDigitalInputValue_WithInversionIncluded(i);
+
+	// debouncing
+	if (value) {
+		if (g_times[i] > debounceMS) {
+			if (g_lastValidState[i] != value) {
+				// became up
+				g_lastValidState[i] = value;
+				CHANNEL_Set(g_cfg.pins.channels[i], value, 0);
+			}
+		}
+		else {
+			g_times[i] += t_diff;
+		}
+		g_times2[i] = 0;
+	}
+	else {
+		if (g_times2[i] > debounceMS) {
+			if (g_lastValidState[i] != value) {
+				// became down
+				g_lastValidState[i] = value;
+				CHANNEL_Set(g_cfg.pins.channels[i], value, 0);
+			}
+		}
+		else {
+			g_times2[i] += t_diff;
+		}
+		g_times[i] = 0;
+	}
+}
+static void PIN_Tick_ToggleChannelOnToggle(int i, uint32_t t_diff, int debounceMS) {
+	int value;
+
+	// we must detect a toggle, but with debouncing
+	value = PIN_ReadDigitalInputValue_WithInversionIncluded(i);
+	// debouncing
+	if (g_times[i] <= 0) {
+		if (g_lastValidState[i] != value) {
+			// became up
+			g_lastValidState[i] = value;
+			CHANNEL_Toggle(g_cfg.pins.channels[i]);
+			// fire event - IOR_ToggleChannelOnToggle has been toggle
+			// Argument is a pin number (NOT channel)
+			EventHandlers_FireEvent(CMD_EVENT_PIN_ONTOGGLE, i);
+			// lock for given time
+			g_times[i] = debounceMS;
+		}
+	}
+	else {
+		g_times[i] -= t_diff;
+	}
+}
+static pinTickFunc_t PIN_GetTickFuncForRole(int role) {
+	switch (role) {
+	case IOR_Button:
+	case IOR_Button_n:
+	case IOR_Button_ToggleAll:
+	case IOR_Button_ToggleAll_n:
+	case IOR_Button_NextColor:
+	case IOR_Button_NextColor_n:
+	case IOR_Button_NextDimmer:
+	case IOR_Button_NextDimmer_n:
+	case IOR_Button_NextTemperature:
+	case IOR_Button_NextTemperature_n:
+	case IOR_Button_ScriptOnly:
+	case IOR_Button_ScriptOnly_n:
+	case IOR_SmartButtonForLEDs:
+	case IOR_SmartButtonForLEDs_n:
+		return PIN_Tick_Button;
+	case IOR_DigitalInput:
+	case IOR_DigitalInput_n:
+	case IOR_DigitalInput_NoPup:
+	case IOR_DigitalInput_NoPup_n:
+	case IOR_DoorSensorWithDeepSleep:
+	case IOR_DoorSensorWithDeepSleep_NoPup:
+	case IOR_DoorSensorWithDeepSleep_pd:
+		return PIN_Tick_DigitalInput;
+	case IOR_ToggleChannelOnToggle:
+		return PIN_Tick_ToggleChannelOnToggle;
+	}
+	return NULL;
+}
+static void PIN_RebuildTickPins() {
+	int i;
+	pinTickFunc_t func;
+	bool bActive;
+
+	g_tickPinsCount = 0;
+	for (i = 0; i < PLATFORM_GPIO_MAX; i++) {
+		func = PIN_GetTickFuncForRole(g_cfg.pins.roles[i]);
+		bActive = BIT_CHECK(g_gpio_index_map[i / 32], i % 32);
+		if (func == NULL && bActive == false) {
+			continue;
+		}
+		g_tickPins[g_tickPinsCount].index = i;
+		g_tickPins[g_tickPinsCount].func = func;
+		g_tickPinsCount++;
+	}
+	g_tickPinsDirty = false;
+}
+const pinTickStats_t* PIN_GetTickStats() {
+	return &g_pinTickStats;
+}
+static void PIN_RecordTickTime(unsigned int us) {
+	int i;
+
+	g_pinTickStats.ticks++;
+	if (us > g_pinTickStats.maxUs) {
+		g_pinTickStats.maxUs = us;
+	}
+	for (i = 0; i < PIN_TICK_TIME_BUCKETS - 1 && us >= g_pinTickTimeLimits[i]; i++) {
+	}
+	g_pinTickStats.timeBuckets[i]++;
+}
+
 //  background ticks, timer repeat invoking interval defined by PIN_TMR_DURATION.
 void PIN_ticks(void* param)
 {
-    int i;
-    int value;
+    int i, j;
+    unsigned int startUs;
 
+    startUs = HAL_GetTimeUs();
 #if defined(PLATFORM_BEKEN) || defined(WINDOWS)
     g_time = rtos_get_time();
 #else
@@ -1569,137 +1787,41 @@ void PIN_ticks(void* param)
 	int activepins = 0;
 	uint32_t pinvalues[2] = { 0, 0 };
 
-	for (i = 0; i < PLATFORM_GPIO_MAX; i++)
+	if (g_tickPinsDirty) {
+		PIN_RebuildTickPins();
+	}
+	// PWM pins are not visited here, their duty is written when the channel changes
+	for (j = 0; j < g_tickPinsCount; j++)
 	{
+		i = g_tickPins[j].index;
 		// note pins which are active - i.e. would not trigger an edge interrupt on change.
 		// if we have any, then we must poll until none
 		// TODO: this will only be used when GPI interrupt triggeringis used.
 		// but it's useful info anyway...
-
-		if (i >= 32)
+		if (g_gpio_index_map[i / 32] & (1 << (i % 32)))
 		{
-			if (g_gpio_index_map[1] & (1 << (i - 32)))
-			{
-				uint32_t level = 1;
-				if (g_gpio_edge_map[1] & (1 << (i - 32))) {
-					level = 0;
-				}
-				int rawval = HAL_PIN_ReadDigitalInput(i);
-				if (rawval && level == 1) {
-					activepins++;
-					pinvalues[1] |= (1 << (i - 32));
-				}
-				if (!rawval && level == 0) {
-					activepins++;
-					pinvalues[1] |= (1 << (i - 32));
-				}
+			uint32_t level = 1;
+			if (g_gpio_edge_map[i / 32] & (1 << (i % 32))) {
+				level = 0;
 			}
-		}
-		else {
-			if (g_gpio_index_map[0] & (1 << i))
-			{
-				uint32_t level = 1;
-				if (g_gpio_edge_map[0] & (1 << i)) {
-					level = 0;
-				}
-				int rawval = HAL_PIN_ReadDigitalInput(i);
-				if (rawval && level == 1) {
-					activepins++;
-					pinvalues[0] |= (1 << i);
-				}
-				if (!rawval && level == 0) {
-					activepins++;
-					pinvalues[0] |= (1 << i);
-				}
+			int rawval = HAL_PIN_ReadDigitalInput(i);
+			if (rawval && level == 1) {
+				activepins++;
+				pinvalues[i / 32] |= (1 << (i % 32));
+			}
+			if (!rawval && level == 0) {
+				activepins++;
+				pinvalues[i / 32] |= (1 << (i % 32));
 			}
 		}
 
-		// activepins is count of pins which are 'active', i.e. match thier expected active level
-		if (activepins) {
-			activepoll_time = 1000; //20 x 50ms = 1s of polls after button release
-		}
-
-#if 1
-		if (g_cfg.pins.roles[i] == IOR_PWM) {
-			HAL_PIN_PWM_Update(i, g_channelValuesFloats[g_cfg.pins.channels[i]]);
+		if (g_tickPins[j].func) {
+			g_tickPins[j].func(i, t_diff, debounceMS);
 		}
-		else if (g_cfg.pins.roles[i] == IOR_PWM_n) {
-			// invert PWM value
-			HAL_PIN_PWM_Update(i, 100 - g_channelValuesFloats[g_cfg.pins.channels[i]]);
-		}
-		else
-#endif
-			if (g_cfg.pins.roles[i] == IOR_Button || g_cfg.pins.roles[i] == IOR_Button_n
-				|| g_cfg.pins.roles[i] == IOR_Button_ToggleAll || g_cfg.pins.roles[i] == IOR_Button_ToggleAll_n
-				|| g_cfg.pins.roles[i] == IOR_Button_NextColor || g_cfg.pins.roles[i] == IOR_Button_NextColor_n
-				|| g_cfg.pins.roles[i] == IOR_Button_NextDimmer || g_cfg.pins.roles[i] == IOR_Button_NextDimmer_n
-				|| g_cfg.pins.roles[i] == IOR_Button_NextTemperature || g_cfg.pins.roles[i] == IOR_Button_NextTemperature_n
-				|| g_cfg.pins.roles[i] == IOR_Button_ScriptOnly || g_cfg.pins.roles[i] == IOR_Button_ScriptOnly_n
-				|| g_cfg.pins.roles[i] == IOR_SmartButtonForLEDs || g_cfg.pins.roles[i] == IOR_SmartButtonForLEDs_n) {
-				//addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL,"Test hold %i\r\n",i);
-				PIN_Input_Handler(i, t_diff);
-			}
-			else if (g_cfg.pins.roles[i] == IOR_DigitalInput || g_cfg.pins.roles[i] == IOR_DigitalInput_n
-				||
-				g_cfg.pins.roles[i] == IOR_DigitalInput_NoPup || g_cfg.pins.roles[i] == IOR_DigitalInput_NoPup_n
-				|| g_cfg.pins.roles[i] == IOR_DoorSensorWithDeepSleep || g_cfg.pins.roles[i] == IOR_DoorSensorWithDeepSleep_NoPup
-				|| g_cfg.pins.roles[i] == IOR_DoorSensorWithDeepSleep_pd) {
-				// read pin digital value (and already invert it if needed)
-				value = PIN_ReadDigitalInputValue_WithInversionIncluded(i);
-
-#if 0
-				CHANNEL_Set(g_cfg.pins.channels[i], value, 0);
-#else
-				// debouncing
-				if (value) {
-					if (g_times[i] > debounceMS) {
-						if (g_lastValidState[i] != value) {
-							// became up
-							g_lastValidState[i] = value;
-							CHANNEL_Set(g_cfg.pins.channels[i], value, 0);
-						}
-					}
-					else {
-						g_times[i] += t_diff;
-					}
-					g_times2[i] = 0;
-				}
-				else {
-					if (g_times2[i] > debounceMS) {
-						if (g_lastValidState[i] != value) {
-							// became down
-							g_lastValidState[i] = value;
-							CHANNEL_Set(g_cfg.pins.channels[i], value, 0);
-						}
-					}
-					else {
-						g_times2[i] += t_diff;
-					}
-					g_times[i] = 0;
-				}
-
-#endif
-			}
-			else if (g_cfg.pins.roles[i] == IOR_ToggleChannelOnToggle) {
-				// we must detect a toggle, but with debouncing
-				value = PIN_ReadDigitalInputValue_WithInversionIncluded(i);
-				// debouncing
-				if (g_times[i] <= 0) {
-					if (g_lastValidState[i] != value) {
-						// became up
-						g_lastValidState[i] = value;
-						CHANNEL_Toggle(g_cfg.pins.channels[i]);
-						// fire event - IOR_ToggleChannelOnToggle has been toggle
-						// Argument is a pin number (NOT channel)
-						EventHandlers_FireEvent(CMD_EVENT_PIN_ONTOGGLE, i);
-						// lock for given time
-						g_times[i] = debounceMS;
-					}
-				}
-				else {
-					g_times[i] -= t_diff;
-				}
-			}
+	}
+	// activepins is count of pins which are 'active', i.e. match thier expected active level
+	if (activepins) {
+		activepoll_time = 1000; //20 x 50ms = 1s of polls after button release
 	}
 
 #ifdef PLATFORM_BEKEN
@@ -1707,7 +1829,7 @@ void PIN_ticks(void* param)
 	// TODO: not implemented yet - this bit continues polling
 	// for a while after a GPI is fired, so that we can see long press, etc.
 	if (param) {
-		addLogAdv(LOG_DEBUG, LOG_FEATURE_GENERAL, "Pin intr at %d (+%d) (%08lX)", g_time, t_diff, pinvalues[0]);
+		ADDLOG_DEBUG(LOG_FEATURE_GENERAL, "Pin intr at %d (+%d) (%08lX)", g_time, t_diff, pinvalues[0]);
 	}
 #endif
 #endif
@@ -1724,10 +1846,10 @@ void PIN_ticks(void* param)
 #ifdef BEKEN_PIN_GPI_INTERRUPTS
 		PIN_TriggerPoll();
 		if (activepins) {
-			addLogAdv(LOG_DEBUG, LOG_FEATURE_GENERAL, "Pins active at %d (%x)", g_time, pinvalues[0]);
+			ADDLOG_DEBUG(LOG_FEATURE_GENERAL, "Pins active at %d (%x)", g_time, pinvalues[0]);
 		}
 		else {
-			addLogAdv(LOG_DEBUG, LOG_FEATURE_GENERAL, "Pins ->inactive at %d (%x)", g_time, pinvalues[0]);
+			ADDLOG_DEBUG(LOG_FEATURE_GENERAL, "Pins ->inactive at %d (%x)", g_time, pinvalues[0]);
 		}
 #endif
 #endif
@@ -1736,11 +1858,12 @@ void PIN_ticks(void* param)
 	else {
 #ifdef PLATFORM_BEKEN
 #ifdef BEKEN_PIN_GPI_INTERRUPTS
-		addLogAdv(LOG_DEBUG, LOG_FEATURE_GENERAL, "Pins inactive at %d", g_time);
+		ADDLOG_DEBUG(LOG_FEATURE_GENERAL, "Pins inactive at %d", g_time);
 #endif      
 #endif      
 	}
 
+	PIN_RecordTickTime(HAL_GetTimeUs() - startUs);
 }
 const char* g_channelTypeNames[] = {
 	"Default",
@@ -1813,7 +1936,7 @@ static commandResult_t CMD_setButtonHoldRepeat(const void* context, const char*
 	Tokenizer_TokenizeString(args, 0);
 
 	if (Tokenizer_GetArgsCount() < 1) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "This command requires 1 argument - timeRepeat - current %i",
+		ADDLOG_INFO(LOG_FEATURE_GENERAL, "This command requires 1 argument - timeRepeat - current %i",
 			g_cfg.buttonHoldRepeat);
 		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
 	}
@@ -1822,10 +1945,10 @@ static commandResult_t CMD_setButtonHoldRepeat(const void* context, const char*
 
     CFG_Save_IfThereArePendingChanges();
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "Times set, %i. Config autosaved to flash.",
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "Times set, %i. Config autosaved to flash.",
 		g_cfg.buttonHoldRepeat
 	);
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "If something is wrong, you can restore default %i",
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "If something is wrong, you can restore default %i",
 		CFG_DEFAULT_BTN_REPEAT);
 	return CMD_RES_OK;
 }
@@ -1837,7 +1960,7 @@ static commandResult_t CMD_SetButtonTimes(const void* context, const char* cmd,
 	Tokenizer_TokenizeString(args, 0);
 
 	if (Tokenizer_GetArgsCount() < 3) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "This command requires 3 arguments - timeLong, timeShort, timeRepeat - current %i %i %i",
+		ADDLOG_INFO(LOG_FEATURE_GENERAL, "This command requires 3 arguments - timeLong, timeShort, timeRepeat - current %i %i %i",
 			g_cfg.buttonLongPress, g_cfg.buttonShortPress, g_cfg.buttonHoldRepeat);
 		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
 	}
@@ -1850,10 +1973,10 @@ static commandResult_t CMD_SetButtonTimes(const void* context, const char* cmd,
 
     CFG_Save_IfThereArePendingChanges();
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "Times set, %i %i %i. Config autosaved to flash.",
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "Times set, %i %i %i. Config autosaved to flash.",
 		g_cfg.buttonLongPress, g_cfg.buttonShortPress, g_cfg.buttonHoldRepeat
 	);
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "If something is wrong, you can restore defaults - %i %i %i",
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "If something is wrong, you can restore defaults - %i %i %i",
 		CFG_DEFAULT_BTN_LONG, CFG_DEFAULT_BTN_SHORT, CFG_DEFAULT_BTN_REPEAT);
 	return 0;
 }
@@ -1862,7 +1985,7 @@ static commandResult_t CMD_ShowChannelValues(const void* context, const char* cm
 
 	for (i = 0; i < CHANNEL_MAX; i++) {
 		if (g_channelValues[i] > 0) {
-			addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "Channel %i value is %i", i, g_channelValues[i]);
+			ADDLOG_INFO(LOG_FEATURE_GENERAL, "Channel %i value is %i", i, g_channelValues[i]);
 		}
 	}
 
@@ -1876,7 +1999,7 @@ static commandResult_t CMD_SetChannelType(const void* context, const char* cmd,
 	Tokenizer_TokenizeString(args, 0);
 
 	if (Tokenizer_GetArgsCount() < 2) {
-		addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "This command requires 2 arguments");
+		ADDLOG_INFO(LOG_FEATURE_GENERAL, "This command requires 2 arguments");
 		return CMD_RES_NOT_ENOUGH_ARGUMENTS;
 	}
 	channel = Tokenizer_GetArgInteger(0);
@@ -1885,13 +2008,13 @@ static commandResult_t CMD_SetChannelType(const void* context, const char* cmd,
 	typeCode = CHANNEL_ParseChannelType(type);
 	if (typeCode == ChType_Error) {
 
-		addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "Channel %i type not set because %s is not a known type", channel, type);
+		ADDLOG_INFO(LOG_FEATURE_GENERAL, "Channel %i type not set because %s is not a known type", channel, type);
 		return CMD_RES_BAD_ARGUMENT;
 	}
 
 	CHANNEL_SetType(channel, typeCode);
 
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "Channel %i type changed to %s", channel, type);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "Channel %i type changed to %s", channel, type);
 	return CMD_RES_OK;
 }
 
@@ -2026,7 +2149,36 @@ static commandResult_t showgpi(const void* context, const char* cmd, const char*
 		else
 			value[0] |= ((val & 1) << i);
 	}
-	addLogAdv(LOG_INFO, LOG_FEATURE_GENERAL, "GPIs are 0x%08lX%08lX", value[1], value[0]);
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "GPIs are 0x%08lX%08lX", value[1], value[0]);
+	return CMD_RES_OK;
+}
+
+static commandResult_t CMD_PinStats(const void* context, const char* cmd, const char* args, int cmdFlags) {
+	int i;
+
+	if (args && !stricmp(args, "reset")) {
+		memset(&g_pinTickStats, 0, sizeof(g_pinTickStats));
+	}
+	if (g_tickPinsDirty) {
+		PIN_RebuildTickPins();
+	}
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "PIN_ticks: %i calls, %i pins polled, max %u us",
+		g_pinTickStats.ticks, g_tickPinsCount, g_pinTickStats.maxUs);
+	if (HAL_GetTimeUsResolution() > 1) {
+		// a poll shorter than one clock step is counted as 0 us
+		ADDLOG_INFO(LOG_FEATURE_GENERAL, "clock resolution is %u us, shorter polls read as 0",
+			HAL_GetTimeUsResolution());
+	}
+	for (i = 0; i < PIN_TICK_TIME_BUCKETS; i++) {
+		if (i < PIN_TICK_TIME_BUCKETS - 1) {
+			ADDLOG_INFO(LOG_FEATURE_GENERAL, "below %i us: %i", g_pinTickTimeLimits[i], g_pinTickStats.timeBuckets[i]);
+		}
+		else {
+			ADDLOG_INFO(LOG_FEATURE_GENERAL, "more: %i", g_pinTickStats.timeBuckets[i]);
+		}
+	}
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "PWM writes %i, skipped as unchanged %i",
+		g_pinTickStats.pwmWrites, g_pinTickStats.pwmWritesSkipped);
 	return CMD_RES_OK;
 }
 
@@ -2057,6 +2209,11 @@ void PIN_AddCommands(void)
     //cmddetail:"fn":"CMD_setButtonHoldRepeat","file":"new_pins.c","requires":"",
     //cmddetail:"examples":""}
     CMD_RegisterCommand("setButtonHoldRepeat", CMD_setButtonHoldRepeat, NULL);
+    //cmddetail:{"name":"PinStats","args":"[reset-Optional]",
+    //cmddetail:"descr":"Logs a histogram of how long the pin poll (PIN_ticks) takes, how many pins it polls, and how many PWM writes were done or skipped because the duty did not change. When the clock only counts RTOS ticks, its resolution is logged too. Use 'reset' to clear the counters.",
+    //cmddetail:"fn":"CMD_PinStats","file":"new_pins.c","requires":"",
+    //cmddetail:"examples":""}
+    CMD_RegisterCommand("PinStats", CMD_PinStats, NULL);
 
 }
 
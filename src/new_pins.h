@@ -1126,7 +1126,19 @@ extern byte g_defaultDoorWakeEdge;
 #define CHANNEL_SET_FLAG_SKIP_MQTT	2
 #define CHANNEL_SET_FLAG_SILENT		4
 
+// PIN_ticks duration histogram, see PinStats command
+#define PIN_TICK_TIME_BUCKETS 8
+typedef struct pinTickStats_s {
+	int ticks;
+	unsigned int maxUs;
+	int timeBuckets[PIN_TICK_TIME_BUCKETS];
+	// PWM duty writes, and the ones skipped because the duty didn't change
+	int pwmWrites;
+	int pwmWritesSkipped;
+} pinTickStats_t;
+
 void PIN_ticks(void* param);
+const pinTickStats_t* PIN_GetTickStats();
 
 void PIN_set_wifi_led(int value);
 void PIN_AddCommands(void);
@@ -1144,6 +1156,10 @@ const char* PIN_GetPinNameAlias(int index);
 void PIN_SetPinRoleForPinIndex(int index, int role);
 void PIN_SetPinChannelForPinIndex(int index, int ch);
 void PIN_SetPinChannel2ForPinIndex(int index, int ch);
+// must be called after anything writes to g_cfg.pins roles or channels
+void PIN_MarkPinIndexesDirty();
+// writes the value of its channel to a PWM pin
+void PIN_PWM_ApplyChannel(int index);
 void CHANNEL_Toggle(int ch);
 void CHANNEL_DoSpecialToggleAll();
 bool CHANNEL_Check(int ch);
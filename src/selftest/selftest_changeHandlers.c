@@ -1,6 +1,6 @@
 #ifdef WINDOWS
 
-#include "selftest_local.h".
+#include "selftest_local.h"
 
 void Test_ChangeHandlers() {
 	// reset whole device
@@ -103,6 +103,68 @@ void Test_ChangeHandlers() {
 	SIM_ClearMQTTHistory();
 
 }
+// many handlers on many channels - only the ones matching event code and argument may fire
+void Test_ChangeHandlers_ManyHandlers() {
+	char buffer[64];
+	int i;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+
+	for (i = 10; i < 60; i++) {
+		sprintf(buffer, "addEventHandler OnChannelChange %i addChannel 1 1", i);
+		CMD_ExecuteCommand(buffer, 0);
+		sprintf(buffer, "addChangeHandler Channel%i == 5 addChannel 2 1", i);
+		CMD_ExecuteCommand(buffer, 0);
+		sprintf(buffer, "addEventHandler OnClick %i addChannel 3 1", i);
+		CMD_ExecuteCommand(buffer, 0);
+	}
+	// second handler for the same event and argument
+	CMD_ExecuteCommand("addEventHandler OnChannelChange 15 addChannel 6 1", 0);
+	CMD_ExecuteCommand("addEventHandler OnUART 55AA0001 addChannel 4 1", 0);
+	SELFTEST_ASSERT(EventHandlers_GetActiveCount() == 152);
+
+	CMD_ExecuteCommand("setChannel 15 5", 0);
+	SELFTEST_ASSERT_CHANNEL(1, 1);
+	SELFTEST_ASSERT_CHANNEL(2, 1);
+	SELFTEST_ASSERT_CHANNEL(6, 1);
+	CMD_ExecuteCommand("setChannel 15 6", 0);
+	SELFTEST_ASSERT_CHANNEL(1, 2);
+	SELFTEST_ASSERT_CHANNEL(2, 1);
+	SELFTEST_ASSERT_CHANNEL(6, 2);
+	CMD_ExecuteCommand("setChannel 40 5", 0);
+	SELFTEST_ASSERT_CHANNEL(1, 3);
+	SELFTEST_ASSERT_CHANNEL(2, 2);
+	SELFTEST_ASSERT_CHANNEL(6, 2);
+	// no handlers for channel 8
+	CMD_ExecuteCommand("setChannel 8 5", 0);
+	SELFTEST_ASSERT_CHANNEL(1, 3);
+	SELFTEST_ASSERT_CHANNEL(2, 2);
+
+	EventHandlers_FireEvent(CMD_EVENT_PIN_ONCLICK, 7);
+	SELFTEST_ASSERT_CHANNEL(3, 0);
+	EventHandlers_FireEvent(CMD_EVENT_PIN_ONCLICK, 17);
+	SELFTEST_ASSERT_CHANNEL(3, 1);
+	// the same argument, but other event
+	EventHandlers_FireEvent(CMD_EVENT_PIN_ONHOLD, 17);
+	SELFTEST_ASSERT_CHANNEL(3, 1);
+
+	// string arguments are case insensitive
+	EventHandlers_FireEvent_String(CMD_EVENT_ON_UART, "55aa0001");
+	SELFTEST_ASSERT_CHANNEL(4, 1);
+	EventHandlers_FireEvent_String(CMD_EVENT_ON_UART, "55AA0002");
+	SELFTEST_ASSERT_CHANNEL(4, 1);
+
+	CMD_ExecuteCommand("clearAllHandlers", 0);
+	SELFTEST_ASSERT(EventHandlers_GetActiveCount() == 0);
+	CMD_ExecuteCommand("setChannel 15 5", 0);
+	EventHandlers_FireEvent(CMD_EVENT_PIN_ONCLICK, 17);
+	EventHandlers_FireEvent_String(CMD_EVENT_ON_UART, "55AA0001");
+	SELFTEST_ASSERT_CHANNEL(1, 3);
+	SELFTEST_ASSERT_CHANNEL(2, 2);
+	SELFTEST_ASSERT_CHANNEL(3, 1);
+	SELFTEST_ASSERT_CHANNEL(4, 1);
+}
 
 
 #endif
@@ -2,6 +2,7 @@
 
 #include "selftest_local.h"
 #include "../driver/drv_ntp.h"
+#include "../driver/drv_ntp_events.h"
 
 void Test_ClockEvents() {
 	// reset whole device
@@ -120,6 +121,97 @@ void Test_ClockEvents() {
 		SELFTEST_ASSERT_CHANNEL(3, 30);
 	}
 }
+// clock jumps of days, with all catch up policies
+void Test_ClockEvents_CatchUp() {
+	char buffer[64];
+	unsigned int simTime;
+	int i;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+
+	CMD_ExecuteCommand("startDriver NTP", 0);
+	NTP_ClearEvents();
+	NTP_RunEvents(0, false);
+
+	// Thursday 15:54:30 local time
+	simTime = 1681998870;
+
+	// one event per minute for an hour, second by second
+	for (i = 0; i < 60; i++) {
+		sprintf(buffer, "addClockEvent 16:%i:30 0xff %i addChannel 1 1", i, 100 + i);
+		CMD_ExecuteCommand(buffer, 0);
+	}
+	for (i = 0; i < 4200; i++) {
+		NTP_RunEvents(simTime + i, true);
+	}
+	SELFTEST_ASSERT_CHANNEL(1, 60);
+	SELFTEST_ASSERT(NTP_ClearEvents() == 60);
+
+	// default policy runs everything missed in the last day
+	NTP_RunEvents(0, false);
+	NTP_RunEvents(simTime, true);
+	CMD_ExecuteCommand("addClockEvent 15:55 0xff 1 addChannel 2 1", 0);
+	// Sunday 15:55:30
+	NTP_RunEvents(simTime + 3 * 86400 + 60, true);
+	SELFTEST_ASSERT_CHANNEL(2, 1);
+	// with a window of four days, all of the missed days
+	CMD_ExecuteCommand("clockEventsCatchUp all 100 345600", 0);
+	NTP_RunEvents(0, false);
+	NTP_RunEvents(simTime, true);
+	NTP_RunEvents(simTime + 3 * 86400 + 60, true);
+	SELFTEST_ASSERT_CHANNEL(2, 5);
+	SELFTEST_ASSERT(NTP_ClearEvents() == 1);
+
+	// a jump of a year runs each of the hourly events once, not 365 times
+	CMD_ExecuteCommand("clockEventsCatchUp all 100 86400", 0);
+	CMD_ExecuteCommand("setChannel 1 0", 0);
+	NTP_RunEvents(0, false);
+	NTP_RunEvents(simTime, true);
+	for (i = 0; i < 24; i++) {
+		sprintf(buffer, "addClockEvent %i:00 0xff %i addChannel 1 1", i, 200 + i);
+		CMD_ExecuteCommand(buffer, 0);
+	}
+	NTP_RunEvents(simTime + 365 * 86400, true);
+	SELFTEST_ASSERT_CHANNEL(1, 24);
+	// and the schedule goes on from there
+	NTP_RunEvents(simTime + 365 * 86400 + 3600, true);
+	SELFTEST_ASSERT_CHANNEL(1, 25);
+	SELFTEST_ASSERT(NTP_ClearEvents() == 24);
+
+	// only the latest of each missed events, in order
+	CMD_ExecuteCommand("clockEventsCatchUp latest", 0);
+	NTP_RunEvents(0, false);
+	NTP_RunEvents(simTime, true);
+	CMD_ExecuteCommand("addClockEvent 07:00 0xff 1 backlog setChannel 3 1; addChannel 4 1", 0);
+	CMD_ExecuteCommand("addClockEvent 22:00 0xff 2 backlog setChannel 3 0; addChannel 4 1", 0);
+	// Saturday 23:00, light was on in the morning and turned off at 22:00
+	simTime += 2 * 86400 + 25530;
+	NTP_RunEvents(simTime, true);
+	SELFTEST_ASSERT_CHANNEL(3, 0);
+	SELFTEST_ASSERT_CHANNEL(4, 2);
+	// Monday 08:00, Sunday 22:00 off, then Monday 07:00 on
+	simTime += 118800;
+	NTP_RunEvents(simTime, true);
+	SELFTEST_ASSERT_CHANNEL(3, 1);
+	SELFTEST_ASSERT_CHANNEL(4, 4);
+
+	// missed events are dropped, but the schedule goes on
+	CMD_ExecuteCommand("clockEventsCatchUp skip", 0);
+	// Wednesday 21:59
+	simTime += 2 * 86400 + 50340;
+	NTP_RunEvents(simTime, true);
+	SELFTEST_ASSERT_CHANNEL(3, 1);
+	SELFTEST_ASSERT_CHANNEL(4, 4);
+	for (i = 0; i < 120; i += 30) {
+		NTP_RunEvents(simTime + i, true);
+	}
+	SELFTEST_ASSERT_CHANNEL(3, 0);
+	SELFTEST_ASSERT_CHANNEL(4, 5);
+
+	CMD_ExecuteCommand("clockEventsCatchUp all 100 86400", 0);
+	SELFTEST_ASSERT(NTP_ClearEvents() == 2);
+}
 
 
 
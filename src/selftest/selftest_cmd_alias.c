@@ -1,8 +1,10 @@
 #ifdef WINDOWS
 
-#include "selftest_local.h".
+#include "selftest_local.h"
 
 void Test_Commands_Alias() {
+	int i;
+
 	// reset whole device
 	SIM_ClearOBK(0);
 
@@ -48,6 +50,20 @@ void Test_Commands_Alias() {
 	SELFTEST_ASSERT_CHANNEL(4, (11+9));
 	SELFTEST_ASSERT_CHANNEL(5, 50);
 
+	// alias to an alias that does not exist yet - compiled command
+	// must be resolved again once the target gets registered
+	CMD_ExecuteCommand("alias test5 test6", 0);
+	CMD_ExecuteCommand("test5", 0);
+	CMD_ExecuteCommand("alias test6 addChannel 6 7", 0);
+	CMD_ExecuteCommand("test5", 0);
+	SELFTEST_ASSERT_CHANNEL(6, 7);
+	// same, but with pre-split arguments reused many times
+	CMD_ExecuteCommand("alias test7 addChannel 7 1 0 1000", 0);
+	for (i = 0; i < 100; i++) {
+		CMD_ExecuteCommand("test7", 0);
+	}
+	SELFTEST_ASSERT_CHANNEL(7, 100);
+
 	// this check will fail obviously!
 	//SELFTEST_ASSERT_CHANNEL(5, 666);
 }
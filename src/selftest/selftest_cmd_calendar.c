@@ -1,6 +1,7 @@
 #ifdef WINDOWS
 
-#include "selftest_local.h".
+#include "selftest_local.h"
+#include "../driver/drv_ntp.h"
 
 void Test_Commands_Calendar() {
 	// reset whole device
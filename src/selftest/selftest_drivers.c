@@ -0,0 +1,108 @@
+#ifdef WINDOWS
+
+#include "selftest_local.h"
+#include "../driver/drv_public.h"
+
+void Test_Drivers_Registry() {
+	int id;
+	int cachedID = DRV_ID_NOT_FOUND_YET;
+	int unknownID = DRV_ID_NOT_FOUND_YET;
+
+	SIM_ClearOBK(0);
+	SIM_ClearAndPrepareForMQTTTesting("miscDevice", "bekens");
+
+	id = DRV_FindDriver("testpower");
+	SELFTEST_ASSERT(id >= 0);
+	SELFTEST_ASSERT(DRV_FindDriver("NoSuchDriver") == -1);
+	SELFTEST_ASSERT(DRV_IsRunningID(-1) == false);
+	SELFTEST_ASSERT(DRV_IsRunningID(id) == false);
+	SELFTEST_ASSERT(DRV_IsRunningCached(&cachedID, "TESTPOWER") == false);
+	SELFTEST_ASSERT(cachedID == id);
+	SELFTEST_ASSERT(DRV_IsRunningCached(&unknownID, "NoSuchDriver") == false);
+	SELFTEST_ASSERT(unknownID == -1);
+	SELFTEST_ASSERT(DRV_IsMeasuringPower() == false);
+	SELFTEST_ASSERT(DRV_GetHookDriversCount(DRV_HOOK_EVERYSECOND) == 0);
+
+	CMD_ExecuteCommand("startDriver TESTPOWER", 0);
+	SELFTEST_ASSERT(DRV_IsRunningID(id));
+	SELFTEST_ASSERT(DRV_IsRunning("TESTPOWER"));
+	SELFTEST_ASSERT(DRV_IsRunningCached(&cachedID, "TESTPOWER"));
+	SELFTEST_ASSERT(DRV_IsMeasuringPower());
+	SELFTEST_ASSERT(DRV_IsSensor() == false);
+	SELFTEST_ASSERT(DRV_HasRunningDriverWithFlag(DRV_FLAG_LED_CHIP) == false);
+	SELFTEST_ASSERT(DRV_GetHookDriversCount(DRV_HOOK_EVERYSECOND) == 1);
+	SELFTEST_ASSERT(DRV_GetHookDriversCount(DRV_HOOK_HTTPINDEX) == 1);
+	SELFTEST_ASSERT(DRV_GetHookDriversCount(DRV_HOOK_CHANNELCHANGED) == 0);
+
+	// TESTLED only adds itself to channel changed list and LED flag
+	CMD_ExecuteCommand("startDriver TESTLED", 0);
+	SELFTEST_ASSERT(LED_IsLedDriverChipRunning());
+	SELFTEST_ASSERT(DRV_GetHookDriversCount(DRV_HOOK_EVERYSECOND) == 2);
+	SELFTEST_ASSERT(DRV_GetHookDriversCount(DRV_HOOK_CHANNELCHANGED) == 1);
+
+	CMD_ExecuteCommand("stopDriver TESTPOWER", 0);
+	SELFTEST_ASSERT(DRV_IsRunningID(id) == false);
+	SELFTEST_ASSERT(DRV_IsRunningCached(&cachedID, "TESTPOWER") == false);
+	SELFTEST_ASSERT(DRV_IsMeasuringPower() == false);
+	SELFTEST_ASSERT(DRV_GetHookDriversCount(DRV_HOOK_EVERYSECOND) == 1);
+	SELFTEST_ASSERT(DRV_GetHookDriversCount(DRV_HOOK_HTTPINDEX) == 0);
+
+	// only one driver can own the UART
+	CMD_ExecuteCommand("startDriver TuyaMCU", 0);
+	SELFTEST_ASSERT(DRV_HasRunningDriverWithFlag(DRV_FLAG_NEEDS_UART));
+	CMD_ExecuteCommand("startDriver BL0942", 0);
+	SELFTEST_ASSERT(DRV_IsRunning("BL0942") == false);
+	CMD_ExecuteCommand("stopDriver TuyaMCU", 0);
+	SELFTEST_ASSERT(DRV_HasRunningDriverWithFlag(DRV_FLAG_NEEDS_UART) == false);
+	CMD_ExecuteCommand("startDriver BL0942", 0);
+	SELFTEST_ASSERT(DRV_IsRunning("BL0942"));
+
+	CMD_ExecuteCommand("stopDriver *", 0);
+	SELFTEST_ASSERT(LED_IsLedDriverChipRunning() == false);
+	SELFTEST_ASSERT(DRV_HasRunningDriverWithFlag(DRV_FLAG_NEEDS_UART) == false);
+	SELFTEST_ASSERT(DRV_GetHookDriversCount(DRV_HOOK_EVERYSECOND) == 0);
+	SELFTEST_ASSERT(DRV_GetHookDriversCount(DRV_HOOK_CHANNELCHANGED) == 0);
+}
+void Test_Drivers_HookStats() {
+	int powerID, ledID;
+
+	SIM_ClearOBK(0);
+	SIM_ClearAndPrepareForMQTTTesting("miscDevice", "bekens");
+
+	powerID = DRV_FindDriver("TESTPOWER");
+	ledID = DRV_FindDriver("TESTLED");
+	CMD_ExecuteCommand("startDriver TESTPOWER", 0);
+	CMD_ExecuteCommand("startDriver TESTLED", 0);
+	SELFTEST_ASSERT(CMD_ExecuteCommand("DriverStats reset", 0) == CMD_RES_OK);
+	SELFTEST_ASSERT(DRV_GetHookCalls(powerID, DRV_HOOK_EVERYSECOND) == 0);
+
+	Sim_RunSeconds(3, false);
+	SELFTEST_ASSERT(DRV_GetHookCalls(powerID, DRV_HOOK_EVERYSECOND) == 3);
+	SELFTEST_ASSERT(DRV_GetHookCalls(ledID, DRV_HOOK_EVERYSECOND) == 3);
+	// neither of them has a quick tick
+	SELFTEST_ASSERT(DRV_GetHookCalls(powerID, DRV_HOOK_QUICKTICK) == 0);
+
+	// only TESTLED is told about channel changes
+	CHANNEL_Set(1, 50, 0);
+	SELFTEST_ASSERT(DRV_GetHookCalls(ledID, DRV_HOOK_CHANNELCHANGED) == 1);
+	SELFTEST_ASSERT(DRV_GetHookCalls(powerID, DRV_HOOK_CHANNELCHANGED) == 0);
+
+	Test_FakeHTTPClientPacket_GET("index");
+	SELFTEST_ASSERT(DRV_GetHookCalls(powerID, DRV_HOOK_HTTPINDEX) == 1);
+	SELFTEST_ASSERT(DRV_GetHookCalls(ledID, DRV_HOOK_HTTPINDEX) == 0);
+
+	SELFTEST_ASSERT(CMD_ExecuteCommand("DriverStats", 0) == CMD_RES_OK);
+	SELFTEST_ASSERT(CMD_ExecuteCommand("DriverStats reset", 0) == CMD_RES_OK);
+	SELFTEST_ASSERT(DRV_GetHookCalls(powerID, DRV_HOOK_EVERYSECOND) == 0);
+	SELFTEST_ASSERT(DRV_GetHookCalls(ledID, DRV_HOOK_CHANNELCHANGED) == 0);
+
+	CMD_ExecuteCommand("stopDriver *", 0);
+	SELFTEST_ASSERT(DRV_GetHookCalls(-1, DRV_HOOK_EVERYSECOND) == 0);
+	SELFTEST_ASSERT(DRV_GetHookCalls(powerID, DRV_HOOK_COUNT) == 0);
+}
+void Test_Drivers() {
+	Test_Drivers_Registry();
+	Test_Drivers_HookStats();
+}
+
+#endif
@@ -1,6 +1,9 @@
 #ifdef WINDOWS
 
 #include "selftest_local.h"
+#include "../hal/hal_flashVars.h"
+#include "../driver/drv_public.h"
+#include "../driver/drv_uart.h"
 
 void Test_EnergyMeter_Basic() {
 	SIM_ClearOBK(0);
@@ -75,9 +78,170 @@ void Test_EnergyMeter_Tasmota() {
 
 	SIM_ClearMQTTHistory();
 }
+static void Test_EnergyMeter_SaveTotal(float total, long saveCounter) {
+	ENERGY_METERING_DATA data;
+
+	HAL_GetEnergyMeterStatus(&data);
+	data.TotalConsumption = total;
+	data.TodayConsumpion = total / 2;
+	data.save_counter = saveCounter;
+	HAL_SetEnergyMeterStatus(&data);
+}
+static float Test_EnergyMeter_LoadTotal() {
+	ENERGY_METERING_DATA data;
+
+	SIM_FlashVars_Reload();
+	HAL_GetEnergyMeterStatus(&data);
+	SELFTEST_ASSERT(data.TodayConsumpion == data.TotalConsumption / 2);
+	return data.TotalConsumption;
+}
+void Test_EnergyMeter_Journal() {
+	ENERGY_METERING_DATA data;
+	int i, cut;
+	int offset;
+	long counter;
+	float total;
+
+	SIM_ClearOBK(0);
+
+	HAL_GetEnergyMeterStatus(&data);
+	SELFTEST_ASSERT(data.TotalConsumption == 0);
+	SELFTEST_ASSERT(data.actual_mday == -1);
+
+	// counter commits take a small delta record
+	counter = 0;
+	Test_EnergyMeter_SaveTotal(10, ++counter);
+	offset = SIM_FlashVars_GetJournalOffset();
+	Test_EnergyMeter_SaveTotal(20, ++counter);
+	SELFTEST_ASSERT(SIM_FlashVars_GetJournalOffset() - offset == 12);
+	SELFTEST_ASSERT(Test_EnergyMeter_LoadTotal() == 20);
+
+	// other changes are stored as a whole
+	HAL_GetEnergyMeterStatus(&data);
+	data.actual_mday = 5;
+	data.YesterdayConsumption = 3;
+	data.save_counter = ++counter;
+	HAL_SetEnergyMeterStatus(&data);
+	SIM_FlashVars_Reload();
+	HAL_GetEnergyMeterStatus(&data);
+	SELFTEST_ASSERT(data.actual_mday == 5);
+	SELFTEST_ASSERT(data.YesterdayConsumption == 3);
+	SELFTEST_ASSERT(data.save_counter == counter);
+
+	// many commits, sectors are erased once per sector filled
+	for (i = 0; i < 1000; i++) {
+		Test_EnergyMeter_SaveTotal(100 + i, ++counter);
+	}
+	SELFTEST_ASSERT(Test_EnergyMeter_LoadTotal() == 1099);
+	SELFTEST_ASSERT(SIM_FlashVars_GetEraseCount() < 1 + 1000 * 12 / 0x1000 + 2);
+	HAL_GetEnergyMeterStatus(&data);
+	SELFTEST_ASSERT(data.actual_mday == 5);
+	SELFTEST_ASSERT(data.save_counter == counter);
+
+	// power lost at any point of a commit gives either the old or the new value
+	total = 2000;
+	for (cut = 0; cut < 16; cut++) {
+		Test_EnergyMeter_SaveTotal(total, ++counter);
+		SIM_FlashVars_SetPowerLossAfter(cut);
+		Test_EnergyMeter_SaveTotal(total + 1, ++counter);
+		data.TotalConsumption = Test_EnergyMeter_LoadTotal();
+		SELFTEST_ASSERT(data.TotalConsumption == total || data.TotalConsumption == total + 1);
+		HAL_GetEnergyMeterStatus(&data);
+		counter = data.save_counter;
+		total += 2;
+	}
+	// the same while moving to the other sector, which takes the erase,
+	// the snapshot and the sector header
+	for (cut = 0; cut < 0x1000 + 128; cut += (cut < 0x1000 - 64) ? 512 : 3) {
+		Test_EnergyMeter_SaveTotal(total, ++counter);
+		while (SIM_FlashVars_GetJournalOffset() + 12 <= 0x1000) {
+			Test_EnergyMeter_SaveTotal(total, ++counter);
+		}
+		SIM_FlashVars_SetPowerLossAfter(cut);
+		Test_EnergyMeter_SaveTotal(total + 1, ++counter);
+		data.TotalConsumption = Test_EnergyMeter_LoadTotal();
+		SELFTEST_ASSERT(data.TotalConsumption == total || data.TotalConsumption == total + 1);
+		HAL_GetEnergyMeterStatus(&data);
+		counter = data.save_counter;
+		total += 2;
+	}
+	// and the journal still works after all of that
+	Test_EnergyMeter_SaveTotal(total, ++counter);
+	SELFTEST_ASSERT(Test_EnergyMeter_LoadTotal() == total);
+
+	// interval of the automatic commits can be set
+	CMD_ExecuteCommand("startDriver TESTPOWER", 0);
+	SELFTEST_ASSERT(CMD_ExecuteCommand("ConsumptionThreshold 5 600", 0) == CMD_RES_OK);
+}
+// the single log of older versions is converted without losing the
+// counters, wherever the power is lost
+void Test_EnergyMeter_JournalConversion() {
+	ENERGY_METERING_DATA data;
+	int counts[3];
+	int i, cut;
+
+	SIM_ClearOBK(0);
+
+	// newest structure in sector 0, straddling both sectors, in sector 1
+	counts[0] = 3;
+	counts[1] = (0x1000 - 4) / SIM_FlashVars_GetLegacySize() + 1;
+	counts[2] = counts[1] + 5;
+
+	for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		// the copy of a straddling structure, the erase, the snapshot and the header
+		for (cut = 0; cut < 64 + 0x1000 + 128; cut += (cut >= 64 && cut < 0x1000) ? 128 : 1) {
+			SIM_FlashVars_WriteLegacy(counts[i]);
+			SIM_FlashVars_SetPowerLossAfter(cut);
+			HAL_GetEnergyMeterStatus(&data);
+			SIM_FlashVars_Reload();
+			HAL_GetEnergyMeterStatus(&data);
+			SELFTEST_ASSERT(data.TotalConsumption == counts[i]);
+			SELFTEST_ASSERT(data.save_counter == counts[i]);
+			// once converted, the journal is used
+			SIM_FlashVars_Reload();
+			HAL_GetEnergyMeterStatus(&data);
+			SELFTEST_ASSERT(data.TotalConsumption == counts[i]);
+			SELFTEST_ASSERT(SIM_FlashVars_GetJournalOffset() > 0);
+		}
+		Test_EnergyMeter_SaveTotal(counts[i] + 1, counts[i] + 1);
+		SELFTEST_ASSERT(Test_EnergyMeter_LoadTotal() == counts[i] + 1);
+	}
+	SIM_FlashVars_Clear();
+}
+void Test_EnergyMeter_CSE7766() {
+	SIM_ClearOBK(0);
+	SIM_ClearAndPrepareForMQTTTesting("miscDevice", "bekens");
+
+	CMD_ExecuteCommand("startDriver CSE7766", 0);
+	// two garbage bytes, then a 70W 240V frame and one with a bad checksum
+	CMD_ExecuteCommand("uartFakeHex 0102555A02FCD800062F00413200D7F2537B18023E9F7171FEEC", 0);
+	CMD_ExecuteCommand("uartFakeHex 555A02FCD800062F00413200D7F2537B18023E9F7171FEED", 0);
+	Sim_RunSeconds(3, false);
+	SELFTEST_ASSERT(UART_GetDataSize() == 0);
+	// only the first frame was taken
+	SELFTEST_ASSERT(fabs(DRV_GetReading(OBK_VOLTAGE) - 238.66f) < 0.1f);
+	SELFTEST_ASSERT(fabs(DRV_GetReading(OBK_POWER) - 69.64f) < 0.1f);
+	CMD_ExecuteCommand("stopDriver *", 0);
+}
+void Test_EnergyMeter_BL0942() {
+	SIM_ClearOBK(0);
+	SIM_ClearAndPrepareForMQTTTesting("miscDevice", "bekens");
+
+	CMD_ExecuteCommand("startDriver BL0942", 0);
+	// one garbage byte, then a 50Hz frame
+	CMD_ExecuteCommand("uartFakeHex 0355001000000020000000004000000000204E0000000074", 0);
+	Sim_RunSeconds(3, false);
+	SELFTEST_ASSERT(fabs(DRV_GetReading(OBK_VOLTAGE) - 138.08f) < 0.1f);
+	SELFTEST_ASSERT(fabs(DRV_GetReading(OBK_POWER) - 27.40f) < 0.1f);
+	CMD_ExecuteCommand("stopDriver *", 0);
+}
 void Test_EnergyMeter() {
 	Test_EnergyMeter_Basic();
 	Test_EnergyMeter_Tasmota();
+	Test_EnergyMeter_Journal();
+	Test_EnergyMeter_JournalConversion();
+	Test_EnergyMeter_CSE7766();
+	Test_EnergyMeter_BL0942();
 }
 
 #endif
@@ -1,6 +1,6 @@
 #ifdef WINDOWS
 
-#include "selftest_local.h".
+#include "selftest_local.h"
 
 void Test_Expressions_RunTests_Basic() {
 	// reset whole device
@@ -238,4 +238,72 @@ void Test_Expressions_RunTests_Basic() {
 	//SELFTEST_ASSERT_EXPRESSION("1.50/$CH18+1000\n\r", 0.1f + 1000);
 }
 
+static const char *g_benchmarkExpressions[] = {
+	"$CH1",
+	"$CH1+10",
+	"$CH12*10.0",
+	"1000*$CH1+100*$CH1-10*$CH1+$CH1*1",
+	"$CH1>=5 && $CH2<3",
+	"!$CH2",
+	"$led_dimmer>100",
+	"$CH10 != $CH12 || MQTTOn",
+	"15.0/$CH18\n\r",
+	"-1.0 - 1.0",
+	"++fsfs+",
+};
+// compares compiled expressions against the original recursive evaluator
+// and prints how long a single evaluation takes with both of them
+void Test_Expressions_Benchmark() {
+	int i, j, k;
+	int numExpressions;
+	int loops = 2000;
+	double nsInterpreted, nsCompiled;
+	float a, b;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+
+	CHANNEL_Set(1, 2, 0);
+	CHANNEL_Set(2, 1, 0);
+	CHANNEL_Set(10, 7, 0);
+	CHANNEL_Set(12, 10, 0);
+	CHANNEL_Set(18, 15, 0);
+
+	numExpressions = sizeof(g_benchmarkExpressions) / sizeof(g_benchmarkExpressions[0]);
+	for (i = 0; i < numExpressions; i++) {
+		// first run compiles, second one comes from cache
+		for (j = 0; j < 2; j++) {
+			a = CMD_EvaluateExpression_Interpreted(g_benchmarkExpressions[i], 0);
+			b = CMD_EvaluateExpression(g_benchmarkExpressions[i], 0);
+			SELFTEST_ASSERT(Float_Equals(a, b));
+		}
+	}
+	// change inputs, cached code must see new values
+	CHANNEL_Set(1, 6, 0);
+	CHANNEL_Set(2, 0, 0);
+	for (i = 0; i < numExpressions; i++) {
+		a = CMD_EvaluateExpression_Interpreted(g_benchmarkExpressions[i], 0);
+		b = CMD_EvaluateExpression(g_benchmarkExpressions[i], 0);
+		SELFTEST_ASSERT(Float_Equals(a, b));
+	}
+
+	SelfTest_Benchmark_Begin();
+	for (k = 0; k < loops; k++) {
+		for (i = 0; i < numExpressions; i++) {
+			CMD_EvaluateExpression_Interpreted(g_benchmarkExpressions[i], 0);
+		}
+	}
+	nsInterpreted = 1e9 / SelfTest_Benchmark_PerSecond(loops * numExpressions);
+
+	for (k = 0; k < loops; k++) {
+		for (i = 0; i < numExpressions; i++) {
+			CMD_EvaluateExpression(g_benchmarkExpressions[i], 0);
+		}
+	}
+	nsCompiled = 1e9 / SelfTest_Benchmark_PerSecond(loops * numExpressions);
+
+	SelfTest_Benchmark_End("Test_Expressions_Benchmark: interpreted %.1f ns, compiled %.1f ns per evaluation\n",
+		nsInterpreted, nsCompiled);
+}
+
 #endif
@@ -2,9 +2,12 @@
 
 #include "selftest_local.h"
 #include "../httpserver/new_http.h"
+#include "../httpserver/http_tcp_server.h"
+#include "../mqtt/new_mqtt.h"
 //#define JSMN_HEADER
 ///#include "../jsmn/jsmn.h"
 #include "../cJSON/cJSON.h"
+#include <time.h>
 
 // "GET /index?tgl=1 HTTP/1.1\r\n"
 const char *http_get_template1 = "GET /%s HTTP/1.1\r\n"
@@ -59,15 +62,38 @@ const char *Helper_GetPastHTTPHeader(const char *s) {
 static char outbuf[8192];
 static char buffer[8192];
 static const char *replyAt;
+static int g_replyLen;
 //static jsmntok_t tokens[256]; /* We expect no more than qq JSON tokens */
 
-void Test_FakeHTTPClientPacket_Generic() {
+static char g_sentData[16384];
+static int g_sentLen;
+static int Test_Http_SimulatorSend(const char *data, int len) {
+	// take at most 100 bytes at once, like a socket with a full send buffer
+	if (len > 100) {
+		len = 100;
+	}
+	SELFTEST_ASSERT(g_sentLen + len < sizeof(g_sentData));
+	memcpy(g_sentData + g_sentLen, data, len);
+	g_sentLen += len;
+	g_sentData[g_sentLen] = 0;
+	return len;
+}
+// Sends "GET /url protocol" with extra headers, or, if url is NULL, the
+// request already in buffer. With keepAlive the server may keep the
+// connection and the reply is finished like the TCP server does, then the
+// result of HTTP_FinishReply is returned. A replyMax below the size of
+// outbuf makes the reply go out in parts, collected in g_sentData.
+static int Test_FakeHTTPClientPacket_Generic(const char *url, const char *protocol, const char *headers,
+	int keepAlive, int replyMax) {
 	int iResult;
 	int len;
+	int bKeep = 0;
 
 	http_request_t request;
 
-
+	if (url) {
+		sprintf(buffer, "GET /%s %s\r\nHost: 127.0.0.1\r\n%s\r\n", url, protocol, headers);
+	}
 	iResult = strlen(buffer);
 
 	memset(&request, 0, sizeof(request));
@@ -80,15 +106,26 @@ void Test_FakeHTTPClientPacket_Generic() {
 	request.reply = outbuf;
 	request.replylen = 0;
 
-	request.replymaxlen = sizeof(outbuf);
+	request.replymaxlen = replyMax - 1;
+	request.responseCode = HTTP_RESPONSE_OK;
+	request.keepAlive = keepAlive;
 
+	g_sentLen = 0;
+	if (replyMax < sizeof(outbuf)) {
+		HTTP_SetSimulatorSendCallback(Test_Http_SimulatorSend);
+	}
 	printf("Test_FakeHTTPClientPacket_GET fake bytes sent: %d \n", iResult);
  	len = HTTP_ProcessPacket(&request);
+	if (keepAlive) {
+		bKeep = HTTP_FinishReply(&request);
+	}
+	HTTP_SetSimulatorSendCallback(0);
 	outbuf[request.replylen] = 0;
+	g_replyLen = request.replylen;
 	printf("Test_FakeHTTPClientPacket_GET fake bytes received: %d \n", len);
 
 	replyAt = Helper_GetPastHTTPHeader(outbuf);
-
+	return bKeep;
 }
 void Test_FakeHTTPClientPacket_GET(const char *tg) {
 	//char bufferTemp[8192];
@@ -99,13 +136,13 @@ void Test_FakeHTTPClientPacket_GET(const char *tg) {
 	//va_end(argList);
 
 	sprintf(buffer, http_get_template1, tg);
-	Test_FakeHTTPClientPacket_Generic();
+	Test_FakeHTTPClientPacket_Generic(NULL, NULL, NULL, 0, sizeof(outbuf));
 }
 void Test_FakeHTTPClientPacket_POST(const char *tg, const char *data) {
 	int dataLen = strlen(data);
 
 	sprintf(buffer, http_post_template1, tg, dataLen, data);
-	Test_FakeHTTPClientPacket_Generic();
+	Test_FakeHTTPClientPacket_Generic(NULL, NULL, NULL, 0, sizeof(outbuf));
 }
 void Test_GetJSONValue_Setup(const char *text) {
 	if (g_json) {
@@ -892,7 +929,325 @@ void Test_Http_LED_RGB() {
 	*/
 
 }
+void Test_Http_KeepAlive() {
+	char expected[64];
+
+	SIM_ClearOBK(0);
+	PIN_SetPinRoleForPinIndex(9, IOR_Relay);
+	PIN_SetPinChannelForPinIndex(9, 1);
+
+	// HTTP/1.1 keeps the connection by default, the reply gets its length
+	SELFTEST_ASSERT(Test_FakeHTTPClientPacket_Generic("index?state=1", "HTTP/1.1", "", 1, sizeof(outbuf)) == 1);
+	SELFTEST_ASSERT(strstr(outbuf, "Connection: close") == 0);
+	SELFTEST_ASSERT(strstr(outbuf, "Connection: keep-alive\r\n") != 0);
+	sprintf(expected, "Content-Length: %i\r\n\r\n", (int)strlen(replyAt));
+	SELFTEST_ASSERT(strstr(outbuf, expected) != 0);
+
+	SELFTEST_ASSERT(Test_FakeHTTPClientPacket_Generic("index?state=1", "HTTP/1.1", "Connection: keep-alive\r\n", 1, sizeof(outbuf)) == 1);
+	SELFTEST_ASSERT(Test_FakeHTTPClientPacket_Generic("index?state=1", "HTTP/1.0", "Connection: Keep-Alive\r\n", 1, sizeof(outbuf)) == 1);
+
+	// otherwise the reply is left as it was
+	SELFTEST_ASSERT(Test_FakeHTTPClientPacket_Generic("index?state=1", "HTTP/1.1", "Connection: close\r\n", 1, sizeof(outbuf)) == 0);
+	SELFTEST_ASSERT(strstr(outbuf, "Connection: close\r\n") != 0);
+	SELFTEST_ASSERT(strstr(outbuf, "Content-Length") == 0);
+	SELFTEST_ASSERT(Test_FakeHTTPClientPacket_Generic("index?state=1", "HTTP/1.0", "", 1, sizeof(outbuf)) == 0);
+	SELFTEST_ASSERT(strstr(outbuf, "Connection: close\r\n") != 0);
+}
+// length of the body of the last reply, it may be binary
+static int Test_GetLastReplyBodyLen() {
+	return g_replyLen - (replyAt - outbuf);
+}
+void Test_Http_StaticAssets() {
+	char etag[32];
+	char ifNoneMatch[96];
+	const char *p;
+	int len;
+
+	SIM_ClearOBK(0);
+
+	// gzipped with an ETag the browser can cache it by
+	Test_FakeHTTPClientPacket_Generic("style.css", "HTTP/1.1", "Accept-Encoding: gzip, deflate, br\r\n", 0, sizeof(outbuf));
+	len = Test_GetLastReplyBodyLen();
+	SELFTEST_ASSERT(len > 100);
+	SELFTEST_ASSERT((unsigned char)replyAt[0] == 0x1f && (unsigned char)replyAt[1] == 0x8b);
+	SELFTEST_ASSERT(strstr(outbuf, "HTTP/1.1 200 OK\r\n") == outbuf);
+	SELFTEST_ASSERT(strstr(outbuf, "Content-type: text/css\r\n") != 0);
+	SELFTEST_ASSERT(strstr(outbuf, "Content-Encoding: gzip\r\n") != 0);
+	SELFTEST_ASSERT(strstr(outbuf, "Cache-Control: public, max-age=31536000\r\n") != 0);
+	p = strstr(outbuf, "ETag: \"");
+	SELFTEST_ASSERT(p != 0);
+	p += 6;
+	len = strchr(p, '\r') - p;
+	SELFTEST_ASSERT(len == 10);
+	memcpy(etag, p, len);
+	etag[len] = 0;
+
+	// not sent again if the client has it already
+	sprintf(ifNoneMatch, "Accept-Encoding: gzip\r\nIf-None-Match: %s\r\n", etag);
+	Test_FakeHTTPClientPacket_Generic("style.css?v=1", "HTTP/1.1", ifNoneMatch, 0, sizeof(outbuf));
+	len = Test_GetLastReplyBodyLen();
+	SELFTEST_ASSERT(len == 0);
+	SELFTEST_ASSERT(strstr(outbuf, "HTTP/1.1 304 Not Modified\r\n") == outbuf);
+	Test_FakeHTTPClientPacket_Generic("style.css", "HTTP/1.1", "Accept-Encoding: gzip\r\nIf-None-Match: \"00000000\"\r\n", 0, sizeof(outbuf));
+	len = Test_GetLastReplyBodyLen();
+	SELFTEST_ASSERT(len > 100);
+
+	// plain text for clients without gzip
+	Test_FakeHTTPClientPacket_Generic("script.js", "HTTP/1.1", "", 0, sizeof(outbuf));
+	len = Test_GetLastReplyBodyLen();
+	SELFTEST_ASSERT(strstr(outbuf, "Content-type: application/javascript\r\n") != 0);
+	SELFTEST_ASSERT(strstr(outbuf, "Content-Encoding") == 0);
+	SELFTEST_ASSERT(len == (int)strlen(replyAt));
+	SELFTEST_ASSERT(strstr(replyAt, "<script") == 0);
+	SELFTEST_ASSERT(strstr(replyAt, "function") != 0);
+	SELFTEST_ASSERT(strstr(outbuf, etag) == 0);
+	Test_FakeHTTPClientPacket_Generic("style.css", "HTTP/1.1", "", 0, sizeof(outbuf));
+	len = Test_GetLastReplyBodyLen();
+	SELFTEST_ASSERT(len == (int)strlen(replyAt));
+	SELFTEST_ASSERT(strncmp(replyAt, "div,", 4) == 0);
+	SELFTEST_ASSERT(strstr(replyAt, "style>") == 0);
+
+	// pages link them instead of inlining
+	Test_FakeHTTPClientPacket_GET("index");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTMLReply(), "<link rel='stylesheet' href='/style.css?v=") != 0);
+	SELFTEST_ASSERT(strstr(Test_GetLastHTMLReply(), "<script src='/script.js?v=") != 0);
+	SELFTEST_ASSERT(strstr(Test_GetLastHTMLReply(), "<style>") == 0);
+}
+static int g_selftestRouteCalls;
+static int Test_Http_RouteCallback(http_request_t *request) {
+	g_selftestRouteCalls++;
+	http_setup(request, httpMimeTypeText);
+	poststr(request, request->url);
+	poststr(request, NULL);
+	return 0;
+}
+void Test_Http_Routes() {
+	cJSON *route;
+	int count;
+
+	SIM_ClearOBK(0);
+
+	// URLs match up to the query, paths ending with '/' match everything below
+	SELFTEST_ASSERT(HTTP_FindRoute("index", HTTP_GET) != 0);
+	SELFTEST_ASSERT(HTTP_FindRoute("index?state=1", HTTP_POST) == HTTP_FindRoute("index", HTTP_GET));
+	SELFTEST_ASSERT(HTTP_FindRoute("indexx", HTTP_GET) == 0);
+	SELFTEST_ASSERT(HTTP_FindRoute("cfg", HTTP_GET) != HTTP_FindRoute("cfg_pins", HTTP_GET));
+	SELFTEST_ASSERT(HTTP_FindRoute("api/channels", HTTP_GET) != HTTP_FindRoute("api/channels", HTTP_POST));
+	SELFTEST_ASSERT(HTTP_FindRoute("api/flash/0-100", HTTP_GET) == HTTP_FindRoute("api/flash/", HTTP_GET));
+	SELFTEST_ASSERT(HTTP_FindRoute("api/unknown/x", HTTP_GET) == HTTP_FindRoute("api/", HTTP_GET));
+	SELFTEST_ASSERT(HTTP_FindRoute("api/flash/0-100", HTTP_GET) != HTTP_FindRoute("api/", HTTP_GET));
+	SELFTEST_ASSERT(HTTP_FindRoute("api/unknown", HTTP_PUT) == 0);
+	SELFTEST_ASSERT(HTTP_FindRoute("apix", HTTP_GET) == 0);
+
+	// drivers can add their own pages, the longest prefix wins
+	HTTP_RegisterCallback("/selftest/", HTTP_GET, Test_Http_RouteCallback);
+	HTTP_RegisterCallback("/selftest/deep/", HTTP_ANY, Test_Http_RouteCallback);
+	g_selftestRouteCalls = 0;
+	Test_FakeHTTPClientPacket_GET("selftest/a/b?x=1");
+	SELFTEST_ASSERT(g_selftestRouteCalls == 1);
+	SELFTEST_ASSERT_HTML_REPLY("selftest/a/b?x=1");
+	Test_FakeHTTPClientPacket_POST("selftest/deep/a", "");
+	SELFTEST_ASSERT(g_selftestRouteCalls == 2);
+	Test_FakeHTTPClientPacket_POST("selftest/a", "");
+	SELFTEST_ASSERT(g_selftestRouteCalls == 2);
+
+	// unknown pages still get the default reply
+	Test_FakeHTTPClientPacket_GET("nosuchpage");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTMLReply(), "Not found") != 0);
+
+	// and the table can be listed
+	Test_FakeHTTPClientPacket_JSON("api/routes");
+	SELFTEST_ASSERT(cJSON_IsArray(g_json));
+	count = 0;
+	cJSON_ArrayForEach(route, g_json) {
+		if (!strcmp(cJSON_GetObjectItemCaseSensitive(route, "path")->valuestring, "/api/channels")) {
+			count++;
+		}
+		if (!strcmp(cJSON_GetObjectItemCaseSensitive(route, "path")->valuestring, "/selftest/deep/")) {
+			SELFTEST_ASSERT_STRING(cJSON_GetObjectItemCaseSensitive(route, "method")->valuestring, "ANY");
+			count++;
+		}
+	}
+	SELFTEST_ASSERT(count == 3);
+}
+void Test_Http_Benchmark() {
+	static const char *paths[] = {
+		"index", "index?state=1", "api/info", "api/channels", "about", "cfg_pins",
+		"api/flash/0-10", "cm?cmnd=POWER", "style.css", "nosuchpage",
+	};
+	int numPaths = sizeof(paths) / sizeof(paths[0]);
+	int i;
+	int loops;
+	double perSecLookups, perSecRequests;
+
+	SIM_ClearOBK(0);
+
+	loops = 1000000;
+	SelfTest_Benchmark_Begin();
+	for (i = 0; i < loops; i++) {
+		HTTP_FindRoute(paths[i % numPaths], HTTP_GET);
+	}
+	perSecLookups = SelfTest_Benchmark_PerSecond(loops);
+
+	loops = 5000;
+	for (i = 0; i < loops; i++) {
+		Test_FakeHTTPClientPacket_GET(paths[i % numPaths]);
+	}
+	perSecRequests = SelfTest_Benchmark_PerSecond(loops);
+
+	SelfTest_Benchmark_End("Test_Http_Benchmark: %.0f route lookups, %.0f requests per second\n",
+		perSecLookups, perSecRequests);
+}
+void Test_Http_Chunked() {
+	static char expected[8192];
+	char decoded[8192];
+	const char *p;
+	int decodedLen;
+	int chunkLen;
+	int responses;
+
+	SIM_ClearOBK(0);
+
+	// the whole reply, as it is with a buffer large enough
+	Test_FakeHTTPClientPacket_GET("api/routes");
+	strcpy(expected, replyAt);
+	SELFTEST_ASSERT(strlen(expected) > 1000);
+
+	responses = HTTP_GetStats()->chunkedResponses;
+	SELFTEST_ASSERT(Test_FakeHTTPClientPacket_Generic("api/routes", "HTTP/1.1", "", 1, 512) == 1);
+	SELFTEST_ASSERT(HTTP_GetStats()->chunkedResponses == responses + 1);
+	SELFTEST_ASSERT(strstr(g_sentData, "Transfer-Encoding: chunked\r\n") != 0);
+	SELFTEST_ASSERT(strstr(g_sentData, "Connection: keep-alive\r\n") != 0);
+	SELFTEST_ASSERT(strstr(g_sentData, "Connection: close") == 0);
+	SELFTEST_ASSERT(strstr(g_sentData, "Content-Length") == 0);
+
+	// join the chunks, the last one is empty
+	p = Helper_GetPastHTTPHeader(g_sentData);
+	decodedLen = 0;
+	do {
+		chunkLen = strtol(p, (char**)&p, 16);
+		SELFTEST_ASSERT(p[0] == '\r' && p[1] == '\n');
+		p += 2;
+		memcpy(decoded + decodedLen, p, chunkLen);
+		decodedLen += chunkLen;
+		p += chunkLen;
+		SELFTEST_ASSERT(p[0] == '\r' && p[1] == '\n');
+		p += 2;
+	} while (chunkLen > 0 && decodedLen < sizeof(decoded) - 512);
+	decoded[decodedLen] = 0;
+	SELFTEST_ASSERT(chunkLen == 0);
+	SELFTEST_ASSERT(*p == 0);
+	SELFTEST_ASSERT_STRING(decoded, expected);
+
+	// without keep-alive it is streamed as it is, and ended by closing
+	SELFTEST_ASSERT(Test_FakeHTTPClientPacket_Generic("api/routes", "HTTP/1.0", "", 1, 512) == 0);
+	SELFTEST_ASSERT(strstr(g_sentData, "Transfer-Encoding") == 0);
+	SELFTEST_ASSERT(strstr(g_sentData, "Connection: close\r\n") != 0);
+	SELFTEST_ASSERT_STRING(Helper_GetPastHTTPHeader(g_sentData), expected);
+	// the same for HTTP/1.0 clients that ask to keep the connection, they do not know chunks
+	SELFTEST_ASSERT(Test_FakeHTTPClientPacket_Generic("api/routes", "HTTP/1.0", "Connection: keep-alive\r\n", 1, 512) == 0);
+	SELFTEST_ASSERT(strstr(g_sentData, "Transfer-Encoding") == 0);
+	SELFTEST_ASSERT(strstr(g_sentData, "Connection: close\r\n") != 0);
+	SELFTEST_ASSERT_STRING(Helper_GetPastHTTPHeader(g_sentData), expected);
+	// while small replies still get their length and keep it
+	SELFTEST_ASSERT(Test_FakeHTTPClientPacket_Generic("api/seriallog", "HTTP/1.0", "Connection: keep-alive\r\n", 1, 512) == 1);
+	SELFTEST_ASSERT(strstr(g_sentData, "Content-Length: ") != 0);
+
+	// small replies still get their length
+	SELFTEST_ASSERT(Test_FakeHTTPClientPacket_Generic("api/seriallog", "HTTP/1.1", "", 1, 512) == 1);
+	SELFTEST_ASSERT(strstr(g_sentData, "Content-Length: ") != 0);
+	// unless there is no room left to add it
+	SELFTEST_ASSERT(Test_FakeHTTPClientPacket_Generic("api/logconfig", "HTTP/1.1", "", 1, 512) == 1);
+	SELFTEST_ASSERT(strstr(g_sentData, "Transfer-Encoding: chunked\r\n") != 0);
+	SELFTEST_ASSERT(strstr(g_sentData, "\r\n0\r\n\r\n") != 0);
+
+	// sizes and times are counted
+	Test_FakeHTTPClientPacket_JSON("api/httpstats");
+	SELFTEST_ASSERT(Test_GetJSONValue_Integer("chunked", "") == HTTP_GetStats()->chunkedResponses);
+	SELFTEST_ASSERT(Test_GetJSONValue_Integer("responses", "") >= 3);
+	Test_FakeHTTPClientPacket_JSON("api/httpstats?reset=1");
+	SELFTEST_ASSERT(Test_GetJSONValue_Integer("responses", "") == 0);
+}
+#if LINUX
+static int Test_Http_ReadAll(int fd, char *out, int maxLen) {
+	int len = 0;
+	int res;
+
+	while ((res = recv(fd, out + len, maxLen - 1 - len, 0)) > 0) {
+		len += res;
+	}
+	out[len] = 0;
+	return len;
+}
+// request handling of the firmware server, on a socket pair
+void Test_Http_TCPServer() {
+	static char buf[INCOMING_BUFFER_SIZE];
+	static char reply[REPLY_BUFFER_SIZE];
+	const char *req = "POST /x HTTP/1.1\r\nContent-Length: 5\r\n\r\nabcdeGET /y HTTP/1.1\r\n\r\n";
+	const char *get = "GET /index HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+	xQueueHandle queue;
+	bool bComplete;
+	time_t start;
+	int fds[2];
+	int have;
+	int len;
+	int fd;
+
+	SIM_ClearOBK(0);
+	queue = HTTP_GetAcceptQueue();
+	SELFTEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+	// a request with its body, the pipelined one after it is kept
+	send(fds[1], req, strlen(req), 0);
+	have = 0;
+	len = HTTP_ReceiveRequest(fds[0], buf, &have, &bComplete, false);
+	SELFTEST_ASSERT(len == strstr(req, "GET") - req);
+	SELFTEST_ASSERT(bComplete);
+	SELFTEST_ASSERT(have == strlen(req));
+	have -= len;
+	memmove(buf, buf + len, have);
+	SELFTEST_ASSERT(HTTP_ReceiveRequest(fds[0], buf, &have, &bComplete, true) == have);
+	SELFTEST_ASSERT(!memcmp(buf, "GET /y ", 7));
+
+	// an idle kept-alive connection is given up for a queued client at once,
+	// while a new connection still waits for its first request
+	fd = 100;
+	SELFTEST_ASSERT(xQueueSend(queue, &fd, 0) == pdTRUE);
+	have = 0;
+	start = time(0);
+	SELFTEST_ASSERT(HTTP_ReceiveRequest(fds[0], buf, &have, &bComplete, true) == 0);
+	SELFTEST_ASSERT(time(0) - start <= 1);
+	send(fds[1], get, strlen(get), 0);
+	SELFTEST_ASSERT(HTTP_ReceiveRequest(fds[0], buf, &have, &bComplete, false) == strlen(get));
+
+	// so the client is served once and closed
+	send(fds[1], get, strlen(get), 0);
+	HTTP_ServeClient(fds[0], buf, reply, true);
+	Test_Http_ReadAll(fds[1], outbuf, sizeof(outbuf));
+	SELFTEST_ASSERT(strstr(outbuf, "HTTP/1.1 200 OK") == outbuf);
+	close(fds[1]);
+	SELFTEST_ASSERT(xQueueReceive(queue, &fd, 0) == pdTRUE);
+
+	// with no client queued, a kept-alive connection is served until the client closes it
+	SELFTEST_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	send(fds[1], get, strlen(get), 0);
+	send(fds[1], get, strlen(get), 0);
+	shutdown(fds[1], SHUT_WR);
+	HTTP_ServeClient(fds[0], buf, reply, true);
+	Test_Http_ReadAll(fds[1], outbuf, sizeof(outbuf));
+	SELFTEST_ASSERT(strstr(outbuf, "HTTP/1.1 200 OK") == outbuf);
+	SELFTEST_ASSERT(strstr(outbuf + 1, "HTTP/1.1 200 OK") != 0);
+	close(fds[1]);
+}
+#endif
 void Test_Http() {
+	Test_Http_KeepAlive();
+	Test_Http_StaticAssets();
+	Test_Http_Routes();
+	Test_Http_Chunked();
+#if LINUX
+	Test_Http_TCPServer();
+#endif
 	Test_Http_SingleRelayOnChannel1();
 	Test_Http_TwoRelays();
 	Test_Http_FourRelays();
@@ -1,6 +1,7 @@
 #ifdef WINDOWS
 
-#include "selftest_local.h".
+#include "selftest_local.h"
+#include "../littlefs/our_lfs.h"
 
 void Test_LFS() {
 	char buffer[64];
@@ -129,4 +130,62 @@ void Test_LFS() {
 	SELFTEST_ASSERT_HTML_REPLY("value is 2023, and 31");
 }
 
+// Writes and loads a 4 KB script, like autoexec.bat, through the simulated
+// flash (a RAM-backed block device) and reports throughput and how many
+// flash operations LFS needed for it.
+void Test_LFS_Benchmark() {
+	static char data[4096];
+	const lfsFlashStats_t *stats;
+	lfs_file_t benchFile;
+	byte *loaded;
+	int i, j;
+	int loops;
+	unsigned int readsPerLoad, progsPerSave;
+	double writeKBs, readKBs;
+
+	SIM_ClearOBK(0);
+	CMD_ExecuteCommand("lfs_format", 0);
+	stats = LFS_GetFlashStats();
+
+	for (i = 0; i < sizeof(data) - 1; i++) {
+		data[i] = (i % 64 == 63) ? '\n' : 'a' + (i / 64) % 26;
+	}
+	data[sizeof(data) - 1] = 0;
+
+	// saved in 256 byte pieces, like an upload from the web app
+	CMD_ExecuteCommand("lfs_stats reset", 0);
+	loops = 50;
+	SelfTest_Benchmark_Begin();
+	for (i = 0; i < loops; i++) {
+		memset(&benchFile, 0, sizeof(benchFile));
+		lfs_file_open(&lfs, &benchFile, "bench.bat", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+		for (j = 0; j < sizeof(data) - 1; j += 256) {
+			lfs_file_write(&lfs, &benchFile, data + j, 256);
+		}
+		lfs_file_close(&lfs, &benchFile);
+	}
+	writeKBs = SelfTest_Benchmark_PerSecond(loops * 4.0);
+	progsPerSave = stats->progs / loops;
+	SELFTEST_ASSERT(stats->maxIrqOffBytes <= LFS_FLASH_IRQ_CHUNK);
+
+	CMD_ExecuteCommand("lfs_stats reset", 0);
+	loops = 500;
+	for (i = 0; i < loops; i++) {
+		loaded = LFS_ReadFile("bench.bat");
+		SELFTEST_ASSERT(loaded != 0);
+		SELFTEST_ASSERT(memcmp(loaded, data, sizeof(data) - 1) == 0);
+		free(loaded);
+	}
+	readKBs = SelfTest_Benchmark_PerSecond(loops * 4.0);
+	readsPerLoad = stats->reads / loops;
+	// whole file is read at once, but interrupts are enabled between chunks
+	SELFTEST_ASSERT(stats->maxIrqOffBytes == LFS_FLASH_IRQ_CHUNK);
+	SELFTEST_ASSERT(readsPerLoad < 32);
+
+	CMD_ExecuteCommand("lfs_remove bench.bat", 0);
+
+	SelfTest_Benchmark_End("Test_LFS_Benchmark: cache %i, save %.0f KB/s with %u progs, load %.0f KB/s with %u reads, max irq off %u us\n",
+		LFS_CACHE_SIZE, writeKBs, progsPerSave, readKBs, readsPerLoad, stats->maxIrqOffUs);
+}
+
 #endif
@@ -8,6 +8,10 @@
 #include "../sim/sim_import.h"
 
 void SelfTest_Failed(const char *file, const char *function, int line, const char *exp);
+// timing for the *_Benchmark tests, console logging is off in between
+void SelfTest_Benchmark_Begin();
+double SelfTest_Benchmark_PerSecond(double operations);
+void SelfTest_Benchmark_End(const char *fmt, ...);
 
 #define SELFTEST_ASSERT(expr) \
 	if (!(expr)) \
@@ -39,7 +43,7 @@ void SelfTest_Failed(const char *file, const char *function, int line, const cha
 #define SELFTEST_ASSERT_HAS_UART_EMPTY() SELFTEST_ASSERT(SIM_UART_GetDataSize()==0);
 
 //#define FLOAT_EQUALS (a,b) (fabs(a-b)<0.001f)
-inline bool Float_Equals(float a, float b) {
+static inline bool Float_Equals(float a, float b) {
 	float res = fabs(a - b);
 	return res < 0.001f;
 }
@@ -47,7 +51,7 @@ inline bool Float_Equals(float a, float b) {
 #define VA_BUFFER_SIZE 4096
 #define VA_COUNT 4
 
-inline const char *va(const char *fmt, ...) {
+static inline const char *va(const char *fmt, ...) {
 	va_list argList;
 	static int whi = 0;
 	static char buffer[VA_COUNT][VA_BUFFER_SIZE];
@@ -67,17 +71,26 @@ void Test_JSON_Lib();
 void Test_Commands_Startup();
 void Test_TwoPWMsOneChannel();
 void Test_ClockEvents();
+void Test_ClockEvents_CatchUp();
 void Test_Commands_Channels();
 void Test_LEDDriver();
 void Test_TuyaMCU_Basic();
+void Test_TuyaMCU_TxQueue();
+void Test_TuyaMCU_Fuzz();
+void Test_TuyaMCU_RxRingBuffer();
 void Test_Command_If();
 void Test_Command_If_Else();
 void Test_LFS();
+void Test_LFS_Benchmark();
 void Test_Tokenizer();
 void Test_Commands_Alias();
+void Test_Expressions_Benchmark();
+void Test_Logging();
+void Test_Logging_Benchmark();
 void Test_ExpandConstant();
 void Test_Scripting();
 void Test_RepeatingEvents();
+void Test_RepeatingEvents_TimerWheel();
 void Test_HTTP_Client();
 void Test_DeviceGroups();
 void Test_NTP();
@@ -85,8 +98,10 @@ void Test_MQTT();
 void Test_Tasmota();
 void Test_EnergyMeter();
 void Test_DHT();
+void Test_Drivers();
 void Test_Flags();
 void Test_MultiplePinsOnChannel();
+void Test_MultiplePinsOnChannel_Index();
 void Test_HassDiscovery();
 void Test_HassDiscovery_Base();
 void Test_HassDiscovery_Ext();
@@ -98,6 +113,7 @@ void Test_Role_ToggleAll();
 void Test_Demo_SimpleShuttersScript();
 void Test_Commands_Generic();
 void Test_ChangeHandlers_MQTT();
+void Test_ChangeHandlers_ManyHandlers();
 void Test_Commands_Calendar();
 void Test_CFG_Via_HTTP();
 void Test_Demo_ButtonScrollingChannelValues();
@@ -107,8 +123,14 @@ void Test_WaitFor();
 void Test_IF_Inside_Backlog();
 void Test_MQTT_Get_LED_EnableAll();
 void Test_TuyaMCU_BatteryPowered();
+void Test_Http();
+void Test_Http_Benchmark();
+void Test_Expressions_RunTests_Basic();
+void Test_ChangeHandlers();
+void Test_ButtonEvents();
 
 void Test_GetJSONValue_Setup(const char *text);
+struct cJSON *Test_GetJSONValue_Generic(const char *keyword, const char *obj);
 void Test_FakeHTTPClientPacket_GET(const char *tg);
 void Test_FakeHTTPClientPacket_POST(const char *tg, const char *data);
 void Test_FakeHTTPClientPacket_JSON(const char *tg);
@@ -127,6 +149,7 @@ const char *Test_GetJSONValue_String_Nested(const char *par1, const char *keywor
 const char *Test_GetJSONValue_String_Nested2(const char *par1, const char *par2, const char *keyword);
 
 void SIM_SendFakeMQTT(const char *text, const char *arguments);
+void SIM_ClearAndPrepareForMQTTTesting(const char *clientName, const char *groupName);
 void SIM_SendFakeMQTTAndRunSimFrame_CMND(const char *command, const char *arguments);
 void SIM_SendFakeMQTTAndRunSimFrame_CMND_ViaGroupTopic(const char *command, const char *arguments);
 void SIM_SendFakeMQTTRawChannelSet(int channelIndex, const char *arguments);
@@ -136,6 +159,7 @@ bool SIM_CheckMQTTHistoryForString(const char *topic, const char *value, bool bR
 bool SIM_HasMQTTHistoryStringWithJSONPayload(const char *topic, bool bPrefixMode, const char *object1, const char *object2, const char *key, const char *value);
 bool SIM_CheckMQTTHistoryForFloat(const char *topic, float value, bool bRetain);
 const char *SIM_GetMQTTHistoryString(const char *topic, bool bPrefixMode);
+int SIM_GetMQTTHistoryQoS(const char *topic);
 bool SIM_BeginParsingMQTTJSON(const char *topic, bool bPrefixMode);
 
 void SIM_SimulateUserClickOnPin(int pin);
@@ -150,4 +174,8 @@ bool SIM_UART_ExpectAndConsumeHByte(byte b);
 bool SIM_UART_ExpectAndConsumeHexStr(const char *hexString);
 void SIM_ClearUART();
 
+// TuyaMCU frames from debug_tuyaMCUsimulator.c
+void TuyaMCUSimulator_AppendFrame(byte version, byte cmd, const byte *payload, int len);
+void TuyaMCUSimulator_AppendNoise(unsigned int *seed, const byte *payload, int len);
+
 #endif
@@ -0,0 +1,135 @@
+#ifdef WINDOWS
+
+#include "selftest_local.h"
+#include "../logging/logging.h"
+
+static void Test_Logging_Drain() {
+	Test_FakeHTTPClientPacket_GET("lograw");
+}
+static void Test_Logging_AssertHas(const char *s) {
+	const char *reply = Test_GetLastHTMLReply();
+	if (reply == 0 || strstr(reply, s) == 0) {
+		printf("Test_Logging: missing [%s]\n", s);
+	}
+	SELFTEST_ASSERT(reply != 0 && strstr(reply, s) != 0);
+}
+
+void Test_Logging() {
+	char tmp[32];
+	int i;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+	loglevel = LOG_INFO;
+	i = 0;
+
+	// this will create the log memory and the /lograw page
+	ADDLOG_INFO(LOG_FEATURE_RAW, "Test_Logging start");
+	Test_Logging_Drain();
+
+	// lines are formatted only when they are read,
+	// so string arguments must be copied when logging
+	strcpy(tmp, "first");
+	ADDLOG_INFO(LOG_FEATURE_RAW, "String %s", tmp);
+	strcpy(tmp, "second");
+	ADDLOG_INFO(LOG_FEATURE_RAW, "Ints %i %d %u %x %X %lu", -5, 12, 7u, 255, 171, 123456789ul);
+	ADDLOG_INFO(LOG_FEATURE_RAW, "Floats %f %5.2f %.1f", 1.5f, 3.14159, 2.25);
+	ADDLOG_INFO(LOG_FEATURE_RAW, "Stars [%.*s] [%*i] [%-4s]", 3, "abcdef", 4, 7, "ab");
+	ADDLOG_INFO(LOG_FEATURE_RAW, "Chars %c%c 100%%", 'o', 'k');
+	ADDLOG_INFO(LOG_FEATURE_RAW, "Null %s", (const char*)0);
+	ADDLOG_INFO(LOG_FEATURE_RAW, "Trailing newline\n");
+	ADDLOG_INFO(LOG_FEATURE_GENERAL, "Prefixed %i", 1);
+	// filtered out by level and feature, the filters are checked before
+	// the arguments are evaluated
+	CMD_ExecuteCommand("logstats reset", 0);
+	ADDLOG_DEBUG(LOG_FEATURE_RAW, "Debug line %i", i++);
+	ADDLOG_INFO(LOG_FEATURE_LFS, "LFS line %i", i++);
+	ADDLOG_INFO(LOG_FEATURE_LFS, "LFS line %i", i++);
+	SELFTEST_ASSERT(i == 0);
+	SELFTEST_ASSERT(logSuppressedCount[LOG_FEATURE_RAW] == 1);
+	SELFTEST_ASSERT(logSuppressedCount[LOG_FEATURE_LFS] == 2);
+	SELFTEST_ASSERT(logEmittedCount[LOG_FEATURE_LFS] == 0);
+	ADDLOG_INFO(LOG_FEATURE_RAW, "Counted");
+	SELFTEST_ASSERT(logEmittedCount[LOG_FEATURE_RAW] == 1);
+	Test_Logging_Drain();
+
+	Test_Logging_AssertHas("String first\r\n");
+	Test_Logging_AssertHas("Ints -5 12 7 ff AB 123456789\r\n");
+	Test_Logging_AssertHas("Floats 1.500000  3.14 2.2\r\n");
+	Test_Logging_AssertHas("Stars [abc] [   7] [ab  ]\r\n");
+	Test_Logging_AssertHas("Chars ok 100%\r\n");
+	Test_Logging_AssertHas("Null (null)\r\n");
+	Test_Logging_AssertHas("Trailing newline\r\n");
+	Test_Logging_AssertHas("Info:GEN:Prefixed 1\r\n");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTMLReply(), "Debug line") == 0);
+	SELFTEST_ASSERT(strstr(Test_GetLastHTMLReply(), "LFS line") == 0);
+	SELFTEST_ASSERT(strstr(Test_GetLastHTMLReply(), "String second") == 0);
+
+	// nothing new was logged, apart from what the HTTP request itself logs
+	Test_Logging_Drain();
+	SELFTEST_ASSERT(strstr(Test_GetLastHTMLReply(), "String first") == 0);
+
+	// overflow drops the oldest lines, but the newest are always kept
+	for (i = 0; i < 1000; i++) {
+		ADDLOG_INFO(LOG_FEATURE_RAW, "Overflow line [%04i] %s", i, "padding padding");
+	}
+	Test_Logging_Drain();
+	Test_Logging_AssertHas("Overflow line [0999] padding padding\r\n");
+	Test_Logging_AssertHas("Overflow line [0950] padding padding\r\n");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTMLReply(), "[0000]") == 0);
+
+	// records of varying size, read a few at a time while the memory wraps many times
+	for (i = 0; i < 400; i++) {
+		char expected[64];
+		ADDLOG_INFO(LOG_FEATURE_RAW, "Wrap [%04i] %.*s", i, i % 31, "0123456789012345678901234567890");
+		if (i % 5 == 4) {
+			Test_Logging_Drain();
+			sprintf(expected, "Wrap [%04i] %.*s\r\n", i - 4, (i - 4) % 31, "0123456789012345678901234567890");
+			Test_Logging_AssertHas(expected);
+			sprintf(expected, "Wrap [%04i] %.*s\r\n", i, i % 31, "0123456789012345678901234567890");
+			Test_Logging_AssertHas(expected);
+		}
+	}
+
+	// a line longer than a single record is cut, but still ends the line
+	memset(tmp, 'x', sizeof(tmp) - 1);
+	tmp[sizeof(tmp) - 1] = 0;
+	ADDLOG_INFO(LOG_FEATURE_RAW, "Long %s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s end",
+		tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp,
+		tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp, tmp);
+	ADDLOG_INFO(LOG_FEATURE_RAW, "After long");
+	Test_Logging_Drain();
+	Test_Logging_AssertHas("xxxx\r\nAfter long\r\n");
+	SELFTEST_ASSERT(strstr(Test_GetLastHTMLReply(), "x end") == 0);
+}
+
+void Test_Logging_Benchmark() {
+	int i;
+	int loops = 100000;
+	double perSecDisabled, perSecFiltered, perSecEnabled;
+
+	SIM_ClearOBK(0);
+	loglevel = LOG_INFO;
+
+	// LFS feature is off by default
+	SelfTest_Benchmark_Begin();
+	for (i = 0; i < loops; i++) {
+		ADDLOG_INFO(LOG_FEATURE_LFS, "Benchmark %i %s %f", i, "disabled", 1.5f);
+	}
+	perSecDisabled = SelfTest_Benchmark_PerSecond(loops);
+
+	for (i = 0; i < loops; i++) {
+		ADDLOG_DEBUG(LOG_FEATURE_MAIN, "Benchmark %i %s %f", i, "filtered", 1.5f);
+	}
+	perSecFiltered = SelfTest_Benchmark_PerSecond(loops);
+
+	for (i = 0; i < loops; i++) {
+		ADDLOG_INFO(LOG_FEATURE_MAIN, "Benchmark %i %s %f", i, "enabled", 1.5f);
+	}
+	perSecEnabled = SelfTest_Benchmark_PerSecond(loops);
+
+	SelfTest_Benchmark_End("Test_Logging_Benchmark: disabled %.0f, filtered %.0f, enabled %.0f log calls per second\n",
+		perSecDisabled, perSecFiltered, perSecEnabled);
+}
+
+#endif
@@ -1,11 +1,43 @@
 #ifdef WINDOWS
 
 #include "selftest_local.h"
+#include "../logging/logging.h"
+#include <time.h>
+
+int g_selfTestErrors = 0;
 
 void SelfTest_Failed(const char *file, const char *function, int line, const char *exp) {
+	g_selfTestErrors++;
 	printf("SelfTest failed for %s\n", exp);
 	printf("Check %s - %s - line %i\n", file, function, line);
+#if !LINUX
 	system("pause");
+#endif
+}
+
+static clock_t g_benchmarkStart;
+static int g_benchmarkLogType;
+
+void SelfTest_Benchmark_Begin() {
+	// keep the console quiet, lines still go to the log memory
+	g_benchmarkLogType = direct_serial_log;
+	direct_serial_log = LOGTYPE_NONE;
+	g_benchmarkStart = clock();
+}
+// operations per second since Begin or the previous call, restarts the clock
+double SelfTest_Benchmark_PerSecond(double operations) {
+	double seconds = (double)(clock() - g_benchmarkStart + 1) / CLOCKS_PER_SEC;
+
+	g_benchmarkStart = clock();
+	return operations / seconds;
+}
+void SelfTest_Benchmark_End(const char *fmt, ...) {
+	va_list argList;
+
+	direct_serial_log = g_benchmarkLogType;
+	va_start(argList, fmt);
+	vprintf(fmt, argList);
+	va_end(argList);
 }
 
 
@@ -2,6 +2,7 @@
 
 #include "selftest_local.h"
 #include "../hal/hal_wifi.h"
+#include "../mqtt/new_mqtt.h"
 
 void SIM_ClearAndPrepareForMQTTTesting(const char *clientName, const char *groupName) {
 	SIM_ClearOBK(0);
@@ -402,6 +403,248 @@ void Test_MQTT_Topic_With_Slash() {
 	SIM_ClearMQTTHistory();
 }
 
+// many messages received before processing, overflow, wrap of the ring buffer
+void Test_MQTT_ReceiveBuffer() {
+	char buffer[64];
+	char *large;
+	int overflows, drops;
+	int i, j, sum;
+
+	SIM_ClearOBK(0);
+	SIM_ClearAndPrepareForMQTTTesting("miscDevice", "bekens");
+
+	overflows = MQTT_GetReceiveOverflowCounter();
+	drops = MQTT_GetReceiveDropCounter();
+
+	// 4 byte header, 26 + 1 byte topic, 3 + 1 byte data - 117 of them fit into 4096 bytes
+	for (i = 0; i < 200; i++) {
+		MQTT_Post_Received_Str("cmnd/miscDevice/addChannel", "2 1");
+	}
+	SELFTEST_ASSERT(MQTT_GetReceiveOverflowCounter() == overflows + 83);
+	SELFTEST_ASSERT(MQTT_GetReceiveDropCounter() == drops + 83);
+	Sim_RunFrames(1, false);
+	SELFTEST_ASSERT_CHANNEL(2, 117);
+
+	// never fits
+	large = malloc(5000);
+	memset(large, ' ', 4999);
+	large[4999] = 0;
+	MQTT_Post_Received_Str("cmnd/miscDevice/addChannel", large);
+	free(large);
+	SELFTEST_ASSERT(MQTT_GetReceiveOverflowCounter() == overflows + 83);
+	SELFTEST_ASSERT(MQTT_GetReceiveDropCounter() == drops + 84);
+
+	// messages of different sizes go around the buffer many times
+	sum = 0;
+	for (i = 0; i < 300; i++) {
+		for (j = 0; j < 3; j++) {
+			sprintf(buffer, "3 %i", i * 10 + j);
+			sum += i * 10 + j;
+			MQTT_Post_Received_Str("cmnd/miscDevice/addChannel", buffer);
+		}
+		MQTT_Post_Received_Str("some/other/topic/not/for/us", buffer);
+		Sim_RunFrames(1, false);
+	}
+	SELFTEST_ASSERT_CHANNEL(3, sum);
+	SELFTEST_ASSERT(MQTT_GetReceiveOverflowCounter() == overflows + 83);
+	SIM_ClearMQTTHistory();
+}
+
+static int g_trieOrder[8];
+static int g_trieOrderCount;
+static char g_trieSubTopic[4][64];
+static int g_trieChannel[4];
+static int g_trieHits;
+
+static int Test_MQTT_TrieRecord(obk_mqtt_request_t* request, int tag) {
+	if (g_trieOrderCount < 8) {
+		g_trieOrder[g_trieOrderCount++] = tag;
+	}
+	strcpy_safe(g_trieSubTopic[tag], request->subTopic ? request->subTopic : "", sizeof(g_trieSubTopic[tag]));
+	g_trieChannel[tag] = request->channel;
+	return 0;
+}
+static int Test_MQTT_TriePlus(obk_mqtt_request_t* request) {
+	return Test_MQTT_TrieRecord(request, 1);
+}
+static int Test_MQTT_TrieHash(obk_mqtt_request_t* request) {
+	return Test_MQTT_TrieRecord(request, 2);
+}
+static int Test_MQTT_TrieEat(obk_mqtt_request_t* request) {
+	Test_MQTT_TrieRecord(request, 3);
+	return 1;
+}
+static int Test_MQTT_TrieMany(obk_mqtt_request_t* request) {
+	g_trieHits++;
+	return 0;
+}
+static void Test_MQTT_TriePost(const char *topic, const char *data) {
+	g_trieOrderCount = 0;
+	MQTT_Post_Received_Str(topic, data);
+	Sim_RunFrames(1, false);
+}
+
+// wildcard routing, subtopic and channel parsing, more callbacks than the old fixed table
+void Test_MQTT_TopicTrie() {
+	char topic[64];
+	char sub[64];
+	int i;
+
+	SIM_ClearOBK(0);
+	SIM_ClearAndPrepareForMQTTTesting("miscDevice", "bekens");
+
+	SELFTEST_ASSERT(MQTT_RegisterCallback("trie/", "trie/+/temp", 100, Test_MQTT_TriePlus) == 0);
+	SELFTEST_ASSERT(MQTT_RegisterCallback("trie/", "trie/#", 101, Test_MQTT_TrieHash) == 0);
+
+	Test_MQTT_TriePost("trie/5/temp", "21");
+	SELFTEST_ASSERT(g_trieOrderCount == 2);
+	SELFTEST_ASSERT(g_trieOrder[0] == 1);
+	SELFTEST_ASSERT(g_trieOrder[1] == 2);
+	SELFTEST_ASSERT_STRING(g_trieSubTopic[1], "5/temp");
+	SELFTEST_ASSERT(g_trieChannel[1] == 5);
+	SELFTEST_ASSERT_STRING(g_trieSubTopic[2], "5/temp");
+
+	Test_MQTT_TriePost("trie/kitchen/temp", "21");
+	SELFTEST_ASSERT(g_trieOrderCount == 2);
+	SELFTEST_ASSERT_STRING(g_trieSubTopic[1], "kitchen/temp");
+	SELFTEST_ASSERT(g_trieChannel[1] == -1);
+
+	Test_MQTT_TriePost("trie/5/humidity", "40");
+	SELFTEST_ASSERT(g_trieOrderCount == 1);
+	SELFTEST_ASSERT(g_trieOrder[0] == 2);
+	SELFTEST_ASSERT_STRING(g_trieSubTopic[2], "5/humidity");
+
+	// "trie/#" matches the parent level as well
+	Test_MQTT_TriePost("trie", "1");
+	SELFTEST_ASSERT(g_trieOrderCount == 1);
+	SELFTEST_ASSERT_STRING(g_trieSubTopic[2], "");
+
+	Test_MQTT_TriePost("trie/5/temp/extra", "1");
+	SELFTEST_ASSERT(g_trieOrderCount == 1);
+	Test_MQTT_TriePost("other/5/temp", "1");
+	SELFTEST_ASSERT(g_trieOrderCount == 0);
+
+	// callback returning 1 stops the later ones
+	SELFTEST_ASSERT(MQTT_RegisterCallback("stop/", "stop/+", 102, Test_MQTT_TrieEat) == 0);
+	SELFTEST_ASSERT(MQTT_RegisterCallback("stop/", "stop/#", 103, Test_MQTT_TrieHash) == 0);
+	Test_MQTT_TriePost("stop/12", "1");
+	SELFTEST_ASSERT(g_trieOrderCount == 1);
+	SELFTEST_ASSERT(g_trieOrder[0] == 3);
+	SELFTEST_ASSERT(g_trieChannel[3] == 12);
+
+	// replacing by ID moves the callback to the new subscription
+	SELFTEST_ASSERT(MQTT_RegisterCallback("stop/", "moved/+", 102, Test_MQTT_TrieEat) == 0);
+	Test_MQTT_TriePost("stop/12", "1");
+	SELFTEST_ASSERT(g_trieOrderCount == 1);
+	SELFTEST_ASSERT(g_trieOrder[0] == 2);
+	Test_MQTT_TriePost("moved/7", "1");
+	SELFTEST_ASSERT(g_trieOrderCount == 1);
+	SELFTEST_ASSERT(g_trieChannel[3] == 7);
+
+	// way more than the 32 callbacks of the old table
+	g_trieHits = 0;
+	for (i = 0; i < 100; i++) {
+		sprintf(topic, "many/%i/", i);
+		sprintf(sub, "many/%i/+", i);
+		SELFTEST_ASSERT(MQTT_RegisterCallback(topic, sub, 200 + i, Test_MQTT_TrieMany) == 0);
+	}
+	for (i = 0; i < 100; i++) {
+		sprintf(topic, "many/%i/value", i);
+		Test_MQTT_TriePost(topic, "1");
+	}
+	SELFTEST_ASSERT(g_trieHits == 100);
+	for (i = 0; i < 100; i++) {
+		SELFTEST_ASSERT(MQTT_RemoveCallback(200 + i) == 1);
+	}
+	Test_MQTT_TriePost("many/42/value", "1");
+	SELFTEST_ASSERT(g_trieHits == 100);
+
+	// built-in handlers get the channel from the '+' level
+	SIM_SendFakeMQTTRawChannelSet(3, "12");
+	Sim_RunFrames(1, false);
+	SELFTEST_ASSERT_CHANNEL(3, 12);
+	CMD_ExecuteCommand("setChannel 0 5", 0);
+	SIM_SendFakeMQTT("miscDevice/notANumber/set", "0");
+	Sim_RunFrames(1, false);
+	SELFTEST_ASSERT_CHANNEL(0, 5);
+	SIM_SendFakeMQTT("cmnd/miscDevice/setChannel", "4 33");
+	Sim_RunFrames(1, false);
+	SELFTEST_ASSERT_CHANNEL(4, 33);
+
+	for (i = 100; i <= 103; i++) {
+		MQTT_RemoveCallback(i);
+	}
+	SIM_ClearMQTTHistory();
+}
+
+// publishes go through pre-rendered topics, without heap allocations
+void Test_MQTT_PublishTemplates() {
+	char longTopic[200];
+	int allocs;
+
+	SIM_ClearOBK(0);
+	SIM_ClearAndPrepareForMQTTTesting("miscDevice", "bekens");
+
+	allocs = MQTT_GetPublishAllocCounter();
+	CMD_ExecuteCommand("setChannel 5 123", 0);
+	MQTT_ChannelPublish(5, 0);
+	SELFTEST_ASSERT_HAD_MQTT_PUBLISH_STR("miscDevice/5/get", "123", false);
+	SELFTEST_ASSERT(SIM_GetMQTTHistoryQoS("miscDevice/5/get") == 2);
+	MQTT_PublishTele("STATE", "on");
+	SELFTEST_ASSERT_HAD_MQTT_PUBLISH_STR("tele/miscDevice/STATE", "on", false);
+	MQTT_PublishStat("RESULT", "ok");
+	SELFTEST_ASSERT_HAD_MQTT_PUBLISH_STR("stat/miscDevice/RESULT", "ok", false);
+	MQTT_PublishMain_StringInt("voltage", 230);
+	SELFTEST_ASSERT_HAD_MQTT_PUBLISH_STR("miscDevice/voltage/get", "230", false);
+	// every channel has a template, even with the longest client ID
+	MQTT_ChannelPublish(CHANNEL_MAX - 1, 0);
+	SELFTEST_ASSERT(SIM_GetMQTTHistoryString("miscDevice/63/get", false) != 0);
+	SELFTEST_ASSERT(MQTT_HasChannelTopicTemplate(CHANNEL_MAX - 1));
+	SELFTEST_ASSERT(MQTT_GetPublishAllocCounter() == allocs);
+
+	// only very long topics need heap
+	memset(longTopic, 'a', sizeof(longTopic) - 1);
+	longTopic[sizeof(longTopic) - 1] = 0;
+	MQTT_Publish(longTopic, "x", "1", 0);
+	SELFTEST_ASSERT(MQTT_GetPublishAllocCounter() == allocs + 1);
+	SIM_ClearMQTTHistory();
+
+	// QoS per class
+	CMD_ExecuteCommand("mqtt_qos channel 0", 0);
+	CMD_ExecuteCommand("mqtt_qos tele 1", 0);
+	MQTT_ChannelPublish(5, 0);
+	MQTT_PublishTele("STATE", "on");
+	MQTT_PublishStat("RESULT", "ok");
+	SELFTEST_ASSERT(SIM_GetMQTTHistoryQoS("miscDevice/5/get") == 0);
+	SELFTEST_ASSERT(SIM_GetMQTTHistoryQoS("tele/miscDevice/STATE") == 1);
+	SELFTEST_ASSERT(SIM_GetMQTTHistoryQoS("stat/miscDevice/RESULT") == 2);
+	CMD_ExecuteCommand("mqtt_qos all 2", 0);
+	SIM_ClearMQTTHistory();
+
+	// templates follow client ID change, even before they are rebuilt
+	CFG_SetMQTTClientId("renamedDevice");
+	MQTT_ChannelPublish(5, 0);
+	SELFTEST_ASSERT_HAD_MQTT_PUBLISH_STR("renamedDevice/5/get", "123", false);
+	MQTT_RunEverySecondUpdate();
+	SIM_ClearMQTTHistory();
+	MQTT_ChannelPublish(5, 0);
+	MQTT_PublishTele("STATE", "off");
+	SELFTEST_ASSERT_HAD_MQTT_PUBLISH_STR("renamedDevice/5/get", "123", false);
+	SELFTEST_ASSERT_HAD_MQTT_PUBLISH_STR("tele/renamedDevice/STATE", "off", false);
+	SELFTEST_ASSERT(SIM_GetMQTTHistoryString("miscDevice/5/get", false) == 0);
+	SELFTEST_ASSERT(MQTT_GetPublishAllocCounter() == allocs + 1);
+	SIM_ClearMQTTHistory();
+
+	// the arena has room for all channels with the longest client ID
+	memset(longTopic, 'b', CGF_MQTT_CLIENT_ID_SIZE - 1);
+	longTopic[CGF_MQTT_CLIENT_ID_SIZE - 1] = 0;
+	CFG_SetMQTTClientId(longTopic);
+	MQTT_RunEverySecondUpdate();
+	SELFTEST_ASSERT(MQTT_HasChannelTopicTemplate(0));
+	SELFTEST_ASSERT(MQTT_HasChannelTopicTemplate(CHANNEL_MAX - 1));
+	SELFTEST_ASSERT(MQTT_HasChannelTopicTemplate(CHANNEL_MAX) == false);
+	SIM_ClearMQTTHistory();
+}
 
 void Test_MQTT(){
 	Test_MQTT_Get_And_Reply();
@@ -411,6 +654,9 @@ void Test_MQTT(){
 	Test_MQTT_LED_RGB();
 	Test_MQTT_Topic_With_Slash();
 	Test_MQTT_Topic_With_Slashes();
+	Test_MQTT_ReceiveBuffer();
+	Test_MQTT_TopicTrie();
+	Test_MQTT_PublishTemplates();
 }
 
 #endif
@@ -1,6 +1,6 @@
 #ifdef WINDOWS
 
-#include "selftest_local.h".
+#include "selftest_local.h"
 
 static int PIN_BUTTON = 10;
 static int PIN_LED_n = 11;
@@ -86,5 +86,59 @@ void Test_MultiplePinsOnChannel() {
 	SELFTEST_ASSERT_PIN_BOOLEAN(PIN_RELAY_n, false);
 }
 
+void Test_MultiplePinsOnChannel_Index() {
+	// reset whole device
+	SIM_ClearOBK(0);
+
+	SELFTEST_ASSERT(CHANNEL_IsInUse(1) == false);
+	SELFTEST_ASSERT(CHANNEL_GetRoleForOutputChannel(1) == IOR_None);
+
+	PIN_SetPinRoleForPinIndex(PIN_RELAY, IOR_Relay);
+	PIN_SetPinChannelForPinIndex(PIN_RELAY, 1);
+	PIN_SetPinRoleForPinIndex(PIN_LED_n, IOR_PWM);
+	PIN_SetPinChannelForPinIndex(PIN_LED_n, 2);
+	// button uses channel 3 only on double click
+	PIN_SetPinRoleForPinIndex(PIN_BUTTON, IOR_Button);
+	PIN_SetPinChannelForPinIndex(PIN_BUTTON, 4);
+	PIN_SetPinChannel2ForPinIndex(PIN_BUTTON, 3);
+
+	SELFTEST_ASSERT(CHANNEL_IsInUse(1));
+	SELFTEST_ASSERT(CHANNEL_IsInUse(2));
+	SELFTEST_ASSERT(CHANNEL_IsInUse(3));
+	SELFTEST_ASSERT(CHANNEL_IsInUse(4));
+	SELFTEST_ASSERT(CHANNEL_IsInUse(5) == false);
+	SELFTEST_ASSERT(CHANNEL_IsPowerRelayChannel(1));
+	SELFTEST_ASSERT(CHANNEL_IsPowerRelayChannel(2) == false);
+	SELFTEST_ASSERT(CHANNEL_HasChannelPinWithRole(2, IOR_PWM));
+	SELFTEST_ASSERT(CHANNEL_HasChannelPinWithRoleOrRole(1, IOR_PWM, IOR_Relay));
+	SELFTEST_ASSERT(CHANNEL_HasChannelPinWithRoleOrRole(1, IOR_PWM, IOR_PWM_n) == false);
+	SELFTEST_ASSERT(CHANNEL_FindMaxValueForChannel(2) == 100);
+	SELFTEST_ASSERT(CHANNEL_GetRoleForOutputChannel(1) == IOR_Relay);
+	SELFTEST_ASSERT(CHANNEL_ShouldBePublished(1));
+	SELFTEST_ASSERT(CHANNEL_ShouldBePublished(4) == false);
+
+	// moving the relay to another channel updates both channels
+	PIN_SetPinChannelForPinIndex(PIN_RELAY_n, 1);
+	PIN_SetPinRoleForPinIndex(PIN_RELAY_n, IOR_Relay_n);
+	PIN_SetPinChannelForPinIndex(PIN_RELAY, 5);
+	SELFTEST_ASSERT(CHANNEL_HasChannelPinWithRole(1, IOR_Relay) == false);
+	SELFTEST_ASSERT(CHANNEL_HasChannelPinWithRole(1, IOR_Relay_n));
+	SELFTEST_ASSERT(CHANNEL_HasChannelPinWithRole(5, IOR_Relay));
+	CMD_ExecuteCommand("setChannel 1 1", 0);
+	CMD_ExecuteCommand("setChannel 5 1", 0);
+	SELFTEST_ASSERT_PIN_BOOLEAN(PIN_RELAY_n, false);
+	SELFTEST_ASSERT_PIN_BOOLEAN(PIN_RELAY, true);
+
+	// clearing a role removes the pin from its channel
+	PIN_SetPinRoleForPinIndex(PIN_LED_n, IOR_None);
+	SELFTEST_ASSERT(CHANNEL_IsInUse(2) == false);
+	SELFTEST_ASSERT(CHANNEL_FindMaxValueForChannel(2) == 1);
+
+	CMD_ExecuteCommand("clearIO", 0);
+	SELFTEST_ASSERT(CHANNEL_IsInUse(1) == false);
+	SELFTEST_ASSERT(CHANNEL_IsInUse(3) == false);
+	SELFTEST_ASSERT(CHANNEL_IsPowerRelayChannel(5) == false);
+}
+
 
 #endif
@@ -1,6 +1,6 @@
 #ifdef WINDOWS
 
-#include "selftest_local.h".
+#include "selftest_local.h"
 
 void Test_RepeatingEvents() {
 	// reset whole device
@@ -22,5 +22,97 @@ void Test_RepeatingEvents() {
 	SELFTEST_ASSERT_CHANNEL(11, 2);
 }
 
+#define WHEEL_TEST_TIMERS 1000
+
+static timerWheel_t *g_testWheel;
+static unsigned int g_testLastFired;
+static int g_testFiredCount;
+static int g_testOrderErrors;
+static int g_testDriftErrors;
+
+static void Test_TimerWheel_OnTimer(timerWheelEntry_t *t) {
+	// fired exactly at its time?
+	if (t->expires != g_testWheel->now) {
+		g_testDriftErrors++;
+	}
+	if (g_testFiredCount > 0 && (int)(t->expires - g_testLastFired) < 0) {
+		g_testOrderErrors++;
+	}
+	g_testLastFired = t->expires;
+	g_testFiredCount++;
+	// mark as fired
+	t->userData = 0;
+}
+void Test_RepeatingEvents_TimerWheel() {
+	static timerWheel_t wheel;
+	static timerWheelEntry_t timers[WHEEL_TEST_TIMERS];
+	unsigned int start;
+	unsigned int last;
+	int i;
+	int step;
+	int canceled;
+
+	memset(&wheel, 0, sizeof(wheel));
+	memset(timers, 0, sizeof(timers));
+	g_testWheel = &wheel;
+	g_testFiredCount = 0;
+	g_testOrderErrors = 0;
+	g_testDriftErrors = 0;
+
+	// start close to the 32 bit wrap of the millisecond counter
+	wheel.now = 0xFFFFFFFF - 5000;
+	start = wheel.now;
+	last = start;
+	for (i = 0; i < WHEEL_TEST_TIMERS; i++) {
+		timers[i].callback = Test_TimerWheel_OnTimer;
+		timers[i].userData = &timers[i];
+		// spread from a few ms up to over 5 hours, so every level (and parking) is used
+		TimerWheel_Add(&wheel, &timers[i], start + 1 + (unsigned int)(i * 7919 % WHEEL_TEST_TIMERS) * 20011 + i % 7);
+		if ((int)(timers[i].expires - last) > 0) {
+			last = timers[i].expires;
+		}
+	}
+	// cancel every tenth timer
+	canceled = 0;
+	for (i = 0; i < WHEEL_TEST_TIMERS; i += 10) {
+		TimerWheel_Cancel(&wheel, &timers[i]);
+		canceled++;
+	}
+	SELFTEST_ASSERT(TimerWheel_IsPending(&timers[1]));
+	SELFTEST_ASSERT(!TimerWheel_IsPending(&timers[10]));
+
+	// advance with uneven steps, like the real quick tick does
+	step = 1;
+	while ((int)(last - wheel.now) >= 0) {
+		TimerWheel_Advance(&wheel, step);
+		step = step * 7 % 1013 + 1;
+	}
+	SELFTEST_ASSERT(g_testFiredCount == WHEEL_TEST_TIMERS - canceled);
+	SELFTEST_ASSERT(g_testOrderErrors == 0);
+	SELFTEST_ASSERT(g_testDriftErrors == 0);
+	for (i = 0; i < WHEEL_TEST_TIMERS; i++) {
+		SELFTEST_ASSERT(!TimerWheel_IsPending(&timers[i]));
+		if (i % 10 == 0) {
+			SELFTEST_ASSERT(timers[i].userData != 0);
+		}
+		else {
+			SELFTEST_ASSERT(timers[i].userData == 0);
+		}
+	}
+
+	// repeating events are scheduled from their planned time, so the count is exact
+	SIM_ClearOBK(0);
+	CMD_ExecuteCommand("addRepeatingEvent 0.3 -1 addChannel 12 1", 0);
+	CMD_ExecuteCommand("addRepeatingEventID 0.7 -1 55 addChannel 13 1", 0);
+	Sim_RunSeconds(30.0f, false);
+	SELFTEST_ASSERT_CHANNEL(12, 100);
+	SELFTEST_ASSERT_CHANNEL(13, 42);
+	CMD_ExecuteCommand("cancelRepeatingEvent 55", 0);
+	SELFTEST_ASSERT(RepeatingEvents_GetActiveCount() == 1);
+	Sim_RunSeconds(3.0f, false);
+	SELFTEST_ASSERT_CHANNEL(12, 110);
+	SELFTEST_ASSERT_CHANNEL(13, 42);
+}
+
 
 #endif
@@ -1,6 +1,6 @@
 #ifdef WINDOWS
 
-#include "selftest_local.h".
+#include "selftest_local.h"
 
 const char *demo_loop_1 =
 "setChannel 10 0\r\n"
@@ -28,6 +28,26 @@ const char *demo_loop_3 =
 "    if $CH20>0 then goto again\r\n"
 "    setChannel 0 0\r\n";
 
+// labels out of order, comments, a label that is never reached
+// and a jump over it - checks the label index of loaded script,
+// long label names wrap the hash around
+const char *demo_labels =
+"// comment at the start\r\n"
+"setChannel 30 0\r\n"
+"goto secondLabelWithALongName\r\n"
+"first:\r\n"
+"    // inside\r\n"
+"    addChannel 30 100\r\n"
+"    goto done\r\n"
+"secondLabelWithALongName:\r\n"
+"    addChannel 31 1\r\n"
+"    if $CH31<50 then goto secondLabelWithALongName\r\n"
+"    goto first\r\n"
+"unused:\r\n"
+"    setChannel 30 666\r\n"
+"done:\r\n"
+"    setChannel 32 1\r\n";
+
 void Test_Scripting_Loop1() {
 	char buffer[64];
 
@@ -108,10 +128,41 @@ void Test_Scripting_Loop3() {
 	SELFTEST_ASSERT_CHANNEL(20, 0);
 	//system("pause");
 }
+void Test_Scripting_Labels() {
+	// reset whole device
+	SIM_ClearOBK(0);
+	CMD_ExecuteCommand("lfs_format", 0);
+
+	Test_FakeHTTPClientPacket_POST("api/lfs/demo_labels.txt", demo_labels);
+
+	// 50 loops take 150 lines, so with default budget of 10 lines per tick
+	// it can't be done within 5 frames
+	CMD_ExecuteCommand("startScript demo_labels.txt", 0);
+	Sim_RunFrames(5, false);
+	SELFTEST_ASSERT_INTEGER(CMD_GetCountActiveScriptThreads(), 1);
+	SELFTEST_ASSERT_CHANNEL(32, 0);
+	// but with larger budget it can
+	CMD_ExecuteCommand("scriptBudget 100", 0);
+	Sim_RunFrames(2, false);
+	SELFTEST_ASSERT_INTEGER(CMD_GetCountActiveScriptThreads(), 0);
+	SELFTEST_ASSERT_CHANNEL(30, 100);
+	SELFTEST_ASSERT_CHANNEL(31, 50);
+	SELFTEST_ASSERT_CHANNEL(32, 1);
+
+	// start at given label, same file is not loaded again
+	CMD_ExecuteCommand("startScript demo_labels.txt first", 0);
+	Sim_RunFrames(2, false);
+	SELFTEST_ASSERT_INTEGER(CMD_GetCountActiveScriptThreads(), 0);
+	SELFTEST_ASSERT_CHANNEL(30, 200);
+	SELFTEST_ASSERT_CHANNEL(31, 50);
+
+	CMD_ExecuteCommand("scriptBudget 10", 0);
+}
 void Test_Scripting() {
 	Test_Scripting_Loop1();
 	Test_Scripting_Loop2();
 	Test_Scripting_Loop3();
+	Test_Scripting_Labels();
 }
 
 #endif
@@ -1,7 +1,9 @@
 
 #ifdef WINDOWS
 
-#include "selftest_local.h".
+#include "selftest_local.h"
+#include "../driver/drv_tuyaMCU.h"
+#include "../driver/drv_uart.h"
 
 void Test_TuyaMCU_Basic() {
 	// reset whole device
@@ -40,8 +42,273 @@ void Test_TuyaMCU_Basic() {
 	// Now, channel 15 should be set to 120...
 	SELFTEST_ASSERT_CHANNEL(15, 120);
 
+	// OnUART handlers get the packet as a hex string
+	CMD_ExecuteCommand("addEventHandler OnUART 55AA03070008020200040000006E87 setChannel 20 1", 0);
+	CMD_ExecuteCommand("uartFakeHex 55AA03070008020200040000006E87", 0);
+	Sim_RunFrames(1000, false);
+	SELFTEST_ASSERT_CHANNEL(15, 110);
+	SELFTEST_ASSERT_CHANNEL(20, 1);
+
+	// linking fnID 2 again moves it to channel 16
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 2 val 16", 0);
+	SELFTEST_ASSERT(TuyaMCU_IsChannelUsedByTuyaMCU(16));
+	SELFTEST_ASSERT(TuyaMCU_IsChannelUsedByTuyaMCU(15) == false);
+	CMD_ExecuteCommand("uartFakeHex 55AA0307000802020004000000647D", 0);
+	Sim_RunFrames(1000, false);
+	SELFTEST_ASSERT_CHANNEL(16, 100);
+	SELFTEST_ASSERT_CHANNEL(15, 110);
+	// a second fnID on the same channel does not hide the first one
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 3 val 16", 0);
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 3 val 17", 0);
+	SELFTEST_ASSERT(TuyaMCU_IsChannelUsedByTuyaMCU(16));
+	SELFTEST_ASSERT(TuyaMCU_IsChannelUsedByTuyaMCU(17));
+
 	// cause error
 	//SELFTEST_ASSERT_CHANNEL(15, 666);
 }
 
+// looks for a frame among everything sent so far, and consumes up to its end
+static bool Test_TuyaMCU_HasSent(const char *hex) {
+	byte frame[64];
+	int len, i, start;
+
+	len = 0;
+	while (*hex) {
+		frame[len++] = hexbyte(hex);
+		hex += 2;
+	}
+	for (start = 0; start + len <= SIM_UART_GetDataSize(); start++) {
+		for (i = 0; i < len; i++) {
+			if (SIM_UART_GetNextByte(start + i) != frame[i])
+				break;
+		}
+		if (i == len) {
+			SIM_UART_ConsumeBytes(start + len);
+			return true;
+		}
+	}
+	return false;
+}
+
+void Test_TuyaMCU_TxQueue() {
+	const tuyaMCUTxStats_t *stats;
+	int initCounter;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+	SIM_UART_InitReceiveRingBuffer(1024);
+	CMD_ExecuteCommand("startDriver TuyaMCU", 0);
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 2 val 15", 0);
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 3 val 16", 0);
+	stats = TuyaMCU_GetTxStats();
+	initCounter = g_uart_init_counter;
+	SIM_ClearUART();
+
+	// first write goes out right away
+	CMD_ExecuteCommand("setChannel 15 10", 0);
+	SELFTEST_ASSERT(Test_TuyaMCU_HasSent("55AA000600080202000400" "00000A1F"));
+	// a fast slider only sends the value it ends at
+	CMD_ExecuteCommand("setChannel 15 20", 0);
+	CMD_ExecuteCommand("setChannel 15 30", 0);
+	CMD_ExecuteCommand("setChannel 15 40", 0);
+	SELFTEST_ASSERT(stats->depth == 1);
+	SELFTEST_ASSERT(stats->coalesced == 2);
+	Sim_RunFrames(20, false);
+	SELFTEST_ASSERT(Test_TuyaMCU_HasSent("55AA00060008020200040000001429") == false);
+	SELFTEST_ASSERT(Test_TuyaMCU_HasSent("55AA00060008020200040000001E33") == false);
+	SELFTEST_ASSERT(Test_TuyaMCU_HasSent("55AA0006000802020004000000283D"));
+	SELFTEST_ASSERT(stats->depth == 0);
+	SELFTEST_ASSERT(stats->maxLatencyMs >= 50);
+
+	// dpId 2 keeps its place before dpId 3
+	CMD_ExecuteCommand("setChannel 15 41", 0);
+	CMD_ExecuteCommand("setChannel 15 42", 0);
+	CMD_ExecuteCommand("setChannel 16 7", 0);
+	CMD_ExecuteCommand("setChannel 15 43", 0);
+	Sim_RunFrames(40, false);
+	SELFTEST_ASSERT(Test_TuyaMCU_HasSent("55AA0006000802020004000000293E"));
+	SELFTEST_ASSERT(Test_TuyaMCU_HasSent("55AA00060008020200040000002B40"));
+	SELFTEST_ASSERT(Test_TuyaMCU_HasSent("55AA0006000803020004000000071D"));
+	SELFTEST_ASSERT(stats->sent == 5);
+	// sending does not initialize the UART again
+	SELFTEST_ASSERT(g_uart_init_counter == initCounter);
+
+	// next write waits for the MCU to report dpId 2 back
+	CMD_ExecuteCommand("tuyaMcu_setTxTiming 0 300 1", 0);
+	// rejected values leave the timing as it was
+	SELFTEST_ASSERT(CMD_ExecuteCommand("tuyaMcu_setTxTiming 0 -1 5", 0) == CMD_RES_BAD_ARGUMENT);
+	SIM_ClearUART();
+	CMD_ExecuteCommand("setChannel 15 50", 0);
+	CMD_ExecuteCommand("setChannel 16 8", 0);
+	SELFTEST_ASSERT(Test_TuyaMCU_HasSent("55AA00060008020200040000003247"));
+	Sim_RunFrames(20, false);
+	SELFTEST_ASSERT(Test_TuyaMCU_HasSent("55AA0006000803020004000000081E") == false);
+	CMD_ExecuteCommand("uartFakeHex 55AA0307000802020004000000324B", 0);
+	Sim_RunFrames(2, false);
+	SELFTEST_ASSERT(Test_TuyaMCU_HasSent("55AA0006000803020004000000081E"));
+	// no report for dpId 3, so it's sent once more and then given up
+	Sim_RunFrames(70, false);
+	SELFTEST_ASSERT(Test_TuyaMCU_HasSent("55AA0006000803020004000000081E"));
+	SELFTEST_ASSERT(stats->retries == 1);
+	Sim_RunFrames(70, false);
+	SELFTEST_ASSERT(stats->ackTimeouts == 1);
+	SELFTEST_ASSERT(stats->depth == 0);
+
+	// a new baud rate initializes the UART once
+	CMD_ExecuteCommand("tuyaMcu_setBaudRate 115200", 0);
+	SELFTEST_ASSERT(g_uart_init_counter == initCounter + 1);
+	CMD_ExecuteCommand("setChannel 15 60", 0);
+	SELFTEST_ASSERT(g_uart_init_counter == initCounter + 1);
+
+	SELFTEST_ASSERT(CMD_ExecuteCommand("tuyaMcu_txStats reset", 0) == CMD_RES_OK);
+	SELFTEST_ASSERT(stats->sent == 0);
+}
+
+void Test_TuyaMCU_Fuzz() {
+	// dpId 2 of type Value set to 666, only ever sent damaged
+	byte poison[] = { 0x02, 0x02, 0x00, 0x04, 0x00, 0x00, 0x02, 0x9A };
+	byte report[] = { 0x02, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00 };
+	byte heartbeat[] = { 0x01 };
+	const tuyaMCUParserStats_t *stats;
+	unsigned int seed = 1234;
+	int i;
+	int value;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+	CMD_ExecuteCommand("startDriver TuyaMCU", 0);
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 2 val 15", 0);
+	stats = TuyaMCU_GetParserStats();
+
+	// length is big endian, this one has 264 bytes of payload
+	CMD_ExecuteCommand("uartFakeHex 55AA0307010802020004000000647D", 0);
+	TuyaMCU_RunFrame();
+	SELFTEST_ASSERT(stats->oversizeFrames == 1);
+	SELFTEST_ASSERT(stats->frames == 0);
+	SELFTEST_ASSERT_CHANNEL(15, 0);
+	// bad checksum
+	CMD_ExecuteCommand("uartFakeHex 55AA0307000802020004000000647E", 0);
+	TuyaMCU_RunFrame();
+	SELFTEST_ASSERT(stats->badChecksums == 1);
+	SELFTEST_ASSERT_CHANNEL(15, 0);
+	// garbage before a good frame is skipped in one go
+	CMD_ExecuteCommand("uartFakeHex 0102035500AA55AA0307000802020004000000647D", 0);
+	TuyaMCU_RunFrame();
+	SELFTEST_ASSERT(stats->frames == 1);
+	SELFTEST_ASSERT_CHANNEL(15, 100);
+
+	// every good frame gets through the noise, and no damaged one does
+	for (i = 0; i < 400; i++) {
+		TuyaMCUSimulator_AppendNoise(&seed, poison, sizeof(poison));
+		value = 1000 + i;
+		report[6] = value >> 8;
+		report[7] = value & 0xFF;
+		TuyaMCUSimulator_AppendFrame(0x03, 0x07, report, sizeof(report));
+		if (UART_GetDataSize() > 128) {
+			TuyaMCU_RunFrame();
+			SELFTEST_ASSERT(CHANNEL_Get(15) != 666);
+		}
+	}
+	// frames held back by a bogus length are found once enough data follows
+	for (i = 0; i < 20; i++) {
+		TuyaMCUSimulator_AppendFrame(0x03, 0x00, heartbeat, sizeof(heartbeat));
+		TuyaMCU_RunFrame();
+	}
+	SELFTEST_ASSERT_CHANNEL(15, value);
+	SELFTEST_ASSERT(stats->frames == 1 + 400 + 20);
+	SELFTEST_ASSERT(stats->badChecksums > 1);
+	SELFTEST_ASSERT(stats->oversizeFrames > 1);
+	SELFTEST_ASSERT(stats->resyncs > 1);
+	SELFTEST_ASSERT(UART_GetDataSize() == 0);
+
+	SELFTEST_ASSERT(CMD_ExecuteCommand("tuyaMcu_parserStats reset", 0) == CMD_RES_OK);
+	SELFTEST_ASSERT(stats->frames == 0);
+}
+
+void Test_TuyaMCU_RxRingBuffer() {
+	byte stream[200];
+	byte out[200];
+	const byte* data;
+	const uartStats_t* stats;
+	int i, len;
+	byte report[] = { 0x02, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00 };
+
+	SIM_ClearOBK(0);
+	stats = UART_GetStats();
+	SELFTEST_ASSERT(CMD_ExecuteCommand("uartStats reset", 0) == CMD_RES_OK);
+
+	// size is rounded up to power of two
+	UART_InitReceiveRingBuffer(100);
+	SELFTEST_ASSERT(UART_GetReceiveRingBufferSize() == 128);
+	for (i = 0; i < sizeof(stream); i++) {
+		stream[i] = i;
+	}
+	UART_AppendBytesToCircularBuffer(stream, 100);
+	SELFTEST_ASSERT(UART_GetDataSize() == 100);
+	SELFTEST_ASSERT(UART_PeekSpan(0, &data) == 100);
+	SELFTEST_ASSERT(data[0] == 0 && data[99] == 99);
+	SELFTEST_ASSERT(UART_ReadSpan(out, 90) == 90);
+	SELFTEST_ASSERT(out[89] == 89);
+	// this one wraps around the end of the ring
+	UART_AppendBytesToCircularBuffer(stream + 100, 100);
+	SELFTEST_ASSERT(UART_GetDataSize() == 110);
+	SELFTEST_ASSERT(UART_PeekSpan(0, &data) == 128 - 90);
+	SELFTEST_ASSERT(data[0] == 90);
+	SELFTEST_ASSERT(UART_PeekSpan(128 - 90, &data) == 110 - (128 - 90));
+	SELFTEST_ASSERT(data[0] == 128);
+	SELFTEST_ASSERT(UART_PeekSpan(110, &data) == 0);
+	SELFTEST_ASSERT(UART_GetNextByte(109) == 199);
+	SELFTEST_ASSERT(UART_ReadSpan(out, sizeof(out)) == 110);
+	for (i = 0; i < 110; i++) {
+		SELFTEST_ASSERT(out[i] == 90 + i);
+	}
+	SELFTEST_ASSERT(UART_GetDataSize() == 0);
+
+	// whole ring can be filled, the rest is counted as dropped
+	SELFTEST_ASSERT(stats->droppedBytes == 0);
+	SELFTEST_ASSERT(stats->maxFill == 110);
+	UART_AppendBytesToCircularBuffer(stream, 200);
+	SELFTEST_ASSERT(UART_GetDataSize() == 128);
+	SELFTEST_ASSERT(stats->droppedBytes == 72);
+	SELFTEST_ASSERT(stats->overflows == 1);
+	SELFTEST_ASSERT(stats->maxFill == 128);
+	UART_ConsumeBytes(1000);
+	SELFTEST_ASSERT(UART_GetDataSize() == 0);
+	SELFTEST_ASSERT(CMD_ExecuteCommand("uartStats reset", 0) == CMD_RES_OK);
+	SELFTEST_ASSERT(stats->droppedBytes == 0);
+
+	// replay a burst of reports larger than the old 256 byte buffer,
+	// all of it arriving before TuyaMCU gets a chance to parse it
+	CMD_ExecuteCommand("startDriver TuyaMCU", 0);
+	CMD_ExecuteCommand("linkTuyaMCUOutputToChannel 2 val 15", 0);
+	SELFTEST_ASSERT(UART_GetReceiveRingBufferSize() >= 1024);
+	for (i = 0; i < 40; i++) {
+		report[7] = i + 1;
+		TuyaMCUSimulator_AppendFrame(0x03, 0x07, report, sizeof(report));
+	}
+	len = UART_GetDataSize();
+	SELFTEST_ASSERT(len == 40 * 15);
+	TuyaMCU_RunFrame();
+	SELFTEST_ASSERT_CHANNEL(15, 40);
+	SELFTEST_ASSERT(UART_GetDataSize() == 0);
+	// the next burst wraps the ring, frames must still parse
+	for (i = 0; i < 40; i++) {
+		report[7] = 100 + i;
+		TuyaMCUSimulator_AppendFrame(0x03, 0x07, report, sizeof(report));
+	}
+	TuyaMCU_RunFrame();
+	SELFTEST_ASSERT_CHANNEL(15, 139);
+	SELFTEST_ASSERT(stats->droppedBytes == 0);
+	SELFTEST_ASSERT(stats->overflows == 0);
+
+	// buffer can be made larger for a running driver
+	SELFTEST_ASSERT(CMD_ExecuteCommand("uartRxBufferSize 3000", 0) == CMD_RES_OK);
+	SELFTEST_ASSERT(UART_GetReceiveRingBufferSize() == 4096);
+	// but not smaller than the driver asked for
+	SELFTEST_ASSERT(CMD_ExecuteCommand("uartRxBufferSize 100", 0) == CMD_RES_OK);
+	SELFTEST_ASSERT(UART_GetReceiveRingBufferSize() == 1024);
+	SELFTEST_ASSERT(CMD_ExecuteCommand("uartRxBufferSize 0", 0) == CMD_RES_OK);
+	SELFTEST_ASSERT(UART_GetReceiveRingBufferSize() == 1024);
+}
+
 #endif
@@ -1,6 +1,7 @@
 #ifdef WINDOWS
 
 #include "selftest_local.h"
+#include "../driver/drv_tuyaMCU.h"
 
 
 void Test_TuyaMCU_BatteryPowered_Style1() {
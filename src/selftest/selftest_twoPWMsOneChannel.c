@@ -1,6 +1,6 @@
 #ifdef WINDOWS
 
-#include "selftest_local.h".
+#include "selftest_local.h"
 
 // This will allow us to treat multiple PWMs on a single channel as one PWM channel.
 // Thanks to this users can turn for example RGB LED controller
@@ -20,22 +20,79 @@ void Test_TwoPWMsOneChannel_Test1() {
 	PIN_get_Relay_PWM_Count(0, &pwmCount, 0);
 
 	// two PWMs on one channel counts as one PWM
-	SELFTEST_ASSERT(pwmCount, 1);
+	SELFTEST_ASSERT_INTEGER(pwmCount, 1);
 
 	PIN_SetPinChannelForPinIndex(12, 0);
 	PIN_SetPinRoleForPinIndex(12, IOR_PWM);
 
 	PIN_get_Relay_PWM_Count(0, &pwmCount, 0);
 	// three PWMs on one channel counts as one PWM
-	SELFTEST_ASSERT(pwmCount, 1);
+	SELFTEST_ASSERT_INTEGER(pwmCount, 1);
 
 	PIN_SetPinChannelForPinIndex(12, 1);
 	// now we have two channels with 3 pwms
 	PIN_get_Relay_PWM_Count(0, &pwmCount, 0);
-	SELFTEST_ASSERT(pwmCount, 2);
+	SELFTEST_ASSERT_INTEGER(pwmCount, 2);
+}
+// PWM duty is written only when it changes, and PIN_ticks doesn't poll PWMs
+void Test_TwoPWMsOneChannel_DirtyWrites() {
+	const pinTickStats_t *stats;
+	int writes;
+
+	// reset whole device
+	SIM_ClearOBK(0);
+	stats = PIN_GetTickStats();
+
+	PIN_SetPinChannelForPinIndex(9, 0);
+	PIN_SetPinRoleForPinIndex(9, IOR_PWM);
+	PIN_SetPinChannelForPinIndex(11, 0);
+	PIN_SetPinRoleForPinIndex(11, IOR_PWM_n);
+	PIN_SetPinChannelForPinIndex(10, 1);
+	PIN_SetPinRoleForPinIndex(10, IOR_Button);
+
+	CMD_ExecuteCommand("setChannel 0 40", 0);
+	SELFTEST_ASSERT_INTEGER(SIM_GetPWMValue(9), 40);
+	SELFTEST_ASSERT_INTEGER(SIM_GetPWMValue(11), 60);
+	writes = stats->pwmWrites;
+	Sim_RunFrames(20, false);
+	SELFTEST_ASSERT_INTEGER(stats->pwmWrites, writes);
+
+	// same duty again is skipped
+	CMD_ExecuteCommand("setChannelFloat 0 40", 0);
+	SELFTEST_ASSERT_INTEGER(stats->pwmWrites, writes);
+	CMD_ExecuteCommand("setChannelFloat 0 41", 0);
+	SELFTEST_ASSERT_INTEGER(stats->pwmWrites, writes + 2);
+	SELFTEST_ASSERT_INTEGER(SIM_GetPWMValue(11), 59);
+
+	// restarting PWM on a pin writes its duty again
+	PIN_SetPinRoleForPinIndex(9, IOR_PWM);
+	SELFTEST_ASSERT_INTEGER(stats->pwmWrites, writes + 3);
+
+	// role set before the channel, then moved to another channel
+	CMD_ExecuteCommand("setChannel 2 70", 0);
+	PIN_SetPinRoleForPinIndex(24, IOR_PWM);
+	PIN_SetPinChannelForPinIndex(24, 0);
+	SELFTEST_ASSERT_INTEGER(SIM_GetPWMValue(24), 41);
+	PIN_SetPinChannelForPinIndex(24, 2);
+	SELFTEST_ASSERT_INTEGER(SIM_GetPWMValue(24), 70);
+	PIN_SetPinRoleForPinIndex(26, IOR_PWM_n);
+	PIN_SetPinChannelForPinIndex(26, 2);
+	SELFTEST_ASSERT_INTEGER(SIM_GetPWMValue(26), 30);
+	// and follows that channel afterwards
+	CMD_ExecuteCommand("setChannel 2 20", 0);
+	SELFTEST_ASSERT_INTEGER(SIM_GetPWMValue(24), 20);
+	SELFTEST_ASSERT_INTEGER(SIM_GetPWMValue(26), 80);
+	SELFTEST_ASSERT_INTEGER(SIM_GetPWMValue(9), 41);
+
+	SELFTEST_ASSERT(stats->ticks > 0);
+	SELFTEST_ASSERT(CMD_ExecuteCommand("PinStats reset", 0) == CMD_RES_OK);
+	SELFTEST_ASSERT_INTEGER(stats->ticks, 0);
+	Sim_RunFrames(5, false);
+	SELFTEST_ASSERT(stats->ticks > 0);
 }
 void Test_TwoPWMsOneChannel() {
 	Test_TwoPWMsOneChannel_Test1();
+	Test_TwoPWMsOneChannel_DirtyWrites();
 
 
 }
@@ -10,6 +10,7 @@ extern "C" {
 	bool SIM_IsPinADC(int index);
 	void SIM_SetVoltageOnADCPin(int index, float v);
 	int SIM_GetPWMValue(int index);
+	void SIM_GeneratePinStatesDesc(char *o, int outLen);
 	// flash control simulation
 	void SIM_SetupFlashFileReading(const char *flashPath);
 	void SIM_SaveFlashData(const char *flashPath);
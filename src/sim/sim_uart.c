@@ -35,14 +35,14 @@ int SIM_UART_GetDataSize()
 }
 byte SIM_UART_GetNextByte(int index) {
 	int realIndex = g_recvBufOut + index;
-	if (realIndex > g_recvBufSize)
+	if (realIndex >= g_recvBufSize)
 		realIndex -= g_recvBufSize;
 
 	return g_recvBuf[realIndex];
 }
 void SIM_UART_ConsumeBytes(int idx) {
 	g_recvBufOut += idx;
-	if (g_recvBufOut > g_recvBufSize)
+	if (g_recvBufOut >= g_recvBufSize)
 		g_recvBufOut -= g_recvBufSize;
 }
 
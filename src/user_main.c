@@ -702,7 +702,7 @@ void QuickTick(void* param)
 #if (defined WINDOWS) || (defined PLATFORM_BEKEN)
 	SVM_RunThreads(g_deltaTimeMS);
 #endif
-	RepeatingEvents_RunUpdate(g_deltaTimeMS * 0.001f);
+	RepeatingEvents_RunUpdate(g_deltaTimeMS);
 #ifndef OBK_DISABLE_ALL_DRIVERS
 	DRV_RunQuickTick();
 #endif
@@ -1,10 +1,16 @@
 #ifndef _FLASH_PUB_H
 #define _FLASH_PUB_H
 
-#include <conio.h>
 #include <stdio.h>
 #include <stdint.h>
+#if LINUX
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+#else
+#include <conio.h>
 #include <BaseTsd.h>
+#endif
 
 #define FLASH_DEV_NAME                ("flash")
 
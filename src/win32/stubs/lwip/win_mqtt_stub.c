@@ -875,7 +875,7 @@ mqtt_create_request(struct mqtt_request_t *r_objs, size_t r_objs_len, u16_t pkt_
 err_t mqtt_sub_unsub(mqtt_client_t *client, const char *topic, u8_t qos, mqtt_request_cb_t cb, void *arg, u8_t sub) {
 
 	if (MQTT_IsFakingOnlineMQTT())
-		return;
+		return ERR_OK;
 	size_t topic_strlen;
 	size_t total_len;
 	u16_t topic_len;
@@ -1375,7 +1375,7 @@ void WIN_RunMQTTClient(mqtt_client_t *cl) {
 		time.tv_usec = 0;
 		if (select(0, NULL, &fd, NULL, &time) == 1) {
 			int error = 0;
-			int len = sizeof(error);
+			socklen_t len = sizeof(error);
 			getsockopt(cl->conn->sock, SOL_SOCKET, SO_ERROR, (char*)&error, &len);
 			if (error == 0) {
 				printf("MQTT: Connected!\n");
@@ -0,0 +1,6 @@
+// memory functions of the Beken SDK, used by littlefs
+#include <stdlib.h>
+#ifndef os_malloc
+#define os_malloc malloc
+#define os_free free
+#endif
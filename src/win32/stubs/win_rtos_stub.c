@@ -1,25 +1,87 @@
 #ifdef WINDOWS
 
 #include "../../new_common.h"
+#if !LINUX
 #include <timeapi.h>
+#endif
 
 DWORD startTime = 0;
 
-int xSemaphoreTake(int semaphore, int blockTime) {
+#if LINUX
+#include <pthread.h>
+#include <sys/time.h>
+
+void Sleep(int ms) {
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	nanosleep(&ts, 0);
+}
+DWORD timeGetTime() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (DWORD)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+#endif
+
+int xSemaphoreTake(SemaphoreHandle_t semaphore, int blockTime) {
 	return 1;
 }
-int xSemaphoreCreateMutex() {
+SemaphoreHandle_t xSemaphoreCreateMutex() {
 	return 0;
 }
-int xSemaphoreGive(int semaphore) {
+int xSemaphoreGive(SemaphoreHandle_t semaphore) {
 	return 0;
 }
-int rtos_delay_milliseconds(int sec) {
-	Sleep(sec);
+// queues never block, the simulator runs single threaded
+typedef struct simQueue_s {
+	int length;
+	int itemSize;
+	int first;
+	int count;
+	char data[1];
+} simQueue_t;
+
+xQueueHandle xQueueCreate(int length, int itemSize) {
+	simQueue_t *q;
+
+	q = (simQueue_t*)malloc(sizeof(simQueue_t) + length * itemSize);
+	if (q == 0)
+		return 0;
+	q->length = length;
+	q->itemSize = itemSize;
+	q->first = 0;
+	q->count = 0;
+	return q;
+}
+int xQueueSend(xQueueHandle handle, const void *item, portTickType ticks) {
+	simQueue_t *q = (simQueue_t*)handle;
+
+	if (q->count >= q->length)
+		return pdFALSE;
+	memcpy(q->data + ((q->first + q->count) % q->length) * q->itemSize, item, q->itemSize);
+	q->count++;
+	return pdTRUE;
+}
+int xQueueReceive(xQueueHandle handle, void *item, portTickType ticks) {
+	simQueue_t *q = (simQueue_t*)handle;
+
+	if (q->count == 0)
+		return pdFALSE;
+	memcpy(item, q->data + q->first * q->itemSize, q->itemSize);
+	q->first = (q->first + 1) % q->length;
+	q->count--;
+	return pdTRUE;
+}
+int uxQueueMessagesWaiting(xQueueHandle handle) {
+	return ((simQueue_t*)handle)->count;
+}
+int rtos_delay_milliseconds(int ms) {
+	Sleep(ms);
 	return 0;
 }
-int delay_ms(int sec) {
-	Sleep(sec);
+int delay_ms(int ms) {
+	Sleep(ms);
 	return 0;
 }
 
@@ -57,13 +119,22 @@ int hal_machw_time_past(int tt) {
 		return 0;
 	return 1;
 }
-int rtos_create_thread(int *out, int prio, const char *name, LPTHREAD_START_ROUTINE function, int stackSize, void *arg) {
-	int handle;
-	handle = CreateThread(NULL, 0, function, arg, 0, NULL);
-	return 0;
+#if LINUX
+OSStatus rtos_create_thread(beken_thread_t *out, int prio, const char *name, beken_thread_function_t function, int stackSize, beken_thread_arg_t arg) {
+	pthread_t handle;
+	if (pthread_create(&handle, NULL, (void *(*)(void *))function, arg) != 0)
+		return 1;
+	pthread_detach(handle);
+	return kNoErr;
+}
+#else
+OSStatus rtos_create_thread(beken_thread_t *out, int prio, const char *name, beken_thread_function_t function, int stackSize, beken_thread_arg_t arg) {
+	CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)function, arg, 0, NULL);
+	return kNoErr;
 }
-void rtos_delete_thread(int i) {
-	
+#endif
+OSStatus rtos_delete_thread(beken_thread_t *thread) {
+	return kNoErr;
 }
 int lwip_fcntl(int s, int cmd, int val) {
 	int argp;
@@ -4,25 +4,42 @@
 
 #define WIN32_LEAN_AND_MEAN
 
+#if !LINUX
 #include <windows.h>
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#endif
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 #include "new_common.h"
-#include "driver\drv_public.h"
-#include "cmnds\cmd_public.h"
-#include "httpserver\new_http.h"
-#include "hal\hal_flashVars.h"
+#include "driver/drv_public.h"
+#include "cmnds/cmd_public.h"
+#include "httpserver/new_http.h"
+#include "hal/hal_flashVars.h"
 #include "new_pins.h"
+#include "selftest/selftest_local.h"
+#include "driver/drv_uart.h"
+#include "littlefs/our_lfs.h"
+#include "logging/logging.h"
+#if !LINUX
 #include <timeapi.h>
+#endif
+
+// win32/stubs/lwip/win_mqtt_stub.c
+void WIN_ResetMQTT();
+void WIN_RunMQTTFrame();
+// httpserver/http_tcp_server_nonblocking.c
+void HTTPServer_RunQuickTick();
 
 #define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
 
+#if !LINUX
 // Need to link with Ws2_32.lib
 #pragma comment (lib, "Ws2_32.lib")
 // #pragma comment (lib, "Mswsock.lib")
 #pragma comment (lib, "Winmm.lib")
+#endif
 
 int accum_time = 0;
 int win_frameNum = 0;
@@ -123,60 +140,101 @@ void SIM_ClearOBK(const char *flashPath) {
 	if (flashPath) {
 		SIM_SetupFlashFileReading(flashPath);
 	}
+	SIM_FlashVars_Clear();
 	bObkStarted = true;
 	Main_Init();
 }
+extern int g_selfTestErrors;
+int g_selfTestsRun = 0;
+int g_selfTestsFailed = 0;
+
+// runs single selftest and prints how much CPU time it took,
+// so host builds can be used to track slow paths
+void Win_RunUnitTest(const char *name, void (*test)()) {
+	int errorsBefore = g_selfTestErrors;
+	clock_t start = clock();
+	bool bFailed;
+
+	test();
+	bFailed = g_selfTestErrors != errorsBefore;
+	g_selfTestsRun++;
+	if (bFailed) {
+		g_selfTestsFailed++;
+	}
+	printf("[%s] %s - %.3f ms\n", bFailed ? "FAIL" : " OK ", name,
+		(double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+}
+#define WIN_RUN_TEST(test) Win_RunUnitTest(#test, test)
+
 void Win_DoUnitTests() {
-	Test_TuyaMCU_BatteryPowered();
-	Test_JSON_Lib();
-	Test_MQTT_Get_LED_EnableAll();
-	Test_Commands_Startup();
-	Test_IF_Inside_Backlog();
-	Test_WaitFor();
-	Test_TwoPWMsOneChannel();
-	Test_ClockEvents();
-	Test_HassDiscovery_Base();
-	Test_HassDiscovery();
-	Test_HassDiscovery_Ext();
-	Test_Role_ToggleAll_2();
-	Test_Demo_ButtonToggleGroup();
-	Test_Demo_ButtonScrollingChannelValues();
-	Test_CFG_Via_HTTP();
-	Test_Commands_Calendar();
-	Test_Commands_Generic();
-	Test_Demo_SimpleShuttersScript();
-	Test_Role_ToggleAll();
-	Test_Demo_FanCyclingRelays();
-	Test_Demo_MapFanSpeedToRelays();
-	Test_MapRanges();
-	Test_Demo_ExclusiveRelays();
-	Test_MultiplePinsOnChannel();
-	Test_Flags();
-	Test_DHT();
-	Test_EnergyMeter();
-	Test_Tasmota();
-	Test_NTP();
-	Test_MQTT();
-	Test_HTTP_Client();
-	Test_ExpandConstant();
-	Test_ChangeHandlers_MQTT();
-	Test_ChangeHandlers();
-	Test_RepeatingEvents();
-	Test_ButtonEvents();
-	Test_Commands_Alias();
-	Test_Expressions_RunTests_Basic();
-	Test_LEDDriver();
-	Test_LFS();
-	Test_Scripting();
-	Test_Commands_Channels();
-	Test_Command_If();
-	Test_Command_If_Else(); 
-	Test_Tokenizer();
-	Test_Http();
-	Test_DeviceGroups();
+#if LINUX
+	// clock event selftests were written against Central European local time
+	setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+	tzset();
+#endif
+	WIN_RUN_TEST(Test_TuyaMCU_BatteryPowered);
+	WIN_RUN_TEST(Test_JSON_Lib);
+	WIN_RUN_TEST(Test_MQTT_Get_LED_EnableAll);
+	WIN_RUN_TEST(Test_Commands_Startup);
+	WIN_RUN_TEST(Test_IF_Inside_Backlog);
+	WIN_RUN_TEST(Test_WaitFor);
+	WIN_RUN_TEST(Test_TwoPWMsOneChannel);
+	WIN_RUN_TEST(Test_ClockEvents);
+	WIN_RUN_TEST(Test_ClockEvents_CatchUp);
+	WIN_RUN_TEST(Test_HassDiscovery_Base);
+	WIN_RUN_TEST(Test_HassDiscovery);
+	WIN_RUN_TEST(Test_HassDiscovery_Ext);
+	WIN_RUN_TEST(Test_Role_ToggleAll_2);
+	WIN_RUN_TEST(Test_Demo_ButtonToggleGroup);
+	WIN_RUN_TEST(Test_Demo_ButtonScrollingChannelValues);
+	WIN_RUN_TEST(Test_CFG_Via_HTTP);
+	WIN_RUN_TEST(Test_Commands_Calendar);
+	WIN_RUN_TEST(Test_Commands_Generic);
+	WIN_RUN_TEST(Test_Demo_SimpleShuttersScript);
+	WIN_RUN_TEST(Test_Role_ToggleAll);
+	WIN_RUN_TEST(Test_Demo_FanCyclingRelays);
+	WIN_RUN_TEST(Test_Demo_MapFanSpeedToRelays);
+	WIN_RUN_TEST(Test_MapRanges);
+	WIN_RUN_TEST(Test_Demo_ExclusiveRelays);
+	WIN_RUN_TEST(Test_MultiplePinsOnChannel);
+	WIN_RUN_TEST(Test_MultiplePinsOnChannel_Index);
+	WIN_RUN_TEST(Test_Flags);
+	WIN_RUN_TEST(Test_DHT);
+	WIN_RUN_TEST(Test_EnergyMeter);
+	WIN_RUN_TEST(Test_Drivers);
+	WIN_RUN_TEST(Test_Tasmota);
+	WIN_RUN_TEST(Test_NTP);
+	WIN_RUN_TEST(Test_MQTT);
+	WIN_RUN_TEST(Test_HTTP_Client);
+	WIN_RUN_TEST(Test_ExpandConstant);
+	WIN_RUN_TEST(Test_ChangeHandlers_MQTT);
+	WIN_RUN_TEST(Test_ChangeHandlers);
+	WIN_RUN_TEST(Test_ChangeHandlers_ManyHandlers);
+	WIN_RUN_TEST(Test_RepeatingEvents);
+	WIN_RUN_TEST(Test_RepeatingEvents_TimerWheel);
+	WIN_RUN_TEST(Test_ButtonEvents);
+	WIN_RUN_TEST(Test_Commands_Alias);
+	WIN_RUN_TEST(Test_Expressions_RunTests_Basic);
+	WIN_RUN_TEST(Test_Expressions_Benchmark);
+	WIN_RUN_TEST(Test_Logging);
+	WIN_RUN_TEST(Test_Logging_Benchmark);
+	WIN_RUN_TEST(Test_LEDDriver);
+	WIN_RUN_TEST(Test_LFS);
+	WIN_RUN_TEST(Test_LFS_Benchmark);
+	WIN_RUN_TEST(Test_Scripting);
+	WIN_RUN_TEST(Test_Commands_Channels);
+	WIN_RUN_TEST(Test_Command_If);
+	WIN_RUN_TEST(Test_Command_If_Else);
+	WIN_RUN_TEST(Test_Tokenizer);
+	WIN_RUN_TEST(Test_Http);
+	WIN_RUN_TEST(Test_Http_Benchmark);
+	WIN_RUN_TEST(Test_DeviceGroups);
 
 	// this is slowest
-	Test_TuyaMCU_Basic();
+	WIN_RUN_TEST(Test_TuyaMCU_Basic);
+	WIN_RUN_TEST(Test_TuyaMCU_TxQueue);
+	WIN_RUN_TEST(Test_TuyaMCU_Fuzz);
+	WIN_RUN_TEST(Test_TuyaMCU_RxRingBuffer);
 
 
 
@@ -230,7 +288,9 @@ int __cdecl main(int argc, char **argv)
 					if (i < argc && sscanf(argv[i], "%d", &value) == 1) {
 						g_port = value;
 					}
-				} else if (wal_strnicmp(argv[i] + 1, "w", 1) == 0) {
+				}
+#if !LINUX
+				else if (wal_strnicmp(argv[i] + 1, "w", 1) == 0) {
 					i++;
 
 					if (i < argc && sscanf(argv[i], "%d", &value) == 1) {
@@ -244,6 +304,7 @@ int __cdecl main(int argc, char **argv)
 						SIM_SetWindowH(value);
 					}
 				}
+#endif
 				else if (wal_strnicmp(argv[i] + 1, "runUnitTests", 12) == 0) {
 					i++;
 
@@ -282,6 +343,9 @@ int __cdecl main(int argc, char **argv)
 	printf("sizeof(long double) = %d\n", (int)sizeof(long double));
 	printf("sizeof(led_corr_t) = %d\n", (int)sizeof(led_corr_t));
 	
+#if !LINUX
+	// layout checks - they assume 32-bit long and time_t, like on the devices,
+	// so they are skipped on 64-bit host builds
 	if (sizeof(FLASH_VARS_STRUCTURE) != MAGIC_FLASHVARS_SIZE) {
 		printf("sizeof(FLASH_VARS_STRUCTURE) != MAGIC_FLASHVARS_SIZE!: %i\n", sizeof(FLASH_VARS_STRUCTURE));
 		system("pause");
@@ -379,6 +443,7 @@ int __cdecl main(int argc, char **argv)
 		printf("OFFSETOF(mainConfig_t, unused) != 0x00000C84: %i\n", OFFSETOF(mainConfig_t, unused));
 		system("pause");
 	}
+#endif
 	// Test expansion
 	//CMD_UART_Send_Hex(0,0,"FFAA$CH1$BB",0);
 
@@ -391,8 +456,12 @@ int __cdecl main(int argc, char **argv)
 		Win_DoUnitTests();
 		Sim_RunFrames(50, false);
 		g_bDoingUnitTestsNow = 0;
+		printf("Selftests done - %i run, %i failed\n", g_selfTestsRun, g_selfTestsFailed);
 	}
-
+#if LINUX
+	// headless host build - there is no simulator window, so just report the result
+	return g_selfTestsFailed != 0;
+#else
 
 	SIM_CreateWindow(argc, argv);
 #if 1
@@ -429,6 +498,7 @@ int __cdecl main(int argc, char **argv)
 		}
 	}
 	return 0;
+#endif
 }
 
 // initialise OTA flash starting at startaddr